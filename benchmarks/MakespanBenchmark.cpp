@@ -0,0 +1,91 @@
+#include <benchmark/benchmark.h>
+#include <map>
+#include <stdexcept>
+#include "SyntheticDag.h"
+
+using orchestrator::job_queue::ConfigureInput;
+using orchestrator::job_queue::SchedulingMode;
+using orchestrator::job_queue::Store;
+using namespace orchestrator::benchmarks;
+
+namespace
+{
+
+struct RunningJob
+{
+    int64_t                                       id;
+    int64_t                                       finishTime;
+    std::promise<orchestrator::result::JobResult> promise;
+};
+
+// Run the DAG to completion through the queue's own ordering and result processing on numWorkers simulated
+// executor slots, returning the total number of elapsed time units
+int64_t simulateMakespan(const SyntheticDag& dag, SchedulingMode mode, size_t numWorkers)
+{
+    Store s;
+    s.configure(ConfigureInput::SetSchedulingMode{mode});
+
+    auto                       ids = submitDag(s, dag);
+    std::map<int64_t, int64_t> durations;
+    for (size_t k = 0; k < ids.size(); k++)
+    {
+        durations[ids[k]] = dag.durations[k];
+    }
+
+    int64_t                 now = 0;
+    std::vector<RunningJob> running;
+    while (!s.pendingJobs.empty() || !running.empty())
+    {
+        // Fill free executor slots in queue order
+        dispatchReadyJobs(s, numWorkers - running.size(), [&](int64_t id, auto promise) {
+            running.push_back({.id = id, .finishTime = now + durations[id], .promise = std::move(promise)});
+        });
+        if (running.empty())
+        {
+            throw std::runtime_error("Synthetic DAG deadlocked");
+        }
+
+        // Advance to the next completion and report every job finishing at that time
+        now = std::min_element(running.begin(), running.end(), [](const RunningJob& a, const RunningJob& b) {
+                  return a.finishTime < b.finishTime;
+              })->finishTime;
+        std::erase_if(running, [&](RunningJob& r) {
+            if (r.finishTime != now)
+            {
+                return false;
+            }
+            r.promise.set_value({kJobSucceeded, std::vector<std::string>{}});
+            return true;
+        });
+        s.processPendingJobResults(false);
+    }
+
+    return now;
+}
+
+// Args: {DAG (0 = layered, 1 = chain-and-fan), SchedulingMode}. Wall time covers the whole simulated run; the
+// "makespan" counter is the scheduling quality figure to track
+void BM_DagMakespan(benchmark::State& state)
+{
+    static constexpr size_t kNumWorkers = 4;
+
+    std::mt19937 rng(42);
+    const auto   dag  = state.range(0) == 0 ? layeredDag(20, 20, rng) : chainAndFanDag(40, 200, rng);
+    const auto   mode = static_cast<SchedulingMode>(state.range(1));
+
+    int64_t makespan = 0;
+    for (auto _ : state)
+    {
+        makespan = simulateMakespan(dag, mode, kNumWorkers);
+        benchmark::DoNotOptimize(makespan);
+    }
+    state.SetLabel(dag.name + (mode == SchedulingMode::CRITICAL_PATH ? "/critical-path" : "/priority"));
+    state.counters["jobs"]     = static_cast<double>(dag.blockers.size());
+    state.counters["workers"]  = kNumWorkers;
+    state.counters["makespan"] = static_cast<double>(makespan);
+}
+BENCHMARK(BM_DagMakespan)
+    ->ArgsProduct({{0, 1}, kSchedulingModeArgs})
+    ->Unit(benchmark::kMillisecond);
+
+} // namespace
@@ -0,0 +1,160 @@
+#include <benchmark/benchmark.h>
+#include "SyntheticDag.h"
+
+using orchestrator::Job;
+using orchestrator::job_queue::ConfigureInput;
+using orchestrator::job_queue::SchedulingMode;
+using orchestrator::job_queue::Store;
+using namespace orchestrator::benchmarks;
+
+namespace
+{
+
+// Independent jobs with IDs 1..numJobs and random priorities
+std::vector<Job> readyJobs(size_t numJobs, std::mt19937& rng)
+{
+    std::uniform_int_distribution<int64_t> priorityDist(0, 4);
+    std::vector<Job>                       jobs(numJobs);
+    for (size_t k = 0; k < numJobs; k++)
+    {
+        jobs[k].id       = static_cast<int64_t>(k) + 1;
+        jobs[k].status   = aapis::orchestrator::v1::JobStatus::JOB_STATUS_QUEUED;
+        jobs[k].priority = priorityDist(rng);
+    }
+    return jobs;
+}
+
+// Bring a queue up on a previously dumped set of jobs, the way the init-wait state does after a database load
+void loadJobs(Store& s, std::vector<Job> jobs)
+{
+    s.pendingJobs = std::move(jobs);
+    s.rebuildDependencyGraph();
+    s.sortJobs();
+}
+
+// Args: {queue depth}. Pushes a batch of independent jobs onto an already-populated queue
+void BM_PushThroughput(benchmark::State& state)
+{
+    static constexpr size_t kBatchSize = 64;
+
+    std::mt19937 rng(1);
+    const auto   jobs = readyJobs(static_cast<size_t>(state.range(0)), rng);
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        Store s;
+        loadJobs(s, jobs);
+        state.ResumeTiming();
+
+        for (size_t k = 0; k < kBatchSize; k++)
+        {
+            Job job;
+            benchmark::DoNotOptimize(s.addAndRegisterNewJob(job, false));
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * kBatchSize);
+}
+BENCHMARK(BM_PushThroughput)->RangeMultiplier(4)->Range(64, 16384);
+
+// Args: {queue depth, SchedulingMode}. Re-sorts a shuffled queue of ready jobs
+void BM_SortJobs(benchmark::State& state)
+{
+    std::mt19937 rng(2);
+    Store        s;
+    s.configure(ConfigureInput::SetSchedulingMode{static_cast<SchedulingMode>(state.range(1))});
+    loadJobs(s, readyJobs(static_cast<size_t>(state.range(0)), rng));
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        std::shuffle(s.pendingJobs.begin(), s.pendingJobs.end(), rng);
+        state.ResumeTiming();
+
+        s.sortJobs();
+    }
+    state.SetComplexityN(state.range(0));
+}
+BENCHMARK(BM_SortJobs)
+    ->ArgsProduct({benchmark::CreateRange(64, 16384, 4), kSchedulingModeArgs})
+    ->Complexity();
+
+// Args: {fan-out}. Completes one job whose outputs feed that many dependents
+void BM_CompletionFanOut(benchmark::State& state)
+{
+    const auto       fanOut = static_cast<size_t>(state.range(0));
+    std::vector<Job> jobs(fanOut + 1);
+    jobs[0].id     = 1;
+    jobs[0].status = aapis::orchestrator::v1::JobStatus::JOB_STATUS_QUEUED;
+    for (size_t k = 1; k <= fanOut; k++)
+    {
+        jobs[k].id               = static_cast<int64_t>(k) + 1;
+        jobs[k].status           = aapis::orchestrator::v1::JobStatus::JOB_STATUS_BLOCKED;
+        jobs[k].relevantBlockers = {1};
+    }
+    const orchestrator::result::JobResult rootResult{kJobSucceeded, std::vector<std::string>{"output"}};
+
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        Store                                         s;
+        std::promise<orchestrator::result::JobResult> rootPromise;
+        loadJobs(s, jobs);
+        dispatchReadyJobs(s, 1, [&](int64_t, auto promise) { rootPromise = std::move(promise); });
+        rootPromise.set_value(rootResult);
+        state.ResumeTiming();
+
+        s.processPendingJobResults(false);
+    }
+    state.SetComplexityN(state.range(0));
+}
+BENCHMARK(BM_CompletionFanOut)->RangeMultiplier(4)->Range(1, 4096)->Complexity();
+
+// Args: {queue depth}. Hands every ready job in the queue to a stub executor with unlimited capacity
+void BM_DispatchRate(benchmark::State& state)
+{
+    std::mt19937 rng(3);
+    const auto   jobs = readyJobs(static_cast<size_t>(state.range(0)), rng);
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        Store s;
+        loadJobs(s, jobs);
+        state.ResumeTiming();
+
+        benchmark::DoNotOptimize(dispatchReadyJobs(s, jobs.size(), [](int64_t, auto) {}));
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_DispatchRate)->RangeMultiplier(4)->Range(64, 16384);
+
+// Args: {number of DAG layers of 64 jobs}. Snapshots the queue as sent to the database by DumpInput
+void BM_DumpQueue(benchmark::State& state)
+{
+    std::mt19937 rng(4);
+    Store        s;
+    submitDag(s, layeredDag(static_cast<size_t>(state.range(0)), 64, rng));
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(s.queuedJobs());
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0) * 64);
+}
+BENCHMARK(BM_DumpQueue)->RangeMultiplier(4)->Range(1, 64);
+
+// Args: {number of DAG layers of 64 jobs}. Rebuilds the dependency graph and ordering from a dumped queue
+void BM_LoadQueue(benchmark::State& state)
+{
+    std::mt19937 rng(5);
+    Store        source;
+    submitDag(source, layeredDag(static_cast<size_t>(state.range(0)), 64, rng));
+    const auto dumped = source.queuedJobs();
+    for (auto _ : state)
+    {
+        Store s;
+        loadJobs(s, dumped);
+        benchmark::DoNotOptimize(s.pendingJobs.data());
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0) * 64);
+}
+BENCHMARK(BM_LoadQueue)->RangeMultiplier(4)->Range(1, 64);
+
+} // namespace
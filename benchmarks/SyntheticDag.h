@@ -0,0 +1,121 @@
+#pragma once
+
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+#include "orchestrator/JobQueue.h"
+
+namespace orchestrator
+{
+
+namespace benchmarks
+{
+
+// The queue treats any non-error result status as success
+constexpr auto kJobSucceeded = aapis::orchestrator::v1::JobStatus::JOB_STATUS_QUEUED;
+
+// Benchmark argument values for the scheduling modes compared against each other
+inline const std::vector<int64_t> kSchedulingModeArgs{static_cast<int64_t>(job_queue::SchedulingMode::PRIORITY),
+                                                      static_cast<int64_t>(job_queue::SchedulingMode::CRITICAL_PATH)};
+
+// Jobs listed in topological order, each blocked by some earlier jobs and taking a fixed number of time units
+struct SyntheticDag
+{
+    std::string                      name;
+    std::vector<std::vector<size_t>> blockers;
+    std::vector<int64_t>             durations;
+};
+
+// Layers of jobs, each one blocked by a few random jobs from the previous layer
+inline SyntheticDag layeredDag(size_t numLayers, size_t layerWidth, std::mt19937& rng)
+{
+    SyntheticDag                          dag;
+    std::uniform_int_distribution<size_t> numBlockersDist(1, 3);
+    std::uniform_int_distribution<size_t> blockerDist(0, layerWidth - 1);
+    std::uniform_int_distribution<int>    durationDist(1, 10);
+    dag.name = "layered";
+    for (size_t layer = 0; layer < numLayers; layer++)
+    {
+        for (size_t k = 0; k < layerWidth; k++)
+        {
+            std::vector<size_t> jobBlockers;
+            if (layer > 0)
+            {
+                for (size_t b = numBlockersDist(rng); b > 0; b--)
+                {
+                    auto blocker = (layer - 1) * layerWidth + blockerDist(rng);
+                    if (std::find(jobBlockers.begin(), jobBlockers.end(), blocker) == jobBlockers.end())
+                    {
+                        jobBlockers.push_back(blocker);
+                    }
+                }
+            }
+            dag.blockers.push_back(jobBlockers);
+            dag.durations.push_back(durationDist(rng));
+        }
+    }
+    return dag;
+}
+
+// Many short independent jobs submitted ahead of a single long chain that dominates the makespan
+inline SyntheticDag chainAndFanDag(size_t chainLength, size_t fanWidth, std::mt19937& rng)
+{
+    SyntheticDag                       dag;
+    std::uniform_int_distribution<int> durationDist(1, 10);
+    dag.name = "chain-and-fan";
+    for (size_t k = 0; k < fanWidth; k++)
+    {
+        dag.blockers.push_back({});
+        dag.durations.push_back(durationDist(rng));
+    }
+    for (size_t k = 0; k < chainLength; k++)
+    {
+        dag.blockers.push_back(k == 0 ? std::vector<size_t>{} : std::vector<size_t>{fanWidth + k - 1});
+        dag.durations.push_back(durationDist(rng));
+    }
+    return dag;
+}
+
+// Push every job of the DAG onto the queue, returning the queue ID assigned to each
+inline std::vector<int64_t> submitDag(job_queue::Store& s, const SyntheticDag& dag)
+{
+    std::vector<int64_t> ids;
+    for (const auto& jobBlockers : dag.blockers)
+    {
+        Job job;
+        for (auto blocker : jobBlockers)
+        {
+            job.independentBlockers.push_back(ids[blocker]);
+        }
+        ids.push_back(s.addAndRegisterNewJob(job, false));
+    }
+    return ids;
+}
+
+// Stand-in for JobExecutor: move up to maxJobs unblocked jobs out of the queue in dispatch order, exactly as
+// timedJobDrain would, handing each one's result promise to the caller
+template<typename OnDispatch>
+size_t dispatchReadyJobs(job_queue::Store& s, size_t maxJobs, OnDispatch&& onDispatch)
+{
+    size_t numDispatched = 0;
+    for (auto it = s.pendingJobs.begin(); it != s.pendingJobs.end() && numDispatched < maxJobs;)
+    {
+        if (it->numBlockers() != 0)
+        {
+            ++it;
+            continue;
+        }
+        std::promise<result::JobResult> promise;
+        s.pendingJobResults.emplace(it->id, promise.get_future());
+        s.recordDispatch(it->id);
+        onDispatch(it->id, std::move(promise));
+        it = s.pendingJobs.erase(it);
+        numDispatched++;
+    }
+    return numDispatched;
+}
+
+} // namespace benchmarks
+
+} // end namespace orchestrator
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <future>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include "orchestrator/Job.h"
+#include "orchestrator/Result.h"
+#include "orchestrator/Rpc.h"
+#include "orchestrator/RpcServer.h"
+#include "orchestrator/Stats.h"
+
+namespace orchestrator
+{
+
+namespace agents
+{
+
+void              writeJobResult(rpc::Writer& writer, const result::JobResult& jobResult);
+result::JobResult readJobResult(rpc::Reader& reader);
+
+struct PoolStats
+{
+    stats::Counter          dispatches;
+    stats::Counter          batches;
+    stats::Counter          localDispatches; // jobs run where the outputs of their relevant blockers already were
+    stats::Counter          reassignments;
+    stats::Counter          lostAgents;
+    stats::Counter          staleResults;
+    stats::LatencyHistogram turnaroundMicros;
+};
+
+// Jobs handed to worker agents (see WorkerAgent) rather than run locally. Agents register over RPC, then keep polling
+// (AGENT_POLL) with the results of the jobs they finished and how many more they can take, and get back a batch of jobs
+// to run. Every poll renews the agent's lease on its jobs; an agent that lets its lease lapse is presumed lost, and its
+// jobs go back to the front of the line for the other agents to pick up.
+//
+// A job whose relevant blockers ran on an agent that is still around waits a little for that agent to ask for work,
+// since it already holds their outputs, before any other agent may take it.
+//
+// Every agent request starts with a token. Agents connecting from anywhere but the loopback interface (or the
+// Unix-domain socket) must present the pool's token, and are turned away if it has none.
+//
+// Called into from the executor and from the RPC server thread.
+class AgentPool
+{
+public:
+    static constexpr std::chrono::milliseconds kDefaultLease        = std::chrono::seconds(5);
+    static constexpr std::chrono::milliseconds kDefaultLocalityWait = std::chrono::milliseconds(50);
+
+    explicit AgentPool(std::chrono::milliseconds lease        = kDefaultLease,
+                       std::chrono::milliseconds localityWait = kDefaultLocalityWait,
+                       std::string               token        = "");
+
+    size_t                         freeSlots() const;
+    bool                           contains(int64_t jobId) const;
+    std::vector<Job>               outstandingJobs() const;
+    std::future<result::JobResult> submit(const Job& job);
+    bool                           abandon(int64_t jobId);
+    size_t                         expireAgents();
+    void                           addStats(std::map<std::string, int64_t>& metrics) const;
+
+    rpc::PendingReply handle(rpc::Frame& request);
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Agent
+    {
+        std::string       name;
+        size_t            numSlots;
+        Clock::time_point leaseExpiry;
+        std::set<int64_t> assignedJobIds;
+    };
+
+    struct Task
+    {
+        Job                             job;
+        std::promise<result::JobResult> promise;
+        Clock::time_point               submitted;
+        std::optional<int64_t>          agentId; // while assigned
+    };
+
+    bool                   authenticated(const rpc::Frame& request, std::string_view token) const;
+    rpc::PendingReply      registerAgent(rpc::Reader& reader);
+    rpc::PendingReply      poll(rpc::Reader& reader);
+    void                   acceptResult(int64_t agentId, int64_t jobId, result::JobResult jobResult);
+    std::vector<Job>       assign(int64_t agentId, size_t maxJobs);
+    std::optional<int64_t> preferredAgent(const Job& job) const;
+    size_t                 expireAgentsLocked(Clock::time_point now);
+    void                   rememberOutputs(int64_t jobId, int64_t agentId);
+
+    const std::chrono::milliseconds mLease;
+    const std::chrono::milliseconds mLocalityWait;
+    const std::string               mToken; // empty if agents may only connect locally
+
+    mutable std::mutex                mMutex;
+    int64_t                           mLastAgentId{0};
+    std::map<int64_t, Agent>          mAgents;
+    std::unordered_map<int64_t, Task> mTasks;
+    // Jobs waiting for an agent, oldest first; IDs of tasks since assigned or abandoned are skipped over lazily
+    std::deque<int64_t> mPendingJobIds;
+    // Which agent ran each recently finished job, and so holds its outputs
+    std::unordered_map<int64_t, int64_t> mOutputHolders;
+    std::deque<int64_t>                  mOutputHolderOrder;
+    PoolStats                            mStats;
+};
+
+} // namespace agents
+
+} // end namespace orchestrator
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstdint>
 #include <string>
 #include <vector>
 #include <chrono>
@@ -15,19 +16,36 @@ struct Job
     int64_t id{-1};
     // int64_t parentId{-1}; TODO shouldn't be necessary
 
-    aapis::orchestrator::v1::JobStatus status;
+    aapis::orchestrator::v1::JobStatus status{aapis::orchestrator::v1::JobStatus::JOB_STATUS_INVALID};
     aapis::orchestrator::v1::JobStatus prePauseStatus{aapis::orchestrator::v1::JobStatus::JOB_STATUS_INVALID};
 
     int64_t priority{0};
 
+    // Jobs sharing a workflow are kept on the same job queue shard when sharding; negative for none
+    int64_t workflowId{-1};
+
+    // Which in-process job kind runs the job (see JobKinds.h); 0 for the executor's general-purpose runner
+    uint32_t kind{0};
+
     int64_t spawnTimeSeconds{-1};
     int64_t executionTimeSeconds{-1};
     int64_t completionTimestampSeconds{-1};
 
+    // Absolute time by which the job should finish; orders dispatch under earliest-deadline-first scheduling
+    int64_t deadlineSeconds{-1};
+    // Longest the job may run once dispatched before it is failed (or retried)
+    int64_t timeoutSeconds{-1};
+    // How many times a timed-out job is re-queued, with exponential backoff, before it is failed
+    int64_t maxRetries{0};
+    int64_t numRetries{0};
+
     // Blockers whose outputs have no relevance to this job
     std::vector<int64_t> independentBlockers;
     // Blockers whose outputs (and whose children's outputs) must become additional inputs to this job
     std::vector<int64_t> relevantBlockers;
+    // Relevant blockers (or their children) that have since finished and had their outputs appended to the inputs;
+    // lets the job be sent where those outputs already are
+    std::vector<int64_t> consumedBlockers{};
 
     size_t numBlockers() const
     {
@@ -38,4 +56,12 @@ struct Job
     std::vector<std::string> inputs;
 };
 
+// A job template waiting on the queue's timer wheel to be pushed; its ID is the schedule's
+struct ScheduledJob
+{
+    Job     job;
+    int64_t nextRunSeconds;
+    int64_t periodSeconds; // zero or less for a one-off
+};
+
 } // end namespace orchestrator
@@ -0,0 +1,222 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <coroutine>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <queue>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "orchestrator/Result.h"
+#include "orchestrator/Stats.h"
+
+namespace orchestrator
+{
+
+namespace job_coroutines
+{
+
+// An in-process job (or part of one) written as a coroutine, which gives up its thread whenever it co_awaits something
+// that isn't ready yet: a timer, file descriptor readiness, blocking work handed off elsewhere, or other tasks. Tasks
+// start suspended and are run either by a CoroutineScheduler or by another task co_awaiting them, which resumes once
+// the awaited task co_returns its result.
+class JobTask
+{
+public:
+    struct promise_type;
+    using Handle = std::coroutine_handle<promise_type>;
+
+    // Called with the finished task's handle once a task with no awaiting task finishes; may destroy the task
+    using OnDone = std::function<void(Handle)>;
+
+    struct FinalAwaiter
+    {
+        bool                    await_ready() noexcept;
+        std::coroutine_handle<> await_suspend(Handle handle) noexcept;
+        void                    await_resume() noexcept {}
+    };
+
+    struct promise_type
+    {
+        std::optional<result::JobResult> result;
+        std::exception_ptr               exception;
+        std::coroutine_handle<>          continuation;
+        OnDone                           onDone;
+
+        JobTask             get_return_object();
+        std::suspend_always initial_suspend() noexcept;
+        FinalAwaiter        final_suspend() noexcept;
+        void                return_value(result::JobResult jobResult);
+        void                unhandled_exception();
+    };
+
+    explicit JobTask(Handle handle) : mHandle(handle) {}
+    JobTask(JobTask&& other) noexcept;
+    JobTask& operator=(JobTask&& other) noexcept;
+    JobTask(const JobTask&)            = delete;
+    JobTask& operator=(const JobTask&) = delete;
+    ~JobTask();
+
+    Handle release();
+
+    static result::JobResult resultOf(Handle handle);
+
+    // Awaiting a task runs it to completion before resuming the awaiting task
+    bool                    await_ready() const noexcept;
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept;
+    result::JobResult       await_resume();
+
+private:
+    Handle mHandle;
+};
+
+struct SchedulerStats
+{
+    stats::Counter resumes;
+    stats::Counter timerWaits;
+    stats::Counter fdWaits;
+    stats::Counter offloads;
+};
+
+// Runs tasks on a handful of worker threads. A task that co_awaits a timer or a file descriptor is parked with the
+// scheduler's reactor thread, which hands it back to the workers once the timer expires or the descriptor is ready, so
+// any number of waiting tasks cost no threads at all. Tasks may be resumed on any worker.
+class CoroutineScheduler
+{
+public:
+    explicit CoroutineScheduler(size_t numThreads);
+    ~CoroutineScheduler();
+    CoroutineScheduler(const CoroutineScheduler&)            = delete;
+    CoroutineScheduler& operator=(const CoroutineScheduler&) = delete;
+
+    static CoroutineScheduler& current();
+
+    void   spawn(JobTask task, std::function<void(result::JobResult)> onDone);
+    void   schedule(std::coroutine_handle<> handle);
+    void   resumeAt(std::chrono::steady_clock::time_point deadline, std::coroutine_handle<> handle);
+    void   resumeWhenReady(int fd, uint32_t events, std::coroutine_handle<> handle);
+    void   offload(std::function<void()> work);
+    size_t numThreads() const;
+    size_t numTasks() const;
+    void   addStats(std::map<std::string, int64_t>& metrics) const;
+
+private:
+    using TimePoint = std::chrono::steady_clock::time_point;
+    using Timer     = std::pair<TimePoint, std::coroutine_handle<>>;
+
+    struct TimerLater
+    {
+        bool operator()(const Timer& lhs, const Timer& rhs) const
+        {
+            return lhs.first > rhs.first;
+        }
+    };
+
+    void runWorker();
+    void runReactor();
+    void wakeReactor();
+
+    std::vector<std::thread> mWorkers;
+    std::thread              mReactor;
+    int                      mEpollFd{-1};
+    int                      mWakeFd{-1};
+    bool                     mStopping{false};
+
+    mutable std::mutex                                         mMutex;
+    std::condition_variable                                    mReady;
+    std::deque<std::coroutine_handle<>>                        mReadyHandles;
+    std::priority_queue<Timer, std::vector<Timer>, TimerLater> mTimers;
+    std::unordered_map<int, std::coroutine_handle<>>           mFdWaiters;
+    // Tasks spawned and not yet finished, destroyed along with the scheduler if still waiting by then
+    std::unordered_set<void*>      mTasks;
+    std::vector<std::future<void>> mOffloads;
+    SchedulerStats                 mStats;
+};
+
+// Resume after a while, without holding a thread in the meantime
+struct SleepAwaiter
+{
+    std::chrono::steady_clock::time_point deadline;
+
+    bool await_ready() const noexcept;
+    void await_suspend(std::coroutine_handle<> handle) const;
+    void await_resume() const noexcept {}
+};
+
+// Resume once a file descriptor is ready; only one task at a time may wait on any one descriptor
+struct FdAwaiter
+{
+    int      fd;
+    uint32_t events;
+
+    bool await_ready() const noexcept
+    {
+        return false;
+    }
+    void await_suspend(std::coroutine_handle<> handle) const;
+    void await_resume() const noexcept {}
+};
+
+// Resume with the result of blocking work, run on a thread of its own rather than one of the scheduler's
+class OffloadAwaiter
+{
+public:
+    explicit OffloadAwaiter(std::function<result::JobResult()> work);
+
+    bool              await_ready() const noexcept;
+    void              await_suspend(std::coroutine_handle<> handle);
+    result::JobResult await_resume();
+
+private:
+    struct State
+    {
+        std::function<result::JobResult()> work;
+        std::optional<result::JobResult>    result;
+    };
+    std::shared_ptr<State> mState;
+};
+
+// Resume with the results of several tasks, in order, once all of them have finished; they run concurrently
+class WhenAllAwaiter
+{
+public:
+    explicit WhenAllAwaiter(std::vector<JobTask> tasks);
+
+    bool                           await_ready() const noexcept;
+    void                           await_suspend(std::coroutine_handle<> handle);
+    std::vector<result::JobResult> await_resume();
+
+private:
+    struct State
+    {
+        std::vector<result::JobResult> results;
+        std::atomic_size_t             numRemaining{0};
+    };
+    std::vector<JobTask>   mTasks;
+    std::shared_ptr<State> mState;
+};
+
+SleepAwaiter      sleepFor(std::chrono::milliseconds duration);
+FdAwaiter         readable(int fd);
+FdAwaiter         writable(int fd);
+OffloadAwaiter    offload(std::function<result::JobResult()> work);
+WhenAllAwaiter    whenAll(std::vector<JobTask> tasks);
+JobTask           completed(result::JobResult jobResult);
+result::JobResult runToCompletion(JobTask task);
+
+} // namespace job_coroutines
+
+} // end namespace orchestrator
@@ -12,7 +12,9 @@
 #include <mscpp/MicroServiceContainer.h>
 
 #include "orchestrator/Result.h"
+#include "orchestrator/ResultCache.h"
 #include "orchestrator/Job.h"
+#include "orchestrator/Stats.h"
 
 namespace orchestrator
 {
@@ -24,29 +26,100 @@ struct HeartbeatInput : public services::Input<HeartbeatInput, result::EmptyResu
 {
 };
 
+// Replaces whatever the same job queue shard dumped before
 struct DumpQueueData : public services::Input<DumpQueueData, result::BooleanResult, 1, 100>
 {
     std::vector<Job>     pendingJobs;
-    std::vector<int64_t> awaitedJobIds;
+    std::vector<int64_t>      awaitedJobIds;
+    std::vector<ScheduledJob> scheduledJobs;
+    size_t                    shardIndex{0};
 };
 
+// Replaces whatever jobs the executor dumped before
+struct DumpRunningJobs : public services::Input<DumpRunningJobs, result::BooleanResult, 1, 100>
+{
+    std::vector<Job> runningJobs;
+};
+
+// Returns what every shard dumped, along with the jobs the executor was running to be re-executed; each shard keeps
+// the jobs it owns under the current sharding
 struct LoadQueueData : public services::Input<LoadQueueData, result::JobQueueDataResult, 1, 100>
 {
 };
 
-using Inputs = services::InputSet<HeartbeatInput, DumpQueueData, LoadQueueData>;
+// Second tier of the job queue's result cache (its "disk tier"), keyed like the first. Like everything else the
+// database keeps, it is held in memory for now: it is bounded, least recently used entries going first, and doesn't
+// survive a restart.
+struct StoreCachedResult : public services::Input<StoreCachedResult, result::BooleanResult, 2, 100>
+{
+    ResultCacheKey    key;
+    result::JobResult result;
+};
+
+struct LoadCachedResult : public services::Input<LoadCachedResult, result::OptionalJobResult, 1, 100>
+{
+    ResultCacheKey key;
+};
+
+struct StatsInput : public services::Input<StatsInput, result::StatsResult, 1, 10>
+{
+};
+
+struct ConfigureInput : public services::Input<ConfigureInput, result::BooleanResult, 2, 5>
+{
+    // Memory budget of the result cache's second tier; zero turns it off
+    struct SetResultCacheCapacity
+    {
+        size_t capacityBytes;
+    };
+    using ConfigType = std::variant<SetResultCacheCapacity>;
+    ConfigType config;
+};
+
+using Inputs = services::InputSet<HeartbeatInput,
+                                  DumpQueueData,
+                                  DumpRunningJobs,
+                                  LoadQueueData,
+                                  StoreCachedResult,
+                                  LoadCachedResult,
+                                  StatsInput,
+                                  ConfigureInput>;
 
 using Container = services::MicroServiceContainer<>;
 
+struct DatabaseStats
+{
+    stats::Counter dumps;
+    stats::Counter loads;
+    stats::Counter cacheHits;
+    stats::Counter cacheMisses;
+};
+
+// Kept in memory for the lifetime of the daemon
 struct Store
 {
+    static constexpr size_t kDefaultResultCacheCapacity = size_t{256} << 20;
+
+    std::map<size_t, std::vector<Job>>          dumpedPendingJobs;   // by shard
+    std::map<size_t, std::vector<int64_t>>      dumpedAwaitedJobIds; // by shard
+    std::map<size_t, std::vector<ScheduledJob>> dumpedScheduledJobs; // by shard
+    std::vector<Job>                            dumpedRunningJobs;
+    ResultCache                                 cachedResults{kDefaultResultCacheCapacity};
+    DatabaseStats                               databaseStats;
+
+    result::StatsResult collectStats() const;
 };
 
 struct ForeverState : public services::State<ForeverState, 0>
 {
     size_t step(Store& s, const Container& c, HeartbeatInput& i);
     size_t step(Store& s, const Container& c, DumpQueueData& i);
+    size_t step(Store& s, const Container& c, DumpRunningJobs& i);
     size_t step(Store& s, const Container& c, LoadQueueData& i);
+    size_t step(Store& s, const Container& c, StoreCachedResult& i);
+    size_t step(Store& s, const Container& c, LoadCachedResult& i);
+    size_t step(Store& s, const Container& c, StatsInput& i);
+    size_t step(Store& s, const Container& c, ConfigureInput& i);
 };
 
 using States = services::StateSet<ForeverState>;
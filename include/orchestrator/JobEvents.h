@@ -0,0 +1,85 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <set>
+#include <unordered_map>
+#include <vector>
+
+#include <aapis/orchestrator/v1/orchestrator.pb.h>
+
+namespace orchestrator
+{
+
+namespace events
+{
+
+// A job entering a new status: queued, blocked, or paused when (re-)queued, active when dispatched, and complete,
+// error, or canceled when archived
+struct JobEvent
+{
+    int64_t                            jobId;
+    aapis::orchestrator::v1::JobStatus status;
+    int64_t                            priority;
+    int64_t                            timestampMicros; // system clock, or the queue's virtual clock
+};
+
+// Which events a subscriber cares about; an empty set matches anything
+struct SubscriptionFilter
+{
+    std::set<int64_t>                            jobIds;
+    std::set<int64_t>                            priorities;
+    std::set<aapis::orchestrator::v1::JobStatus> statuses;
+
+    bool matches(const JobEvent& event) const;
+};
+
+// Events handed over to a subscriber in one go
+struct EventBatch
+{
+    std::vector<JobEvent> events;
+    // Events lost to a full buffer since the previous batch; the subscriber should re-query to resynchronize
+    uint64_t numDropped{0};
+    // Set once the subscription has been canceled and every remaining event delivered
+    bool closed{false};
+};
+
+// Bounded buffer of one subscriber's undelivered events, filled by the job queue once per heartbeat and drained by
+// the subscriber from any thread. A job that changes status again before its previous event is taken only keeps its
+// latest event, in the position of the first, so a slow subscriber sees at most one event per job rather than every
+// intermediate transition. A subscriber that can't block in waitAndTake() may instead set a listener, which is called
+// whenever the stream becomes ready.
+class EventStream
+{
+public:
+    static constexpr size_t kDefaultCapacity = 4096;
+
+    EventStream(SubscriptionFilter filter, size_t capacity);
+
+    void       setListener(std::function<void()> listener);
+    void       publish(const std::vector<JobEvent>& events);
+    void       close();
+    bool       ready() const;
+    EventBatch take(size_t maxEvents);
+    EventBatch waitAndTake(size_t maxEvents, std::chrono::milliseconds timeout);
+
+private:
+    EventBatch takeLocked(size_t maxEvents);
+
+    const SubscriptionFilter            mFilter;
+    const size_t                        mCapacity;
+    mutable std::mutex                  mMutex;
+    std::condition_variable             mPublished;
+    std::function<void()>               mListener; // called on the publishing thread, without the lock held
+    std::vector<JobEvent>               mEvents;
+    std::unordered_map<int64_t, size_t> mEventIndices; // job ID -> position of its undelivered event
+    uint64_t                            mNumDropped{0};
+    bool                                mClosed{false};
+};
+
+} // namespace events
+
+} // end namespace orchestrator
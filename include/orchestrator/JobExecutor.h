@@ -1,18 +1,28 @@
 #pragma once
 
+#include <array>
 #include <atomic>
 #include <variant>
 #include <cstdint>
+#include <functional>
 #include <map>
+#include <memory>
 #include <mutex>
 #include <string>
+#include <vector>
 #include <mscpp/InputSet.h>
 #include <mscpp/StateSet.h>
 #include <mscpp/MicroService.h>
 #include <mscpp/MicroServiceContainer.h>
 
+#include "orchestrator/AgentPool.h"
 #include "orchestrator/Result.h"
 #include "orchestrator/Job.h"
+#include "orchestrator/JobDatabase.h"
+#include "orchestrator/JobCoroutines.h"
+#include "orchestrator/JobKinds.h"
+#include "orchestrator/OutputStore.h"
+#include "orchestrator/Stats.h"
 
 namespace orchestrator
 {
@@ -33,16 +43,119 @@ struct TogglePauseInput : public services::Input<TogglePauseInput, result::Boole
 {
 };
 
+// Stop waiting on a job whose result is no longer awaited; its slot frees up once its worker finishes
+struct AbandonInput : public services::Input<AbandonInput, result::BooleanResult, 1, 5>
+{
+    int64_t id;
+};
+
+// Hand the jobs still running to the database, for the queue to have them re-executed once it reloads
 struct DumpInput : public services::Input<DumpInput, result::BooleanResult, 1, 100>
 {
 };
 
-using Inputs = services::InputSet<HeartbeatInput, ExecuteInput, TogglePauseInput, DumpInput>;
+struct StatsInput : public services::Input<StatsInput, result::StatsResult, 1, 10>
+{
+};
+
+// Runs a job to completion on a worker thread
+using JobRunner = std::function<result::JobResult(const Job&)>;
+
+struct ConfigureInput : public services::Input<ConfigureInput, result::BooleanResult, 2, 5>
+{
+    // How many jobs may run at once
+    struct SetNumSlots
+    {
+        size_t numSlots;
+    };
+    struct SetJobRunner
+    {
+        JobRunner runner;
+    };
+    // Hand jobs to worker agents instead of running them locally, whose slots then take the place of the executor's
+    struct SetAgentPool
+    {
+        std::shared_ptr<agents::AgentPool> pool;
+    };
+    // How many threads run coroutine jobs (which only counts once the first one starts), and how many of them may be
+    // in flight at once; coroutine jobs don't take up the executor's slots
+    struct SetCoroutineCapacity
+    {
+        size_t numThreads;
+        size_t numSlots;
+    };
+    // Load spilled outputs back in for the jobs that take them as inputs
+    struct SetOutputStore
+    {
+        std::shared_ptr<outputs::OutputStore> store;
+    };
+    using ConfigType = std::variant<SetNumSlots, SetJobRunner, SetAgentPool, SetCoroutineCapacity, SetOutputStore>;
+    ConfigType config;
+};
+
+using Inputs = services::InputSet<HeartbeatInput,
+                                  ExecuteInput,
+                                  TogglePauseInput,
+                                  DumpInput,
+                                  AbandonInput,
+                                  StatsInput,
+                                  ConfigureInput>;
 
-using Container = services::MicroServiceContainer<>;
+using Container = services::MicroServiceContainer<job_database::JobDatabase>;
+
+struct ExecutorStats
+{
+    stats::Counter          launches;
+    stats::Counter          rejections;
+    stats::Counter          abandons;
+    stats::Counter          invalidJobs;
+    stats::LatencyHistogram runMicros;
+};
 
 struct Store
 {
+    static result::JobResult echoJob(const Job& job);
+
+    size_t    numSlots{4};
+    JobRunner runner{echoJob};
+    // Each worker hands back how long its job ran for, in microseconds
+    std::map<int64_t, std::future<uint64_t>> runningJobs;
+    // Every job running in-process, coroutines included, kept to be dumped at shutdown
+    std::map<int64_t, Job> launchedJobs;
+    // Workers can't be interrupted, so abandoned jobs finish in the background; they keep their slots (though not
+    // their kinds') until they do, so that timed-out jobs can't pile up threads past the executor's limits
+    std::vector<std::future<uint64_t>> abandonedJobs;
+    std::vector<std::future<uint64_t>> abandonedCoroutineJobs;
+    // Running jobs of in-process kinds, counted by position in JobKinds, and the kind of each
+    std::array<size_t, job_kinds::JobKinds::size()> numRunningPerKind{};
+    std::map<int64_t, size_t>                       runningJobKinds;
+    ExecutorStats                                   executorStats;
+    std::shared_ptr<agents::AgentPool>              agentPool;
+    std::shared_ptr<outputs::OutputStore>           outputStore; // unset unless the queue spills outputs to disk
+
+    // Jobs of suspending kinds run as coroutines on a scheduler of their own, started along with the first of them
+    size_t                                              numCoroutineThreads{2};
+    size_t                                              numCoroutineSlots{4096};
+    std::unique_ptr<job_coroutines::CoroutineScheduler> coroutineScheduler;
+    std::map<int64_t, std::future<uint64_t>>            coroutineJobs;
+
+    void                execute(ExecuteInput& i);
+    void                executeKind(ExecuteInput& i);
+    void                startCoroutine(ExecuteInput& i, job_kinds::JobKinds::PreparedJob& preparedJob);
+    void                executeRemotely(ExecuteInput& i);
+    void                failInvalidJob(ExecuteInput& i, const std::string& reason);
+    void                releaseKindSlot(int64_t jobId);
+    void                reapFinishedJobs();
+    size_t              numBusySlots() const;
+    size_t              numBusyCoroutineSlots() const;
+    bool                abandon(int64_t jobId);
+    std::vector<Job>    jobsInFlight() const;
+    bool                dumpRunningJobs(const Container& c) const;
+    void                configure(const ConfigureInput::ConfigType& config);
+    result::StatsResult collectStats() const;
+
+    template<typename Work>
+    void launch(ExecuteInput& i, Work work);
 };
 
 // Initial state in which any persistent memory is loaded
@@ -52,6 +165,9 @@ struct InitState : public services::State<InitState, 0>
     size_t step(Store& s, const Container& c, ExecuteInput& i);
     size_t step(Store& s, const Container& c, TogglePauseInput& i);
     size_t step(Store& s, const Container& c, DumpInput& i);
+    size_t step(Store& s, const Container& c, AbandonInput& i);
+    size_t step(Store& s, const Container& c, StatsInput& i);
+    size_t step(Store& s, const Container& c, ConfigureInput& i);
 };
 
 // Nominal running state
@@ -61,6 +177,9 @@ struct RunningState : public services::State<RunningState, 1>
     size_t step(Store& s, const Container& c, ExecuteInput& i);
     size_t step(Store& s, const Container& c, TogglePauseInput& i);
     size_t step(Store& s, const Container& c, DumpInput& i);
+    size_t step(Store& s, const Container& c, AbandonInput& i);
+    size_t step(Store& s, const Container& c, StatsInput& i);
+    size_t step(Store& s, const Container& c, ConfigureInput& i);
 };
 
 // Paused state in which no new active jobs get queued
@@ -70,12 +189,11 @@ struct PausedState : public services::State<PausedState, 2>
     size_t step(Store& s, const Container& c, ExecuteInput& i);
     size_t step(Store& s, const Container& c, TogglePauseInput& i);
     size_t step(Store& s, const Container& c, DumpInput& i);
+    size_t step(Store& s, const Container& c, AbandonInput& i);
+    size_t step(Store& s, const Container& c, StatsInput& i);
+    size_t step(Store& s, const Container& c, ConfigureInput& i);
 };
 
-// TODO it's the EXECUTOR's responsibility to dump all the info about running jobs on shutdown
-// but it's the QUEUE's responsibility to get that info from the database on restart
-// and ask the executor to re-execute via the standard ExecuteInput interface
-
 using States = services::StateSet<InitState, RunningState, PausedState>;
 
 using JobExecutorBase = services::MicroService<Store, Container, States, Inputs>;
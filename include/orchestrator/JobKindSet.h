@@ -0,0 +1,193 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <variant>
+
+#include "orchestrator/Job.h"
+#include "orchestrator/JobCoroutines.h"
+#include "orchestrator/Result.h"
+
+namespace orchestrator
+{
+
+namespace job_kinds
+{
+
+template<size_t N>
+constexpr bool areUnique(const std::array<uint32_t, N>& ids)
+{
+    for (size_t k = 0; k < N; k++)
+    {
+        for (size_t l = k + 1; l < N; l++)
+        {
+            if (ids[k] == ids[l])
+            {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// Whether a kind's jobs are coroutines, which give up their thread while they wait
+template<typename Kind>
+inline constexpr bool kSuspends =
+    std::is_same_v<decltype(Kind::run(std::declval<typename Kind::Args&>())), job_coroutines::JobTask>;
+
+// A job kind's arguments, parsed out of a job's inputs once, before it runs
+template<typename Kind>
+struct Prepared
+{
+    typename Kind::Args args;
+
+    decltype(auto) run()
+    {
+        return Kind::run(args);
+    }
+};
+
+// The in-process job kinds, fixed at compile time the way a service's inputs are (cf. services::InputSet). Each kind is
+// a type with:
+//
+//   static constexpr uint32_t kId;             // what Job::kind names it by; unique and non-zero
+//   static constexpr size_t   kMaxConcurrency; // most jobs of the kind running at once; 0 for no limit of its own
+//   using Args = ...;                          // arguments, as parsed from a job
+//   static Args              parse(const Job& job); // throws std::invalid_argument on malformed inputs
+//   static result::JobResult run(Args& args);
+//
+// or, for a kind whose jobs spend most of their time waiting, a coroutine that takes its arguments by value (they must
+// outlive the job, which its caller's may not):
+//
+//   static job_coroutines::JobTask run(Args args);
+//
+// A job's kind is looked up in a table generated from the IDs, and a prepared job runs by visiting a variant of every
+// kind's arguments, so there are no virtual calls, string comparisons, or parsing between dispatch and running.
+template<typename... Kinds>
+class JobKindSet
+{
+public:
+    using PreparedJob = std::variant<Prepared<Kinds>...>;
+
+    static constexpr size_t size()
+    {
+        return sizeof...(Kinds);
+    }
+
+    /// @brief Find a kind by its ID
+    /// @return Position of the kind in the set, or size() if no kind has the ID
+    static constexpr size_t indexOf(uint32_t kindId)
+    {
+        for (size_t k = 0; k < kIds.size(); k++)
+        {
+            if (kIds[k] == kindId)
+            {
+                return k;
+            }
+        }
+        return size();
+    }
+
+    static constexpr uint32_t idOf(size_t index)
+    {
+        return kIds[index];
+    }
+
+    /// @brief Most jobs of a kind that may run at once
+    /// @param index Position of the kind in the set
+    /// @return Limit, or 0 if the kind has none of its own
+    static constexpr size_t maxConcurrency(size_t index)
+    {
+        return kMaxConcurrencies[index];
+    }
+
+    /// @brief Parse a job's arguments according to its kind
+    /// @param index Position of the job's kind in the set, as found by indexOf()
+    /// @param job Job to prepare
+    /// @return Arguments, ready to run
+    static PreparedJob prepare(size_t index, const Job& job)
+    {
+        return kPrepareTable[index](job);
+    }
+
+    /// @brief Whether a kind's jobs are coroutines, to be started on a scheduler rather than run on a thread
+    /// @param index Position of the kind in the set
+    static constexpr bool suspends(size_t index)
+    {
+        return kSuspending[index];
+    }
+
+    /// @brief Run a prepared job on the calling thread, blocking until it finishes even if it is a coroutine
+    static result::JobResult run(PreparedJob& preparedJob)
+    {
+        return std::visit(
+            []<typename Kind>(Prepared<Kind>& prepared) {
+                if constexpr (kSuspends<Kind>)
+                {
+                    return job_coroutines::runToCompletion(prepared.run());
+                }
+                else
+                {
+                    return prepared.run();
+                }
+            },
+            preparedJob);
+    }
+
+    /// @brief Turn a prepared job into a task for a coroutine scheduler; a job of a kind that doesn't suspend runs
+    /// right away, on the calling thread
+    static job_coroutines::JobTask start(PreparedJob& preparedJob)
+    {
+        return std::visit(
+            []<typename Kind>(Prepared<Kind>& prepared) {
+                if constexpr (kSuspends<Kind>)
+                {
+                    return prepared.run();
+                }
+                else
+                {
+                    return job_coroutines::completed(prepared.run());
+                }
+            },
+            preparedJob);
+    }
+
+    /// @brief Prepare and run a job in one go, e.g. as a job runner
+    /// @param job Job of any kind in the set
+    /// @return Result of the job; throws std::invalid_argument if it is of no kind in the set or malformed
+    static result::JobResult runJob(const Job& job)
+    {
+        const auto index = indexOf(job.kind);
+        if (index == size())
+        {
+            throw std::invalid_argument("Unknown job kind");
+        }
+        auto preparedJob = prepare(index, job);
+        return run(preparedJob);
+    }
+
+private:
+    using PrepareFunction = PreparedJob (*)(const Job&);
+
+    template<typename Kind>
+    static PreparedJob prepareAs(const Job& job)
+    {
+        return PreparedJob{std::in_place_type<Prepared<Kind>>, Prepared<Kind>{Kind::parse(job)}};
+    }
+
+    static constexpr std::array<uint32_t, sizeof...(Kinds)>        kIds{Kinds::kId...};
+    static constexpr std::array<size_t, sizeof...(Kinds)>          kMaxConcurrencies{Kinds::kMaxConcurrency...};
+    static constexpr std::array<PrepareFunction, sizeof...(Kinds)> kPrepareTable{&prepareAs<Kinds>...};
+    static constexpr std::array<bool, sizeof...(Kinds)>            kSuspending{kSuspends<Kinds>...};
+
+    static_assert(((Kinds::kId != 0) && ...), "Job kind ID 0 is reserved for jobs of no particular kind");
+    static_assert(areUnique(std::array<uint32_t, sizeof...(Kinds)>{Kinds::kId...}), "Job kind IDs must be unique");
+};
+
+} // namespace job_kinds
+
+} // end namespace orchestrator
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "orchestrator/JobKindSet.h"
+
+namespace orchestrator
+{
+
+namespace job_kinds
+{
+
+// Succeeds with its inputs as outputs
+struct EchoJob
+{
+    static constexpr uint32_t kId             = 1;
+    static constexpr size_t   kMaxConcurrency = 0;
+
+    using Args = std::vector<std::string>;
+
+    static Args              parse(const Job& job);
+    static result::JobResult run(Args& args);
+};
+
+// Holds its slot for as many milliseconds as its first input says, then succeeds with no outputs; stands in for real
+// work when exercising the orchestrator
+struct SleepJob
+{
+    static constexpr uint32_t kId             = 2;
+    static constexpr size_t   kMaxConcurrency = 64;
+
+    using Args = std::chrono::milliseconds;
+
+    static Args              parse(const Job& job);
+    static result::JobResult run(Args& args);
+};
+
+// Waits as many milliseconds as its first input says, then succeeds with the rest of its inputs as outputs; like a
+// sleep job, but a coroutine, so waiting jobs take up no thread
+struct DelayJob
+{
+    static constexpr uint32_t kId             = 3;
+    static constexpr size_t   kMaxConcurrency = 0;
+
+    struct Args
+    {
+        std::chrono::milliseconds delay;
+        std::vector<std::string>  outputs;
+    };
+
+    static Args                    parse(const Job& job);
+    static job_coroutines::JobTask run(Args args);
+};
+
+// Every job kind the executor runs in-process; jobs of kind 0 go to its general-purpose runner instead
+using JobKinds = JobKindSet<EchoJob, SleepJob, DelayJob>;
+
+} // namespace job_kinds
+
+} // end namespace orchestrator
@@ -1,10 +1,15 @@
 #pragma once
 
+#include <array>
 #include <atomic>
 #include <variant>
 #include <cstdint>
 #include <map>
+#include <memory>
 #include <mutex>
+#include <optional>
+#include <queue>
+#include <set>
 #include <string>
 #include <functional>
 #include <mscpp/InputSet.h>
@@ -14,6 +19,12 @@
 
 #include "orchestrator/Result.h"
 #include "orchestrator/Job.h"
+#include "orchestrator/JobEvents.h"
+#include "orchestrator/OutputStore.h"
+#include "orchestrator/ResultCache.h"
+#include "orchestrator/ShardRouter.h"
+#include "orchestrator/TimerWheel.h"
+#include "orchestrator/Stats.h"
 
 #include "orchestrator/JobDatabase.h"
 #include "orchestrator/JobExecutor.h"
@@ -33,6 +44,18 @@ struct PushInput : public services::Input<PushInput, result::JobIdResult, 0, 100
     Job job;
 };
 
+struct StatsInput : public services::Input<StatsInput, result::StatsResult, 1, 10>
+{
+};
+
+// Push a job once its start time arrives, and then again every periodSeconds if that is positive
+struct ScheduleInput : public services::Input<ScheduleInput, result::JobIdResult, 0, 100>
+{
+    Job     job;
+    int64_t startTimeSeconds;
+    int64_t periodSeconds{0};
+};
+
 struct QueryInput : public services::Input<QueryInput, result::JobsListResult, 1, 10>
 {
     typedef struct GetAllQueuedJobs
@@ -42,7 +65,15 @@ struct QueryInput : public services::Input<QueryInput, result::JobsListResult, 1
     {
         int64_t priority;
     };
-    using QueryType = std::variant<GetAllQueuedJobs, GetJobsAtPriorityLevel>;
+    // Finished, failed, and canceled jobs, carrying only their ID, final status, and completion time
+    struct GetArchivedJobs
+    {
+    };
+    // Delayed and recurring jobs, identified by schedule ID and carrying their next run time as executionTimeSeconds
+    struct GetScheduledJobs
+    {
+    };
+    using QueryType = std::variant<GetAllQueuedJobs, GetJobsAtPriorityLevel, GetArchivedJobs, GetScheduledJobs>;
     QueryType query;
 };
 
@@ -54,19 +85,211 @@ struct DumpInput : public services::Input<DumpInput, result::BooleanResult, 1, 5
 {
 };
 
-using Inputs = services::InputSet<HeartbeatInput, PushInput, QueryInput, TogglePauseInput, DumpInput>;
+// Cancel a queued job along with every job that (transitively) depends on it
+struct CancelInput : public services::Input<CancelInput, result::JobIdsListResult, 1, 10>
+{
+    int64_t id;
+};
+
+// Register interest in job status changes. Matching events are pushed to the returned stream in one batch per
+// heartbeat, so subscribers learn about changes without repeatedly querying for copies of every job.
+struct SubscribeInput : public services::Input<SubscribeInput, result::SubscriptionResult, 1, 10>
+{
+    events::SubscriptionFilter filter;
+    size_t                     capacity{events::EventStream::kDefaultCapacity};
+};
+
+struct UnsubscribeInput : public services::Input<UnsubscribeInput, result::BooleanResult, 1, 10>
+{
+    int64_t id;
+};
+
+// How ready jobs sharing a priority level are ordered for dispatch
+enum class SchedulingMode
+{
+    // Fewest blockers, then oldest first
+    PRIORITY,
+    // Longest chain of (transitive) dependents first, to shorten overall DAG makespan
+    CRITICAL_PATH,
+    // Earliest Job::deadlineSeconds first; jobs without a deadline go last
+    EARLIEST_DEADLINE
+};
+
+// Scheduling mode by its command-line name (priority, critical-path, or earliest-deadline); none if unknown
+std::optional<SchedulingMode> schedulingModeFromName(const std::string& name);
+
+struct ConfigureInput : public services::Input<ConfigureInput, result::BooleanResult, 2, 5>
+{
+    struct SetSchedulingMode
+    {
+        SchedulingMode mode;
+    };
+    // Reuse the results of jobs whose inputs match those of a previously finished job; a zero capacity disables it
+    struct SetResultCache
+    {
+        size_t capacityBytes;
+        bool   diskTier;
+    };
+    // Attach ready jobs to an identical (same kind and inputs) queued or running job instead of executing them apart
+    struct SetJobCoalescing
+    {
+        bool enabled;
+    };
+    // Make this queue one of several shards partitioning the jobs between them; must precede the first heartbeat
+    struct SetSharding
+    {
+        std::shared_ptr<ShardRouter> router;
+        size_t                       shardIndex;
+    };
+    // Spill job outputs at or above the store's threshold to disk, handing dependents a handle in their place; a null
+    // store keeps every output in memory
+    struct SetOutputStore
+    {
+        std::shared_ptr<outputs::OutputStore> store;
+    };
+    using ConfigType = std::variant<SetSchedulingMode, SetResultCache, SetJobCoalescing, SetSharding, SetOutputStore>;
+    ConfigType config;
+};
+
+using Inputs = services::InputSet<HeartbeatInput,
+                                  PushInput,
+                                  QueryInput,
+                                  TogglePauseInput,
+                                  DumpInput,
+                                  ConfigureInput,
+                                  CancelInput,
+                                  ScheduleInput,
+                                  StatsInput,
+                                  SubscribeInput,
+                                  UnsubscribeInput>;
 
 using Container = services::MicroServiceContainer<job_executor::JobExecutor, job_database::JobDatabase>;
 
+// What is kept of a job once it reaches a terminal state and leaves the scheduling structures
+struct ArchivedJob
+{
+    aapis::orchestrator::v1::JobStatus status;
+    int64_t                            completionTimestampSeconds;
+};
+
+// (Deadline, job ID) pairs of running jobs with a timeout, soonest deadline on top
+using DeadlineHeap =
+    std::priority_queue<std::pair<int64_t, int64_t>, std::vector<std::pair<int64_t, int64_t>>, std::greater<>>;
+
+// Subscription ID -> stream the subscriber reads events from
+using Subscriptions = std::map<int64_t, std::shared_ptr<events::EventStream>>;
+
+// Hot-path instrumentation, written only from the job queue's own thread
+struct QueueStats
+{
+    static constexpr size_t kNumStates = 5;
+
+    std::array<stats::LatencyHistogram, kNumStates> heartbeatMicros; // indexed by state
+    stats::LatencyHistogram                         pushToDispatchMicros;
+    stats::LatencyHistogram                         dispatchToCompletionMicros;
+    stats::Counter                                  pushes;
+    stats::Counter                                  dispatches;
+    stats::Counter                                  cacheHits;
+    stats::Counter                                  completions;
+    stats::Counter                                  failures;
+    stats::Counter                                  timeouts;
+    stats::Counter                                  budgetOverruns;
+    stats::Counter                                  executorRejections;
+    stats::Counter                                  executorSlowAcks;
+};
+
+// A job set aside while the on-disk tier of the result cache is consulted for its inputs
+using PendingCacheLookup = std::pair<Job, result::FutureOptionalJobResult>;
+
+// A finished job's result while its large outputs are spilled off the queue's thread, along with the handles spilled
+using PendingSpill = std::future<std::pair<result::JobResult, std::vector<std::string>>>;
+
+// Job ID -> handles to spilled outputs the job holds references to
+using HeldHandles = std::map<int64_t, std::vector<std::string>>;
+
+// Takes the place of the JobExecutor service when set, so that a queue can be driven without one (e.g. by a
+// simulation); called from the queue's own thread
+struct ExecutorStandIn
+{
+    std::function<bool(job_executor::ExecuteInput&&)> execute;
+    std::function<void(int64_t)>                      abandon; // job ID
+};
+
 struct Store // TODO clean up by making this a class to protect private members
 {
     std::atomic_uint8_t                        subCounter{0};
+    int64_t                                    lastJobId{-1};
     std::vector<Job>                           pendingJobs;
     std::map<int64_t, result::FutureJobResult> pendingJobResults;
+    std::map<int64_t, std::vector<int64_t>>    jobDependents; // blocker ID -> IDs of jobs it directly blocks
+    SchedulingMode                             schedulingMode{SchedulingMode::PRIORITY};
+    std::map<int64_t, int64_t>                 criticalPathLengths;
+    std::map<int64_t, ArchivedJob>             archivedJobs;
+    ResultCache                                resultCache;
+    bool                                       resultCacheDiskTier{false};
+    std::map<int64_t, ResultCacheKey>          inFlightCacheKeys;
+    std::map<int64_t, PendingCacheLookup>      pendingCacheLookups;
+    std::set<int64_t>                          diskCacheMissedJobIds;
+    std::vector<ResultCache::Entry>            pendingCacheSpills;
+    std::shared_ptr<outputs::OutputStore>      outputStore; // unset unless large outputs are spilled to disk
+    std::map<int64_t, PendingSpill>            pendingSpills;
+    // Handles to spilled outputs each job holds a reference to: among its inputs while it is in the queue, and among
+    // its outputs from the time its result is in (a spill or cache hit) until the result is taken in
+    HeldHandles                                heldInputHandles;
+    HeldHandles                                heldResultHandles;
+    // Microseconds since the epoch, standing in for both the system and steady clocks when set (e.g. by a simulation)
+    std::function<int64_t()>                   virtualClock;
+    std::optional<ExecutorStandIn>             executorStandIn;
+    bool                                       jobCoalescing{false};
+    std::map<uint64_t, int64_t>                coalescingPrimaries;   // key hash -> ID of the job doing the work
+    std::map<int64_t, ResultCacheKey>          coalescingPrimaryKeys; // reverse of coalescingPrimaries
+    std::map<int64_t, std::vector<Job>>        coalescedWaiters;      // primary ID -> identical jobs awaiting it
+    TimerWheel                                 jobTimers;
+    std::map<int64_t, ScheduledJob>            scheduledJobs;
+    DeadlineHeap                               runningDeadlines;
+    std::map<int64_t, int64_t>                 runningDeadlineSeconds; // authoritative; heap entries may be stale
+    std::map<int64_t, Job>                     retryableRunningJobs;
+    std::map<int64_t, Job>                     retryingJobs;           // waiting out their backoff on the wheel
+    QueueStats                                 queueStats;
+    std::map<int64_t, int64_t>                 pushTimesMicros;
+    std::map<int64_t, int64_t>                 dispatchTimesMicros;
+    std::map<int64_t, int64_t>                 jobPriorities; // of every job not yet archived, for event filtering
+    int64_t                                    lastSubscriptionId{0};
+    Subscriptions                              subscriptions;
+    std::vector<events::JobEvent>              pendingEvents; // recorded since the last publishEvents()
+    std::shared_ptr<ShardRouter>               shardRouter;   // unset unless sharded
+    size_t                                     shardIndex{0};
+    std::map<int64_t, std::set<size_t>>        remoteWatchers; // job ID -> other shards with jobs blocked on it
+    // Outcomes of finished jobs, kept while they are archived for watches that arrive late; only when sharded. They
+    // hold references to any spilled outputs, as do resolutions in the mail until the shard they're sent to takes them.
+    std::map<int64_t, BlockerResolution>       finishedResolutions;
     result::FutureJobQueueDataResult           pendingInitLoad;
     std::vector<Job>                           pendingInitExecs;
+    int64_t                                    nowMicros() const;
+    int64_t                                    nowSeconds() const;
+    int64_t                                    steadyMicros() const;
+    bool                                       sendToExecutor(const Container& c, job_executor::ExecuteInput&& input);
+    void                                       abandonOnExecutor(const Container& c, int64_t jobId);
     int64_t                                    addAndRegisterNewJob(Job& job, bool paused);
     int64_t                                    initializeJobData(Job& job, bool paused);
+    int64_t                                    scheduleJob(const Job& job,
+                                                           int64_t    startTimeSeconds,
+                                                           int64_t    periodSeconds,
+                                                           bool       paused);
+    void                                       releaseScheduledJobs(bool paused);
+    bool                                       hasActiveJob(int64_t jobId) const;
+    std::vector<Job>                           queuedJobs() const;
+    job_database::DumpQueueData                dumpQueueData() const;
+    void                                       loadQueueData(result::JobQueueDataResult queueData);
+    bool                                       createsCycle(int64_t jobId, const std::vector<int64_t>& blockers) const;
+    void                                       registerDependencies(const Job& job);
+    void                                       rebuildDependencyGraph();
+    void                                       computeCriticalPathLengths();
+    void                                       archiveJob(int64_t jobId, aapis::orchestrator::v1::JobStatus status);
+    std::vector<int64_t>                       cancelJobs(int64_t rootId);
+    bool                                       coalesceJob(Job& job);
+    void                                       registerCoalescingPrimary(int64_t jobId, ResultCacheKey key);
+    std::vector<Job>                           retireCoalescingPrimary(int64_t jobId);
     void                                       sortJobs();
     void                                       pauseJobs();
     void                                       unpauseJobs();
@@ -74,8 +297,45 @@ struct Store // TODO clean up by making this a class to protect private members
                                                              std::vector<Job>&                      jobs,
                                                              const Container&                       c,
                                                              const std::function<bool(const Job&)>& fJobDrainCriterion);
+    bool                                       resolveFromResultCache(const Job& job, const Container& c);
+    void                                       processPendingCacheLookups(bool paused);
+    void                                       flushPendingCacheSpills(const Container& c);
+    void                                       trackDeadline(const Job& job);
+    void                                       reapExpiredJobs(const Container& c, bool paused);
     void                                       processPendingJobResults(bool paused);
+    void                                       processPendingSpills(bool paused);
+    void                                       holdHandles(HeldHandles&                    held,
+                                                           int64_t                         jobId,
+                                                           const std::vector<std::string>& inputs);
+    void                                       releaseHeldHandles(HeldHandles& held, int64_t jobId);
+    void                                       retainHandles(const result::JobResult& jobResult);
+    void                                       releaseHandles(const result::JobResult& jobResult);
+    void                                       cacheResult(const ResultCacheKey&        key,
+                                                           const result::JobResult& jobResult);
+    void                                       retireCacheEntries(std::vector<ResultCache::Entry> removed);
+    void                                       postResolution(size_t watcherShard, const BlockerResolution& resolution);
+    void                                       completeJob(int64_t jobId, result::JobResult jobResult, bool paused);
+    void                                       resolveJob(int64_t                     jobId,
+                                                          const result::JobResult&    jobResult,
+                                                          const std::vector<int64_t>& childJobIds);
+    void                                       unblockDependents(int64_t                     jobId,
+                                                                 const result::JobResult&    jobResult,
+                                                                 const std::vector<int64_t>& childJobIds);
+    bool                                       isRemoteJob(int64_t jobId) const;
+    void                                       notifyRemoteWatchers(int64_t                     jobId,
+                                                                    const result::JobResult&    jobResult,
+                                                                    const std::vector<int64_t>& childJobIds);
+    void                                       processShardMail();
     std::vector<Job>                           query(const QueryInput::QueryType& query);
+    void                                       configure(const ConfigureInput::ConfigType& config);
+    void                                       recordDispatch(int64_t jobId);
+    result::StatsResult                        collectStats() const;
+    void                                       recordEvent(int64_t jobId, aapis::orchestrator::v1::JobStatus status);
+    void                                       publishEvents();
+    result::SubscriptionResult                 subscribe(const events::SubscriptionFilter& filter, size_t capacity);
+    bool                                       unsubscribe(int64_t subscriptionId);
+    void                                       answerSubscribe(SubscribeInput& i);
+    void                                       answerUnsubscribe(UnsubscribeInput& i);
 };
 
 // Initial state in which any persistent memory is requested to be loaded
@@ -86,6 +346,12 @@ struct InitState : public services::State<InitState, 0>
     size_t step(Store& s, const Container& c, QueryInput& i);
     size_t step(Store& s, const Container& c, TogglePauseInput& i);
     size_t step(Store& s, const Container& c, DumpInput& i);
+    size_t step(Store& s, const Container& c, ConfigureInput& i);
+    size_t step(Store& s, const Container& c, CancelInput& i);
+    size_t step(Store& s, const Container& c, ScheduleInput& i);
+    size_t step(Store& s, const Container& c, StatsInput& i);
+    size_t step(Store& s, const Container& c, SubscribeInput& i);
+    size_t step(Store& s, const Container& c, UnsubscribeInput& i);
 };
 
 // Follow-on initial state in which persistent memory is actually loaded
@@ -96,6 +362,12 @@ struct InitWaitState : public services::State<InitWaitState, 1>
     size_t step(Store& s, const Container& c, QueryInput& i);
     size_t step(Store& s, const Container& c, TogglePauseInput& i);
     size_t step(Store& s, const Container& c, DumpInput& i);
+    size_t step(Store& s, const Container& c, ConfigureInput& i);
+    size_t step(Store& s, const Container& c, CancelInput& i);
+    size_t step(Store& s, const Container& c, ScheduleInput& i);
+    size_t step(Store& s, const Container& c, StatsInput& i);
+    size_t step(Store& s, const Container& c, SubscribeInput& i);
+    size_t step(Store& s, const Container& c, UnsubscribeInput& i);
 };
 
 // Final initial state in which formerly in-progress jobs are re-triggered
@@ -106,6 +378,12 @@ struct InitFinalWaitState : public services::State<InitFinalWaitState, 2>
     size_t step(Store& s, const Container& c, QueryInput& i);
     size_t step(Store& s, const Container& c, TogglePauseInput& i);
     size_t step(Store& s, const Container& c, DumpInput& i);
+    size_t step(Store& s, const Container& c, ConfigureInput& i);
+    size_t step(Store& s, const Container& c, CancelInput& i);
+    size_t step(Store& s, const Container& c, ScheduleInput& i);
+    size_t step(Store& s, const Container& c, StatsInput& i);
+    size_t step(Store& s, const Container& c, SubscribeInput& i);
+    size_t step(Store& s, const Container& c, UnsubscribeInput& i);
 };
 
 // Nominal running state
@@ -116,6 +394,12 @@ struct RunningState : public services::State<RunningState, 3>
     size_t step(Store& s, const Container& c, QueryInput& i);
     size_t step(Store& s, const Container& c, TogglePauseInput& i);
     size_t step(Store& s, const Container& c, DumpInput& i);
+    size_t step(Store& s, const Container& c, ConfigureInput& i);
+    size_t step(Store& s, const Container& c, CancelInput& i);
+    size_t step(Store& s, const Container& c, ScheduleInput& i);
+    size_t step(Store& s, const Container& c, StatsInput& i);
+    size_t step(Store& s, const Container& c, SubscribeInput& i);
+    size_t step(Store& s, const Container& c, UnsubscribeInput& i);
 };
 
 // Paused state in which no new active jobs get queued
@@ -126,6 +410,12 @@ struct PausedState : public services::State<PausedState, 4>
     size_t step(Store& s, const Container& c, QueryInput& i);
     size_t step(Store& s, const Container& c, TogglePauseInput& i);
     size_t step(Store& s, const Container& c, DumpInput& i);
+    size_t step(Store& s, const Container& c, ConfigureInput& i);
+    size_t step(Store& s, const Container& c, CancelInput& i);
+    size_t step(Store& s, const Container& c, ScheduleInput& i);
+    size_t step(Store& s, const Container& c, StatsInput& i);
+    size_t step(Store& s, const Container& c, SubscribeInput& i);
+    size_t step(Store& s, const Container& c, UnsubscribeInput& i);
 };
 
 using States = services::StateSet<InitState, InitWaitState, InitFinalWaitState, RunningState, PausedState>;
@@ -139,6 +429,23 @@ public:
     const std::string name() const override;
 };
 
+// Most job queue shards a daemon can run; each one past the first is a distinct service type (and so thread)
+static constexpr size_t kMaxShards = 8;
+
+// Job queue shard beyond the first (which is a plain JobQueue), for sharded mode
+template<size_t ShardIndex>
+class JobQueueShard : public JobQueue
+{
+    static_assert(ShardIndex > 0 && ShardIndex < kMaxShards);
+
+public:
+    JobQueueShard(const Container& container) : JobQueue(container) {}
+    const std::string name() const override
+    {
+        return "JobQueue" + std::to_string(ShardIndex);
+    }
+};
+
 } // namespace job_queue
 
 } // end namespace orchestrator
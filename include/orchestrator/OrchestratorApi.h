@@ -0,0 +1,62 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <map>
+#include <memory>
+#include <vector>
+
+#include "orchestrator/AgentPool.h"
+#include "orchestrator/JobQueue.h"
+#include "orchestrator/OutputStore.h"
+#include "orchestrator/RpcServer.h"
+
+namespace orchestrator
+{
+
+// Serves the RPC methods by forwarding each request to the service that owns it: the job queue shard owning the job
+// for requests about a single job, and every shard otherwise. Event subscriptions are the exception once made:
+// NEXT_EVENTS is answered straight from the subscription's streams, without involving the queue, as soon as the queue
+// publishes to them (provided the server is woken up then, see setWakeCallback()). Requests from worker agents go to
+// the agent pool, if jobs are run on agents at all, and reads of spilled outputs to the output store.
+class OrchestratorApi
+{
+public:
+    OrchestratorApi(std::vector<std::shared_ptr<job_queue::JobQueue>> jobQueues,
+                    std::shared_ptr<job_queue::ShardRouter>           shardRouter,
+                    std::shared_ptr<job_executor::JobExecutor>        jobExecutor,
+                    std::shared_ptr<job_database::JobDatabase>        jobDatabase,
+                    std::shared_ptr<agents::AgentPool>                agentPool   = nullptr,
+                    std::shared_ptr<outputs::OutputStore>             outputStore = nullptr);
+
+    void              setWakeCallback(std::function<void()> wakeServer);
+    rpc::PendingReply handle(rpc::Frame& request);
+    rpc::PendingReply statsDump();
+    rpc::PendingReply nextEvents(int64_t subscriptionId, size_t maxEvents);
+
+private:
+    struct RpcSubscription
+    {
+        std::vector<result::SubscriptionResult> shardSubscriptions; // in shard order
+        std::chrono::steady_clock::time_point   lastPolled;
+        // Set by the streams' listeners when there may be events to take, so pending replies needn't look every poll
+        std::shared_ptr<std::atomic_bool> published;
+    };
+
+    void expireSubscriptions();
+
+    std::vector<std::shared_ptr<job_queue::JobQueue>> mJobQueues; // indexed by shard
+    std::shared_ptr<job_queue::ShardRouter>           mShardRouter;
+    std::shared_ptr<job_executor::JobExecutor>        mJobExecutor;
+    std::shared_ptr<job_database::JobDatabase>        mJobDatabase;
+    std::shared_ptr<agents::AgentPool>                mAgentPool;
+    std::shared_ptr<outputs::OutputStore>             mOutputStore;
+    std::function<void()>                             mWakeServer;
+    // Subscriptions made over RPC; like the pending replies, only ever touched from the server thread
+    int64_t                               mLastSubscriptionId{0};
+    std::map<int64_t, RpcSubscription>    mSubscriptions;
+    std::chrono::steady_clock::time_point mLastExpiry; // of abandoned subscriptions
+};
+
+} // end namespace orchestrator
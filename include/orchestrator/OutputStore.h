@@ -0,0 +1,90 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace orchestrator
+{
+
+namespace outputs
+{
+
+// A spilled output mapped read-only into memory. Pages are only read from disk as they are touched, so consumers can
+// stream through outputs far larger than they could afford to copy.
+class MappedOutput
+{
+public:
+    MappedOutput() = default;
+    MappedOutput(const void* data, size_t size);
+    MappedOutput(MappedOutput&& other) noexcept;
+    MappedOutput& operator=(MappedOutput&& other) noexcept;
+    MappedOutput(const MappedOutput&)            = delete;
+    MappedOutput& operator=(const MappedOutput&) = delete;
+    ~MappedOutput();
+
+    std::string_view view() const;
+
+private:
+    const void* mData{nullptr};
+    size_t      mSize{0};
+};
+
+struct OutputStoreStats
+{
+    // Written from every job queue shard at once, unlike stats::Counter
+    std::atomic_uint64_t spills{0};
+    std::atomic_uint64_t spilledBytes{0};
+    std::atomic_uint64_t duplicates{0}; // spills whose content was already on disk
+    std::atomic_uint64_t failures{0};   // outputs kept in memory because they couldn't be written
+    std::atomic_uint64_t removals{0};   // files removed once nothing referred to them anymore
+};
+
+// Content-addressed on-disk store for job outputs too large to hold in memory. The job queue spills every output at or
+// above the store's threshold once the job producing it finishes (off its own thread), and dependents (along with the
+// result cache and RPC clients) get a short handle in its place among their inputs. Outputs are named by their SHA-256,
+// so identical ones are stored once. The store counts references to each file, taken by spill() and retain() and given
+// up by release(), and removes a file as soon as nothing refers to it; files left over from earlier runs are never
+// removed, the directory being the daemon's to clear between runs.
+class OutputStore
+{
+public:
+    // Prefix of every handle; an input starting with it is taken for a handle whether or not it names a stored output
+    static constexpr std::string_view kHandlePrefix = "orchestrator-output:";
+
+    OutputStore(std::string directory, size_t spillThresholdBytes);
+
+    static bool                  isHandle(std::string_view input);
+    static std::optional<size_t> spilledSize(std::string_view input);
+
+    const std::string&       directory() const;
+    size_t                   spillThreshold() const;
+    bool                     hasLarge(const std::vector<std::string>& outputs) const;
+    std::string              spill(std::string_view output);
+    std::vector<std::string> spillLarge(std::vector<std::string>& outputs);
+    void                     retain(const std::vector<std::string>& inputs);
+    void                     release(const std::vector<std::string>& inputs);
+    MappedOutput             open(std::string_view handle) const;
+    std::string              read(std::string_view handle, size_t offset, size_t maxBytes) const;
+    std::string              load(const std::string& input) const;
+    void                     addStats(std::map<std::string, int64_t>& metrics) const;
+
+private:
+    std::string pathOf(std::string_view handle) const;
+
+    std::string                   mDirectory;
+    size_t                        mSpillThreshold;
+    OutputStoreStats              mStats;
+    std::mutex                    mReferencesMutex; // also held while files are created or removed under their name
+    std::map<std::string, size_t> mReferences;      // handle -> holders of the file it names
+};
+
+} // namespace outputs
+
+} // end namespace orchestrator
@@ -4,10 +4,16 @@
 #include <utility>
 #include <cstdint>
 #include <future>
+#include <map>
+#include <memory>
+#include <string>
+#include <optional>
 
 #include <aapis/orchestrator/v1/orchestrator.pb.h>
+#include <mscpp/MicroService.h>
 
 #include "orchestrator/Job.h"
+#include "orchestrator/JobEvents.h"
 
 namespace orchestrator
 {
@@ -43,15 +49,42 @@ struct JobResult
 
 using FutureJobResult = std::future<JobResult>;
 
+struct OptionalJobResult
+{
+    std::optional<JobResult> result;
+};
+
 struct JobsListResult
 {
     std::vector<Job> jobs;
 };
 
-using JobQueueDataResult = std::pair<result::JobsListResult, result::JobsListResult>;
+// Named instrumentation readings (counts, depths, and latency percentiles in microseconds) of a service
+struct StatsResult
+{
+    std::map<std::string, int64_t> metrics;
+};
+
+// A registered subscription and the stream its events are pushed to; dropping every reference to the stream ends the
+// subscription
+struct SubscriptionResult
+{
+    int64_t                              id;
+    std::shared_ptr<events::EventStream> stream;
+};
+
+// Everything the job queue shards and the executor dumped
+struct JobQueueDataResult
+{
+    JobsListResult            pendingJobs;
+    JobsListResult            runningJobs; // to be re-executed
+    std::vector<ScheduledJob> scheduledJobs;
+};
 
 using FutureJobQueueDataResult = std::future<std::variant<services::ErrorResult, JobQueueDataResult>>;
 
+using FutureOptionalJobResult = std::future<std::variant<services::ErrorResult, OptionalJobResult>>;
+
 // template<typename T>
 // struct Success
 // {
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <mscpp/MicroService.h>
+
+#include "orchestrator/Result.h"
+
+namespace orchestrator
+{
+
+struct ResultCacheStats
+{
+    uint64_t hits{0};
+    uint64_t diskHits{0};
+    uint64_t misses{0};
+    uint64_t collisions{0}; // lookups whose hash matched an entry for different inputs, counted among the misses
+    uint64_t evictions{0};
+    size_t   sizeBytes{0};
+    size_t   capacityBytes{0};
+};
+
+// What a job's result depends on: its kind and inputs. Lookups go by the hash, but only count as hits if everything
+// else matches too, so that a hash collision never hands a job the result of a different one.
+struct ResultCacheKey
+{
+    uint64_t                 hash{0};
+    uint32_t                 kind{0};
+    std::vector<std::string> inputs{};
+
+    bool operator==(const ResultCacheKey& other) const = default;
+};
+
+// Memory-bounded, least-recently-used map from what a job's result depends on to the result it produced
+class ResultCache
+{
+public:
+    using Entry = std::pair<ResultCacheKey, result::JobResult>;
+
+    static uint64_t       hashInputs(const std::vector<std::string>& inputs);
+    static ResultCacheKey keyOf(uint32_t kind, const std::vector<std::string>& inputs);
+    static bool           isCacheable(const result::JobResult& jobResult);
+
+    explicit ResultCache(size_t capacityBytes = 0);
+
+    bool                             enabled() const;
+    size_t                           numEntries() const;
+    std::vector<Entry>               setCapacity(size_t capacityBytes);
+    std::optional<result::JobResult> lookup(const ResultCacheKey& key);
+    std::vector<Entry>               insert(const ResultCacheKey& key, const result::JobResult& jobResult);
+    bool                             contains(const ResultCacheKey& key) const;
+    void                             recordDiskHit();
+    const ResultCacheStats&          stats() const;
+
+private:
+    static size_t      entryBytes(const Entry& entry);
+    std::vector<Entry> evictToCapacity();
+
+    std::list<Entry>                                          mEntries; // most recently used first
+    std::unordered_map<uint64_t, std::list<Entry>::iterator> mIndex;   // by key hash; colliding keys evict each other
+    ResultCacheStats                                          mStats;
+};
+
+} // end namespace orchestrator
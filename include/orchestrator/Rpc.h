@@ -0,0 +1,107 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "orchestrator/Job.h"
+#include "orchestrator/JobEvents.h"
+
+namespace orchestrator
+{
+
+namespace rpc
+{
+
+// Every request and reply travels in one frame: a 9-byte header of little-endian payload length (u32), request ID
+// (u32), and method or status (u8), then the payload. Requests may be pipelined on a connection; replies come back in
+// request order.
+static constexpr size_t   kHeaderSize     = 9;
+static constexpr uint32_t kMaxPayloadSize = 16 << 20;
+
+enum class Method : uint8_t
+{
+    PUSH = 1,       // Job -> job ID
+    SCHEDULE,       // Job, start time (s), period (s) -> schedule ID
+    CANCEL,         // job ID -> canceled job IDs
+    QUERY_QUEUED,   // -> jobs
+    QUERY_ARCHIVED, // -> jobs
+    TOGGLE_PAUSE,   // -> bool
+    STATS,          // -> text dump of every service's metrics
+    ATTACH_SHM,     // request and reply ring capacities, with memfd, doorbell and notify eventfds passed -> ()
+    SUBSCRIBE,      // filter, buffer capacity -> subscription ID
+    NEXT_EVENTS,    // subscription ID, max events (0 for any) -> dropped count, closed flag, events; long-polled
+    UNSUBSCRIBE,    // subscription ID -> ()
+    // Agent methods start with the agent token, which may be empty for agents on the loopback interface
+    AGENT_REGISTER, // token, agent name, slot count -> agent ID, lease (ms)
+    AGENT_POLL,     // token, agent ID, free slots, longest wait (ms), finished jobs' results -> jobs to run; renews it
+    READ_OUTPUT,    // spilled output handle, offset, longest chunk (bytes) -> chunk, empty past the end
+};
+
+enum class Status : uint8_t
+{
+    OK    = 0,
+    ERROR = 1, // payload is the error message
+};
+
+struct Frame
+{
+    uint32_t    requestId;
+    uint8_t     code;
+    std::string payload;
+    // Set by RpcServer: whether the request came over the loopback interface or a Unix-domain socket
+    bool fromLocalPeer{false};
+};
+
+void   appendFrame(std::string& buffer, uint32_t requestId, uint8_t code, std::string_view payload);
+size_t parseFrame(std::string_view buffer, Frame& frame);
+
+// Appends little-endian scalars and length-prefixed strings and lists to a payload
+class Writer
+{
+public:
+    explicit Writer(std::string& out) : mOut(out) {}
+
+    void u8(uint8_t value);
+    void u32(uint32_t value);
+    void i64(int64_t value);
+    void string(std::string_view value);
+    void strings(const std::vector<std::string>& values);
+    void ids(const std::vector<int64_t>& values);
+    void job(const Job& job);
+    void jobs(const std::vector<Job>& jobs);
+    void filter(const events::SubscriptionFilter& filter);
+    void jobEvents(const std::vector<events::JobEvent>& events);
+
+private:
+    std::string& mOut;
+};
+
+// Reads back what Writer wrote, throwing std::runtime_error on a truncated payload
+class Reader
+{
+public:
+    explicit Reader(std::string_view in) : mIn(in) {}
+
+    uint8_t                       u8();
+    uint32_t                      u32();
+    int64_t                       i64();
+    std::string                   string();
+    std::vector<std::string>      strings();
+    std::vector<int64_t>          ids();
+    Job                           job();
+    std::vector<Job>              jobs();
+    events::SubscriptionFilter    filter();
+    std::vector<events::JobEvent> jobEvents();
+
+private:
+    std::string_view take(size_t numBytes);
+    size_t           count();
+
+    std::string_view mIn;
+};
+
+} // namespace rpc
+
+} // end namespace orchestrator
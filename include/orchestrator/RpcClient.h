@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "orchestrator/Rpc.h"
+
+namespace orchestrator
+{
+
+namespace rpc
+{
+
+// Blocking client for a server on a TCP port (by default on the loopback interface) or a Unix-domain socket. Requests
+// are buffered until flush(), so any number of them can be pipelined before reading back the replies in order.
+class RpcClient
+{
+public:
+    explicit RpcClient(uint16_t port);
+    RpcClient(const std::string& host, uint16_t port);
+    explicit RpcClient(const std::string& socketPath);
+    ~RpcClient();
+    RpcClient(const RpcClient&)            = delete;
+    RpcClient& operator=(const RpcClient&) = delete;
+
+    uint32_t send(Method method, std::string_view payload);
+    void     flush();
+    Frame    receive();
+    Frame    call(Method method, std::string_view payload);
+    Frame    callPassingFds(Method method, std::string_view payload, const std::vector<int>& fds);
+
+private:
+    int         mFd{-1};
+    uint32_t    mNextRequestId{1};
+    std::string mWriteBuffer;
+    std::string mReadBuffer;
+};
+
+} // namespace rpc
+
+} // end namespace orchestrator
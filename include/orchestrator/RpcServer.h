@@ -0,0 +1,115 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "orchestrator/Rpc.h"
+#include "orchestrator/ShmRing.h"
+
+namespace orchestrator
+{
+
+namespace rpc
+{
+
+struct Reply
+{
+    Status      status;
+    std::string payload;
+};
+
+// Polled by the server until it yields the reply, so slow requests never hold up the event loop
+using PendingReply = std::function<std::optional<Reply>()>;
+
+// Turns a request frame into its (pending) reply
+using Handler = std::function<PendingReply(Frame& request)>;
+
+// Single-threaded epoll server on a TCP port (by default on the loopback interface only) and, optionally, a Unix-domain
+// socket. Each connection is
+// persistent and may pipeline requests; every reply that is ready by the end of a loop iteration goes out in one
+// batched write. Clients on the Unix-domain socket may also attach a shared-memory channel (see ShmClient), whose
+// requests and replies skip the socket entirely.
+class RpcServer
+{
+public:
+    RpcServer(uint16_t port, Handler handler, const std::string& address = "127.0.0.1");
+    ~RpcServer();
+
+    void     listenUnix(const std::string& socketPath);
+    void     run();
+    void     stop();
+    void     wake();
+    uint16_t port() const;
+
+private:
+    struct ShmChannel
+    {
+        void*   region{nullptr};
+        size_t  regionSize{0};
+        ShmRing requests;
+        ShmRing replies;
+        // Signaled whenever replies are written, for a client blocked waiting on them
+        int notifyFd{-1};
+    };
+
+    struct Connection
+    {
+        // The socket, or for a shared-memory channel the eventfd its client rings after writing requests
+        int                                           fd{-1};
+        std::string                                   readBuffer;
+        std::string                                   writeBuffer;
+        size_t                                        writeOffset{0};
+        std::deque<std::pair<uint32_t, PendingReply>> inFlight;
+        uint32_t                                      events{0};
+        bool                                          peerClosed{false};
+        bool                                          isUnix{false};
+        bool                                          isLocal{false}; // Unix-domain or from a loopback address
+        // File descriptors passed over a Unix-domain socket, waiting to be claimed by a request
+        std::vector<int>            receivedFds;
+        std::unique_ptr<ShmChannel> channel;
+        // Socket a channel was attached through, and the channels attached through a socket
+        int              ownerFd{-1};
+        std::vector<int> channelFds;
+    };
+
+    void         acceptConnections(int listenFd);
+    void         pauseAccepting(bool paused);
+    PendingReply attachChannel(Connection& conn, Frame& request);
+    void         readRequests(Connection& conn);
+    void parseRequests(Connection& conn);
+    void collectReplies(Connection& conn);
+    bool writeReplies(Connection& conn);
+    void serviceConnection(Connection& conn);
+    void closeConnection(Connection& conn);
+
+    Handler                                              mHandler;
+    int                                                  mListenFd{-1};
+    int                                                  mUnixListenFd{-1};
+    std::string                                          mUnixSocketPath;
+    int                                                  mEpollFd{-1};
+    int                                                  mWakeFd{-1};
+    uint16_t                                             mPort{0};
+    std::atomic_bool                                     mStopping{false};
+    std::unordered_map<int, std::unique_ptr<Connection>> mConnections;
+    // Connections waiting on at least one reply, polled every loop iteration
+    std::unordered_set<int> mBusyFds;
+    uint64_t                mNumReplies{0}; // collected so far, to tell whether polling turned anything up
+    // Set while out of file descriptors, when listening sockets are left alone for a while
+    bool                                  mAcceptPaused{false};
+    std::chrono::steady_clock::time_point mAcceptResumeTime;
+    // Closed connections are kept for reuse so their buffers don't have to grow again
+    std::vector<std::unique_ptr<Connection>> mIdleConnections;
+};
+
+} // namespace rpc
+
+} // end namespace orchestrator
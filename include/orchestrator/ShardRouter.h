@@ -0,0 +1,70 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "orchestrator/Job.h"
+#include "orchestrator/Result.h"
+
+namespace orchestrator
+{
+
+namespace job_queue
+{
+
+// A shard's request to hear about the outcome of one of another shard's jobs that its own jobs are blocked on
+struct BlockerWatch
+{
+    int64_t blockerId;
+    size_t  watcherShard;
+};
+
+// The outcome of a blocker, delivered to each shard that watches it
+struct BlockerResolution
+{
+    int64_t              blockerId;
+    result::JobResult    result;
+    std::vector<int64_t> childJobIds;
+};
+
+// Everything posted to a shard since it last checked
+struct ShardMail
+{
+    std::vector<BlockerWatch>      watches;
+    std::vector<BlockerResolution> resolutions;
+};
+
+// Partitions jobs across job queue shards and carries blocker notifications between them. Every job ID is congruent
+// to its shard's index modulo the number of shards, so any shard can tell where a blocker lives without asking.
+class ShardRouter
+{
+public:
+    explicit ShardRouter(size_t numShards);
+
+    size_t  numShards() const;
+    size_t  shardOf(int64_t jobId) const;
+    size_t  shardFor(const Job& job);
+    int64_t alignId(int64_t jobId, size_t shard) const;
+
+    void      postWatch(size_t shard, const BlockerWatch& watch);
+    void      postResolution(size_t shard, BlockerResolution resolution);
+    ShardMail takeMail(size_t shard);
+
+private:
+    struct Mailbox
+    {
+        std::mutex mutex;
+        ShardMail  mail;
+    };
+
+    const size_t                          mNumShards;
+    std::vector<std::unique_ptr<Mailbox>> mMailboxes;
+    std::atomic_size_t                    mNextShard{0};
+};
+
+} // namespace job_queue
+
+} // end namespace orchestrator
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+
+#include "orchestrator/RpcClient.h"
+#include "orchestrator/ShmRing.h"
+
+namespace orchestrator
+{
+
+namespace rpc
+{
+
+// Client of a shared-memory channel to a server on the same host. Requests and replies go through a pair of rings
+// mapped into both processes, so submitting a job costs a copy into the ring and, once per flushed batch, an eventfd
+// write; the Unix-domain socket is only used to hand the channel over. Same pipelining interface as RpcClient.
+class ShmClient
+{
+public:
+    static constexpr size_t kDefaultRequestCapacity = 1 << 20;
+    static constexpr size_t kDefaultReplyCapacity   = 4 << 20;
+
+    explicit ShmClient(const std::string& socketPath,
+                       size_t             requestCapacity = kDefaultRequestCapacity,
+                       size_t             replyCapacity   = kDefaultReplyCapacity);
+    ~ShmClient();
+    ShmClient(const ShmClient&)            = delete;
+    ShmClient& operator=(const ShmClient&) = delete;
+
+    uint32_t send(Method method, std::string_view payload);
+    void     flush();
+    Frame    receive();
+    Frame    call(Method method, std::string_view payload);
+
+private:
+    bool takeReplies();
+
+    RpcClient        mControl;
+    ShmChannelLayout mLayout;
+    void*            mRegion{nullptr};
+    ShmRing          mRequests;
+    ShmRing          mReplies;
+    int              mDoorbellFd{-1};
+    int              mNotifyFd{-1};
+    uint32_t         mNextRequestId{1};
+    bool             mUnflushed{false};
+    // Replies taken out of the ring early to make room while waiting to send
+    std::deque<Frame> mReceived;
+};
+
+} // namespace rpc
+
+} // end namespace orchestrator
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+#include "orchestrator/Rpc.h"
+
+namespace orchestrator
+{
+
+namespace rpc
+{
+
+// Single-producer, single-consumer ring of variable-length frames living in memory shared between two processes.
+// Each record is a 16-byte header (payload length, request ID, method or status) followed by the payload, padded to 8
+// bytes; a record that would straddle the end of the ring is preceded by a wrap marker instead. The other process can
+// scribble over the whole region at any time, so each side keeps the capacity and its own cursor privately and only
+// ever takes the other side's cursor from shared memory, checking it before use.
+class ShmRing
+{
+public:
+    static constexpr size_t kMaxCapacity = size_t{1} << 30;
+
+    struct Header
+    {
+        alignas(64) std::atomic_uint64_t head; // bytes ever written, owned by the producer
+        alignas(64) std::atomic_uint64_t tail; // bytes ever read, owned by the consumer
+        alignas(64) uint64_t capacity;
+    };
+
+    static size_t regionSize(size_t capacity);
+
+    ShmRing() = default;
+    ShmRing(void* region, size_t capacity, bool initialize);
+
+    size_t capacity() const;
+    bool   tryWrite(uint32_t requestId, uint8_t code, std::string_view payload);
+    bool   tryRead(Frame& frame);
+    bool   empty() const;
+
+private:
+    static constexpr size_t   kRecordHeaderSize = 16;
+    static constexpr uint32_t kWrapMarker       = 0xffffffff;
+
+    Header*  mHeader{nullptr};
+    char*    mData{nullptr};
+    size_t   mCapacity{0};
+    uint64_t mHead{0}; // producer side only
+    uint64_t mTail{0}; // consumer side only
+};
+
+// The pair of rings making up one client's shared-memory channel, laid out back to back in a single region
+struct ShmChannelLayout
+{
+    size_t requestCapacity;
+    size_t replyCapacity;
+
+    size_t regionSize() const
+    {
+        return ShmRing::regionSize(requestCapacity) + ShmRing::regionSize(replyCapacity);
+    }
+    ShmRing requestRing(void* region, bool initialize) const
+    {
+        return ShmRing(region, requestCapacity, initialize);
+    }
+    ShmRing replyRing(void* region, bool initialize) const
+    {
+        return ShmRing(static_cast<char*>(region) + ShmRing::regionSize(requestCapacity), replyCapacity, initialize);
+    }
+};
+
+} // namespace rpc
+
+} // end namespace orchestrator
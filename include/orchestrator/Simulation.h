@@ -0,0 +1,125 @@
+#pragma once
+
+#include <cstdint>
+#include <future>
+#include <istream>
+#include <map>
+#include <memory>
+#include <ostream>
+#include <queue>
+#include <string>
+#include <vector>
+
+#include "orchestrator/JobEvents.h"
+#include "orchestrator/JobQueue.h"
+#include "orchestrator/Stats.h"
+
+namespace orchestrator
+{
+
+namespace simulation
+{
+
+// One job of a workload: when it is pushed, and how it then behaves once handed to the executor
+struct TraceJob
+{
+    int64_t              key;        // names the job within the trace; unrelated to the ID the queue gives it
+    int64_t              pushMicros; // since the start of the trace
+    int64_t              runMicros;  // from dispatch to result
+    bool                 fails{false};
+    int64_t              priority{0};
+    uint32_t             kind{0};
+    std::vector<int64_t> relevantBlockers{}; // keys of jobs pushed earlier
+    std::vector<int64_t> independentBlockers{};
+};
+
+// Jobs in push order
+using Trace = std::vector<TraceJob>;
+
+// Shape of a synthetic workload, for when there is no recorded trace to replay
+struct WorkloadModel
+{
+    size_t   numJobs{10000};
+    double   jobsPerSecond{1000};     // mean rate of (exponentially distributed) arrivals
+    double   meanRunMillis{20};       // mean of (exponentially distributed) run times
+    double   blockedFraction{0.3};    // share of jobs blocked on earlier ones
+    size_t   maxBlockers{3};          // per blocked job
+    size_t   blockerWindow{100};      // blockers are drawn from this many jobs pushed just before
+    int64_t  numPriorities{1};        // priorities are drawn uniformly from [0, numPriorities)
+    double   failureProbability{0.0}; // chance of a job failing, which cancels everything downstream of it
+    uint64_t seed{1};
+};
+
+struct SimulationConfig
+{
+    size_t                    numSlots{16}; // jobs the stand-in executor runs at once
+    int64_t                   heartbeatPeriodMicros{10000};
+    job_queue::SchedulingMode schedulingMode{job_queue::SchedulingMode::PRIORITY};
+    // Virtual wall-clock time at the start of the trace; fixed so that job IDs come out the same on every run
+    int64_t startMicros{1700000000000000};
+};
+
+struct SimulationReport
+{
+    // The queue's own metrics and sim.* ones, all in virtual time but for heartbeat_us.*, sim.heartbeat_budget_pct.*
+    // (real heartbeat step time as a share of the virtual period), sim.wall_us, and sim.speedup_pct
+    std::map<std::string, int64_t> metrics;
+    // Trace keys in the order the queue dispatched them
+    std::vector<int64_t> dispatchOrder;
+};
+
+Trace readTrace(std::istream& in);
+void  writeTrace(std::ostream& out, const Trace& trace);
+Trace generateTrace(const WorkloadModel& model);
+
+// (Virtual time, job ID) pairs of jobs running on the stand-in executor, soonest to finish on top
+using CompletionHeap =
+    std::priority_queue<std::pair<int64_t, int64_t>, std::vector<std::pair<int64_t, int64_t>>, std::greater<>>;
+
+// Replays a trace through a real job queue store on a virtual clock, as fast as the queue can take it. The queue is
+// stepped exactly like the running daemon's, one heartbeat per period, but the executor is a stand-in that runs every
+// job for the time the trace says and the clock skips ahead over heartbeats in which nothing can happen. Given the same
+// trace and configuration, runs dispatch jobs in the same order and report the same virtual-time metrics, so that
+// scheduler changes can be compared against each other (or against a production workload) offline.
+class Simulation
+{
+public:
+    Simulation(Trace trace, SimulationConfig config);
+
+    SimulationReport run();
+
+private:
+    bool execute(job_executor::ExecuteInput&& input);
+    void pushDueJobs();
+    void completeDueJobs();
+    void heartbeat();
+    void takeFinishedJobs();
+    bool canSkipHeartbeats() const;
+
+    const Trace                                        mTrace;
+    const SimulationConfig                             mConfig;
+    job_queue::Store                                   mQueue;
+    job_queue::Container                               mContainer;
+    std::shared_ptr<events::EventStream>               mFinishedJobs;
+    int64_t                                            mNowMicros;
+    size_t                                             mNextPush{0};
+    std::map<int64_t, int64_t>                         mIdsByKey;     // trace key -> queue ID
+    std::map<int64_t, size_t>                          mTraceIndices; // queue ID -> position in the trace
+    std::map<int64_t, int64_t>                         mPushTimes;    // queue ID -> virtual time
+    std::map<int64_t, std::promise<result::JobResult>> mRunningJobs;  // queue ID -> result yet to be set
+    CompletionHeap                                     mCompletions;
+    std::vector<int64_t>                               mDispatchOrder;
+    stats::LatencyHistogram                            mPushToFinishMicros;
+    stats::LatencyHistogram                            mHeartbeatBudgetPercent; // real step time over the period
+    int64_t                                            mNumPushed{0};
+    int64_t                                            mNumRejected{0};
+    int64_t                                            mNumBlockersDropped{0};
+    int64_t                                            mNumHeartbeats{0};
+    int64_t                                            mNumCompleted{0};
+    int64_t                                            mNumFailed{0};
+    int64_t                                            mNumCanceled{0};
+};
+
+} // namespace simulation
+
+} // end namespace orchestrator
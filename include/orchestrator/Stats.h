@@ -0,0 +1,86 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <string>
+
+namespace orchestrator
+{
+
+namespace stats
+{
+
+// Monotonic event counter. Each service only ever updates its own counters from its own thread, so a relaxed
+// load/store pair is enough for lock-free reads from elsewhere without paying for an atomic read-modify-write.
+class Counter
+{
+public:
+    void add(uint64_t n = 1)
+    {
+        mValue.store(mValue.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+    uint64_t value() const
+    {
+        return mValue.load(std::memory_order_relaxed);
+    }
+
+private:
+    std::atomic_uint64_t mValue{0};
+};
+
+// Log-linear (HDR-style) histogram of non-negative integer samples, e.g. microsecond latencies. Every power-of-two
+// range is split into 16 linear sub-buckets, bounding the relative error of reported percentiles to ~6%. Like Counter,
+// it expects a single writing thread.
+class LatencyHistogram
+{
+public:
+    void     record(uint64_t value);
+    uint64_t count() const;
+    uint64_t max() const;
+    uint64_t percentile(double p) const;
+
+private:
+    static constexpr int    kSubBucketBits = 4;
+    static constexpr size_t kNumSubBuckets = 1 << kSubBucketBits;
+    static constexpr size_t kNumBuckets    = kNumSubBuckets * (64 - kSubBucketBits + 1);
+
+    static size_t   bucketIndex(uint64_t value);
+    static uint64_t bucketUpperBound(size_t index);
+
+    std::array<std::atomic_uint64_t, kNumBuckets> mBuckets{};
+    Counter                                       mCount;
+    std::atomic_uint64_t                          mMax{0};
+};
+
+// Records the lifetime of the enclosing scope, in microseconds, into a histogram
+class ScopedLatency
+{
+public:
+    explicit ScopedLatency(LatencyHistogram& histogram)
+        : mHistogram(histogram), mStart(std::chrono::steady_clock::now())
+    {
+    }
+    ~ScopedLatency()
+    {
+        const auto elapsed = std::chrono::steady_clock::now() - mStart;
+        mHistogram.record(std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count());
+    }
+
+private:
+    LatencyHistogram&                     mHistogram;
+    std::chrono::steady_clock::time_point mStart;
+};
+
+int64_t     steadyClockMicros();
+void        addCounter(std::map<std::string, int64_t>& metrics, const std::string& name, const Counter& counter);
+void        addHistogram(std::map<std::string, int64_t>& metrics,
+                         const std::string&              name,
+                         const LatencyHistogram&         histogram);
+std::string formatMetrics(const std::string& serviceName, const std::map<std::string, int64_t>& metrics);
+
+} // namespace stats
+
+} // end namespace orchestrator
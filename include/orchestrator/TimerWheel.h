@@ -0,0 +1,48 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace orchestrator
+{
+
+// Hierarchical timing wheel with one-second resolution. Scheduling is O(1); advancing skips straight over empty slots,
+// so it costs O(1) per occupied slot passed plus the timers that fire or cascade down a level on the way, however much
+// time elapses. Timers can't be removed; owners should ignore stale IDs.
+class TimerWheel
+{
+public:
+    void                 schedule(int64_t id, int64_t expirySeconds);
+    std::vector<int64_t> advance(int64_t nowSeconds);
+    bool                 anchored() const;
+    size_t               size() const;
+
+private:
+    static constexpr int     kSlotBits  = 6;
+    static constexpr size_t  kNumSlots  = 1 << kSlotBits;
+    static constexpr size_t  kNumLevels = 4;
+    static constexpr int64_t kSlotMask  = kNumSlots - 1;
+    static_assert(kNumSlots == 64, "Slot occupancy is kept in one 64-bit word per level");
+
+    struct Timer
+    {
+        int64_t id;
+        int64_t expirySeconds;
+    };
+
+    void    place(const Timer& timer);
+    void    cascade(size_t level, size_t slotIndex);
+    void    tick(std::vector<int64_t>& expired);
+    int64_t nextTickSeconds() const;
+
+    std::array<std::array<std::vector<Timer>, kNumSlots>, kNumLevels> mLevels;
+    std::array<uint64_t, kNumLevels>                                  mOccupied{}; // one bit per non-empty slot
+    std::vector<Timer>                                                mOverflow; // beyond the top level's horizon
+    std::vector<Timer>                                                mDue;      // scheduled in the past
+    int64_t                                                           mCurrentSeconds{-1};
+    size_t                                                            mSize{0};
+};
+
+} // end namespace orchestrator
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <future>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "orchestrator/AgentPool.h"
+#include "orchestrator/JobExecutor.h"
+#include "orchestrator/RpcClient.h"
+
+namespace orchestrator
+{
+
+namespace agents
+{
+
+// Runs jobs for an orchestratord on another machine (or another process on this one) that hands them out through an
+// AgentPool. While any of its jobs are running, it polls as soon as one finishes, or every third of its lease to renew
+// it; while idle, it leaves a poll waiting on the server so new jobs reach it straight away. If the connection drops
+// or its lease lapses, it registers again as a new agent, its old jobs having gone to others.
+class WorkerAgent
+{
+public:
+    WorkerAgent(std::string             host,
+                uint16_t                port,
+                std::string             name,
+                size_t                  numSlots,
+                job_executor::JobRunner runner,
+                std::string             token = "");
+    ~WorkerAgent();
+    WorkerAgent(const WorkerAgent&)            = delete;
+    WorkerAgent& operator=(const WorkerAgent&) = delete;
+
+    void   run();
+    void   stop();
+    size_t numJobsRun() const;
+
+private:
+    void serve(rpc::RpcClient& client);
+    void launch(Job job);
+    void reapWorkers();
+
+    const std::string             mHost;
+    const uint16_t                mPort;
+    const std::string             mName;
+    const size_t                  mNumSlots;
+    const job_executor::JobRunner mRunner;
+    const std::string             mToken;
+
+    std::atomic_bool               mStopping{false};
+    std::atomic_size_t             mNumJobsRun{0};
+    std::vector<std::future<void>> mWorkers;
+    // Results of finished jobs not yet reported, guarded by mMutex and signaled through mFinished
+    std::mutex                                         mMutex;
+    std::condition_variable                            mFinished;
+    std::vector<std::pair<int64_t, result::JobResult>> mResults;
+    size_t                                             mNumRunning{0};
+};
+
+} // namespace agents
+
+} // end namespace orchestrator
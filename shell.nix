@@ -10,6 +10,7 @@ mkShell {
     mscpp
     aapis-cpp
     protobuf
+    gbenchmark
   ];
   shellHook = ''
     cpp-helper vscode
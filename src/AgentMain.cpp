@@ -0,0 +1,81 @@
+#include <boost/program_options.hpp>
+#include <unistd.h>
+#include <csignal>
+#include <cstdlib>
+#include <iostream>
+#include <thread>
+#include "orchestrator/WorkerAgent.h"
+
+using namespace orchestrator;
+
+int main(int argc, char* argv[])
+{
+    uint32_t    port_number = 4444;
+    uint32_t    num_slots   = 4;
+    std::string host        = "127.0.0.1";
+    std::string name        = "agent-" + std::to_string(getpid());
+
+    boost::program_options::options_description args_desc("Options");
+    // clang-format off
+    args_desc.add_options()
+        ("help,h", "print usage")
+        ("host,H", boost::program_options::value<std::string>(),
+            "IPv4 address of the orchestratord to run jobs for; unless it is on this host, its agent token is read "
+            "from $ORCHESTRATOR_AGENT_TOKEN")
+        ("port,p", boost::program_options::value<uint32_t>(), "Port orchestratord serves requests on")
+        ("slots,n", boost::program_options::value<uint32_t>(), "Number of jobs to run at once")
+        ("name", boost::program_options::value<std::string>(), "Name to register under");
+    // clang-format on
+
+    boost::program_options::variables_map vm;
+    boost::program_options::store(boost::program_options::parse_command_line(argc, argv, args_desc), vm);
+    boost::program_options::notify(vm);
+
+    if (vm.count("help"))
+    {
+        std::cout << args_desc << std::endl;
+        return 0;
+    }
+
+    if (vm.count("host"))
+    {
+        host = vm["host"].as<std::string>();
+    }
+    if (vm.count("port"))
+    {
+        port_number = vm["port"].as<uint32_t>();
+    }
+    if (vm.count("slots"))
+    {
+        num_slots = vm["slots"].as<uint32_t>();
+    }
+    if (vm.count("name"))
+    {
+        name = vm["name"].as<std::string>();
+    }
+
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
+    // Agents run jobs of the same kinds the executor runs in-process, though without the kinds' concurrency limits
+    auto runJob = [](const Job& job) {
+        return job.kind == 0 ? job_executor::Store::echoJob(job) : job_kinds::JobKinds::runJob(job);
+    };
+    const char*         token = std::getenv("ORCHESTRATOR_AGENT_TOKEN");
+    agents::WorkerAgent agent(host, static_cast<uint16_t>(port_number), name, num_slots, runJob, token ? token : "");
+    std::thread         running([&agent]() { agent.run(); });
+
+    std::cout << name << " running up to " << num_slots << " jobs at a time for " << host << ":" << port_number
+              << std::endl;
+
+    int signal = 0;
+    sigwait(&signals, &signal);
+    agent.stop();
+    running.join();
+    std::cout << name << " ran " << agent.numJobsRun() << " jobs" << std::endl;
+
+    return 0;
+}
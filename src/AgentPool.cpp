@@ -0,0 +1,381 @@
+#include "orchestrator/AgentPool.h"
+#include <algorithm>
+#include <iterator>
+#include <stdexcept>
+
+namespace orchestrator
+{
+
+namespace agents
+{
+
+namespace
+{
+
+// Longest an agent may have a poll held open waiting for jobs, so it still reports results and renews its lease often
+static constexpr std::chrono::milliseconds kMaxPollWait = std::chrono::seconds(1);
+// How many finished jobs' whereabouts are remembered for placing their dependents
+static constexpr size_t kMaxOutputHolders = 65536;
+
+rpc::PendingReply immediateReply(rpc::Status status, std::string payload)
+{
+    return [reply = rpc::Reply{status, std::move(payload)}]() { return std::optional<rpc::Reply>{reply}; };
+}
+
+} // namespace
+
+void writeJobResult(rpc::Writer& writer, const result::JobResult& jobResult)
+{
+    writer.u8(static_cast<uint8_t>(jobResult.resultStatus));
+    if (std::holds_alternative<std::vector<Job>>(jobResult.outputs))
+    {
+        writer.u8(1);
+        writer.jobs(std::get<std::vector<Job>>(jobResult.outputs));
+    }
+    else
+    {
+        writer.u8(0);
+        writer.strings(std::get<std::vector<std::string>>(jobResult.outputs));
+    }
+}
+
+result::JobResult readJobResult(rpc::Reader& reader)
+{
+    result::JobResult jobResult;
+    jobResult.resultStatus = static_cast<aapis::orchestrator::v1::JobStatus>(reader.u8());
+    if (reader.u8() == 1)
+    {
+        jobResult.outputs = reader.jobs();
+    }
+    else
+    {
+        jobResult.outputs = reader.strings();
+    }
+    return jobResult;
+}
+
+/// @brief Create a pool with no agents
+/// @param lease How long an agent keeps its jobs without polling
+/// @param localityWait How long a job holds out for the agent holding its relevant blockers' outputs
+/// @param token Secret that agents connecting from other hosts must present; empty to only accept local agents
+AgentPool::AgentPool(std::chrono::milliseconds lease, std::chrono::milliseconds localityWait, std::string token)
+    : mLease(lease), mLocalityWait(localityWait), mToken(std::move(token))
+{
+}
+
+/// @brief How many more jobs the live agents could take between them
+size_t AgentPool::freeSlots() const
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    size_t                      numSlots = 0;
+    for (const auto& [agentId, agent] : mAgents)
+    {
+        numSlots += agent.numSlots;
+    }
+    return numSlots > mTasks.size() ? numSlots - mTasks.size() : 0;
+}
+
+/// @brief Whether a job is waiting for or running on an agent
+bool AgentPool::contains(int64_t jobId) const
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mTasks.contains(jobId);
+}
+
+/// @brief Every job submitted that has yet to finish or be abandoned, whether or not an agent has it
+std::vector<Job> AgentPool::outstandingJobs() const
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    std::vector<Job>            jobs;
+    std::ranges::transform(mTasks, std::back_inserter(jobs), [](const auto& task) { return task.second.job; });
+    return jobs;
+}
+
+/// @brief Line a job up for the next agent that asks for work
+/// @param job Job to run, with its inputs filled in
+/// @return Result the agent reports back
+std::future<result::JobResult> AgentPool::submit(const Job& job)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    Task                        task{job, {}, Clock::now(), std::nullopt};
+    auto                        future = task.promise.get_future();
+    mTasks.insert_or_assign(job.id, std::move(task));
+    mPendingJobIds.push_back(job.id);
+    return future;
+}
+
+/// @brief Forget a job whose result nobody needs anymore; an agent already running it finishes it unheard
+/// @param jobId Job to abandon
+/// @return Whether the job was waiting for or running on an agent
+bool AgentPool::abandon(int64_t jobId)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    auto                        taskIt = mTasks.find(jobId);
+    if (taskIt == mTasks.end())
+    {
+        return false;
+    }
+    if (taskIt->second.agentId)
+    {
+        mAgents.at(*taskIt->second.agentId).assignedJobIds.erase(jobId);
+    }
+    mTasks.erase(taskIt);
+    return true;
+}
+
+/// @brief Give up on agents whose leases have lapsed, lining their jobs up again
+/// @return Number of agents lost
+size_t AgentPool::expireAgents()
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    return expireAgentsLocked(Clock::now());
+}
+
+size_t AgentPool::expireAgentsLocked(Clock::time_point now)
+{
+    size_t numLost = 0;
+    for (auto agentIt = mAgents.begin(); agentIt != mAgents.end();)
+    {
+        if (agentIt->second.leaseExpiry > now)
+        {
+            ++agentIt;
+            continue;
+        }
+        // Reassigned jobs go ahead of everything else, having waited the longest
+        for (auto jobIdIt = agentIt->second.assignedJobIds.rbegin(); jobIdIt != agentIt->second.assignedJobIds.rend();
+             ++jobIdIt)
+        {
+            mTasks.at(*jobIdIt).agentId.reset();
+            mPendingJobIds.push_front(*jobIdIt);
+            mStats.reassignments.add();
+        }
+        agentIt = mAgents.erase(agentIt);
+        mStats.lostAgents.add();
+        numLost++;
+    }
+    return numLost;
+}
+
+/// @brief Add the pool's instrumentation to a service's metrics
+void AgentPool::addStats(std::map<std::string, int64_t>& metrics) const
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    size_t                      numSlots = 0;
+    for (const auto& [agentId, agent] : mAgents)
+    {
+        numSlots += agent.numSlots;
+    }
+    metrics["agents.live"]  = static_cast<int64_t>(mAgents.size());
+    metrics["agents.slots"] = static_cast<int64_t>(numSlots);
+    metrics["agents.tasks"] = static_cast<int64_t>(mTasks.size());
+    stats::addCounter(metrics, "agents.dispatches", mStats.dispatches);
+    stats::addCounter(metrics, "agents.batches", mStats.batches);
+    stats::addCounter(metrics, "agents.local_dispatches", mStats.localDispatches);
+    stats::addCounter(metrics, "agents.reassignments", mStats.reassignments);
+    stats::addCounter(metrics, "agents.lost", mStats.lostAgents);
+    stats::addCounter(metrics, "agents.stale_results", mStats.staleResults);
+    stats::addHistogram(metrics, "agents.turnaround_us", mStats.turnaroundMicros);
+}
+
+/// @brief Serve an agent's request
+/// @param request AGENT_REGISTER or AGENT_POLL frame
+/// @return Reply, which for a poll becomes ready once there are jobs for the agent or its wait runs out
+rpc::PendingReply AgentPool::handle(rpc::Frame& request)
+{
+    rpc::Reader reader(request.payload);
+    if (!authenticated(request, reader.string()))
+    {
+        return immediateReply(rpc::Status::ERROR, "Agents on other hosts must present the orchestrator's agent token");
+    }
+    switch (static_cast<rpc::Method>(request.code))
+    {
+    case rpc::Method::AGENT_REGISTER:
+        return registerAgent(reader);
+    case rpc::Method::AGENT_POLL:
+        return poll(reader);
+    default:
+        break;
+    }
+    throw std::runtime_error("Not an agent RPC method");
+}
+
+/// @brief Whether an agent request may be served
+/// @param request Agent request
+/// @param token Token the agent presented
+/// @return Whether the agent is local, or presented the pool's token
+bool AgentPool::authenticated(const rpc::Frame& request, std::string_view token) const
+{
+    if (request.fromLocalPeer)
+    {
+        return true;
+    }
+    if (mToken.empty() || token.size() != mToken.size())
+    {
+        return false;
+    }
+    // Compare every byte, so that how long a rejection takes gives nothing away
+    unsigned char difference = 0;
+    for (size_t k = 0; k < mToken.size(); k++)
+    {
+        difference |= static_cast<unsigned char>(token[k] ^ mToken[k]);
+    }
+    return difference == 0;
+}
+
+rpc::PendingReply AgentPool::registerAgent(rpc::Reader& reader)
+{
+    Agent agent;
+    agent.name     = reader.string();
+    agent.numSlots = std::max<uint32_t>(reader.u32(), 1);
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    const auto                  now = Clock::now();
+    expireAgentsLocked(now);
+    agent.leaseExpiry = now + mLease;
+    const auto agentId = ++mLastAgentId;
+    mAgents.emplace(agentId, std::move(agent));
+
+    std::string payload;
+    rpc::Writer writer(payload);
+    writer.i64(agentId);
+    writer.i64(mLease.count());
+    return immediateReply(rpc::Status::OK, std::move(payload));
+}
+
+rpc::PendingReply AgentPool::poll(rpc::Reader& reader)
+{
+    const auto agentId   = reader.i64();
+    const auto freeSlots = reader.u32();
+    const auto maxWait   = std::min(std::chrono::milliseconds(reader.u32()), kMaxPollWait);
+    const auto deadline  = Clock::now() + maxWait;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        const auto                  now = Clock::now();
+        expireAgentsLocked(now);
+        auto agentIt = mAgents.find(agentId);
+        if (agentIt == mAgents.end())
+        {
+            return immediateReply(rpc::Status::ERROR, "Unknown agent; its lease may have lapsed");
+        }
+        // The lease covers the wait, or an agent left waiting could be presumed lost
+        agentIt->second.leaseExpiry = now + maxWait + mLease;
+
+        const auto numResults = reader.u32();
+        for (uint32_t k = 0; k < numResults; k++)
+        {
+            const auto jobId = reader.i64();
+            acceptResult(agentId, jobId, readJobResult(reader));
+        }
+    }
+
+    return [this, agentId, freeSlots, deadline]() -> std::optional<rpc::Reply> {
+        std::lock_guard<std::mutex> lock(mMutex);
+        if (!mAgents.contains(agentId))
+        {
+            return rpc::Reply{rpc::Status::ERROR, "Unknown agent; its lease may have lapsed"};
+        }
+        auto jobs = assign(agentId, freeSlots);
+        if (jobs.empty() && Clock::now() < deadline)
+        {
+            return std::nullopt;
+        }
+        std::string payload;
+        rpc::Writer(payload).jobs(jobs);
+        return rpc::Reply{rpc::Status::OK, std::move(payload)};
+    };
+}
+
+void AgentPool::acceptResult(int64_t agentId, int64_t jobId, result::JobResult jobResult)
+{
+    auto taskIt = mTasks.find(jobId);
+    // Jobs taken away from the agent, whether abandoned or reassigned, no longer belong to it
+    if (taskIt == mTasks.end() || taskIt->second.agentId != agentId)
+    {
+        mStats.staleResults.add();
+        return;
+    }
+    const auto turnaround = Clock::now() - taskIt->second.submitted;
+    mStats.turnaroundMicros.record(std::chrono::duration_cast<std::chrono::microseconds>(turnaround).count());
+    taskIt->second.promise.set_value(std::move(jobResult));
+    mTasks.erase(taskIt);
+    mAgents.at(agentId).assignedJobIds.erase(jobId);
+    rememberOutputs(jobId, agentId);
+}
+
+/// @brief Hand jobs to an agent, oldest first, except those holding out for another agent with their blockers' outputs
+/// @param agentId Agent asking for jobs
+/// @param maxJobs Most jobs the agent can take
+/// @return Jobs now leased to the agent
+std::vector<Job> AgentPool::assign(int64_t agentId, size_t maxJobs)
+{
+    std::vector<Job> jobs;
+    const auto       now   = Clock::now();
+    auto&            agent = mAgents.at(agentId);
+    for (auto jobIdIt = mPendingJobIds.begin(); jobIdIt != mPendingJobIds.end() && jobs.size() < maxJobs;)
+    {
+        auto taskIt = mTasks.find(*jobIdIt);
+        if (taskIt == mTasks.end() || taskIt->second.agentId)
+        {
+            jobIdIt = mPendingJobIds.erase(jobIdIt);
+            continue;
+        }
+        auto&      task      = taskIt->second;
+        const auto preferred = preferredAgent(task.job);
+        if (preferred && *preferred != agentId && now - task.submitted < mLocalityWait)
+        {
+            ++jobIdIt;
+            continue;
+        }
+        if (preferred == agentId)
+        {
+            mStats.localDispatches.add();
+        }
+        task.agentId = agentId;
+        agent.assignedJobIds.insert(task.job.id);
+        jobs.push_back(task.job);
+        jobIdIt = mPendingJobIds.erase(jobIdIt);
+    }
+    if (!jobs.empty())
+    {
+        mStats.dispatches.add(jobs.size());
+        mStats.batches.add();
+    }
+    return jobs;
+}
+
+/// @brief Find the live agent holding the outputs of most of a job's relevant blockers
+std::optional<int64_t> AgentPool::preferredAgent(const Job& job) const
+{
+    // By the time a job is ready, the queue has moved all of its relevant blockers over to consumedBlockers
+    std::map<int64_t, size_t> numHeld;
+    for (auto blockerId : job.consumedBlockers)
+    {
+        auto holderIt = mOutputHolders.find(blockerId);
+        if (holderIt != mOutputHolders.end() && mAgents.contains(holderIt->second))
+        {
+            numHeld[holderIt->second]++;
+        }
+    }
+    if (numHeld.empty())
+    {
+        return std::nullopt;
+    }
+    return std::ranges::max_element(numHeld, {}, &std::pair<const int64_t, size_t>::second)->first;
+}
+
+void AgentPool::rememberOutputs(int64_t jobId, int64_t agentId)
+{
+    if (mOutputHolders.insert_or_assign(jobId, agentId).second)
+    {
+        mOutputHolderOrder.push_back(jobId);
+    }
+    if (mOutputHolderOrder.size() > kMaxOutputHolders)
+    {
+        mOutputHolders.erase(mOutputHolderOrder.front());
+        mOutputHolderOrder.pop_front();
+    }
+}
+
+} // namespace agents
+
+} // end namespace orchestrator
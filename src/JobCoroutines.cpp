@@ -0,0 +1,520 @@
+#include "orchestrator/JobCoroutines.h"
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <stdexcept>
+#include <system_error>
+
+namespace orchestrator
+{
+
+namespace job_coroutines
+{
+
+namespace
+{
+
+static constexpr auto kJobFailed = aapis::orchestrator::v1::JobStatus::JOB_STATUS_ERROR;
+
+// Most file descriptor events handled per reactor wakeup
+static constexpr int kMaxReactorEvents = 64;
+
+thread_local CoroutineScheduler* tCurrentScheduler = nullptr;
+
+} // namespace
+
+bool JobTask::FinalAwaiter::await_ready() noexcept
+{
+    return false;
+}
+
+/// @brief Hand control back to whoever awaited the finished task, or else tell its owner it is done
+std::coroutine_handle<> JobTask::FinalAwaiter::await_suspend(Handle handle) noexcept
+{
+    auto& promise = handle.promise();
+    if (promise.continuation)
+    {
+        return promise.continuation;
+    }
+    if (promise.onDone)
+    {
+        // The callback may destroy the task, and itself along with it unless moved out first
+        auto onDone = std::move(promise.onDone);
+        onDone(handle);
+    }
+    return std::noop_coroutine();
+}
+
+JobTask JobTask::promise_type::get_return_object()
+{
+    return JobTask{Handle::from_promise(*this)};
+}
+
+std::suspend_always JobTask::promise_type::initial_suspend() noexcept
+{
+    return {};
+}
+
+JobTask::FinalAwaiter JobTask::promise_type::final_suspend() noexcept
+{
+    return {};
+}
+
+void JobTask::promise_type::return_value(result::JobResult jobResult)
+{
+    result = std::move(jobResult);
+}
+
+void JobTask::promise_type::unhandled_exception()
+{
+    exception = std::current_exception();
+}
+
+JobTask::JobTask(JobTask&& other) noexcept : mHandle(std::exchange(other.mHandle, nullptr)) {}
+
+JobTask& JobTask::operator=(JobTask&& other) noexcept
+{
+    if (this != &other)
+    {
+        if (mHandle)
+        {
+            mHandle.destroy();
+        }
+        mHandle = std::exchange(other.mHandle, nullptr);
+    }
+    return *this;
+}
+
+JobTask::~JobTask()
+{
+    if (mHandle)
+    {
+        mHandle.destroy();
+    }
+}
+
+/// @brief Give up ownership of the task, e.g. to a scheduler
+JobTask::Handle JobTask::release()
+{
+    return std::exchange(mHandle, nullptr);
+}
+
+/// @brief What a finished task came to, a job failure if it threw
+result::JobResult JobTask::resultOf(Handle handle)
+{
+    auto& promise = handle.promise();
+    if (promise.exception)
+    {
+        try
+        {
+            std::rethrow_exception(promise.exception);
+        }
+        catch (const std::exception& e)
+        {
+            return result::JobResult{kJobFailed, std::vector<std::string>{e.what()}};
+        }
+        catch (...)
+        {
+            return result::JobResult{kJobFailed, std::vector<std::string>{"Unknown error"}};
+        }
+    }
+    return std::move(*promise.result);
+}
+
+bool JobTask::await_ready() const noexcept
+{
+    return !mHandle || mHandle.done();
+}
+
+std::coroutine_handle<> JobTask::await_suspend(std::coroutine_handle<> awaiting) noexcept
+{
+    mHandle.promise().continuation = awaiting;
+    return mHandle;
+}
+
+result::JobResult JobTask::await_resume()
+{
+    auto& promise = mHandle.promise();
+    if (promise.exception)
+    {
+        std::rethrow_exception(promise.exception);
+    }
+    return std::move(*promise.result);
+}
+
+/// @brief Start the worker and reactor threads
+/// @param numThreads How many tasks may be running (rather than waiting) at once
+CoroutineScheduler::CoroutineScheduler(size_t numThreads)
+{
+    mEpollFd = epoll_create1(EPOLL_CLOEXEC);
+    mWakeFd  = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (mEpollFd < 0 || mWakeFd < 0)
+    {
+        throw std::system_error(errno, std::generic_category(), "epoll");
+    }
+    epoll_event event{};
+    event.events  = EPOLLIN;
+    event.data.fd = mWakeFd;
+    epoll_ctl(mEpollFd, EPOLL_CTL_ADD, mWakeFd, &event);
+
+    for (size_t k = 0; k < std::max<size_t>(numThreads, 1); k++)
+    {
+        mWorkers.emplace_back([this]() { runWorker(); });
+    }
+    mReactor = std::thread([this]() { runReactor(); });
+}
+
+/// @brief Stop every thread, then destroy whatever tasks were still waiting
+CoroutineScheduler::~CoroutineScheduler()
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mStopping = true;
+    }
+    mReady.notify_all();
+    wakeReactor();
+    for (auto& worker : mWorkers)
+    {
+        worker.join();
+    }
+    mReactor.join();
+    for (auto& offloaded : mOffloads)
+    {
+        offloaded.wait();
+    }
+    for (auto* address : mTasks)
+    {
+        std::coroutine_handle<>::from_address(address).destroy();
+    }
+    close(mWakeFd);
+    close(mEpollFd);
+}
+
+/// @brief The scheduler running the calling task
+/// @return Scheduler whose worker thread is calling; throws std::logic_error when called from any other thread
+CoroutineScheduler& CoroutineScheduler::current()
+{
+    if (tCurrentScheduler == nullptr)
+    {
+        throw std::logic_error("Not running on a coroutine scheduler's worker");
+    }
+    return *tCurrentScheduler;
+}
+
+/// @brief Take over a task and start running it
+/// @param task Task to run
+/// @param onDone Called with the task's result, or a job failure if it threw, once it finishes
+void CoroutineScheduler::spawn(JobTask task, std::function<void(result::JobResult)> onDone)
+{
+    auto handle             = task.release();
+    handle.promise().onDone = [this, onDone = std::move(onDone)](JobTask::Handle finished) {
+        auto jobResult = JobTask::resultOf(finished);
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mTasks.erase(finished.address());
+        }
+        finished.destroy();
+        onDone(std::move(jobResult));
+    };
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mTasks.insert(handle.address());
+    }
+    schedule(handle);
+}
+
+/// @brief Resume a suspended task on the next free worker
+void CoroutineScheduler::schedule(std::coroutine_handle<> handle)
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mReadyHandles.push_back(handle);
+    }
+    mReady.notify_one();
+}
+
+/// @brief Resume a suspended task once a deadline has passed
+void CoroutineScheduler::resumeAt(std::chrono::steady_clock::time_point deadline, std::coroutine_handle<> handle)
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mTimers.emplace(deadline, handle);
+        mStats.timerWaits.add();
+    }
+    wakeReactor();
+}
+
+/// @brief Resume a suspended task once a file descriptor is ready
+/// @param fd Descriptor nothing else is waiting on
+/// @param events epoll events to wait for, e.g. EPOLLIN
+/// @param handle Task to resume
+void CoroutineScheduler::resumeWhenReady(int fd, uint32_t events, std::coroutine_handle<> handle)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (mFdWaiters.contains(fd))
+    {
+        throw std::logic_error("Another task is already waiting on the file descriptor");
+    }
+    epoll_event event{};
+    event.events  = events | EPOLLONESHOT;
+    event.data.fd = fd;
+    if (epoll_ctl(mEpollFd, EPOLL_CTL_ADD, fd, &event) < 0)
+    {
+        throw std::system_error(errno, std::generic_category(), "epoll_ctl");
+    }
+    mFdWaiters.emplace(fd, handle);
+    mStats.fdWaits.add();
+}
+
+/// @brief Run blocking work on a thread of its own
+void CoroutineScheduler::offload(std::function<void()> work)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    std::erase_if(mOffloads, [](const std::future<void>& offloaded) {
+        return offloaded.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+    });
+    mOffloads.push_back(std::async(std::launch::async, std::move(work)));
+    mStats.offloads.add();
+}
+
+size_t CoroutineScheduler::numThreads() const
+{
+    return mWorkers.size();
+}
+
+/// @brief How many spawned tasks have yet to finish, whether running or waiting
+size_t CoroutineScheduler::numTasks() const
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mTasks.size();
+}
+
+/// @brief Add the scheduler's instrumentation to a service's metrics
+void CoroutineScheduler::addStats(std::map<std::string, int64_t>& metrics) const
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    metrics["coroutines.threads"]  = static_cast<int64_t>(mWorkers.size());
+    metrics["coroutines.tasks"]    = static_cast<int64_t>(mTasks.size());
+    metrics["coroutines.ready"]    = static_cast<int64_t>(mReadyHandles.size());
+    metrics["coroutines.timers"]   = static_cast<int64_t>(mTimers.size());
+    metrics["coroutines.fd_waits"] = static_cast<int64_t>(mFdWaiters.size());
+    stats::addCounter(metrics, "coroutines.resumes", mStats.resumes);
+    stats::addCounter(metrics, "coroutines.timer_waits_total", mStats.timerWaits);
+    stats::addCounter(metrics, "coroutines.fd_waits_total", mStats.fdWaits);
+    stats::addCounter(metrics, "coroutines.offloads", mStats.offloads);
+}
+
+void CoroutineScheduler::runWorker()
+{
+    tCurrentScheduler = this;
+    while (true)
+    {
+        std::coroutine_handle<> handle;
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            mReady.wait(lock, [this]() { return mStopping || !mReadyHandles.empty(); });
+            if (mStopping)
+            {
+                return;
+            }
+            handle = mReadyHandles.front();
+            mReadyHandles.pop_front();
+            mStats.resumes.add();
+        }
+        handle.resume();
+    }
+}
+
+void CoroutineScheduler::runReactor()
+{
+    std::array<epoll_event, kMaxReactorEvents> events;
+    while (true)
+    {
+        int timeoutMs = -1;
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            if (mStopping)
+            {
+                return;
+            }
+            if (!mTimers.empty())
+            {
+                const auto untilDue = mTimers.top().first - std::chrono::steady_clock::now();
+                timeoutMs           = static_cast<int>(std::max<int64_t>(
+                    std::chrono::ceil<std::chrono::milliseconds>(untilDue).count(), 0));
+            }
+        }
+        const int numEvents = epoll_wait(mEpollFd, events.data(), kMaxReactorEvents, timeoutMs);
+
+        size_t numReady = 0;
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            for (int k = 0; k < numEvents; k++)
+            {
+                const int fd = events[k].data.fd;
+                if (fd == mWakeFd)
+                {
+                    uint64_t count = 0;
+                    [[maybe_unused]] auto numRead = read(mWakeFd, &count, sizeof(count));
+                    continue;
+                }
+                auto waiter = mFdWaiters.extract(fd);
+                epoll_ctl(mEpollFd, EPOLL_CTL_DEL, fd, nullptr);
+                if (!waiter.empty())
+                {
+                    mReadyHandles.push_back(waiter.mapped());
+                    numReady++;
+                }
+            }
+            const auto now = std::chrono::steady_clock::now();
+            while (!mTimers.empty() && mTimers.top().first <= now)
+            {
+                mReadyHandles.push_back(mTimers.top().second);
+                mTimers.pop();
+                numReady++;
+            }
+        }
+        if (numReady > 0)
+        {
+            mReady.notify_all();
+        }
+    }
+}
+
+void CoroutineScheduler::wakeReactor()
+{
+    const uint64_t one = 1;
+    [[maybe_unused]] auto numWritten = write(mWakeFd, &one, sizeof(one));
+}
+
+bool SleepAwaiter::await_ready() const noexcept
+{
+    return deadline <= std::chrono::steady_clock::now();
+}
+
+void SleepAwaiter::await_suspend(std::coroutine_handle<> handle) const
+{
+    CoroutineScheduler::current().resumeAt(deadline, handle);
+}
+
+void FdAwaiter::await_suspend(std::coroutine_handle<> handle) const
+{
+    CoroutineScheduler::current().resumeWhenReady(fd, events, handle);
+}
+
+OffloadAwaiter::OffloadAwaiter(std::function<result::JobResult()> work)
+    : mState(std::make_shared<State>(State{std::move(work), std::nullopt}))
+{
+}
+
+bool OffloadAwaiter::await_ready() const noexcept
+{
+    return false;
+}
+
+void OffloadAwaiter::await_suspend(std::coroutine_handle<> handle)
+{
+    auto& scheduler = CoroutineScheduler::current();
+    scheduler.offload([state = mState, handle, &scheduler]() {
+        try
+        {
+            state->result = state->work();
+        }
+        catch (const std::exception& e)
+        {
+            state->result = result::JobResult{kJobFailed, std::vector<std::string>{e.what()}};
+        }
+        scheduler.schedule(handle);
+    });
+}
+
+result::JobResult OffloadAwaiter::await_resume()
+{
+    return std::move(*mState->result);
+}
+
+WhenAllAwaiter::WhenAllAwaiter(std::vector<JobTask> tasks) : mTasks(std::move(tasks)), mState(std::make_shared<State>())
+{
+}
+
+bool WhenAllAwaiter::await_ready() const noexcept
+{
+    return mTasks.empty();
+}
+
+void WhenAllAwaiter::await_suspend(std::coroutine_handle<> handle)
+{
+    // The awaiting task may be resumed (and this awaiter destroyed) as soon as the last task is spawned, so nothing
+    // past that point may touch the awaiter
+    auto  tasks     = std::move(mTasks);
+    auto  state     = mState;
+    auto& scheduler = CoroutineScheduler::current();
+    state->results.resize(tasks.size());
+    state->numRemaining = tasks.size();
+    for (size_t k = 0; k < tasks.size(); k++)
+    {
+        scheduler.spawn(std::move(tasks[k]), [state, k, handle, &scheduler](result::JobResult jobResult) {
+            state->results[k] = std::move(jobResult);
+            if (state->numRemaining.fetch_sub(1) == 1)
+            {
+                scheduler.schedule(handle);
+            }
+        });
+    }
+}
+
+std::vector<result::JobResult> WhenAllAwaiter::await_resume()
+{
+    return std::move(mState->results);
+}
+
+SleepAwaiter sleepFor(std::chrono::milliseconds duration)
+{
+    return SleepAwaiter{std::chrono::steady_clock::now() + duration};
+}
+
+FdAwaiter readable(int fd)
+{
+    return FdAwaiter{fd, EPOLLIN};
+}
+
+FdAwaiter writable(int fd)
+{
+    return FdAwaiter{fd, EPOLLOUT};
+}
+
+OffloadAwaiter offload(std::function<result::JobResult()> work)
+{
+    return OffloadAwaiter(std::move(work));
+}
+
+WhenAllAwaiter whenAll(std::vector<JobTask> tasks)
+{
+    return WhenAllAwaiter(std::move(tasks));
+}
+
+/// @brief A task that has nothing to wait for
+JobTask completed(result::JobResult jobResult)
+{
+    co_return jobResult;
+}
+
+/// @brief Run a task on a scheduler of its own, blocking until it finishes, e.g. outside of the executor
+/// @param task Task to run
+/// @return The task's result
+result::JobResult runToCompletion(JobTask task)
+{
+    std::promise<result::JobResult> promise;
+    auto                            future = promise.get_future();
+    CoroutineScheduler              scheduler(1);
+    scheduler.spawn(std::move(task),
+                    [&promise](result::JobResult jobResult) { promise.set_value(std::move(jobResult)); });
+    return future.get();
+}
+
+} // namespace job_coroutines
+
+} // end namespace orchestrator
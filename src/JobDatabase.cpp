@@ -0,0 +1,123 @@
+#include "orchestrator/JobDatabase.h"
+#include <algorithm>
+#include <iterator>
+#include <numeric>
+
+namespace orchestrator
+{
+
+namespace job_database
+{
+
+/// @brief Snapshot the database's instrumentation and holdings
+/// @return Named metrics
+result::StatsResult Store::collectStats() const
+{
+    result::StatsResult statsResult;
+    auto&               metrics = statsResult.metrics;
+
+    auto total = [](const auto& dumped) {
+        return std::accumulate(dumped.begin(), dumped.end(), int64_t{0}, [](int64_t n, const auto& shardDump) {
+            return n + static_cast<int64_t>(shardDump.second.size());
+        });
+    };
+    metrics["dumped.pending_jobs"]   = total(dumpedPendingJobs);
+    metrics["dumped.awaited_jobs"]   = total(dumpedAwaitedJobIds);
+    metrics["dumped.scheduled_jobs"] = total(dumpedScheduledJobs);
+    metrics["dumped.running_jobs"]   = static_cast<int64_t>(dumpedRunningJobs.size());
+    metrics["cached_results"]        = static_cast<int64_t>(cachedResults.numEntries());
+
+    const auto& cacheStats                   = cachedResults.stats();
+    metrics["cached_results.bytes"]          = static_cast<int64_t>(cacheStats.sizeBytes);
+    metrics["cached_results.capacity_bytes"] = static_cast<int64_t>(cacheStats.capacityBytes);
+    metrics["cached_results.evictions"]      = static_cast<int64_t>(cacheStats.evictions);
+
+    stats::addCounter(metrics, "dumps", databaseStats.dumps);
+    stats::addCounter(metrics, "loads", databaseStats.loads);
+    stats::addCounter(metrics, "cache_hits", databaseStats.cacheHits);
+    stats::addCounter(metrics, "cache_misses", databaseStats.cacheMisses);
+
+    return statsResult;
+}
+
+const std::string JobDatabase::name() const
+{
+    return "JobDatabase";
+}
+
+size_t ForeverState::step(Store& s, const Container& c, HeartbeatInput& i)
+{
+    return ForeverState::index();
+}
+
+size_t ForeverState::step(Store& s, const Container& c, DumpQueueData& i)
+{
+    s.dumpedPendingJobs[i.shardIndex]   = std::move(i.pendingJobs);
+    s.dumpedAwaitedJobIds[i.shardIndex] = std::move(i.awaitedJobIds);
+    s.dumpedScheduledJobs[i.shardIndex] = std::move(i.scheduledJobs);
+    s.databaseStats.dumps.add();
+    i.setResult(result::BooleanResult{true});
+    return ForeverState::index();
+}
+
+size_t ForeverState::step(Store& s, const Container& c, DumpRunningJobs& i)
+{
+    s.dumpedRunningJobs = std::move(i.runningJobs);
+    s.databaseStats.dumps.add();
+    i.setResult(result::BooleanResult{true});
+    return ForeverState::index();
+}
+
+size_t ForeverState::step(Store& s, const Container& c, LoadQueueData& i)
+{
+    s.databaseStats.loads.add();
+    result::JobQueueDataResult queueData;
+    for (const auto& [shardIndex, shardJobs] : s.dumpedPendingJobs)
+    {
+        std::copy(shardJobs.begin(), shardJobs.end(), std::back_inserter(queueData.pendingJobs.jobs));
+    }
+    for (const auto& [shardIndex, shardSchedules] : s.dumpedScheduledJobs)
+    {
+        std::copy(shardSchedules.begin(), shardSchedules.end(), std::back_inserter(queueData.scheduledJobs));
+    }
+    queueData.runningJobs.jobs = s.dumpedRunningJobs;
+    i.setResult(std::move(queueData));
+    return ForeverState::index();
+}
+
+size_t ForeverState::step(Store& s, const Container& c, StoreCachedResult& i)
+{
+    // Whatever is evicted to make room is simply recomputed if it is ever needed again
+    s.cachedResults.insert(i.key, i.result);
+    i.setResult(result::BooleanResult{true});
+    return ForeverState::index();
+}
+
+size_t ForeverState::step(Store& s, const Container& c, LoadCachedResult& i)
+{
+    // A hash collision is just a miss
+    auto cachedResult = s.cachedResults.lookup(i.key);
+    (cachedResult ? s.databaseStats.cacheHits : s.databaseStats.cacheMisses).add();
+    i.setResult(result::OptionalJobResult{std::move(cachedResult)});
+    return ForeverState::index();
+}
+
+size_t ForeverState::step(Store& s, const Container& c, StatsInput& i)
+{
+    i.setResult(s.collectStats());
+    return ForeverState::index();
+}
+
+size_t ForeverState::step(Store& s, const Container& c, ConfigureInput& i)
+{
+    if (std::holds_alternative<ConfigureInput::SetResultCacheCapacity>(i.config))
+    {
+        s.cachedResults.setCapacity(std::get<ConfigureInput::SetResultCacheCapacity>(i.config).capacityBytes);
+    }
+    i.setResult(result::BooleanResult{true});
+    return ForeverState::index();
+}
+
+} // namespace job_database
+
+} // end namespace orchestrator
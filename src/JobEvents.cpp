@@ -0,0 +1,153 @@
+#include "orchestrator/JobEvents.h"
+#include <utility>
+
+namespace orchestrator
+{
+
+namespace events
+{
+
+bool SubscriptionFilter::matches(const JobEvent& event) const
+{
+    return (jobIds.empty() || jobIds.contains(event.jobId)) &&
+           (priorities.empty() || priorities.contains(event.priority)) &&
+           (statuses.empty() || statuses.contains(event.status));
+}
+
+/// @brief Create an empty stream
+/// @param filter Events the subscriber cares about
+/// @param capacity Most undelivered events (i.e., distinct jobs) held at once; further events are dropped
+EventStream::EventStream(SubscriptionFilter filter, size_t capacity) : mFilter(std::move(filter)), mCapacity(capacity)
+{
+}
+
+/// @brief Have something called every time events are published to the stream or it is closed
+/// @param listener Called on whichever thread publishes or closes, so it must be thread-safe and quick
+void EventStream::setListener(std::function<void()> listener)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    mListener = std::move(listener);
+}
+
+/// @brief Add the subscriber's share of a batch of events, coalescing them with undelivered events of the same jobs
+/// @param events Events in the order they happened
+void EventStream::publish(const std::vector<JobEvent>& events)
+{
+    bool                  published = false;
+    std::function<void()> listener;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        if (mClosed)
+        {
+            return;
+        }
+        for (const auto& event : events)
+        {
+            if (!mFilter.matches(event))
+            {
+                continue;
+            }
+            auto indexIt = mEventIndices.find(event.jobId);
+            if (indexIt != mEventIndices.end())
+            {
+                mEvents[indexIt->second] = event;
+            }
+            else if (mEvents.size() < mCapacity)
+            {
+                mEventIndices.emplace(event.jobId, mEvents.size());
+                mEvents.push_back(event);
+            }
+            else
+            {
+                mNumDropped++;
+                continue;
+            }
+            published = true;
+        }
+        if (published)
+        {
+            listener = mListener;
+        }
+    }
+    if (published)
+    {
+        mPublished.notify_all();
+        if (listener)
+        {
+            listener();
+        }
+    }
+}
+
+/// @brief Stop accepting events; whatever is still buffered can be taken, after which batches come back closed
+void EventStream::close()
+{
+    std::function<void()> listener;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mClosed  = true;
+        listener = mListener;
+    }
+    mPublished.notify_all();
+    if (listener)
+    {
+        listener();
+    }
+}
+
+/// @brief Whether take() would return anything new right now
+bool EventStream::ready() const
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    return !mEvents.empty() || mNumDropped > 0 || mClosed;
+}
+
+/// @brief Take the oldest undelivered events without waiting
+/// @param maxEvents Most events to take
+/// @return Possibly empty batch
+EventBatch EventStream::take(size_t maxEvents)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    return takeLocked(maxEvents);
+}
+
+/// @brief Take the oldest undelivered events, waiting for some to arrive if there are none
+/// @param maxEvents Most events to take
+/// @param timeout Longest to wait
+/// @return Batch that is empty only if the wait timed out
+EventBatch EventStream::waitAndTake(size_t maxEvents, std::chrono::milliseconds timeout)
+{
+    std::unique_lock<std::mutex> lock(mMutex);
+    mPublished.wait_for(lock, timeout, [&]() { return !mEvents.empty() || mNumDropped > 0 || mClosed; });
+    return takeLocked(maxEvents);
+}
+
+EventBatch EventStream::takeLocked(size_t maxEvents)
+{
+    EventBatch batch;
+    batch.numDropped = mNumDropped;
+    mNumDropped      = 0;
+
+    if (maxEvents >= mEvents.size())
+    {
+        batch.events.swap(mEvents);
+        mEventIndices.clear();
+    }
+    else
+    {
+        const auto split = mEvents.begin() + static_cast<std::ptrdiff_t>(maxEvents);
+        batch.events.assign(mEvents.begin(), split);
+        mEvents.erase(mEvents.begin(), split);
+        mEventIndices.clear();
+        for (size_t k = 0; k < mEvents.size(); k++)
+        {
+            mEventIndices.emplace(mEvents[k].jobId, k);
+        }
+    }
+    batch.closed = mClosed && mEvents.empty();
+    return batch;
+}
+
+} // namespace events
+
+} // end namespace orchestrator
@@ -0,0 +1,534 @@
+#include "orchestrator/JobExecutor.h"
+#include <chrono>
+#include <algorithm>
+#include <iterator>
+#include <optional>
+#include <stdexcept>
+
+namespace orchestrator
+{
+
+namespace job_executor
+{
+
+static constexpr auto kJobFailed    = aapis::orchestrator::v1::JobStatus::JOB_STATUS_ERROR;
+static constexpr auto kJobSucceeded = aapis::orchestrator::v1::JobStatus::JOB_STATUS_COMPLETE;
+
+/// @brief Default job runner, standing in until jobs carry something to run: succeeds with the job's inputs as outputs
+/// @param job Job to run
+/// @return A completed result with the job's inputs as its outputs
+result::JobResult Store::echoJob(const Job& job)
+{
+    return result::JobResult{kJobSucceeded, job.inputs};
+}
+
+/// @brief Swap any handles to spilled outputs among a job's inputs for the outputs themselves, so that whatever runs
+/// the job sees the same inputs whether or not they were spilled
+/// @param store Where outputs were spilled, if anywhere
+/// @param job Job to run
+/// @return The job with its inputs loaded; throws std::system_error if a spilled output can't be read back
+static Job loadSpilledInputs(const std::shared_ptr<outputs::OutputStore>& store, Job job)
+{
+    if (store)
+    {
+        for (auto& input : job.inputs)
+        {
+            input = store->load(input);
+        }
+    }
+    return job;
+}
+
+/// @brief Run a job on its own worker, handing back its result through the execution request
+/// @param i Execution request, answered with the future job result
+/// @param work Runs the job to completion
+template<typename Work>
+void Store::launch(ExecuteInput& i, Work work)
+{
+    auto promise = std::make_shared<std::promise<result::JobResult>>();
+    i.setResult(promise->get_future());
+    launchedJobs.insert_or_assign(i.job.id, i.job);
+
+    runningJobs.emplace(i.job.id, std::async(std::launch::async, [promise, work = std::move(work)]() mutable {
+                            const auto start = stats::steadyClockMicros();
+                            try
+                            {
+                                promise->set_value(work());
+                            }
+                            catch (const std::exception& e)
+                            {
+                                promise->set_value(result::JobResult{kJobFailed, std::vector<std::string>{e.what()}});
+                            }
+                            return static_cast<uint64_t>(stats::steadyClockMicros() - start);
+                        }));
+    executorStats.launches.add();
+}
+
+/// @brief Launch a job on its own worker if there is a free slot
+/// @param i Execution request, answered with the future job result or an error if every slot is taken
+void Store::execute(ExecuteInput& i)
+{
+    if (agentPool)
+    {
+        executeRemotely(i);
+        return;
+    }
+    reapFinishedJobs();
+    if (runningJobs.contains(i.job.id) || coroutineJobs.contains(i.job.id))
+    {
+        executorStats.rejections.add();
+        i.setResult(services::ErrorResult{"Job is already running"});
+        return;
+    }
+
+    if (i.job.kind != 0)
+    {
+        executeKind(i);
+        return;
+    }
+    if (numBusySlots() >= numSlots)
+    {
+        executorStats.rejections.add();
+        i.setResult(services::ErrorResult{"No free execution slots"});
+        return;
+    }
+    // Spilled inputs are read back on the worker, where a large one doesn't hold up the executor
+    launch(i, [runner = runner, store = outputStore, job = i.job]() { return runner(loadSpilledInputs(store, job)); });
+}
+
+/// @brief Launch a job of an in-process kind if its kind is under its concurrency limit, parsing its arguments first
+/// @param i Execution request, answered with the future job result (failed if the job is malformed) or an error if
+/// the job's kind is at its limit or there is no free slot for it
+void Store::executeKind(ExecuteInput& i)
+{
+    using job_kinds::JobKinds;
+
+    const auto kindIndex = JobKinds::indexOf(i.job.kind);
+    if (kindIndex == JobKinds::size())
+    {
+        failInvalidJob(i, "Unknown job kind " + std::to_string(i.job.kind));
+        return;
+    }
+    const auto maxConcurrency = JobKinds::maxConcurrency(kindIndex);
+    if (maxConcurrency > 0 && numRunningPerKind[kindIndex] >= maxConcurrency)
+    {
+        executorStats.rejections.add();
+        i.setResult(services::ErrorResult{"No free execution slots for the job's kind"});
+        return;
+    }
+    const bool suspends = JobKinds::suspends(kindIndex);
+    if (suspends ? numBusyCoroutineSlots() >= numCoroutineSlots : numBusySlots() >= numSlots)
+    {
+        executorStats.rejections.add();
+        i.setResult(services::ErrorResult{"No free execution slots"});
+        return;
+    }
+
+    // Kinds parse their arguments out of their inputs up front, so spilled ones have to be read back first
+    std::optional<JobKinds::PreparedJob> preparedJob;
+    try
+    {
+        preparedJob.emplace(JobKinds::prepare(kindIndex, loadSpilledInputs(outputStore, i.job)));
+    }
+    catch (const std::exception& e)
+    {
+        failInvalidJob(i, e.what());
+        return;
+    }
+    numRunningPerKind[kindIndex]++;
+    runningJobKinds.emplace(i.job.id, kindIndex);
+    if (suspends)
+    {
+        startCoroutine(i, *preparedJob);
+        return;
+    }
+    launch(i, [preparedJob = std::move(*preparedJob)]() mutable { return JobKinds::run(preparedJob); });
+}
+
+/// @brief Start a job of a suspending kind on the coroutine scheduler, where it holds a thread only while it isn't
+/// waiting on anything
+/// @param i Execution request, answered with the future job result
+/// @param preparedJob The job's arguments, which the job takes over
+void Store::startCoroutine(ExecuteInput& i, job_kinds::JobKinds::PreparedJob& preparedJob)
+{
+    if (!coroutineScheduler)
+    {
+        coroutineScheduler = std::make_unique<job_coroutines::CoroutineScheduler>(numCoroutineThreads);
+    }
+    auto promise  = std::make_shared<std::promise<result::JobResult>>();
+    auto finished = std::make_shared<std::promise<uint64_t>>();
+    i.setResult(promise->get_future());
+    coroutineJobs.emplace(i.job.id, finished->get_future());
+    launchedJobs.insert_or_assign(i.job.id, i.job);
+
+    const auto start = stats::steadyClockMicros();
+    coroutineScheduler->spawn(job_kinds::JobKinds::start(preparedJob),
+                              [promise, finished, start](result::JobResult jobResult) {
+                                  promise->set_value(std::move(jobResult));
+                                  finished->set_value(static_cast<uint64_t>(stats::steadyClockMicros() - start));
+                              });
+    executorStats.launches.add();
+}
+
+/// @brief Fail a job that can't be run, without taking up a slot; it would fail the same way if tried again
+/// @param i Execution request, answered with the (already) failed job result
+/// @param reason Why the job can't be run, which becomes its output
+void Store::failInvalidJob(ExecuteInput& i, const std::string& reason)
+{
+    std::promise<result::JobResult> promise;
+    promise.set_value(result::JobResult{kJobFailed, std::vector<std::string>{reason}});
+    i.setResult(promise.get_future());
+    executorStats.invalidJobs.add();
+}
+
+/// @brief Let another job of a finished or abandoned job's kind run, if it was of an in-process kind
+void Store::releaseKindSlot(int64_t jobId)
+{
+    auto kindIt = runningJobKinds.find(jobId);
+    if (kindIt != runningJobKinds.end())
+    {
+        numRunningPerKind[kindIt->second]--;
+        runningJobKinds.erase(kindIt);
+    }
+}
+
+/// @brief Line a job up for the worker agents if they have a free slot between them
+/// @param i Execution request, answered with the future job result or an error if every slot is taken
+void Store::executeRemotely(ExecuteInput& i)
+{
+    if (agentPool->freeSlots() == 0)
+    {
+        executorStats.rejections.add();
+        i.setResult(services::ErrorResult{"No free execution slots"});
+        return;
+    }
+    if (agentPool->contains(i.job.id))
+    {
+        executorStats.rejections.add();
+        i.setResult(services::ErrorResult{"Job is already running"});
+        return;
+    }
+    // Agents don't share the store's directory, so they are sent spilled inputs in full
+    Job job;
+    try
+    {
+        job = loadSpilledInputs(outputStore, i.job);
+    }
+    catch (const std::exception& e)
+    {
+        failInvalidJob(i, e.what());
+        return;
+    }
+    i.setResult(agentPool->submit(job));
+    executorStats.launches.add();
+}
+
+/// @brief Free the slots of jobs whose workers have finished
+void Store::reapFinishedJobs()
+{
+    for (auto* jobs : {&runningJobs, &coroutineJobs})
+    {
+        for (auto it = jobs->begin(); it != jobs->end();)
+        {
+            if (it->second.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+            {
+                ++it;
+                continue;
+            }
+            executorStats.runMicros.record(it->second.get());
+            releaseKindSlot(it->first);
+            launchedJobs.erase(it->first);
+            it = jobs->erase(it);
+        }
+    }
+    for (auto* abandoned : {&abandonedJobs, &abandonedCoroutineJobs})
+    {
+        std::erase_if(*abandoned, [](const std::future<uint64_t>& worker) {
+            return worker.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+        });
+    }
+    if (agentPool)
+    {
+        agentPool->expireAgents();
+    }
+}
+
+/// @brief Count the slots taken by worker threads, including those of abandoned jobs still running
+size_t Store::numBusySlots() const
+{
+    return runningJobs.size() + abandonedJobs.size();
+}
+
+/// @brief Count the coroutine slots taken, including those of abandoned coroutine jobs still in flight
+size_t Store::numBusyCoroutineSlots() const
+{
+    return coroutineJobs.size() + abandonedCoroutineJobs.size();
+}
+
+/// @brief Stop waiting on a job whose result nobody needs anymore
+/// @param jobId Job to abandon
+/// @return Whether the job was running
+bool Store::abandon(int64_t jobId)
+{
+    if (agentPool && agentPool->abandon(jobId))
+    {
+        executorStats.abandons.add();
+        return true;
+    }
+    for (auto [jobs, abandoned] : {std::pair{&runningJobs, &abandonedJobs},
+                                   std::pair{&coroutineJobs, &abandonedCoroutineJobs}})
+    {
+        auto runningIt = jobs->find(jobId);
+        if (runningIt == jobs->end())
+        {
+            continue;
+        }
+        abandoned->push_back(std::move(runningIt->second));
+        jobs->erase(runningIt);
+        releaseKindSlot(jobId);
+        launchedJobs.erase(jobId);
+        executorStats.abandons.add();
+        return true;
+    }
+    return false;
+}
+
+/// @brief Gather every job still running, whether in-process or on a worker agent
+/// @return Copies of the jobs as they were handed to the executor
+std::vector<Job> Store::jobsInFlight() const
+{
+    std::vector<Job> jobs;
+    std::ranges::transform(
+        launchedJobs, std::back_inserter(jobs), [](const auto& launched) { return launched.second; });
+    if (agentPool)
+    {
+        auto remoteJobs = agentPool->outstandingJobs();
+        std::move(remoteJobs.begin(), remoteJobs.end(), std::back_inserter(jobs));
+    }
+    return jobs;
+}
+
+/// @brief Hand the jobs still running to the database, which passes them on to the queue to re-execute once it
+/// reloads; jobs that finish in the meantime simply run again
+/// @param c Access point for the job database
+/// @return Whether the database took the jobs
+bool Store::dumpRunningJobs(const Container& c) const
+{
+    job_database::DumpRunningJobs dumpInput;
+    dumpInput.runningJobs = jobsInFlight();
+    auto dumpOutput       = dumpInput.getFuture();
+    if (!c.get<job_database::JobDatabase>()->sendInput(std::move(dumpInput)))
+    {
+        return false;
+    }
+    auto dumpResult = dumpOutput.get();
+    return std::holds_alternative<result::BooleanResult>(dumpResult) &&
+           std::get<result::BooleanResult>(dumpResult).result;
+}
+
+/// @brief Apply a runtime configuration change to the executor
+/// @param config Configuration change
+void Store::configure(const ConfigureInput::ConfigType& config)
+{
+    if (std::holds_alternative<ConfigureInput::SetNumSlots>(config))
+    {
+        // Jobs already running above a lowered limit are left to finish
+        numSlots = std::max<size_t>(std::get<ConfigureInput::SetNumSlots>(config).numSlots, 1);
+    }
+    else if (std::holds_alternative<ConfigureInput::SetJobRunner>(config))
+    {
+        runner = std::get<ConfigureInput::SetJobRunner>(config).runner;
+    }
+    else if (std::holds_alternative<ConfigureInput::SetAgentPool>(config))
+    {
+        agentPool = std::get<ConfigureInput::SetAgentPool>(config).pool;
+    }
+    else if (std::holds_alternative<ConfigureInput::SetCoroutineCapacity>(config))
+    {
+        const auto& capacity = std::get<ConfigureInput::SetCoroutineCapacity>(config);
+        numCoroutineThreads  = std::max<size_t>(capacity.numThreads, 1);
+        numCoroutineSlots    = std::max<size_t>(capacity.numSlots, 1);
+    }
+    else if (std::holds_alternative<ConfigureInput::SetOutputStore>(config))
+    {
+        outputStore = std::get<ConfigureInput::SetOutputStore>(config).store;
+    }
+}
+
+/// @brief Snapshot the executor's instrumentation and slot occupancy
+/// @return Named metrics; run times are in microseconds
+result::StatsResult Store::collectStats() const
+{
+    result::StatsResult statsResult;
+    auto&               metrics = statsResult.metrics;
+
+    metrics["slots.total"]     = static_cast<int64_t>(numSlots);
+    metrics["slots.running"]   = static_cast<int64_t>(runningJobs.size());
+    metrics["slots.abandoned"] = static_cast<int64_t>(abandonedJobs.size());
+
+    metrics["coroutines.slots.total"]   = static_cast<int64_t>(numCoroutineSlots);
+    metrics["coroutines.slots.running"]   = static_cast<int64_t>(coroutineJobs.size());
+    metrics["coroutines.slots.abandoned"] = static_cast<int64_t>(abandonedCoroutineJobs.size());
+
+    stats::addCounter(metrics, "launches", executorStats.launches);
+    stats::addCounter(metrics, "rejections", executorStats.rejections);
+    stats::addCounter(metrics, "abandons", executorStats.abandons);
+    stats::addCounter(metrics, "invalid_jobs", executorStats.invalidJobs);
+    for (size_t k = 0; k < numRunningPerKind.size(); k++)
+    {
+        const auto kindId                                    = job_kinds::JobKinds::idOf(k);
+        metrics["kinds." + std::to_string(kindId) + ".running"] = static_cast<int64_t>(numRunningPerKind[k]);
+    }
+    stats::addHistogram(metrics, "run_us", executorStats.runMicros);
+    if (agentPool)
+    {
+        agentPool->addStats(metrics);
+    }
+    if (coroutineScheduler)
+    {
+        coroutineScheduler->addStats(metrics);
+    }
+
+    return statsResult;
+}
+
+const std::string JobExecutor::name() const
+{
+    return "JobExecutor";
+}
+
+size_t InitState::step(Store& s, const Container& c, HeartbeatInput& i)
+{
+    // Nothing persists across restarts; the queue re-requests whatever was in flight
+    return RunningState::index();
+}
+
+size_t InitState::step(Store& s, const Container& c, ExecuteInput& i)
+{
+    i.setResult(services::ErrorResult{"Cannot execute a job when the executor is still initializing"});
+    return InitState::index();
+}
+
+size_t InitState::step(Store& s, const Container& c, TogglePauseInput& i)
+{
+    i.setResult(services::ErrorResult{"Cannot toggle pause when the executor is still initializing"});
+    return InitState::index();
+}
+
+size_t InitState::step(Store& s, const Container& c, DumpInput& i)
+{
+    i.setResult(result::BooleanResult{true});
+    return InitState::index();
+}
+
+size_t InitState::step(Store& s, const Container& c, AbandonInput& i)
+{
+    i.setResult(result::BooleanResult{false});
+    return InitState::index();
+}
+
+size_t InitState::step(Store& s, const Container& c, StatsInput& i)
+{
+    i.setResult(s.collectStats());
+    return InitState::index();
+}
+
+size_t InitState::step(Store& s, const Container& c, ConfigureInput& i)
+{
+    s.configure(i.config);
+    i.setResult(result::BooleanResult{true});
+    return InitState::index();
+}
+
+size_t RunningState::step(Store& s, const Container& c, HeartbeatInput& i)
+{
+    s.reapFinishedJobs();
+    return RunningState::index();
+}
+
+size_t RunningState::step(Store& s, const Container& c, ExecuteInput& i)
+{
+    s.execute(i);
+    return RunningState::index();
+}
+
+size_t RunningState::step(Store& s, const Container& c, TogglePauseInput& i)
+{
+    i.setResult(result::BooleanResult{true});
+    return PausedState::index();
+}
+
+// Only to be run to rescue data right before shutdown!
+size_t RunningState::step(Store& s, const Container& c, DumpInput& i)
+{
+    i.setResult(result::BooleanResult{s.dumpRunningJobs(c)});
+    return RunningState::index();
+}
+
+size_t RunningState::step(Store& s, const Container& c, AbandonInput& i)
+{
+    i.setResult(result::BooleanResult{s.abandon(i.id)});
+    return RunningState::index();
+}
+
+size_t RunningState::step(Store& s, const Container& c, StatsInput& i)
+{
+    i.setResult(s.collectStats());
+    return RunningState::index();
+}
+
+size_t RunningState::step(Store& s, const Container& c, ConfigureInput& i)
+{
+    s.configure(i.config);
+    i.setResult(result::BooleanResult{true});
+    return RunningState::index();
+}
+
+size_t PausedState::step(Store& s, const Container& c, HeartbeatInput& i)
+{
+    s.reapFinishedJobs();
+    return PausedState::index();
+}
+
+size_t PausedState::step(Store& s, const Container& c, ExecuteInput& i)
+{
+    s.executorStats.rejections.add();
+    i.setResult(services::ErrorResult{"Cannot execute a job when the executor is paused"});
+    return PausedState::index();
+}
+
+size_t PausedState::step(Store& s, const Container& c, TogglePauseInput& i)
+{
+    i.setResult(result::BooleanResult{true});
+    return RunningState::index();
+}
+
+// Only to be run to rescue data right before shutdown!
+size_t PausedState::step(Store& s, const Container& c, DumpInput& i)
+{
+    i.setResult(result::BooleanResult{s.dumpRunningJobs(c)});
+    return PausedState::index();
+}
+
+size_t PausedState::step(Store& s, const Container& c, AbandonInput& i)
+{
+    i.setResult(result::BooleanResult{s.abandon(i.id)});
+    return PausedState::index();
+}
+
+size_t PausedState::step(Store& s, const Container& c, StatsInput& i)
+{
+    i.setResult(s.collectStats());
+    return PausedState::index();
+}
+
+size_t PausedState::step(Store& s, const Container& c, ConfigureInput& i)
+{
+    s.configure(i.config);
+    i.setResult(result::BooleanResult{true});
+    return PausedState::index();
+}
+
+} // namespace job_executor
+
+} // end namespace orchestrator
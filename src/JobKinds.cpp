@@ -0,0 +1,70 @@
+#include "orchestrator/JobKinds.h"
+#include <charconv>
+#include <stdexcept>
+#include <thread>
+
+namespace orchestrator
+{
+
+namespace job_kinds
+{
+
+static constexpr auto kJobSucceeded = aapis::orchestrator::v1::JobStatus::JOB_STATUS_COMPLETE;
+
+EchoJob::Args EchoJob::parse(const Job& job)
+{
+    return job.inputs;
+}
+
+result::JobResult EchoJob::run(Args& args)
+{
+    return result::JobResult{kJobSucceeded, std::move(args)};
+}
+
+/// @brief Parse a job's first input as a duration
+/// @param job Job whose first input is a non-negative number of milliseconds
+/// @param what What kind of job it is, for the error thrown (as std::invalid_argument) if it is malformed
+static std::chrono::milliseconds parseMillis(const Job& job, const std::string& what)
+{
+    int64_t millis = -1;
+    if (!job.inputs.empty())
+    {
+        const auto& input = job.inputs.front();
+        const auto  end   = input.data() + input.size();
+        if (std::from_chars(input.data(), end, millis).ptr != end)
+        {
+            millis = -1;
+        }
+    }
+    if (millis < 0)
+    {
+        throw std::invalid_argument("A " + what + " job's first input must be a non-negative number of milliseconds");
+    }
+    return std::chrono::milliseconds(millis);
+}
+
+SleepJob::Args SleepJob::parse(const Job& job)
+{
+    return parseMillis(job, "sleep");
+}
+
+result::JobResult SleepJob::run(Args& args)
+{
+    std::this_thread::sleep_for(args);
+    return result::JobResult{kJobSucceeded, std::vector<std::string>{}};
+}
+
+DelayJob::Args DelayJob::parse(const Job& job)
+{
+    return Args{parseMillis(job, "delay"), std::vector<std::string>(job.inputs.begin() + 1, job.inputs.end())};
+}
+
+job_coroutines::JobTask DelayJob::run(Args args)
+{
+    co_await job_coroutines::sleepFor(args.delay);
+    co_return result::JobResult{kJobSucceeded, std::move(args.outputs)};
+}
+
+} // namespace job_kinds
+
+} // end namespace orchestrator
@@ -1,7 +1,11 @@
 #include "orchestrator/JobQueue.h"
 #include <chrono>
 #include <algorithm>
+#include <limits>
+#include <numeric>
 #include <ranges>
+#include <set>
+#include <stdexcept>
 
 namespace orchestrator
 {
@@ -9,6 +13,74 @@ namespace orchestrator
 namespace job_queue
 {
 
+std::optional<SchedulingMode> schedulingModeFromName(const std::string& name)
+{
+    if (name == "priority")
+    {
+        return SchedulingMode::PRIORITY;
+    }
+    if (name == "critical-path")
+    {
+        return SchedulingMode::CRITICAL_PATH;
+    }
+    if (name == "earliest-deadline")
+    {
+        return SchedulingMode::EARLIEST_DEADLINE;
+    }
+    return std::nullopt;
+}
+
+/// @brief Read the system clock, or the virtual clock standing in for it
+/// @return Microseconds since the epoch
+int64_t Store::nowMicros() const
+{
+    if (virtualClock)
+    {
+        return virtualClock();
+    }
+    const auto now = std::chrono::system_clock::now().time_since_epoch();
+    return std::chrono::duration_cast<std::chrono::microseconds>(now).count();
+}
+
+int64_t Store::nowSeconds() const
+{
+    return nowMicros() / 1000000;
+}
+
+/// @brief Read the steady clock (for latencies), or the virtual clock standing in for it
+int64_t Store::steadyMicros() const
+{
+    return virtualClock ? virtualClock() : stats::steadyClockMicros();
+}
+
+/// @brief Offer a job to the executor, or to whatever stands in for it
+/// @param c Access point for the job executor
+/// @param input Execution request
+/// @return Whether the request was taken; its future tells whether the job was
+bool Store::sendToExecutor(const Container& c, job_executor::ExecuteInput&& input)
+{
+    if (executorStandIn)
+    {
+        return executorStandIn->execute(std::move(input));
+    }
+    return c.get<job_executor::JobExecutor>()->sendInput(std::move(input));
+}
+
+/// @brief Tell the executor, or whatever stands in for it, to stop running a job
+/// @param c Access point for the job executor
+/// @param jobId Job to abandon
+void Store::abandonOnExecutor(const Container& c, int64_t jobId)
+{
+    if (executorStandIn)
+    {
+        executorStandIn->abandon(jobId);
+        return;
+    }
+    job_executor::AbandonInput abandonRequest;
+    abandonRequest.id = jobId;
+    c.get<job_executor::JobExecutor>()->sendInput(std::move(abandonRequest));
+}
+
 /// @brief Take a new job and register it with the queue store, giving it a unique ID
 /// @param job Job to be registered and given an ID
 /// @param paused Whether or not the program is currently paused
@@ -23,6 +95,26 @@ int64_t Store::addAndRegisterNewJob(Job& job, bool paused)
         throw std::runtime_error("Duplicate job ID would be inserted in the Job Queue");
     }
 
+    // If the job's blockers already (transitively) depend on it, then it could never be unblocked
+    if (createsCycle(id, job.independentBlockers) || createsCycle(id, job.relevantBlockers))
+    {
+        throw std::runtime_error("Job would introduce a dependency cycle in the Job Queue");
+    }
+
+    jobPriorities[id] = job.priority;
+    recordEvent(id, job.status);
+    holdHandles(heldInputHandles, id, job.inputs);
+
+    if (coalesceJob(job))
+    {
+        queueStats.pushes.add();
+        return id;
+    }
+
+    queueStats.pushes.add();
+    pushTimesMicros[id] = steadyMicros();
+
+    registerDependencies(job);
     pendingJobs.push_back(std::move(job));
     sortJobs();
 
@@ -35,15 +127,23 @@ int64_t Store::addAndRegisterNewJob(Job& job, bool paused)
 /// @return A globally unique, monotinically increasing ID
 int64_t Store::initializeJobData(Job& job, bool paused)
 {
-    const auto now = std::chrono::system_clock::now().time_since_epoch();
+    const auto now = nowMicros();
 
-    job.spawnTimeSeconds = std::chrono::duration_cast<std::chrono::seconds>(now).count();
+    job.spawnTimeSeconds = now / 1000000;
 
-    int64_t spawnMicrosId =
-        std::chrono::duration_cast<std::chrono::milliseconds>(now).count() * 1e3 + static_cast<int64_t>(subCounter);
+    int64_t spawnMicrosId = (now / 1000) * 1000 + static_cast<int64_t>(subCounter);
 
     subCounter++;
 
+    // The sub-counter wraps after 256 jobs within the same millisecond, so enforce monotonicity explicitly
+    spawnMicrosId = std::max(spawnMicrosId, lastJobId + 1);
+    // When sharded, the ID also has to tell the other shards which shard the job belongs to
+    if (shardRouter)
+    {
+        spawnMicrosId = shardRouter->alignId(spawnMicrosId, shardIndex);
+    }
+    lastJobId = spawnMicrosId;
+
     job.id = spawnMicrosId;
 
     if (job.numBlockers() == 0)
@@ -62,10 +162,476 @@ int64_t Store::initializeJobData(Job& job, bool paused)
     return spawnMicrosId;
 }
 
+/// @brief Register a job template to be pushed at a later time, possibly repeatedly
+/// @param job Job template; each push gets a fresh ID
+/// @param startTimeSeconds Time of the first push
+/// @param periodSeconds Interval between subsequent pushes; zero or less pushes only once
+/// @param paused Whether or not the program is currently paused
+/// @return A schedule ID that can be used to cancel the schedule
+int64_t Store::scheduleJob(const Job& job, int64_t startTimeSeconds, int64_t periodSeconds, bool paused)
+{
+    // Blockers would have long finished by the time later runs come around
+    if (job.numBlockers() != 0)
+    {
+        throw std::runtime_error("Scheduled jobs cannot have blockers");
+    }
+
+    // Bring the wheel up to the current time (anchoring it on first use) so the new timer is filed relative to now
+    releaseScheduledJobs(paused);
+
+    ScheduledJob scheduled{.job = job, .nextRunSeconds = startTimeSeconds, .periodSeconds = periodSeconds};
+    auto         scheduleId = initializeJobData(scheduled.job, paused);
+    jobTimers.schedule(scheduleId, startTimeSeconds);
+    scheduledJobs.emplace(scheduleId, std::move(scheduled));
+
+    return scheduleId;
+}
+
+/// @brief Push every scheduled job whose time has come, rescheduling recurring ones, and re-queue retried jobs
+/// @param paused Whether or not the program is currently paused
+void Store::releaseScheduledJobs(bool paused)
+{
+    const auto now = nowSeconds();
+
+    for (auto scheduleId : jobTimers.advance(now))
+    {
+        // Timed-out jobs that have waited out their backoff go back in line under their original IDs
+        auto retryingIt = retryingJobs.find(scheduleId);
+        if (retryingIt != retryingJobs.end())
+        {
+            auto& job = retryingIt->second;
+            if (paused)
+            {
+                job.prePauseStatus = aapis::orchestrator::v1::JobStatus::JOB_STATUS_QUEUED;
+                job.status         = aapis::orchestrator::v1::JobStatus::JOB_STATUS_PAUSED;
+            }
+            else
+            {
+                job.status = aapis::orchestrator::v1::JobStatus::JOB_STATUS_QUEUED;
+            }
+            recordEvent(job.id, job.status);
+            pendingJobs.push_back(std::move(job));
+            retryingJobs.erase(retryingIt);
+            sortJobs();
+            continue;
+        }
+
+        // Canceled schedules are left on the wheel and simply skipped when they come due
+        auto scheduledIt = scheduledJobs.find(scheduleId);
+        if (scheduledIt == scheduledJobs.end())
+        {
+            continue;
+        }
+        auto& scheduled = scheduledIt->second;
+
+        Job job = scheduled.job;
+        try
+        {
+            addAndRegisterNewJob(job, paused);
+        }
+        catch (const std::runtime_error&)
+        {
+            // TODO log error
+        }
+
+        if (scheduled.periodSeconds <= 0)
+        {
+            scheduledJobs.erase(scheduledIt);
+            continue;
+        }
+        // Runs missed while the queue wasn't heartbeating are skipped rather than released all at once
+        const auto missedPeriods = (now - scheduled.nextRunSeconds) / scheduled.periodSeconds;
+        scheduled.nextRunSeconds += (missedPeriods + 1) * scheduled.periodSeconds;
+        jobTimers.schedule(scheduleId, scheduled.nextRunSeconds);
+    }
+}
+
+/// @brief Determine whether a job is still queued, set aside, or running
+/// @param jobId Job to look for
+/// @return Whether the job has yet to reach a terminal state
+bool Store::hasActiveJob(int64_t jobId) const
+{
+    return std::any_of(pendingJobs.begin(), pendingJobs.end(), [&](const Job& j) { return j.id == jobId; }) ||
+           pendingJobResults.contains(jobId) || pendingCacheLookups.contains(jobId) || scheduledJobs.contains(jobId) ||
+           retryingJobs.contains(jobId) || pendingSpills.contains(jobId) ||
+           std::any_of(coalescedWaiters.begin(), coalescedWaiters.end(), [&](const auto& waiters) {
+               return std::any_of(waiters.second.begin(), waiters.second.end(), [&](const Job& j) {
+                   return j.id == jobId;
+               });
+           });
+}
+
+/// @brief Gather every job that has not been handed to the executor yet, wherever it is being held
+/// @return Copies of all not-yet-executed jobs
+std::vector<Job> Store::queuedJobs() const
+{
+    std::vector<Job> jobs = pendingJobs;
+    std::ranges::transform(pendingCacheLookups, std::back_inserter(jobs), [](const auto& lookup) {
+        return lookup.second.first;
+    });
+    for (const auto& waiters : coalescedWaiters)
+    {
+        std::copy(waiters.second.begin(), waiters.second.end(), std::back_inserter(jobs));
+    }
+    std::ranges::transform(retryingJobs, std::back_inserter(jobs), [](const auto& retrying) {
+        return retrying.second;
+    });
+    return jobs;
+}
+
+/// @brief Gather everything the queue would need to pick up where it left off after a restart
+/// @return Request for the database to keep the shard's jobs and schedules in place of what it dumped before
+job_database::DumpQueueData Store::dumpQueueData() const
+{
+    job_database::DumpQueueData dumpInput;
+    dumpInput.pendingJobs = queuedJobs();
+    std::ranges::copy(std::views::keys(pendingJobResults), std::back_inserter(dumpInput.awaitedJobIds));
+    std::ranges::copy(std::views::keys(pendingSpills), std::back_inserter(dumpInput.awaitedJobIds));
+    std::ranges::transform(
+        scheduledJobs, std::back_inserter(dumpInput.scheduledJobs), [](const auto& scheduled) {
+            return scheduled.second;
+        });
+    dumpInput.shardIndex = shardIndex;
+    return dumpInput;
+}
+
+/// @brief Take back what the shards and the executor dumped before a restart, keeping whatever this shard owns
+/// @param queueData Loaded data set; the jobs that were running are set aside in pendingInitExecs to re-execute
+void Store::loadQueueData(result::JobQueueDataResult queueData)
+{
+    // Every shard loads the same data set, keeping only the jobs it owns
+    if (shardRouter)
+    {
+        std::erase_if(queueData.pendingJobs.jobs, [&](const Job& j) { return isRemoteJob(j.id); });
+        std::erase_if(queueData.runningJobs.jobs, [&](const Job& j) { return isRemoteJob(j.id); });
+        std::erase_if(queueData.scheduledJobs, [&](const ScheduledJob& sj) { return isRemoteJob(sj.job.id); });
+    }
+
+    pendingJobs           = std::move(queueData.pendingJobs.jobs);
+    auto rememberPriority = [&](const Job& j) { jobPriorities[j.id] = j.priority; };
+    std::ranges::for_each(pendingJobs, rememberPriority);
+    std::ranges::for_each(queueData.runningJobs.jobs, rememberPriority);
+    rebuildDependencyGraph();
+    sortJobs();
+
+    // Schedules keep their IDs and next run times; runs missed while the daemon was down are released once on the
+    // first heartbeat, like those missed between heartbeats
+    if (!jobTimers.anchored())
+    {
+        jobTimers.advance(nowSeconds());
+    }
+    for (auto& scheduled : queueData.scheduledJobs)
+    {
+        const auto scheduleId = scheduled.job.id;
+        lastJobId             = std::max(lastJobId, scheduleId);
+        jobTimers.schedule(scheduleId, scheduled.nextRunSeconds);
+        scheduledJobs.insert_or_assign(scheduleId, std::move(scheduled));
+    }
+
+    pendingInitExecs = std::move(queueData.runningJobs.jobs);
+}
+
+/// @brief Determine whether making a job wait on the given blockers would introduce a dependency cycle
+/// @param jobId Job that would be blocked
+/// @param blockers Prospective blockers of the job
+/// @return Whether any of the blockers is the job itself or (transitively) waits on the job
+bool Store::createsCycle(int64_t jobId, const std::vector<int64_t>& blockers) const
+{
+    if (blockers.empty())
+    {
+        return false;
+    }
+
+    // Walk every job downstream of jobId; the graph is kept acyclic, so this only visits jobId's own dependents
+    std::set<int64_t>    visited{jobId};
+    std::vector<int64_t> frontier{jobId};
+    while (!frontier.empty())
+    {
+        auto id = frontier.back();
+        frontier.pop_back();
+        if (std::find(blockers.begin(), blockers.end(), id) != blockers.end())
+        {
+            return true;
+        }
+        auto dependentsIt = jobDependents.find(id);
+        if (dependentsIt == jobDependents.end())
+        {
+            continue;
+        }
+        for (auto dependentId : dependentsIt->second)
+        {
+            if (visited.insert(dependentId).second)
+            {
+                frontier.push_back(dependentId);
+            }
+        }
+    }
+
+    return false;
+}
+
+/// @brief Record a job as a dependent of each of its blockers, asking other shards to report on blockers they own
+/// @param job Job whose blockers should point back to it
+void Store::registerDependencies(const Job& job)
+{
+    auto registerBlocker = [&](int64_t blockerId) {
+        jobDependents[blockerId].push_back(job.id);
+        if (isRemoteJob(blockerId))
+        {
+            shardRouter->postWatch(shardRouter->shardOf(blockerId),
+                                   BlockerWatch{.blockerId = blockerId, .watcherShard = shardIndex});
+        }
+    };
+    std::ranges::for_each(job.independentBlockers, registerBlocker);
+    std::ranges::for_each(job.relevantBlockers, registerBlocker);
+}
+
+/// @brief Reconstruct the blocker -> dependents graph from scratch out of all registered jobs
+void Store::rebuildDependencyGraph()
+{
+    jobDependents.clear();
+    for (const auto& job : pendingJobs)
+    {
+        registerDependencies(job);
+    }
+}
+
+/// @brief For every registered job, compute the number of jobs in the longest chain of dependents it heads
+void Store::computeCriticalPathLengths()
+{
+    criticalPathLengths.clear();
+
+    // Iterative post-order traversal so that very deep chains can't overflow the stack
+    std::set<int64_t>                     expandedIds;
+    std::vector<std::pair<int64_t, bool>> stack;
+    for (const auto& job : pendingJobs)
+    {
+        stack.emplace_back(job.id, false);
+    }
+    while (!stack.empty())
+    {
+        auto [id, expanded] = stack.back();
+        stack.pop_back();
+        auto dependentsIt = jobDependents.find(id);
+        if (!expanded)
+        {
+            if (!expandedIds.insert(id).second)
+            {
+                continue;
+            }
+            stack.emplace_back(id, true);
+            if (dependentsIt != jobDependents.end())
+            {
+                for (auto dependentId : dependentsIt->second)
+                {
+                    stack.emplace_back(dependentId, false);
+                }
+            }
+            continue;
+        }
+        int64_t longestChain = 0;
+        if (dependentsIt != jobDependents.end())
+        {
+            for (auto dependentId : dependentsIt->second)
+            {
+                auto lengthIt = criticalPathLengths.find(dependentId);
+                if (lengthIt != criticalPathLengths.end())
+                {
+                    longestChain = std::max(longestChain, lengthIt->second);
+                }
+            }
+        }
+        criticalPathLengths[id] = longestChain + 1;
+    }
+}
+
+/// @brief Record the terminal state of a job that no longer needs to be scheduled
+/// @param jobId Job that reached a terminal state
+/// @param status Terminal status of the job
+void Store::archiveJob(int64_t jobId, aapis::orchestrator::v1::JobStatus status)
+{
+    archivedJobs[jobId] = ArchivedJob{.status = status, .completionTimestampSeconds = nowSeconds()};
+    recordEvent(jobId, status);
+    jobPriorities.erase(jobId);
+    releaseHeldHandles(heldInputHandles, jobId);
+}
+
+/// @brief Cancel a job (if it is still queued) along with every job that transitively depends on it, or cancel a
+/// schedule
+/// @param rootId Job at the root of the subtree to cancel, or schedule to cancel
+/// @return IDs of all canceled jobs
+std::vector<int64_t> Store::cancelJobs(int64_t rootId)
+{
+    // Nothing depends on a schedule; canceling one just stops any further pushes
+    if (scheduledJobs.erase(rootId) > 0)
+    {
+        return {rootId};
+    }
+
+    // Gather the whole downstream subtree in a single traversal of the dependency graph
+    std::set<int64_t>    canceledIds;
+    std::vector<int64_t> frontier{rootId};
+    while (!frontier.empty())
+    {
+        auto id = frontier.back();
+        frontier.pop_back();
+        auto dependentsIt = jobDependents.find(id);
+        if (dependentsIt == jobDependents.end())
+        {
+            continue;
+        }
+        for (auto dependentId : dependentsIt->second)
+        {
+            if (canceledIds.insert(dependentId).second)
+            {
+                frontier.push_back(dependentId);
+            }
+        }
+    }
+
+    // A root that has already been handed to the executor can't be recalled; only its dependents are canceled
+    if (std::any_of(pendingJobs.begin(), pendingJobs.end(), [&](const Job& j) { return j.id == rootId; }))
+    {
+        canceledIds.insert(rootId);
+    }
+    // A root waiting out a retry backoff never gets re-queued
+    if (retryingJobs.erase(rootId) > 0)
+    {
+        canceledIds.insert(rootId);
+    }
+    // A coalesced root simply stops waiting on the identical job doing its work
+    for (auto& waiters : coalescedWaiters)
+    {
+        if (std::erase_if(waiters.second, [&](const Job& j) { return j.id == rootId; }) > 0)
+        {
+            canceledIds.insert(rootId);
+        }
+    }
+
+    // Pull the canceled jobs out of the scheduling structures in one pass, unlinking them from surviving blockers
+    std::erase_if(pendingJobs, [&](const Job& j) {
+        if (!canceledIds.contains(j.id))
+        {
+            return false;
+        }
+        auto unlink = [&](int64_t blockerId) {
+            auto dependentsIt = jobDependents.find(blockerId);
+            if (!canceledIds.contains(blockerId) && dependentsIt != jobDependents.end())
+            {
+                std::erase(dependentsIt->second, j.id);
+            }
+        };
+        std::ranges::for_each(j.independentBlockers, unlink);
+        std::ranges::for_each(j.relevantBlockers, unlink);
+        return true;
+    });
+    for (auto canceledId : canceledIds)
+    {
+        pushTimesMicros.erase(canceledId);
+        jobDependents.erase(canceledId);
+        criticalPathLengths.erase(canceledId);
+        archiveJob(canceledId, aapis::orchestrator::v1::JobStatus::JOB_STATUS_CANCELED);
+        notifyRemoteWatchers(canceledId,
+                             result::JobResult{.resultStatus = aapis::orchestrator::v1::JobStatus::JOB_STATUS_CANCELED,
+                                               .outputs      = std::vector<std::string>{}},
+                             {});
+    }
+
+    // Jobs coalesced onto a canceled job still have to run on their own
+    bool requeued = false;
+    for (auto canceledId : canceledIds)
+    {
+        auto waiters = retireCoalescingPrimary(canceledId);
+        requeued     = requeued || !waiters.empty();
+        std::move(waiters.begin(), waiters.end(), std::back_inserter(pendingJobs));
+    }
+    if (requeued)
+    {
+        sortJobs();
+    }
+
+    return {canceledIds.begin(), canceledIds.end()};
+}
+
+/// @brief Attach a newly registered job to an identical queued or running job, if there is one
+/// @param job Registered job
+/// @return Whether the job was attached as a waiter and must not be queued itself
+bool Store::coalesceJob(Job& job)
+{
+    // Only jobs with no blockers have final inputs; relevant blockers may still append to them
+    if (!jobCoalescing || job.numBlockers() != 0)
+    {
+        return false;
+    }
+
+    auto key       = ResultCache::keyOf(job.kind, job.inputs);
+    auto primaryIt = coalescingPrimaries.find(key.hash);
+    if (primaryIt == coalescingPrimaries.end())
+    {
+        registerCoalescingPrimary(job.id, std::move(key));
+        return false;
+    }
+    // A job whose inputs merely hash the same runs on its own
+    if (coalescingPrimaryKeys.at(primaryIt->second) != key)
+    {
+        return false;
+    }
+
+    coalescedWaiters[primaryIt->second].push_back(std::move(job));
+    return true;
+}
+
+/// @brief Make a job the one that identical jobs get coalesced onto, unless another job already fills that role
+/// @param jobId Queued or running job
+/// @param key What the job's result depends on
+void Store::registerCoalescingPrimary(int64_t jobId, ResultCacheKey key)
+{
+    if (coalescingPrimaries.try_emplace(key.hash, jobId).second)
+    {
+        coalescingPrimaryKeys[jobId] = std::move(key);
+    }
+}
+
+/// @brief Stop coalescing new jobs onto a job that is finished or canceled
+/// @param jobId Finished or canceled job
+/// @return The jobs that were coalesced onto it
+std::vector<Job> Store::retireCoalescingPrimary(int64_t jobId)
+{
+    auto keyIt = coalescingPrimaryKeys.find(jobId);
+    if (keyIt == coalescingPrimaryKeys.end())
+    {
+        return {};
+    }
+    auto primaryIt = coalescingPrimaries.find(keyIt->second.hash);
+    if (primaryIt != coalescingPrimaries.end() && primaryIt->second == jobId)
+    {
+        coalescingPrimaries.erase(primaryIt);
+    }
+    coalescingPrimaryKeys.erase(keyIt);
+
+    std::vector<Job> waiters;
+    auto             waitersIt = coalescedWaiters.find(jobId);
+    if (waitersIt != coalescedWaiters.end())
+    {
+        waiters = std::move(waitersIt->second);
+        coalescedWaiters.erase(waitersIt);
+    }
+    return waiters;
+}
+
 /// @brief Sort all registered jobs in the store according to blocking status, priority, and ID
 void Store::sortJobs()
 {
-    std::sort(pendingJobs.begin(), pendingJobs.end(), [](const Job& a, const Job& b) {
+    if (schedulingMode == SchedulingMode::CRITICAL_PATH)
+    {
+        computeCriticalPathLengths();
+    }
+    // Jobs without a deadline sort after every job with one
+    auto effectiveDeadline = [](const Job& j) {
+        return j.deadlineSeconds < 0 ? std::numeric_limits<int64_t>::max() : j.deadlineSeconds;
+    };
+
+    std::sort(pendingJobs.begin(), pendingJobs.end(), [&](const Job& a, const Job& b) {
         // Dependencies ultimately supersede priority; we don't want to get stuck
         if (std::find(a.independentBlockers.begin(), a.independentBlockers.end(), b.id) != a.independentBlockers.end())
         {
@@ -84,9 +650,23 @@ void Store::sortJobs()
         {
             return true;
         }
-        if (a.priority < b.priority)
+        if (a.priority != b.priority)
         {
-            return true;
+            return a.priority < b.priority;
+        }
+        // Within a priority level, jobs heading the longest chains of dependents go first when requested
+        if (schedulingMode == SchedulingMode::CRITICAL_PATH)
+        {
+            const auto aChain = criticalPathLengths.at(a.id);
+            const auto bChain = criticalPathLengths.at(b.id);
+            if (aChain != bChain)
+            {
+                return aChain > bChain;
+            }
+        }
+        if (schedulingMode == SchedulingMode::EARLIEST_DEADLINE && effectiveDeadline(a) != effectiveDeadline(b))
+        {
+            return effectiveDeadline(a) < effectiveDeadline(b);
         }
         if (a.numBlockers() != b.numBlockers())
         {
@@ -103,6 +683,7 @@ void Store::pauseJobs()
     {
         job.prePauseStatus = job.status;
         job.status         = aapis::orchestrator::v1::JobStatus::JOB_STATUS_PAUSED;
+        recordEvent(job.id, job.status);
     }
 }
 
@@ -112,6 +693,7 @@ void Store::unpauseJobs()
     for (auto& job : pendingJobs)
     {
         job.status = job.prePauseStatus;
+        recordEvent(job.id, job.status);
     }
 }
 
@@ -131,18 +713,28 @@ bool Store::timedJobDrain(const std::chrono::milliseconds&       timeBudget,
     // Each loaded job ID must be passed to the executor to get a future back
     std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
     std::chrono::steady_clock::time_point now   = std::chrono::steady_clock::now();
+    // Kinds of job the executor has no room for; jobs of other kinds may still get in ahead of them
+    std::set<uint32_t> saturatedKinds;
     for (auto it = jobs.begin(); it != jobs.end();)
     {
         // Don't consider jobs that don't meet the drain criteria
-        if (!fJobDrainCriterion(*it))
+        if (!fJobDrainCriterion(*it) || saturatedKinds.contains(it->kind))
         {
             ++it;
             continue;
         }
 
+        // Jobs whose inputs have been seen before don't need the executor at all
+        if (resolveFromResultCache(*it, c))
+        {
+            it = jobs.erase(it);
+            continue;
+        }
+
         // Prepare the job for execution
-        auto tryExecKey    = it->id;
-        auto tryExecInput  = job_executor::ExecuteInput{.job = *it};
+        auto                       tryExecKey = it->id;
+        job_executor::ExecuteInput tryExecInput;
+        tryExecInput.job   = *it;
         auto tryExecFuture = tryExecInput.getFuture();
 
         // Only attempt to queue this job if we have enough time budget to wait for an answer
@@ -150,32 +742,48 @@ bool Store::timedJobDrain(const std::chrono::milliseconds&       timeBudget,
         now                             = std::chrono::steady_clock::now();
         if (std::chrono::duration_cast<std::chrono::milliseconds>(now - start) + tryExecInputWaitTime > timeBudget)
         {
+            queueStats.budgetOverruns.add();
             return false;
         }
 
         // The executor will tell us if there was room for our pending job.
         // Wait for "as long as it takes" to get this information.
-        if (!c.get<job_executor::JobExecutor>()->sendInput(std::move(tryExecInput)))
+        if (!sendToExecutor(c, std::move(tryExecInput)))
         {
+            queueStats.executorRejections.add();
             return false;
         }
         while (tryExecFuture.wait_for(tryExecInputWaitTime) != std::future_status::ready)
         {
             // Our timeout underestimated how slow JobExecutor is; see if we can try again
-            // TODO log a warning
+            queueStats.executorSlowAcks.add();
         }
         // If there was no room, then exit. Else, store the future result, remove the pending job from the list, and
         // move on to trying to jump another job.
         auto tryExecResult = tryExecFuture.get();
         if (std::holds_alternative<services::ErrorResult>(tryExecResult))
         {
-            // TODO log error
+            queueStats.executorRejections.add();
+            // A job of an in-process kind may only have hit its kind's concurrency limit
+            if (it->kind != 0)
+            {
+                saturatedKinds.insert(it->kind);
+                ++it;
+                continue;
+            }
             return false;
         }
         else
         {
             pendingJobResults.emplace(
                 std::make_pair(tryExecKey, std::move(std::get<result::FutureJobResult>(tryExecResult))));
+            if (jobCoalescing && !coalescingPrimaryKeys.contains(tryExecKey))
+            {
+                registerCoalescingPrimary(tryExecKey, ResultCache::keyOf(it->kind, it->inputs));
+            }
+            trackDeadline(*it);
+            queueStats.dispatches.add();
+            recordDispatch(tryExecKey);
             it = jobs.erase(it); // this increments the iterator
         }
     }
@@ -183,86 +791,605 @@ bool Store::timedJobDrain(const std::chrono::milliseconds&       timeBudget,
     return jobs.size() == 0;
 }
 
+/// @brief Satisfy a ready job from the result cache if a job of the same kind and inputs has already finished
+/// @param job Job that is about to be sent to the executor
+/// @param c Access point for the job database, which holds the on-disk tier of the cache
+/// @return Whether the job has been taken care of and must not be sent to the executor
+bool Store::resolveFromResultCache(const Job& job, const Container& c)
+{
+    if (!resultCache.enabled())
+    {
+        return false;
+    }
+
+    // Both tiers were already consulted for this job on its way back from a disk lookup
+    if (diskCacheMissedJobIds.erase(job.id) > 0)
+    {
+        return false;
+    }
+
+    auto key            = ResultCache::keyOf(job.kind, job.inputs);
+    auto memCacheResult = resultCache.lookup(key);
+    if (memCacheResult.has_value())
+    {
+        // The cached copy may be evicted before the result is taken in, so the result keeps its own hold on the files
+        holdHandles(heldResultHandles, job.id, std::get<std::vector<std::string>>(memCacheResult->outputs));
+        std::promise<result::JobResult> cachedResult;
+        cachedResult.set_value(std::move(*memCacheResult));
+        pendingJobResults.emplace(job.id, cachedResult.get_future());
+        queueStats.cacheHits.add();
+        recordDispatch(job.id);
+        return true;
+    }
+
+    // Remember the key so that the eventual result can be cached under it
+    inFlightCacheKeys[job.id] = key;
+
+    if (!resultCacheDiskTier)
+    {
+        return false;
+    }
+
+    // Set the job aside while the database looks for it; it rejoins the ready jobs on a miss
+    job_database::LoadCachedResult loadRequest;
+    loadRequest.key      = key;
+    auto diskCacheFuture = loadRequest.getFuture();
+    if (!c.get<job_database::JobDatabase>()->sendInput(std::move(loadRequest)))
+    {
+        return false;
+    }
+    pendingCacheLookups.emplace(job.id, std::make_pair(job, std::move(diskCacheFuture)));
+    return true;
+}
+
+/// @brief Poll outstanding on-disk result cache lookups, resolving hits and returning misses to the queue
+/// @param paused Whether or not the program is currently paused
+void Store::processPendingCacheLookups(bool paused)
+{
+    static constexpr std::chrono::milliseconds kFutureCheckTimeout = std::chrono::milliseconds(1);
+
+    for (auto lookupIt = pendingCacheLookups.begin(); lookupIt != pendingCacheLookups.end();)
+    {
+        auto& [job, diskCacheFuture] = lookupIt->second;
+        if (diskCacheFuture.wait_for(kFutureCheckTimeout) != std::future_status::ready)
+        {
+            ++lookupIt;
+            continue;
+        }
+
+        auto diskCacheResult = diskCacheFuture.get();
+        if (std::holds_alternative<result::OptionalJobResult>(diskCacheResult) &&
+            std::get<result::OptionalJobResult>(diskCacheResult).result.has_value())
+        {
+            auto& jobResult = *std::get<result::OptionalJobResult>(diskCacheResult).result;
+            resultCache.recordDiskHit();
+            cacheResult(inFlightCacheKeys[job.id], jobResult);
+            inFlightCacheKeys.erase(job.id);
+            holdHandles(heldResultHandles, job.id, std::get<std::vector<std::string>>(jobResult.outputs));
+
+            std::promise<result::JobResult> cachedResult;
+            cachedResult.set_value(std::move(jobResult));
+            pendingJobResults.emplace(job.id, cachedResult.get_future());
+            queueStats.cacheHits.add();
+            recordDispatch(job.id);
+        }
+        else
+        {
+            if (paused)
+            {
+                job.prePauseStatus = job.status;
+                job.status         = aapis::orchestrator::v1::JobStatus::JOB_STATUS_PAUSED;
+                recordEvent(job.id, job.status);
+            }
+            diskCacheMissedJobIds.insert(job.id);
+            pendingJobs.push_back(std::move(job));
+            sortJobs();
+        }
+        lookupIt = pendingCacheLookups.erase(lookupIt);
+    }
+}
+
+/// @brief Hand results evicted from the in-memory result cache over to its on-disk tier
+/// @param c Access point for the job database
+void Store::flushPendingCacheSpills(const Container& c)
+{
+    for (auto& [key, jobResult] : pendingCacheSpills)
+    {
+        job_database::StoreCachedResult storeRequest;
+        storeRequest.key    = key;
+        storeRequest.result = std::move(jobResult);
+        // Losing a spilled result only costs a recomputation, so don't wait on the database
+        c.get<job_database::JobDatabase>()->sendInput(std::move(storeRequest));
+    }
+    pendingCacheSpills.clear();
+}
+
+/// @brief Start the clock on a job that was just handed to the executor, if it has a timeout
+/// @param job Dispatched job
+void Store::trackDeadline(const Job& job)
+{
+    if (job.timeoutSeconds <= 0)
+    {
+        return;
+    }
+
+    const auto deadlineSeconds = nowSeconds() + job.timeoutSeconds;
+    runningDeadlines.emplace(deadlineSeconds, job.id);
+    runningDeadlineSeconds[job.id] = deadlineSeconds;
+    // Retries re-queue the job under the same ID so that its dependents stay attached, which takes a copy of it
+    if (job.numRetries < job.maxRetries)
+    {
+        retryableRunningJobs[job.id] = job;
+    }
+}
+
+/// @brief Give up on running jobs that have outlived their timeouts, retrying them after a backoff if allowed
+/// @param c Access point for the job executor
+/// @param paused Whether or not the program is currently paused
+void Store::reapExpiredJobs(const Container& c, bool paused)
+{
+    // Backoff doubles with each retry from the base up to the cap, which it reaches long before the shift overflows
+    static constexpr int64_t kRetryBackoffBaseSeconds = 1;
+    static constexpr int64_t kMaxRetryBackoffSeconds  = 3600;
+    static constexpr int64_t kMaxRetryBackoffShift    = 12;
+
+    const auto now = nowSeconds();
+
+    while (!runningDeadlines.empty() && runningDeadlines.top().first <= now)
+    {
+        auto [deadlineSeconds, jobId] = runningDeadlines.top();
+        runningDeadlines.pop();
+
+        // Skip entries for jobs that have since finished or been re-dispatched with a new deadline
+        auto deadlineIt = runningDeadlineSeconds.find(jobId);
+        if (deadlineIt == runningDeadlineSeconds.end() || deadlineIt->second != deadlineSeconds)
+        {
+            continue;
+        }
+        runningDeadlineSeconds.erase(deadlineIt);
+        if (pendingJobResults.erase(jobId) == 0)
+        {
+            continue;
+        }
+        releaseHeldHandles(heldResultHandles, jobId);
+        queueStats.timeouts.add();
+        dispatchTimesMicros.erase(jobId);
+
+        // Free the executor slot; the result will be ignored if the job ever does finish
+        abandonOnExecutor(c, jobId);
+
+        auto retryableIt = retryableRunningJobs.find(jobId);
+        if (retryableIt != retryableRunningJobs.end())
+        {
+            auto job = std::move(retryableIt->second);
+            retryableRunningJobs.erase(retryableIt);
+            const auto shift          = std::clamp<int64_t>(job.numRetries, 0, kMaxRetryBackoffShift);
+            const auto backoffSeconds = std::min(kRetryBackoffBaseSeconds << shift, kMaxRetryBackoffSeconds);
+            job.numRetries++;
+            jobTimers.schedule(jobId, now + backoffSeconds);
+            retryingJobs.emplace(jobId, std::move(job));
+            continue;
+        }
+
+        // There's no dedicated timeout status, so a timed-out job fails like any other
+        completeJob(jobId,
+                    result::JobResult{.resultStatus = aapis::orchestrator::v1::JobStatus::JOB_STATUS_ERROR,
+                                      .outputs      = std::vector<std::string>{}},
+                    paused);
+    }
+}
+
 /// @brief Poll pending jobs for results and clear blockers and add child jobs as necessary
 /// @param paused Whether or not the program is currently paused
 void Store::processPendingJobResults(bool paused)
 {
-    static constexpr std::chrono::milliseconds kFutureCheckTimeout = std::chrono::milliseconds(1);
+    // Only poll: waiting on each running job in turn would cost heartbeat time per job rather than find results sooner
+    static constexpr std::chrono::milliseconds kFutureCheckTimeout = std::chrono::milliseconds(0);
+
+    processPendingSpills(paused);
+    for (auto futJobResultIt = pendingJobResults.begin(); futJobResultIt != pendingJobResults.end();)
+    {
+        auto jobId = futJobResultIt->first;
+        if (futJobResultIt->second.wait_for(kFutureCheckTimeout) != std::future_status::ready)
+        {
+            ++futJobResultIt;
+            continue;
+        }
+
+        // A future can only be consumed once, so the job stops being awaited as soon as its result is in hand
+        auto jobResult = futJobResultIt->second.get();
+        futJobResultIt = pendingJobResults.erase(futJobResultIt);
+
+        // Large outputs go to disk before anything (the result cache, dependents' inputs, other shards) takes a copy,
+        // but hashing and writing them out is no work for the queue's own thread
+        if (outputStore && std::holds_alternative<std::vector<std::string>>(jobResult.outputs) &&
+            outputStore->hasLarge(std::get<std::vector<std::string>>(jobResult.outputs)))
+        {
+            pendingSpills.emplace(jobId,
+                                  std::async(std::launch::async,
+                                             [store = outputStore, jobResult = std::move(jobResult)]() mutable {
+                                                 auto handles = store->spillLarge(
+                                                     std::get<std::vector<std::string>>(jobResult.outputs));
+                                                 return std::make_pair(std::move(jobResult), std::move(handles));
+                                             }));
+            continue;
+        }
+        completeJob(jobId, std::move(jobResult), paused);
+    }
+}
+
+/// @brief Take in the results of jobs whose large outputs have finished spilling
+/// @param paused Whether or not the program is currently paused
+void Store::processPendingSpills(bool paused)
+{
+    for (auto spillIt = pendingSpills.begin(); spillIt != pendingSpills.end();)
+    {
+        if (spillIt->second.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+        {
+            ++spillIt;
+            continue;
+        }
+        const auto jobId                 = spillIt->first;
+        auto [jobResult, spilledHandles] = spillIt->second.get();
+        spillIt                          = pendingSpills.erase(spillIt);
+
+        // The spill already holds the files it wrote (or found) for the result
+        auto& held = heldResultHandles[jobId];
+        held.insert(held.end(), spilledHandles.begin(), spilledHandles.end());
+        completeJob(jobId, std::move(jobResult), paused);
+    }
+}
+
+/// @brief Take a reference on a job's behalf to every spilled output among some of its inputs or outputs
+/// @param held Where the job's references are kept
+/// @param jobId Job holding the references
+/// @param inputs Inputs or outputs, of which only handles count
+void Store::holdHandles(HeldHandles& held, int64_t jobId, const std::vector<std::string>& inputs)
+{
+    if (!outputStore)
+    {
+        return;
+    }
+    std::vector<std::string> handles;
+    std::copy_if(inputs.begin(), inputs.end(), std::back_inserter(handles), outputs::OutputStore::isHandle);
+    if (handles.empty())
+    {
+        return;
+    }
+    outputStore->retain(handles);
+    auto& jobHandles = held[jobId];
+    jobHandles.insert(jobHandles.end(), handles.begin(), handles.end());
+}
 
-    for (auto& futJobResult : pendingJobResults)
+/// @brief Give up the references a job holds, letting the store remove outputs nothing else refers to
+/// @param held Where the job's references are kept
+/// @param jobId Job holding the references
+void Store::releaseHeldHandles(HeldHandles& held, int64_t jobId)
+{
+    auto heldIt = held.find(jobId);
+    if (heldIt == held.end())
+    {
+        return;
+    }
+    if (outputStore)
     {
-        auto jobId = futJobResult.first;
-        if (futJobResult.second.wait_for(kFutureCheckTimeout) == std::future_status::ready)
+        outputStore->release(heldIt->second);
+    }
+    held.erase(heldIt);
+}
+
+/// @brief Take a reference to every spilled output among a result's outputs, for a copy of the result to hold
+void Store::retainHandles(const result::JobResult& jobResult)
+{
+    if (outputStore && std::holds_alternative<std::vector<std::string>>(jobResult.outputs))
+    {
+        outputStore->retain(std::get<std::vector<std::string>>(jobResult.outputs));
+    }
+}
+
+/// @brief Give up the references a copy of a result held, once it is dropped
+void Store::releaseHandles(const result::JobResult& jobResult)
+{
+    if (outputStore && std::holds_alternative<std::vector<std::string>>(jobResult.outputs))
+    {
+        outputStore->release(std::get<std::vector<std::string>>(jobResult.outputs));
+    }
+}
+
+/// @brief Cache a job's result, the cached copy holding its spilled outputs like any other
+/// @param key What the result depends on
+/// @param jobResult Result to cache
+void Store::cacheResult(const ResultCacheKey& key, const result::JobResult& jobResult)
+{
+    auto removed = resultCache.insert(key, jobResult);
+    if (resultCache.contains(key))
+    {
+        retainHandles(jobResult);
+    }
+    retireCacheEntries(std::move(removed));
+}
+
+/// @brief Let go of entries dropped from the in-memory result cache, handing them to its on-disk tier if there is one
+/// @param removed Entries evicted or replaced
+void Store::retireCacheEntries(std::vector<ResultCache::Entry> removed)
+{
+    for (auto& entry : removed)
+    {
+        const auto& cachedOutputs = std::get<std::vector<std::string>>(entry.second.outputs);
+        if (std::any_of(cachedOutputs.begin(), cachedOutputs.end(), outputs::OutputStore::isHandle))
+        {
+            // Spilled outputs don't outlive the daemon, so results referring to them aren't worth keeping on disk
+            releaseHandles(entry.second);
+            continue;
+        }
+        if (resultCacheDiskTier)
         {
-            auto jobResult = futJobResult.second.get();
-            // If the job was unsuccessful, then mark all dependent jobs as canceled and move on. The executor will deal
-            // with them.
-            if (jobResult.resultStatus == aapis::orchestrator::v1::JobStatus::JOB_STATUS_ERROR)
+            pendingCacheSpills.push_back(std::move(entry));
+        }
+    }
+}
+
+/// @brief Take in the result of a job that is no longer running and propagate it
+/// @param jobId Job that stopped running
+/// @param jobResult Result of the job
+/// @param paused Whether or not the program is currently paused
+void Store::completeJob(int64_t jobId, result::JobResult jobResult, bool paused)
+{
+    runningDeadlineSeconds.erase(jobId);
+    retryableRunningJobs.erase(jobId);
+
+    queueStats.completions.add();
+    if (jobResult.resultStatus == aapis::orchestrator::v1::JobStatus::JOB_STATUS_ERROR)
+    {
+        queueStats.failures.add();
+    }
+    auto dispatchTimeIt = dispatchTimesMicros.find(jobId);
+    if (dispatchTimeIt != dispatchTimesMicros.end())
+    {
+        queueStats.dispatchToCompletionMicros.record(steadyMicros() - dispatchTimeIt->second);
+        dispatchTimesMicros.erase(dispatchTimeIt);
+    }
+
+    // The result's spilled outputs stay on disk while it is passed on, whatever else lets go of them meanwhile
+    retainHandles(jobResult);
+    releaseHeldHandles(heldResultHandles, jobId);
+
+    auto cacheKeyIt = inFlightCacheKeys.find(jobId);
+    if (cacheKeyIt != inFlightCacheKeys.end())
+    {
+        cacheResult(cacheKeyIt->second, jobResult);
+        inFlightCacheKeys.erase(cacheKeyIt);
+    }
+
+    // Identical jobs coalesced onto this one finish along with it
+    std::vector<int64_t> finishedJobIds{jobId};
+    for (const auto& waiter : retireCoalescingPrimary(jobId))
+    {
+        finishedJobIds.push_back(waiter.id);
+    }
+
+    // Spawned child jobs are only added once, no matter how many finished jobs they stand in for
+    std::vector<int64_t> childJobIds;
+    if (jobResult.resultStatus != aapis::orchestrator::v1::JobStatus::JOB_STATUS_ERROR &&
+        std::holds_alternative<std::vector<Job>>(jobResult.outputs))
+    {
+        auto childJobs = std::get<std::vector<Job>>(jobResult.outputs);
+        std::transform(childJobs.begin(), childJobs.end(), std::back_inserter(childJobIds), [&](Job j) {
+            return addAndRegisterNewJob(j, paused);
+        });
+    }
+
+    for (auto finishedJobId : finishedJobIds)
+    {
+        resolveJob(finishedJobId, jobResult, childJobIds);
+    }
+    releaseHandles(jobResult);
+}
+
+/// @brief Propagate the result of a finished job to the jobs blocked on it
+/// @param jobId Finished job
+/// @param jobResult Result of the finished job
+/// @param childJobIds IDs of the already-registered child jobs spawned by the finished job, if any
+void Store::resolveJob(int64_t jobId, const result::JobResult& jobResult, const std::vector<int64_t>& childJobIds)
+{
+    archiveJob(jobId, jobResult.resultStatus);
+    notifyRemoteWatchers(jobId, jobResult, childJobIds);
+    unblockDependents(jobId, jobResult, childJobIds);
+}
+
+/// @brief Release, rewire, or cancel the jobs blocked on a finished job, which may belong to another shard
+/// @param jobId Finished job
+/// @param jobResult Result of the finished job
+/// @param childJobIds IDs of the already-registered child jobs spawned by the finished job, if any
+void Store::unblockDependents(int64_t                     jobId,
+                              const result::JobResult&    jobResult,
+                              const std::vector<int64_t>& childJobIds)
+{
+    // If the job was unsuccessful, then cancel everything downstream of it and move on
+    if (jobResult.resultStatus == aapis::orchestrator::v1::JobStatus::JOB_STATUS_ERROR)
+    {
+        cancelJobs(jobId);
+    }
+    // If the job returned outputs, then remove the blocker from any blocked jobs and add all outputs as inputs for
+    // the case of relevantBlockers.
+    else if (std::holds_alternative<std::vector<std::string>>(jobResult.outputs))
+    {
+        const auto& outputs = std::get<std::vector<std::string>>(jobResult.outputs);
+        std::ranges::for_each(pendingJobs, [&](Job& j) {
+            auto indBlockerIt = std::find(j.independentBlockers.begin(), j.independentBlockers.end(), jobId);
+            if (indBlockerIt != j.independentBlockers.end())
             {
-                std::ranges::for_each(pendingJobs, [&](Job& j) {
-                    if (std::find(j.independentBlockers.begin(), j.independentBlockers.end(), jobId) !=
-                            j.independentBlockers.end() ||
-                        std::find(j.relevantBlockers.begin(), j.relevantBlockers.end(), jobId) !=
-                            j.relevantBlockers.end())
-                    {
-                        j.status = aapis::orchestrator::v1::JobStatus::JOB_STATUS_CANCELED;
-                    }
-                });
+                j.independentBlockers.erase(indBlockerIt);
             }
-            else
+            auto relBlockerIt = std::find(j.relevantBlockers.begin(), j.relevantBlockers.end(), jobId);
+            if (relBlockerIt != j.relevantBlockers.end())
             {
-                // If the job returned outputs, then remove the blocker from any blocked jobs and add all outputs as
-                // inputs for the case of relevantBlockers.
-                if (std::holds_alternative<std::vector<std::string>>(jobResult.outputs))
-                {
-                    auto outputs = std::get<std::vector<std::string>>(jobResult.outputs);
-                    std::ranges::for_each(pendingJobs, [&](Job& j) {
-                        auto indBlockerIt =
-                            std::find(j.independentBlockers.begin(), j.independentBlockers.end(), jobId);
-                        if (indBlockerIt != j.independentBlockers.end())
-                        {
-                            j.independentBlockers.erase(indBlockerIt);
-                        }
-                        auto relBlockerIt = std::find(j.relevantBlockers.begin(), j.relevantBlockers.end(), jobId);
-                        if (relBlockerIt != j.relevantBlockers.end())
-                        {
-                            j.relevantBlockers.erase(relBlockerIt);
-                            std::move(outputs.begin(), outputs.end(), std::back_inserter(j.inputs));
-                        }
-                    });
-                }
-                // If the job returned child jobs, then add each child job to pendingJobs. Then, remove the parent ID
-                // from any blocked jobs but add the child job IDs to the corresponding blockers list.
-                else
+                j.relevantBlockers.erase(relBlockerIt);
+                j.consumedBlockers.push_back(jobId);
+                std::copy(outputs.begin(), outputs.end(), std::back_inserter(j.inputs));
+                holdHandles(heldInputHandles, j.id, outputs);
+            }
+        });
+    }
+    // If the job returned child jobs, then remove the parent ID from any blocked jobs but add the child job IDs to the
+    // corresponding blockers list.
+    else
+    {
+        std::vector<int64_t> deadlockedJobIds;
+        std::ranges::for_each(pendingJobs, [&](Job& j) {
+            auto indBlockerIt = std::find(j.independentBlockers.begin(), j.independentBlockers.end(), jobId);
+            auto relBlockerIt = std::find(j.relevantBlockers.begin(), j.relevantBlockers.end(), jobId);
+            if (indBlockerIt == j.independentBlockers.end() && relBlockerIt == j.relevantBlockers.end())
+            {
+                return;
+            }
+            // If any child (transitively) waits on this job, then splicing would deadlock both, so cancel the
+            // dependent instead of leaving it blocked forever
+            if (createsCycle(j.id, childJobIds))
+            {
+                deadlockedJobIds.push_back(j.id);
+                return;
+            }
+            if (indBlockerIt != j.independentBlockers.end())
+            {
+                j.independentBlockers.erase(indBlockerIt);
+                std::copy(childJobIds.begin(), childJobIds.end(), std::back_inserter(j.independentBlockers));
+            }
+            if (relBlockerIt != j.relevantBlockers.end())
+            {
+                j.relevantBlockers.erase(relBlockerIt);
+                std::copy(childJobIds.begin(), childJobIds.end(), std::back_inserter(j.relevantBlockers));
+            }
+            for (auto childJobId : childJobIds)
+            {
+                jobDependents[childJobId].push_back(j.id);
+            }
+        });
+        std::ranges::for_each(deadlockedJobIds, [&](int64_t id) { cancelJobs(id); });
+        sortJobs();
+    }
+
+    jobDependents.erase(jobId);
+}
+
+/// @brief Determine whether a job belongs to another shard
+/// @param jobId Job to locate
+/// @return Whether the queue is sharded and the job was created by a different shard
+bool Store::isRemoteJob(int64_t jobId) const
+{
+    return shardRouter && shardRouter->shardOf(jobId) != shardIndex;
+}
+
+/// @brief Pass the outcome of a job on to the other shards with jobs blocked on it
+/// @param jobId Finished or canceled job
+/// @param jobResult Result of the job
+/// @param childJobIds IDs of the child jobs spawned by the job, if any, which inherit its watchers
+void Store::notifyRemoteWatchers(int64_t                     jobId,
+                                 const result::JobResult&    jobResult,
+                                 const std::vector<int64_t>& childJobIds)
+{
+    if (!shardRouter)
+    {
+        return;
+    }
+    // Other shards may be about to watch the job without knowing it is done, and will need the whole outcome
+    auto finishedIt = finishedResolutions.find(jobId);
+    if (finishedIt != finishedResolutions.end())
+    {
+        releaseHandles(finishedIt->second.result);
+    }
+    retainHandles(jobResult);
+    finishedResolutions[jobId] = BlockerResolution{.blockerId = jobId, .result = jobResult, .childJobIds = childJobIds};
+
+    auto watchersIt = remoteWatchers.find(jobId);
+    if (watchersIt == remoteWatchers.end())
+    {
+        return;
+    }
+    for (auto watcherShard : watchersIt->second)
+    {
+        postResolution(watcherShard,
+                       BlockerResolution{.blockerId = jobId, .result = jobResult, .childJobIds = childJobIds});
+    }
+    // Watching shards splice the children in for the job, so they will want to hear about the children next
+    if (jobResult.resultStatus != aapis::orchestrator::v1::JobStatus::JOB_STATUS_ERROR)
+    {
+        for (auto childJobId : childJobIds)
+        {
+            remoteWatchers[childJobId].insert(watchersIt->second.begin(), watchersIt->second.end());
+        }
+    }
+    remoteWatchers.erase(jobId);
+}
+
+/// @brief Act on the blocker notifications other shards have posted since the last heartbeat
+void Store::processShardMail()
+{
+    if (!shardRouter)
+    {
+        return;
+    }
+    auto mail = shardRouter->takeMail(shardIndex);
+
+    // Answering a late watch on a job that spawned children puts the watcher onto the children, which may be done too
+    auto& watches = mail.watches;
+    for (size_t k = 0; k < watches.size(); k++)
+    {
+        const auto watch = watches[k];
+        if (hasActiveJob(watch.blockerId))
+        {
+            remoteWatchers[watch.blockerId].insert(watch.watcherShard);
+            continue;
+        }
+        // The blocker finished before the watch arrived, so pass on the outcome it would have been sent
+        auto finishedIt = finishedResolutions.find(watch.blockerId);
+        if (finishedIt != finishedResolutions.end())
+        {
+            const auto& resolution = finishedIt->second;
+            postResolution(watch.watcherShard, resolution);
+            if (resolution.result.resultStatus != aapis::orchestrator::v1::JobStatus::JOB_STATUS_ERROR)
+            {
+                for (auto childJobId : resolution.childJobIds)
                 {
-                    auto                 childJobs = std::get<std::vector<Job>>(jobResult.outputs);
-                    std::vector<int64_t> childJobIds(childJobs.size());
-                    std::transform(childJobs.begin(), childJobs.end(), childJobIds.begin(), [&](Job j) {
-                        return addAndRegisterNewJob(j, paused);
-                    });
-                    std::ranges::for_each(pendingJobs, [&](Job& j) {
-                        auto indBlockerIt =
-                            std::find(j.independentBlockers.begin(), j.independentBlockers.end(), jobId);
-                        if (indBlockerIt != j.independentBlockers.end())
-                        {
-                            j.independentBlockers.erase(indBlockerIt);
-                            std::copy(childJobIds.begin(),
-                                      childJobIds.end(),
-                                      std::back_inserter(j.independentBlockers));
-                        }
-                        auto relBlockerIt = std::find(j.relevantBlockers.begin(), j.relevantBlockers.end(), jobId);
-                        if (relBlockerIt != j.relevantBlockers.end())
-                        {
-                            j.relevantBlockers.erase(relBlockerIt);
-                            std::copy(childJobIds.begin(), childJobIds.end(), std::back_inserter(j.relevantBlockers));
-                        }
-                    });
+                    watches.push_back(BlockerWatch{.blockerId = childJobId, .watcherShard = watch.watcherShard});
                 }
             }
+            continue;
+        }
+        // Nothing is known of the blocker (anymore), so its dependents can never be released
+        shardRouter->postResolution(
+            watch.watcherShard,
+            BlockerResolution{.blockerId   = watch.blockerId,
+                              .result      = result::JobResult{aapis::orchestrator::v1::JobStatus::JOB_STATUS_ERROR,
+                                                               std::vector<std::string>{}},
+                              .childJobIds = {}});
+    }
+
+    for (const auto& resolution : mail.resolutions)
+    {
+        // A canceled blocker takes its dependents down with it, just as it would on its own shard
+        if (resolution.result.resultStatus == aapis::orchestrator::v1::JobStatus::JOB_STATUS_CANCELED)
+        {
+            cancelJobs(resolution.blockerId);
+            jobDependents.erase(resolution.blockerId);
+        }
+        else
+        {
+            unblockDependents(resolution.blockerId, resolution.result, resolution.childJobIds);
         }
+        releaseHandles(resolution.result);
     }
 }
 
+/// @brief Send another shard the outcome of a job it has jobs blocked on, holding any spilled outputs until it arrives
+/// @param watcherShard Shard to notify
+/// @param resolution Outcome of the job
+void Store::postResolution(size_t watcherShard, const BlockerResolution& resolution)
+{
+    retainHandles(resolution.result);
+    shardRouter->postResolution(watcherShard, resolution);
+}
+
 /// @brief Return a copy of all jobs that match a query criterion
 /// @param query Query criterion with which to filter jobs
 /// @return Filtered list of jobs meeting the query criterion
@@ -272,18 +1399,247 @@ std::vector<Job> Store::query(const QueryInput::QueryType& query)
 
     if (std::holds_alternative<QueryInput::GetAllQueuedJobs>(query))
     {
-        std::copy(pendingJobs.begin(), pendingJobs.end(), std::back_inserter(queryResult));
+        queryResult = queuedJobs();
     }
     else if (std::holds_alternative<QueryInput::GetJobsAtPriorityLevel>(query))
     {
-        std::copy_if(pendingJobs.begin(), pendingJobs.end(), std::back_inserter(queryResult), [&](Job& j) {
+        auto jobs = queuedJobs();
+        std::copy_if(jobs.begin(), jobs.end(), std::back_inserter(queryResult), [&](Job& j) {
             return j.priority == std::get<QueryInput::GetJobsAtPriorityLevel>(query).priority;
         });
     }
+    else if (std::holds_alternative<QueryInput::GetArchivedJobs>(query))
+    {
+        std::ranges::transform(archivedJobs, std::back_inserter(queryResult), [](const auto& archived) {
+            Job job;
+            job.id                         = archived.first;
+            job.status                     = archived.second.status;
+            job.completionTimestampSeconds = archived.second.completionTimestampSeconds;
+            return job;
+        });
+    }
+    else if (std::holds_alternative<QueryInput::GetScheduledJobs>(query))
+    {
+        std::ranges::transform(scheduledJobs, std::back_inserter(queryResult), [](const auto& scheduled) {
+            Job job                  = scheduled.second.job;
+            job.executionTimeSeconds = scheduled.second.nextRunSeconds;
+            return job;
+        });
+    }
 
     return queryResult;
 }
 
+/// @brief Note that a job has just left the queue, either for the executor or satisfied by the result cache
+/// @param jobId Dispatched job
+void Store::recordDispatch(int64_t jobId)
+{
+    const auto now        = steadyMicros();
+    auto       pushTimeIt = pushTimesMicros.find(jobId);
+    if (pushTimeIt != pushTimesMicros.end())
+    {
+        queueStats.pushToDispatchMicros.record(now - pushTimeIt->second);
+        pushTimesMicros.erase(pushTimeIt);
+    }
+    dispatchTimesMicros[jobId] = now;
+    recordEvent(jobId, aapis::orchestrator::v1::JobStatus::JOB_STATUS_ACTIVE);
+}
+
+/// @brief Snapshot the queue's instrumentation along with its current depth by job status
+/// @return Named metrics; latencies are in microseconds
+result::StatsResult Store::collectStats() const
+{
+    static const std::array<std::string, QueueStats::kNumStates> kStateNames = {
+        "init", "init_wait", "init_final_wait", "running", "paused"};
+
+    result::StatsResult statsResult;
+    auto&               metrics = statsResult.metrics;
+
+    // Depths are tallied here on request rather than maintained on the hot path
+    for (const auto& job : pendingJobs)
+    {
+        metrics["depth." + aapis::orchestrator::v1::JobStatus_Name(job.status)]++;
+    }
+    metrics["depth.running"]      = static_cast<int64_t>(pendingJobResults.size());
+    metrics["depth.cache_lookup"] = static_cast<int64_t>(pendingCacheLookups.size());
+    metrics["depth.spilling"]     = static_cast<int64_t>(pendingSpills.size());
+    metrics["depth.coalesced"]    = std::accumulate(
+        coalescedWaiters.begin(), coalescedWaiters.end(), int64_t{0}, [](int64_t n, const auto& waiters) {
+            return n + static_cast<int64_t>(waiters.second.size());
+        });
+    metrics["depth.retrying"]  = static_cast<int64_t>(retryingJobs.size());
+    metrics["depth.scheduled"] = static_cast<int64_t>(scheduledJobs.size());
+    metrics["depth.archived"]  = static_cast<int64_t>(archivedJobs.size());
+
+    // Inputs of queued jobs are mostly the outputs of their blockers, so they are what large outputs cost the queue
+    int64_t heldBytes    = 0;
+    int64_t spilledBytes = 0;
+    for (const auto& job : pendingJobs)
+    {
+        for (const auto& input : job.inputs)
+        {
+            const auto spilledSize = outputs::OutputStore::spilledSize(input);
+            (spilledSize ? spilledBytes : heldBytes) += static_cast<int64_t>(spilledSize.value_or(input.size()));
+        }
+    }
+    metrics["inputs.held_bytes"]    = heldBytes;
+    metrics["inputs.spilled_bytes"] = spilledBytes;
+
+    for (size_t k = 0; k < QueueStats::kNumStates; k++)
+    {
+        stats::addHistogram(metrics, "heartbeat_us." + kStateNames[k], queueStats.heartbeatMicros[k]);
+    }
+    stats::addHistogram(metrics, "push_to_dispatch_us", queueStats.pushToDispatchMicros);
+    stats::addHistogram(metrics, "dispatch_to_completion_us", queueStats.dispatchToCompletionMicros);
+    stats::addCounter(metrics, "pushes", queueStats.pushes);
+    stats::addCounter(metrics, "dispatches", queueStats.dispatches);
+    stats::addCounter(metrics, "cache_hits", queueStats.cacheHits);
+    stats::addCounter(metrics, "completions", queueStats.completions);
+    stats::addCounter(metrics, "failures", queueStats.failures);
+    stats::addCounter(metrics, "timeouts", queueStats.timeouts);
+    stats::addCounter(metrics, "budget_overruns", queueStats.budgetOverruns);
+    stats::addCounter(metrics, "executor_rejections", queueStats.executorRejections);
+    stats::addCounter(metrics, "executor_slow_acks", queueStats.executorSlowAcks);
+
+    const auto& cacheStats             = resultCache.stats();
+    metrics["result_cache.hits"]       = static_cast<int64_t>(cacheStats.hits);
+    metrics["result_cache.disk_hits"]  = static_cast<int64_t>(cacheStats.diskHits);
+    metrics["result_cache.misses"]     = static_cast<int64_t>(cacheStats.misses);
+    metrics["result_cache.evictions"]  = static_cast<int64_t>(cacheStats.evictions);
+    metrics["result_cache.collisions"] = static_cast<int64_t>(cacheStats.collisions);
+    metrics["result_cache.size_bytes"] = static_cast<int64_t>(cacheStats.sizeBytes);
+    if (outputStore)
+    {
+        outputStore->addStats(metrics);
+    }
+
+    return statsResult;
+}
+
+/// @brief Note that a job has entered a new status, for the next batch of events pushed to subscribers
+/// @param jobId Job whose status changed
+/// @param status New status of the job
+void Store::recordEvent(int64_t jobId, aapis::orchestrator::v1::JobStatus status)
+{
+    // Without subscribers there is nobody to tell, so the hot path doesn't pay for events
+    if (subscriptions.empty())
+    {
+        return;
+    }
+    auto       priorityIt = jobPriorities.find(jobId);
+    const auto priority   = priorityIt != jobPriorities.end() ? priorityIt->second : 0;
+    pendingEvents.push_back(
+        events::JobEvent{.jobId = jobId, .status = status, .priority = priority, .timestampMicros = nowMicros()});
+}
+
+/// @brief Push the events recorded since the last call out to every subscriber in one batch
+void Store::publishEvents()
+{
+    if (pendingEvents.empty())
+    {
+        return;
+    }
+    for (auto subscriptionIt = subscriptions.begin(); subscriptionIt != subscriptions.end();)
+    {
+        // A subscriber that let go of its stream without unsubscribing has lost interest all the same
+        if (subscriptionIt->second.use_count() == 1)
+        {
+            subscriptionIt = subscriptions.erase(subscriptionIt);
+            continue;
+        }
+        subscriptionIt->second->publish(pendingEvents);
+        ++subscriptionIt;
+    }
+    pendingEvents.clear();
+}
+
+/// @brief Register interest in job status changes
+/// @param filter Events the subscriber cares about
+/// @param capacity Most undelivered events to buffer for the subscriber
+/// @return Subscription ID and the stream events will be pushed to
+result::SubscriptionResult Store::subscribe(const events::SubscriptionFilter& filter, size_t capacity)
+{
+    auto stream = std::make_shared<events::EventStream>(filter, capacity);
+    auto id     = ++lastSubscriptionId;
+    subscriptions.emplace(id, stream);
+    return result::SubscriptionResult{.id = id, .stream = std::move(stream)};
+}
+
+/// @brief Stop pushing events to a subscriber, closing its stream
+/// @param subscriptionId Subscription to end
+/// @return Whether there was such a subscription
+bool Store::unsubscribe(int64_t subscriptionId)
+{
+    auto subscriptionIt = subscriptions.find(subscriptionId);
+    if (subscriptionIt == subscriptions.end())
+    {
+        return false;
+    }
+    subscriptionIt->second->close();
+    subscriptions.erase(subscriptionIt);
+    return true;
+}
+
+/// @brief Register a subscription on behalf of a SUBSCRIBE request, whatever state the queue is in
+/// @param i Subscription request, answered with the subscription or an error if it couldn't buffer anything
+void Store::answerSubscribe(SubscribeInput& i)
+{
+    if (i.capacity == 0)
+    {
+        i.setResult(services::ErrorResult{"A subscription must be able to buffer at least one event"});
+        return;
+    }
+    i.setResult(subscribe(i.filter, i.capacity));
+}
+
+/// @brief Cancel a subscription on behalf of an UNSUBSCRIBE request, whatever state the queue is in
+/// @param i Cancellation request, answered with an error if there was no such subscription
+void Store::answerUnsubscribe(UnsubscribeInput& i)
+{
+    if (!unsubscribe(i.id))
+    {
+        i.setResult(services::ErrorResult{"No subscription has the requested ID"});
+        return;
+    }
+    i.setResult(result::BooleanResult{true});
+}
+
+/// @brief Apply a runtime configuration change to the queue
+/// @param config Configuration change to apply
+void Store::configure(const ConfigureInput::ConfigType& config)
+{
+    if (std::holds_alternative<ConfigureInput::SetSchedulingMode>(config))
+    {
+        schedulingMode = std::get<ConfigureInput::SetSchedulingMode>(config).mode;
+        sortJobs();
+    }
+    else if (std::holds_alternative<ConfigureInput::SetResultCache>(config))
+    {
+        const auto& cacheConfig = std::get<ConfigureInput::SetResultCache>(config);
+        resultCacheDiskTier     = cacheConfig.diskTier;
+        retireCacheEntries(resultCache.setCapacity(cacheConfig.capacityBytes));
+    }
+    else if (std::holds_alternative<ConfigureInput::SetSharding>(config))
+    {
+        const auto& sharding = std::get<ConfigureInput::SetSharding>(config);
+        shardRouter          = sharding.router;
+        shardIndex           = sharding.shardIndex;
+    }
+    else if (std::holds_alternative<ConfigureInput::SetOutputStore>(config))
+    {
+        outputStore = std::get<ConfigureInput::SetOutputStore>(config).store;
+    }
+    else if (std::holds_alternative<ConfigureInput::SetJobCoalescing>(config))
+    {
+        jobCoalescing = std::get<ConfigureInput::SetJobCoalescing>(config).enabled;
+        // Jobs already coalesced still finish with their primaries, but no new ones get attached
+        if (!jobCoalescing)
+        {
+            coalescingPrimaries.clear();
+        }
+    }
+}
+
 const std::string JobQueue::name() const
 {
     return "JobQueue";
@@ -291,6 +1647,8 @@ const std::string JobQueue::name() const
 
 size_t InitState::step(Store& s, const Container& c, HeartbeatInput& i)
 {
+    stats::ScopedLatency stepTimer(s.queueStats.heartbeatMicros[InitState::index()]);
+
     // Shoot off a load data request to the database, then move on to the waiting state
     job_database::LoadQueueData loadRequest;
     s.pendingInitLoad = std::move(loadRequest.getFuture());
@@ -324,8 +1682,47 @@ size_t InitState::step(Store& s, const Container& c, DumpInput& i)
     return InitState::index();
 }
 
+size_t InitState::step(Store& s, const Container& c, StatsInput& i)
+{
+    i.setResult(s.collectStats());
+    return InitState::index();
+}
+
+size_t InitState::step(Store& s, const Container& c, ConfigureInput& i)
+{
+    s.configure(i.config);
+    i.setResult(result::BooleanResult{true});
+    return InitState::index();
+}
+
+size_t InitState::step(Store& s, const Container& c, CancelInput& i)
+{
+    i.setResult(services::ErrorResult{"Cannot cancel jobs when the queue is still initializing"});
+    return InitState::index();
+}
+
+size_t InitState::step(Store& s, const Container& c, ScheduleInput& i)
+{
+    i.setResult(services::ErrorResult{"Cannot schedule a new job when the queue is still initializing"});
+    return InitState::index();
+}
+
+size_t InitState::step(Store& s, const Container& c, SubscribeInput& i)
+{
+    s.answerSubscribe(i);
+    return InitState::index();
+}
+
+size_t InitState::step(Store& s, const Container& c, UnsubscribeInput& i)
+{
+    s.answerUnsubscribe(i);
+    return InitState::index();
+}
+
 size_t InitWaitState::step(Store& s, const Container& c, HeartbeatInput& i)
 {
+    stats::ScopedLatency stepTimer(s.queueStats.heartbeatMicros[InitWaitState::index()]);
+
     static constexpr std::chrono::milliseconds kFutureCheckTimeout = std::chrono::milliseconds(1);
 
     // Continue waiting if the init load is not ready
@@ -342,21 +1739,11 @@ size_t InitWaitState::step(Store& s, const Container& c, HeartbeatInput& i)
         return RunningState::index();
     }
 
-    result::JobQueueDataResult jobQueueData = std::get<result::JobQueueDataResult>(initLoadResult);
-
-    // Set pending jobs directly equal to the loaded data set
-    s.pendingJobs = jobQueueData.first.jobs;
-    s.sortJobs();
-
-    // If there are no in-progress jobs to re-request, then jump directly to the running state
-    if (jobQueueData.second.jobs.size() == 0)
-    {
-        return RunningState::index();
-    }
+    s.loadQueueData(std::get<result::JobQueueDataResult>(std::move(initLoadResult)));
 
-    // Store the pending in-progress jobs to re-request and move on to the final init state
-    s.pendingInitExecs = jobQueueData.second.jobs;
-    return InitFinalWaitState::index();
+    // If there are no in-progress jobs to re-request, then jump directly to the running state; otherwise move on to
+    // the final init state to re-request them
+    return s.pendingInitExecs.empty() ? RunningState::index() : InitFinalWaitState::index();
 }
 
 size_t InitWaitState::step(Store& s, const Container& c, PushInput& i)
@@ -385,13 +1772,55 @@ size_t InitWaitState::step(Store& s, const Container& c, DumpInput& i)
     return InitWaitState::index();
 }
 
+size_t InitWaitState::step(Store& s, const Container& c, StatsInput& i)
+{
+    i.setResult(s.collectStats());
+    return InitWaitState::index();
+}
+
+size_t InitWaitState::step(Store& s, const Container& c, ConfigureInput& i)
+{
+    s.configure(i.config);
+    i.setResult(result::BooleanResult{true});
+    return InitWaitState::index();
+}
+
+size_t InitWaitState::step(Store& s, const Container& c, CancelInput& i)
+{
+    i.setResult(services::ErrorResult{"Cannot cancel jobs when the queue is still initializing"});
+    return InitWaitState::index();
+}
+
+size_t InitWaitState::step(Store& s, const Container& c, ScheduleInput& i)
+{
+    i.setResult(services::ErrorResult{"Cannot schedule a new job when the queue is still initializing"});
+    return InitWaitState::index();
+}
+
+size_t InitWaitState::step(Store& s, const Container& c, SubscribeInput& i)
+{
+    s.answerSubscribe(i);
+    return InitWaitState::index();
+}
+
+size_t InitWaitState::step(Store& s, const Container& c, UnsubscribeInput& i)
+{
+    s.answerUnsubscribe(i);
+    return InitWaitState::index();
+}
+
 size_t InitFinalWaitState::step(Store& s, const Container& c, HeartbeatInput& i)
 {
+    stats::ScopedLatency stepTimer(s.queueStats.heartbeatMicros[InitFinalWaitState::index()]);
+
     // There's a lot going on in this step, so time things to ensure we can fall within our time budget
     static constexpr std::chrono::milliseconds kCheckFuturesBudget = std::chrono::milliseconds(950);
 
     // Each loaded job ID must be passed to the executor to get a future back
-    if (!s.timedJobDrain(kCheckFuturesBudget, s.pendingInitExecs, c, [](const Job& j) { return true; }))
+    const bool drained =
+        s.timedJobDrain(kCheckFuturesBudget, s.pendingInitExecs, c, [](const Job& j) { return true; });
+    s.publishEvents();
+    if (!drained)
     {
         return InitFinalWaitState::index();
     }
@@ -425,38 +1854,90 @@ size_t InitFinalWaitState::step(Store& s, const Container& c, DumpInput& i)
     return InitFinalWaitState::index();
 }
 
+size_t InitFinalWaitState::step(Store& s, const Container& c, StatsInput& i)
+{
+    i.setResult(s.collectStats());
+    return InitFinalWaitState::index();
+}
+
+size_t InitFinalWaitState::step(Store& s, const Container& c, ConfigureInput& i)
+{
+    s.configure(i.config);
+    i.setResult(result::BooleanResult{true});
+    return InitFinalWaitState::index();
+}
+
+size_t InitFinalWaitState::step(Store& s, const Container& c, CancelInput& i)
+{
+    i.setResult(services::ErrorResult{"Cannot cancel jobs when the queue is still initializing"});
+    return InitFinalWaitState::index();
+}
+
+size_t InitFinalWaitState::step(Store& s, const Container& c, ScheduleInput& i)
+{
+    i.setResult(services::ErrorResult{"Cannot schedule a new job when the queue is still initializing"});
+    return InitFinalWaitState::index();
+}
+
+size_t InitFinalWaitState::step(Store& s, const Container& c, SubscribeInput& i)
+{
+    s.answerSubscribe(i);
+    return InitFinalWaitState::index();
+}
+
+size_t InitFinalWaitState::step(Store& s, const Container& c, UnsubscribeInput& i)
+{
+    s.answerUnsubscribe(i);
+    return InitFinalWaitState::index();
+}
+
 size_t RunningState::step(Store& s, const Container& c, HeartbeatInput& i)
 {
+    stats::ScopedLatency stepTimer(s.queueStats.heartbeatMicros[RunningState::index()]);
+
     // There's a lot going on in this step, so time things to ensure we can fall within our time budget
     static constexpr std::chrono::milliseconds kCheckFuturesBudget = std::chrono::milliseconds(900);
 
     // Part 1: Check futures for results and propagate the results to all queued jobs
     std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    s.processShardMail();
+    s.releaseScheduledJobs(false);
+    s.reapExpiredJobs(c, false);
+    s.processPendingCacheLookups(false);
     s.processPendingJobResults(false);
+    s.flushPendingCacheSpills(c);
 
     // Do we have enough time to move onto Part 2? Calculate our Part 2 budget.
     std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
     auto part1Duration                        = std::chrono::duration_cast<std::chrono::duration<double>>(now - start);
     if (part1Duration > kCheckFuturesBudget)
     {
+        s.queueStats.budgetOverruns.add();
+        s.publishEvents();
         return RunningState::index();
     }
     std::chrono::milliseconds kDumpJobsBudget =
         kCheckFuturesBudget - std::chrono::duration_cast<std::chrono::milliseconds>(part1Duration);
 
     // Part 2: Dump as many "ready" jobs onto the execution stack as we can
-    if (!s.timedJobDrain(kCheckFuturesBudget, s.pendingJobs, c, [](const Job& j) { return j.numBlockers() == 0; }))
-    {
-        return RunningState::index();
-    }
+    s.timedJobDrain(kDumpJobsBudget, s.pendingJobs, c, [](const Job& j) { return j.numBlockers() == 0; });
 
+    // Part 3: Push every status change since the last heartbeat out to subscribers in one batch
+    s.publishEvents();
     return RunningState::index();
 }
 
 // Add an externally created job to the execution queue
 size_t RunningState::step(Store& s, const Container& c, PushInput& i)
 {
-    i.setResult(result::JobIdResult{s.addAndRegisterNewJob(i.job, false)});
+    try
+    {
+        i.setResult(result::JobIdResult{s.addAndRegisterNewJob(i.job, false)});
+    }
+    catch (const std::runtime_error& e)
+    {
+        i.setResult(services::ErrorResult{e.what()});
+    }
     return RunningState::index();
 }
 
@@ -469,10 +1950,8 @@ size_t RunningState::step(Store& s, const Container& c, QueryInput& i)
 // Only to be run to rescue data right before shutdown!
 size_t RunningState::step(Store& s, const Container& c, DumpInput& i)
 {
-    auto                        kv = std::views::keys(s.pendingJobResults);
-    std::vector<int64_t>        keys{kv.begin(), kv.end()};
-    job_database::DumpQueueData dumpInput{.pendingJobs = s.pendingJobs, .awaitedJobIds = keys};
-    auto                        dumpOutput = dumpInput.getFuture();
+    auto dumpInput  = s.dumpQueueData();
+    auto dumpOutput = dumpInput.getFuture();
     c.get<job_database::JobDatabase>()->sendInput(std::move(dumpInput));
     auto dumpResult = dumpOutput.get();
     if (std::holds_alternative<services::ErrorResult>(dumpResult))
@@ -494,16 +1973,82 @@ size_t RunningState::step(Store& s, const Container& c, TogglePauseInput& i)
     return PausedState::index();
 }
 
+size_t RunningState::step(Store& s, const Container& c, StatsInput& i)
+{
+    i.setResult(s.collectStats());
+    return RunningState::index();
+}
+
+size_t RunningState::step(Store& s, const Container& c, ConfigureInput& i)
+{
+    s.configure(i.config);
+    i.setResult(result::BooleanResult{true});
+    return RunningState::index();
+}
+
+size_t RunningState::step(Store& s, const Container& c, CancelInput& i)
+{
+    if (!s.hasActiveJob(i.id))
+    {
+        i.setResult(services::ErrorResult{"No queued or running job has the requested ID"});
+    }
+    else
+    {
+        i.setResult(result::JobIdsListResult{s.cancelJobs(i.id)});
+    }
+    return RunningState::index();
+}
+
+size_t RunningState::step(Store& s, const Container& c, ScheduleInput& i)
+{
+    try
+    {
+        i.setResult(result::JobIdResult{s.scheduleJob(i.job, i.startTimeSeconds, i.periodSeconds, false)});
+    }
+    catch (const std::runtime_error& e)
+    {
+        i.setResult(services::ErrorResult{e.what()});
+    }
+    return RunningState::index();
+}
+
+size_t RunningState::step(Store& s, const Container& c, SubscribeInput& i)
+{
+    s.answerSubscribe(i);
+    return RunningState::index();
+}
+
+size_t RunningState::step(Store& s, const Container& c, UnsubscribeInput& i)
+{
+    s.answerUnsubscribe(i);
+    return RunningState::index();
+}
+
 size_t PausedState::step(Store& s, const Container& c, HeartbeatInput& i)
 {
+    stats::ScopedLatency stepTimer(s.queueStats.heartbeatMicros[PausedState::index()]);
+
     // If we're paused, then only worry about cleaning up any pending job results we have left
+    s.processShardMail();
+    s.releaseScheduledJobs(true);
+    s.reapExpiredJobs(c, true);
+    s.processPendingCacheLookups(true);
     s.processPendingJobResults(true);
+    s.flushPendingCacheSpills(c);
+    s.publishEvents();
     return PausedState::index();
 }
 
 size_t PausedState::step(Store& s, const Container& c, PushInput& i)
 {
-    i.setResult(result::JobIdResult{s.addAndRegisterNewJob(i.job, true)});
+    try
+    {
+        i.setResult(result::JobIdResult{s.addAndRegisterNewJob(i.job, true)});
+    }
+    catch (const std::runtime_error& e)
+    {
+        i.setResult(services::ErrorResult{e.what()});
+    }
     return PausedState::index();
 }
 
@@ -523,10 +2068,8 @@ size_t PausedState::step(Store& s, const Container& c, TogglePauseInput& i)
 
 size_t PausedState::step(Store& s, const Container& c, DumpInput& i)
 {
-    auto                        kv = std::views::keys(s.pendingJobResults);
-    std::vector<int64_t>        keys{kv.begin(), kv.end()};
-    job_database::DumpQueueData dumpInput{.pendingJobs = s.pendingJobs, .awaitedJobIds = keys};
-    auto                        dumpOutput = dumpInput.getFuture();
+    auto dumpInput  = s.dumpQueueData();
+    auto dumpOutput = dumpInput.getFuture();
     c.get<job_database::JobDatabase>()->sendInput(std::move(dumpInput));
     auto dumpResult = dumpOutput.get();
     if (std::holds_alternative<services::ErrorResult>(dumpResult))
@@ -540,6 +2083,57 @@ size_t PausedState::step(Store& s, const Container& c, DumpInput& i)
     return PausedState::index();
 }
 
+size_t PausedState::step(Store& s, const Container& c, StatsInput& i)
+{
+    i.setResult(s.collectStats());
+    return PausedState::index();
+}
+
+size_t PausedState::step(Store& s, const Container& c, ConfigureInput& i)
+{
+    s.configure(i.config);
+    i.setResult(result::BooleanResult{true});
+    return PausedState::index();
+}
+
+size_t PausedState::step(Store& s, const Container& c, CancelInput& i)
+{
+    if (!s.hasActiveJob(i.id))
+    {
+        i.setResult(services::ErrorResult{"No queued or running job has the requested ID"});
+    }
+    else
+    {
+        i.setResult(result::JobIdsListResult{s.cancelJobs(i.id)});
+    }
+    return PausedState::index();
+}
+
+size_t PausedState::step(Store& s, const Container& c, ScheduleInput& i)
+{
+    try
+    {
+        i.setResult(result::JobIdResult{s.scheduleJob(i.job, i.startTimeSeconds, i.periodSeconds, true)});
+    }
+    catch (const std::runtime_error& e)
+    {
+        i.setResult(services::ErrorResult{e.what()});
+    }
+    return PausedState::index();
+}
+
+size_t PausedState::step(Store& s, const Container& c, SubscribeInput& i)
+{
+    s.answerSubscribe(i);
+    return PausedState::index();
+}
+
+size_t PausedState::step(Store& s, const Container& c, UnsubscribeInput& i)
+{
+    s.answerUnsubscribe(i);
+    return PausedState::index();
+}
+
 } // namespace job_queue
 
 } // end namespace orchestrator
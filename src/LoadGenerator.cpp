@@ -0,0 +1,211 @@
+#include <boost/program_options.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <thread>
+#include <vector>
+#include "orchestrator/RpcClient.h"
+#include "orchestrator/ShmClient.h"
+
+using namespace orchestrator;
+
+namespace
+{
+
+struct WorkerResult
+{
+    uint64_t              numRequests{0};
+    uint64_t              numErrors{0};
+    std::vector<uint64_t> batchMicros;
+};
+
+std::string requestPayload(rpc::Method method)
+{
+    std::string payload;
+    if (method == rpc::Method::PUSH)
+    {
+        Job job;
+        job.inputs = {"loadgen"};
+        rpc::Writer(payload).job(job);
+    }
+    return payload;
+}
+
+// Keep one connection saturated with back-to-back batches of pipelined requests until told to stop
+template<typename Client>
+void runWorker(Client&                 client,
+               rpc::Method             method,
+               size_t                  pipelineDepth,
+               const std::atomic_bool& stopping,
+               WorkerResult&           result)
+{
+    const auto payload = requestPayload(method);
+    while (!stopping)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        for (size_t k = 0; k < pipelineDepth; k++)
+        {
+            client.send(method, payload);
+        }
+        client.flush();
+        for (size_t k = 0; k < pipelineDepth; k++)
+        {
+            if (client.receive().code != static_cast<uint8_t>(rpc::Status::OK))
+            {
+                result.numErrors++;
+            }
+        }
+        result.numRequests += pipelineDepth;
+        result.batchMicros.push_back(static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count()));
+    }
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    uint32_t    port_number     = 4444;
+    uint32_t    num_connections = 4;
+    uint32_t    pipeline_depth  = 32;
+    uint32_t    num_seconds     = 5;
+    std::string method_name     = "query";
+    std::string socket_path;
+    bool        use_shm = false;
+
+    boost::program_options::options_description args_desc("Options");
+    // clang-format off
+    args_desc.add_options()
+        ("help,h", "print usage")
+        ("port,p", boost::program_options::value<uint32_t>(), "Port orchestratord serves requests on")
+        ("connections,c", boost::program_options::value<uint32_t>(), "Number of concurrent connections")
+        ("pipeline,d", boost::program_options::value<uint32_t>(), "Requests in flight per connection")
+        ("seconds,s", boost::program_options::value<uint32_t>(), "How long to generate load for")
+        ("method,m", boost::program_options::value<std::string>(), "Request to send: push, query, or stats")
+        ("socket,u", boost::program_options::value<std::string>(), "Connect over a Unix-domain socket, not TCP")
+        ("shm", "Send requests through a shared-memory channel set up over --socket");
+    // clang-format on
+
+    boost::program_options::variables_map vm;
+    boost::program_options::store(boost::program_options::parse_command_line(argc, argv, args_desc), vm);
+    boost::program_options::notify(vm);
+
+    if (vm.count("help"))
+    {
+        std::cout << args_desc << std::endl;
+        return 0;
+    }
+
+    if (vm.count("port"))
+    {
+        port_number = vm["port"].as<uint32_t>();
+    }
+    if (vm.count("connections"))
+    {
+        num_connections = std::max(vm["connections"].as<uint32_t>(), 1u);
+    }
+    if (vm.count("pipeline"))
+    {
+        pipeline_depth = std::max(vm["pipeline"].as<uint32_t>(), 1u);
+    }
+    if (vm.count("seconds"))
+    {
+        num_seconds = vm["seconds"].as<uint32_t>();
+    }
+    if (vm.count("method"))
+    {
+        method_name = vm["method"].as<std::string>();
+    }
+    if (vm.count("socket"))
+    {
+        socket_path = vm["socket"].as<std::string>();
+    }
+    if (vm.count("shm"))
+    {
+        if (socket_path.empty())
+        {
+            std::cerr << "--shm needs --socket" << std::endl;
+            return 1;
+        }
+        use_shm = true;
+    }
+
+    rpc::Method method;
+    if (method_name == "push")
+    {
+        method = rpc::Method::PUSH;
+    }
+    else if (method_name == "query")
+    {
+        method = rpc::Method::QUERY_QUEUED;
+    }
+    else if (method_name == "stats")
+    {
+        method = rpc::Method::STATS;
+    }
+    else
+    {
+        std::cerr << "Unknown method " << method_name << std::endl;
+        return 1;
+    }
+
+    std::atomic_bool          stopping{false};
+    std::vector<WorkerResult> results(num_connections);
+    std::vector<std::thread>  workers;
+    const auto                start = std::chrono::steady_clock::now();
+    for (auto& result : results)
+    {
+        workers.emplace_back([&, method]() {
+            try
+            {
+                if (use_shm)
+                {
+                    rpc::ShmClient client(socket_path);
+                    runWorker(client, method, pipeline_depth, stopping, result);
+                }
+                else
+                {
+                    rpc::RpcClient client = socket_path.empty() ? rpc::RpcClient(static_cast<uint16_t>(port_number))
+                                                                : rpc::RpcClient(socket_path);
+                    runWorker(client, method, pipeline_depth, stopping, result);
+                }
+            }
+            catch (const std::exception& e)
+            {
+                std::cerr << "Connection failed: " << e.what() << std::endl;
+            }
+        });
+    }
+    std::this_thread::sleep_for(std::chrono::seconds(num_seconds));
+    stopping = true;
+    for (auto& worker : workers)
+    {
+        worker.join();
+    }
+    const double elapsedSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    uint64_t              numRequests = 0;
+    uint64_t              numErrors   = 0;
+    std::vector<uint64_t> batchMicros;
+    for (const auto& result : results)
+    {
+        numRequests += result.numRequests;
+        numErrors += result.numErrors;
+        batchMicros.insert(batchMicros.end(), result.batchMicros.begin(), result.batchMicros.end());
+    }
+    std::sort(batchMicros.begin(), batchMicros.end());
+    auto percentile = [&](double p) {
+        return batchMicros.empty() ? 0 : batchMicros[static_cast<size_t>(p / 100.0 * (batchMicros.size() - 1))];
+    };
+
+    // One machine-readable line per run
+    const auto transport = use_shm ? "shm" : (socket_path.empty() ? "tcp" : "unix");
+    std::cout << "transport=" << transport << " method=" << method_name << " connections=" << num_connections
+              << " pipeline=" << pipeline_depth << " seconds=" << elapsedSeconds << " requests=" << numRequests
+              << " errors=" << numErrors
+              << " requests_per_second=" << static_cast<uint64_t>(numRequests / elapsedSeconds)
+              << " batch_p50_us=" << percentile(50.0) << " batch_p99_us=" << percentile(99.0) << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,425 @@
+#include "orchestrator/OrchestratorApi.h"
+#include <algorithm>
+#include <chrono>
+#include <iterator>
+#include <stdexcept>
+
+namespace orchestrator
+{
+
+namespace
+{
+
+// How long NEXT_EVENTS waits for events before replying with none, so clients can tell a quiet queue from a dead one
+static constexpr std::chrono::seconds kNextEventsTimeout = std::chrono::seconds(1);
+// Keeps a reply to NEXT_EVENTS well within the maximum frame size
+static constexpr uint32_t kMaxEventsPerReply = 65536;
+// A subscription nobody has asked for events in this long is assumed to belong to a client that went away
+static constexpr std::chrono::seconds kAbandonedSubscriptionTimeout = std::chrono::seconds(60);
+// How often requests of any kind look for abandoned subscriptions
+static constexpr std::chrono::seconds kSubscriptionExpiryPeriod = std::chrono::seconds(1);
+// Largest chunk of a spilled output one READ_OUTPUT replies with, which keeps the reply well within the maximum frame
+// size and the server thread from copying much at a time
+static constexpr uint32_t kMaxOutputChunk = 4 << 20;
+
+rpc::PendingReply immediateReply(rpc::Status status, std::string payload)
+{
+    return [reply = rpc::Reply{status, std::move(payload)}]() { return std::optional<rpc::Reply>{reply}; };
+}
+
+/// @brief Hand an input to a service, replying with its encoded result once the service gets to it
+/// @param service Service that owns the input
+/// @param input Input to send
+/// @param encode Turns the input's result into a reply payload
+template<typename Service, typename InputT, typename Encode>
+rpc::PendingReply forward(Service& service, InputT input, Encode encode)
+{
+    auto future = std::make_shared<decltype(input.getFuture())>(input.getFuture());
+    if (!service->sendInput(std::move(input)))
+    {
+        return immediateReply(rpc::Status::ERROR, service->name() + " is too busy to take the request");
+    }
+    return [future, encode]() -> std::optional<rpc::Reply> {
+        if (future->wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+        {
+            return std::nullopt;
+        }
+        auto result = future->get();
+        if (std::holds_alternative<services::ErrorResult>(result))
+        {
+            return rpc::Reply{rpc::Status::ERROR, std::get<services::ErrorResult>(result).message};
+        }
+        std::string payload;
+        rpc::Writer writer(payload);
+        encode(writer, std::get<1>(result));
+        return rpc::Reply{rpc::Status::OK, std::move(payload)};
+    };
+}
+
+/// @brief Hand an input to every job queue shard, replying once all of them have answered
+/// @param shards Job queue shards
+/// @param makeInput Builds the input for a given shard index
+/// @param encode Turns the results of every shard, in shard order, into a reply payload
+template<typename MakeInput, typename Encode>
+rpc::PendingReply fanOut(const std::vector<std::shared_ptr<job_queue::JobQueue>>& shards,
+                         MakeInput                                                makeInput,
+                         Encode                                                   encode)
+{
+    using Future  = decltype(makeInput(size_t{0}).getFuture());
+    using ResultT = std::variant_alternative_t<1, decltype(std::declval<Future>().get())>;
+
+    auto futures = std::make_shared<std::vector<Future>>();
+    for (size_t k = 0; k < shards.size(); k++)
+    {
+        auto input = makeInput(k);
+        futures->push_back(input.getFuture());
+        if (!shards[k]->sendInput(std::move(input)))
+        {
+            return immediateReply(rpc::Status::ERROR, shards[k]->name() + " is too busy to take the request");
+        }
+    }
+    return [futures, encode]() -> std::optional<rpc::Reply> {
+        for (const auto& future : *futures)
+        {
+            if (future.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+            {
+                return std::nullopt;
+            }
+        }
+        std::vector<ResultT> results;
+        for (auto& future : *futures)
+        {
+            auto result = future.get();
+            if (std::holds_alternative<services::ErrorResult>(result))
+            {
+                return rpc::Reply{rpc::Status::ERROR, std::get<services::ErrorResult>(result).message};
+            }
+            results.push_back(std::move(std::get<1>(result)));
+        }
+        std::string payload;
+        rpc::Writer writer(payload);
+        encode(writer, results);
+        return rpc::Reply{rpc::Status::OK, std::move(payload)};
+    };
+}
+
+} // namespace
+
+OrchestratorApi::OrchestratorApi(std::vector<std::shared_ptr<job_queue::JobQueue>> jobQueues,
+                                 std::shared_ptr<job_queue::ShardRouter>           shardRouter,
+                                 std::shared_ptr<job_executor::JobExecutor>        jobExecutor,
+                                 std::shared_ptr<job_database::JobDatabase>        jobDatabase,
+                                 std::shared_ptr<agents::AgentPool>                agentPool,
+                                 std::shared_ptr<outputs::OutputStore>             outputStore)
+    : mJobQueues(std::move(jobQueues))
+    , mShardRouter(std::move(shardRouter))
+    , mJobExecutor(std::move(jobExecutor))
+    , mJobDatabase(std::move(jobDatabase))
+    , mAgentPool(std::move(agentPool))
+    , mOutputStore(std::move(outputStore))
+{
+    if (mJobQueues.size() != mShardRouter->numShards())
+    {
+        throw std::invalid_argument("There must be exactly one job queue per shard");
+    }
+}
+
+/// @brief Set how to get the server to poll pending replies again, so that NEXT_EVENTS replies go out as soon as there
+/// are events rather than whenever the server next gets around to polling
+/// @param wakeServer Called from the queues' threads, e.g. RpcServer::wake()
+void OrchestratorApi::setWakeCallback(std::function<void()> wakeServer)
+{
+    mWakeServer = std::move(wakeServer);
+}
+
+/// @brief Decode a request and forward it to the service that owns it
+/// @param request Request frame
+/// @return Reply that becomes ready once the service has answered
+rpc::PendingReply OrchestratorApi::handle(rpc::Frame& request)
+{
+    auto encodeId   = [](rpc::Writer& w, const result::JobIdResult& r) { w.i64(r.id); };
+    auto encodeJobs = [](rpc::Writer& w, std::vector<result::JobsListResult>& results) {
+        std::vector<Job> jobs;
+        for (auto& shardJobs : results)
+        {
+            std::move(shardJobs.jobs.begin(), shardJobs.jobs.end(), std::back_inserter(jobs));
+        }
+        w.jobs(jobs);
+    };
+
+    expireSubscriptions();
+
+    rpc::Reader reader(request.payload);
+    switch (static_cast<rpc::Method>(request.code))
+    {
+    case rpc::Method::PUSH:
+    {
+        job_queue::PushInput pushInput;
+        pushInput.job = reader.job();
+        return forward(mJobQueues[mShardRouter->shardFor(pushInput.job)], std::move(pushInput), encodeId);
+    }
+    case rpc::Method::SCHEDULE:
+    {
+        job_queue::ScheduleInput scheduleInput;
+        scheduleInput.job              = reader.job();
+        scheduleInput.startTimeSeconds = reader.i64();
+        scheduleInput.periodSeconds    = reader.i64();
+        return forward(mJobQueues[mShardRouter->shardFor(scheduleInput.job)], std::move(scheduleInput), encodeId);
+    }
+    case rpc::Method::CANCEL:
+    {
+        job_queue::CancelInput cancelInput;
+        cancelInput.id = reader.i64();
+        auto& shard    = mJobQueues[mShardRouter->shardOf(cancelInput.id)];
+        return forward(shard, std::move(cancelInput), [](rpc::Writer& w, const result::JobIdsListResult& r) {
+            w.ids(r.ids);
+        });
+    }
+    case rpc::Method::QUERY_QUEUED:
+        return fanOut(
+            mJobQueues,
+            [](size_t) {
+                job_queue::QueryInput queryInput;
+                queryInput.query = job_queue::QueryInput::GetAllQueuedJobs{};
+                return queryInput;
+            },
+            encodeJobs);
+    case rpc::Method::QUERY_ARCHIVED:
+        return fanOut(
+            mJobQueues,
+            [](size_t) {
+                job_queue::QueryInput queryInput;
+                queryInput.query = job_queue::QueryInput::GetArchivedJobs{};
+                return queryInput;
+            },
+            encodeJobs);
+    case rpc::Method::TOGGLE_PAUSE:
+        return fanOut(
+            mJobQueues,
+            [](size_t) { return job_queue::TogglePauseInput{}; },
+            [](rpc::Writer& w, const std::vector<result::BooleanResult>& results) {
+                w.u8(std::ranges::all_of(results, &result::BooleanResult::result) ? 1 : 0);
+            });
+    case rpc::Method::STATS:
+        return statsDump();
+    case rpc::Method::ATTACH_SHM:
+        // Handled by the server itself
+        break;
+    case rpc::Method::SUBSCRIBE:
+    {
+        const auto filter   = reader.filter();
+        const auto capacity = reader.u32();
+        // Every shard gets its own subscription, and NEXT_EVENTS merges their streams
+        auto makeSubscribeInput = [&](size_t) {
+            job_queue::SubscribeInput subscribeInput;
+            subscribeInput.filter   = filter;
+            subscribeInput.capacity = capacity;
+            return subscribeInput;
+        };
+        auto encodeSubscription = [this](rpc::Writer& w, std::vector<result::SubscriptionResult>& results) {
+            auto published = std::make_shared<std::atomic_bool>(false);
+            for (auto& shardSubscription : results)
+            {
+                shardSubscription.stream->setListener([published, wakeServer = mWakeServer]() {
+                    published->store(true);
+                    if (wakeServer)
+                    {
+                        wakeServer();
+                    }
+                });
+            }
+            auto id = ++mLastSubscriptionId;
+            mSubscriptions[id] =
+                RpcSubscription{std::move(results), std::chrono::steady_clock::now(), std::move(published)};
+            w.i64(id);
+        };
+        return fanOut(mJobQueues, makeSubscribeInput, encodeSubscription);
+    }
+    case rpc::Method::NEXT_EVENTS:
+    {
+        const auto subscriptionId = reader.i64();
+        const auto maxEvents      = reader.u32();
+        return nextEvents(subscriptionId,
+                          maxEvents == 0 ? kMaxEventsPerReply : std::min(maxEvents, kMaxEventsPerReply));
+    }
+    case rpc::Method::UNSUBSCRIBE:
+    {
+        const auto subscriptionId = reader.i64();
+        auto       subscriptionIt = mSubscriptions.find(subscriptionId);
+        if (subscriptionIt == mSubscriptions.end())
+        {
+            return immediateReply(rpc::Status::ERROR, "No subscription has the requested ID");
+        }
+        auto makeUnsubscribeInput = [&shardSubscriptions = subscriptionIt->second.shardSubscriptions](size_t k) {
+            job_queue::UnsubscribeInput unsubscribeInput;
+            unsubscribeInput.id = shardSubscriptions[k].id;
+            return unsubscribeInput;
+        };
+        auto encodeUnsubscription = [this, subscriptionId](rpc::Writer&, const std::vector<result::BooleanResult>&) {
+            mSubscriptions.erase(subscriptionId);
+        };
+        return fanOut(mJobQueues, makeUnsubscribeInput, encodeUnsubscription);
+    }
+    case rpc::Method::AGENT_REGISTER:
+    case rpc::Method::AGENT_POLL:
+        if (!mAgentPool)
+        {
+            return immediateReply(rpc::Status::ERROR, "Jobs are not being run on worker agents");
+        }
+        return mAgentPool->handle(request);
+    case rpc::Method::READ_OUTPUT:
+    {
+        const auto handle   = reader.string();
+        const auto offset   = reader.i64();
+        const auto maxBytes = std::min(reader.u32(), kMaxOutputChunk);
+        if (!mOutputStore)
+        {
+            return immediateReply(rpc::Status::ERROR, "Outputs are not being spilled to disk");
+        }
+        if (offset < 0)
+        {
+            return immediateReply(rpc::Status::ERROR, "Offset must not be negative");
+        }
+        try
+        {
+            std::string payload;
+            rpc::Writer writer(payload);
+            writer.string(mOutputStore->read(handle, static_cast<size_t>(offset), maxBytes));
+            return immediateReply(rpc::Status::OK, std::move(payload));
+        }
+        catch (const std::exception& e)
+        {
+            return immediateReply(rpc::Status::ERROR, e.what());
+        }
+    }
+    }
+    throw std::runtime_error("Unknown RPC method");
+}
+
+/// @brief Hand over a subscription's buffered events, waiting a while for some if there are none yet
+/// @param subscriptionId Subscription made through SUBSCRIBE
+/// @param maxEvents Most events to reply with
+/// @return Reply that becomes ready once there are events, the subscription is closed, or the wait times out
+rpc::PendingReply OrchestratorApi::nextEvents(int64_t subscriptionId, size_t maxEvents)
+{
+    auto subscriptionIt = mSubscriptions.find(subscriptionId);
+    if (subscriptionIt == mSubscriptions.end())
+    {
+        return immediateReply(rpc::Status::ERROR, "No subscription has the requested ID");
+    }
+
+    auto       shardSubscriptions     = subscriptionIt->second.shardSubscriptions;
+    auto       published              = subscriptionIt->second.published;
+    const auto deadline               = std::chrono::steady_clock::now() + kNextEventsTimeout;
+    subscriptionIt->second.lastPolled = std::chrono::steady_clock::now();
+    // Events may be left over from before, e.g. beyond what the previous reply could hold, so look at least once
+    published->store(true);
+    return [this, subscriptionId, shardSubscriptions, published, maxEvents, deadline]() -> std::optional<rpc::Reply> {
+        // Rather than taking every stream's lock each time the server polls, only look once the streams have said
+        // there is something to take; the flag is cleared before looking, so a publish racing with the look isn't lost
+        const auto now = std::chrono::steady_clock::now();
+        if (now < deadline)
+        {
+            if (!published->exchange(false))
+            {
+                return std::nullopt;
+            }
+            const bool ready = std::ranges::any_of(shardSubscriptions, [](const auto& shardSubscription) {
+                return shardSubscription.stream->ready();
+            });
+            if (!ready)
+            {
+                return std::nullopt;
+            }
+        }
+
+        events::EventBatch batch;
+        batch.closed = true;
+        for (const auto& shardSubscription : shardSubscriptions)
+        {
+            auto shardBatch = shardSubscription.stream->take(maxEvents - batch.events.size());
+            std::move(shardBatch.events.begin(), shardBatch.events.end(), std::back_inserter(batch.events));
+            batch.numDropped += shardBatch.numDropped;
+            batch.closed = batch.closed && shardBatch.closed;
+        }
+        // Shards are independent, so interleaving their events by time is as ordered as they get
+        std::ranges::stable_sort(batch.events, {}, &events::JobEvent::timestampMicros);
+
+        auto subscriptionIt = mSubscriptions.find(subscriptionId);
+        if (subscriptionIt != mSubscriptions.end())
+        {
+            subscriptionIt->second.lastPolled = now;
+            // Once a closed stream has been drained, there is nothing left to hold on to it for
+            if (batch.closed)
+            {
+                mSubscriptions.erase(subscriptionIt);
+            }
+        }
+        std::string payload;
+        rpc::Writer writer(payload);
+        writer.i64(static_cast<int64_t>(batch.numDropped));
+        writer.u8(batch.closed ? 1 : 0);
+        writer.jobEvents(batch.events);
+        return rpc::Reply{rpc::Status::OK, std::move(payload)};
+    };
+}
+
+/// @brief Let go of subscriptions whose clients have stopped asking for events, so the queue stops feeding them; does
+/// nothing if it was done less than kSubscriptionExpiryPeriod ago
+void OrchestratorApi::expireSubscriptions()
+{
+    const auto now = std::chrono::steady_clock::now();
+    if (now - mLastExpiry < kSubscriptionExpiryPeriod)
+    {
+        return;
+    }
+    mLastExpiry = now;
+    std::erase_if(mSubscriptions, [&](const auto& subscription) {
+        return now - subscription.second.lastPolled > kAbandonedSubscriptionTimeout;
+    });
+}
+
+/// @brief Gather every service's metrics into one text dump
+/// @return Reply that becomes ready once all services have answered
+rpc::PendingReply OrchestratorApi::statsDump()
+{
+    using StatsFuture = std::future<std::variant<services::ErrorResult, result::StatsResult>>;
+
+    std::vector<std::pair<std::string, std::shared_ptr<StatsFuture>>> serviceStats;
+    auto requestStats = [&](auto& service, auto statsInput) {
+        auto future = std::make_shared<StatsFuture>(statsInput.getFuture());
+        if (service->sendInput(std::move(statsInput)))
+        {
+            serviceStats.emplace_back(service->name(), std::move(future));
+        }
+    };
+    for (auto& jobQueue : mJobQueues)
+    {
+        requestStats(jobQueue, job_queue::StatsInput{});
+    }
+    requestStats(mJobExecutor, job_executor::StatsInput{});
+    requestStats(mJobDatabase, job_database::StatsInput{});
+
+    return [serviceStats]() -> std::optional<rpc::Reply> {
+        for (const auto& [serviceName, future] : serviceStats)
+        {
+            if (future->wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+            {
+                return std::nullopt;
+            }
+        }
+        // A service too busy to answer is left out of the dump rather than failing it
+        std::string dump;
+        for (const auto& [serviceName, future] : serviceStats)
+        {
+            auto statsResult = future->get();
+            if (std::holds_alternative<result::StatsResult>(statsResult))
+            {
+                dump += stats::formatMetrics(serviceName, std::get<result::StatsResult>(statsResult).metrics);
+            }
+        }
+        return rpc::Reply{rpc::Status::OK, std::move(dump)};
+    };
+}
+
+} // end namespace orchestrator
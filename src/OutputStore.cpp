@@ -0,0 +1,447 @@
+#include "orchestrator/OutputStore.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <charconv>
+#include <filesystem>
+#include <stdexcept>
+#include <system_error>
+#include <utility>
+
+namespace orchestrator
+{
+
+namespace outputs
+{
+
+namespace
+{
+
+// Handles are the prefix, then the SHA-256 of the content in hex, a dash, and the content's size in bytes
+static constexpr size_t kHashDigits = 64;
+
+// Tells apart the temporary files of concurrent spills, which are renamed into place once written in full
+std::atomic_uint64_t gNextTemporaryId{0};
+
+// SHA-256 (FIPS 180-4). Outputs are deduplicated by name alone, so the name has to be collision resistant; a 64-bit
+// hash would sooner or later hand a dependent some other job's output.
+class Sha256
+{
+public:
+    void update(std::string_view data)
+    {
+        mLength += data.size();
+        for (const char c : data)
+        {
+            mBlock[mBlockSize++] = static_cast<uint8_t>(c);
+            if (mBlockSize == mBlock.size())
+            {
+                compress();
+                mBlockSize = 0;
+            }
+        }
+    }
+
+    std::string hexDigest()
+    {
+        static constexpr char kDigits[] = "0123456789abcdef";
+
+        const uint64_t lengthBits = mLength * 8;
+        mBlock[mBlockSize++]      = 0x80;
+        if (mBlockSize > 56)
+        {
+            std::fill(mBlock.begin() + mBlockSize, mBlock.end(), 0);
+            compress();
+            mBlockSize = 0;
+        }
+        std::fill(mBlock.begin() + mBlockSize, mBlock.begin() + 56, 0);
+        for (size_t k = 0; k < 8; k++)
+        {
+            mBlock[63 - k] = static_cast<uint8_t>(lengthBits >> (8 * k));
+        }
+        compress();
+
+        std::string hex;
+        hex.reserve(kHashDigits);
+        for (const uint32_t word : mState)
+        {
+            for (int shift = 28; shift >= 0; shift -= 4)
+            {
+                hex.push_back(kDigits[(word >> shift) & 0xf]);
+            }
+        }
+        return hex;
+    }
+
+private:
+    static uint32_t rotr(uint32_t x, int n)
+    {
+        return (x >> n) | (x << (32 - n));
+    }
+
+    void compress()
+    {
+        static constexpr std::array<uint32_t, 64> kRoundConstants{
+            0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+            0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+            0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+            0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+            0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+            0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+            0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+            0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+
+        std::array<uint32_t, 64> w{};
+        for (size_t k = 0; k < 16; k++)
+        {
+            w[k] = (uint32_t{mBlock[4 * k]} << 24) | (uint32_t{mBlock[4 * k + 1]} << 16) |
+                   (uint32_t{mBlock[4 * k + 2]} << 8) | uint32_t{mBlock[4 * k + 3]};
+        }
+        for (size_t k = 16; k < 64; k++)
+        {
+            const uint32_t s0 = rotr(w[k - 15], 7) ^ rotr(w[k - 15], 18) ^ (w[k - 15] >> 3);
+            const uint32_t s1 = rotr(w[k - 2], 17) ^ rotr(w[k - 2], 19) ^ (w[k - 2] >> 10);
+            w[k]              = w[k - 16] + s0 + w[k - 7] + s1;
+        }
+
+        auto [a, b, c, d, e, f, g, h] = mState;
+        for (size_t k = 0; k < 64; k++)
+        {
+            const uint32_t t1 = h + (rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25)) + ((e & f) ^ (~e & g)) +
+                                kRoundConstants[k] + w[k];
+            const uint32_t t2 = (rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+            h                 = g;
+            g                 = f;
+            f                 = e;
+            e                 = d + t1;
+            d                 = c;
+            c                 = b;
+            b                 = a;
+            a                 = t1 + t2;
+        }
+        const std::array<uint32_t, 8> rounds{a, b, c, d, e, f, g, h};
+        for (size_t k = 0; k < mState.size(); k++)
+        {
+            mState[k] += rounds[k];
+        }
+    }
+
+    std::array<uint32_t, 8> mState{
+        0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+    std::array<uint8_t, 64> mBlock{};
+    size_t                  mBlockSize{0};
+    uint64_t                mLength{0};
+};
+
+std::string hexHash(std::string_view content)
+{
+    Sha256 sha256;
+    sha256.update(content);
+    return sha256.hexDigest();
+}
+
+[[noreturn]] void throwErrno(const std::string& what)
+{
+    throw std::system_error(errno, std::generic_category(), what);
+}
+
+} // namespace
+
+MappedOutput::MappedOutput(const void* data, size_t size) : mData(data), mSize(size) {}
+
+MappedOutput::MappedOutput(MappedOutput&& other) noexcept
+    : mData(std::exchange(other.mData, nullptr)), mSize(std::exchange(other.mSize, 0))
+{
+}
+
+MappedOutput& MappedOutput::operator=(MappedOutput&& other) noexcept
+{
+    if (this != &other)
+    {
+        if (mData != nullptr)
+        {
+            munmap(const_cast<void*>(mData), mSize);
+        }
+        mData = std::exchange(other.mData, nullptr);
+        mSize = std::exchange(other.mSize, 0);
+    }
+    return *this;
+}
+
+MappedOutput::~MappedOutput()
+{
+    if (mData != nullptr)
+    {
+        munmap(const_cast<void*>(mData), mSize);
+    }
+}
+
+std::string_view MappedOutput::view() const
+{
+    return mData != nullptr ? std::string_view(static_cast<const char*>(mData), mSize) : std::string_view();
+}
+
+/// @brief Open (creating if need be) a store in a directory
+/// @param directory Where spilled outputs are written
+/// @param spillThresholdBytes Size from which outputs are spilled rather than kept in memory
+OutputStore::OutputStore(std::string directory, size_t spillThresholdBytes)
+    : mDirectory(std::move(directory)), mSpillThreshold(std::max<size_t>(spillThresholdBytes, 1))
+{
+    std::filesystem::create_directories(mDirectory);
+}
+
+/// @brief Whether a job input is a handle to a spilled output rather than the output itself
+bool OutputStore::isHandle(std::string_view input)
+{
+    if (!input.starts_with(kHandlePrefix))
+    {
+        return false;
+    }
+    input.remove_prefix(kHandlePrefix.size());
+    if (input.size() < kHashDigits + 2 || input[kHashDigits] != '-')
+    {
+        return false;
+    }
+    auto isHexDigit = [](char c) { return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f'); };
+    auto isDigit    = [](char c) { return c >= '0' && c <= '9'; };
+    return std::all_of(input.begin(), input.begin() + kHashDigits, isHexDigit) &&
+           std::all_of(input.begin() + kHashDigits + 1, input.end(), isDigit);
+}
+
+/// @brief Size of the output a handle stands in for, without touching the disk
+/// @param input Job input
+/// @return Size in bytes, or nothing if the input isn't a handle
+std::optional<size_t> OutputStore::spilledSize(std::string_view input)
+{
+    if (!isHandle(input))
+    {
+        return std::nullopt;
+    }
+    const auto sizeDigits = input.substr(kHandlePrefix.size() + kHashDigits + 1);
+    size_t     size       = 0;
+    if (std::from_chars(sizeDigits.data(), sizeDigits.data() + sizeDigits.size(), size).ec != std::errc())
+    {
+        return std::nullopt;
+    }
+    return size;
+}
+
+const std::string& OutputStore::directory() const
+{
+    return mDirectory;
+}
+
+size_t OutputStore::spillThreshold() const
+{
+    return mSpillThreshold;
+}
+
+/// @brief Whether any of a job's outputs is large enough to be spilled and hasn't been yet
+/// @param outputs A job's outputs
+bool OutputStore::hasLarge(const std::vector<std::string>& outputs) const
+{
+    return std::any_of(outputs.begin(), outputs.end(), [this](const std::string& output) {
+        return output.size() >= mSpillThreshold && !isHandle(output);
+    });
+}
+
+/// @brief Write an output to disk under the SHA-256 of its content, unless identical content already is
+/// @param output Output to spill
+/// @return Handle to pass around in the output's place, holding a reference to the file for the caller to release;
+/// throws std::system_error if the output can't be written
+std::string OutputStore::spill(std::string_view output)
+{
+    auto       handle = std::string(kHandlePrefix) + hexHash(output) + "-" + std::to_string(output.size());
+    const auto path   = pathOf(handle);
+    {
+        // The name is a SHA-256 of the content, so a file of the right size under it holds that content; one of any
+        // other size was left behind by something else and is written over
+        std::lock_guard lock(mReferencesMutex);
+        struct stat     status{};
+        if (stat(path.c_str(), &status) == 0 && static_cast<size_t>(status.st_size) == output.size())
+        {
+            mReferences[handle]++;
+            mStats.duplicates++;
+            return handle;
+        }
+    }
+
+    // Readers must never see a partly written output, so it only takes its final name once complete
+    const auto temporaryPath = path + ".tmp-" + std::to_string(gNextTemporaryId++);
+    const int  fd            = ::open(temporaryPath.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+    if (fd < 0)
+    {
+        throwErrno("Failed to create " + temporaryPath);
+    }
+    for (size_t written = 0; written < output.size();)
+    {
+        const auto numWritten = write(fd, output.data() + written, output.size() - written);
+        if (numWritten < 0 && errno != EINTR)
+        {
+            const int error = errno;
+            close(fd);
+            unlink(temporaryPath.c_str());
+            throw std::system_error(error, std::generic_category(), "Failed to write " + temporaryPath);
+        }
+        written += static_cast<size_t>(std::max<ssize_t>(numWritten, 0));
+    }
+    close(fd);
+
+    std::lock_guard lock(mReferencesMutex);
+    if (rename(temporaryPath.c_str(), path.c_str()) < 0)
+    {
+        const int error = errno;
+        unlink(temporaryPath.c_str());
+        throw std::system_error(error, std::generic_category(), "Failed to rename " + temporaryPath);
+    }
+    mReferences[handle]++;
+    mStats.spills++;
+    mStats.spilledBytes += output.size();
+    return handle;
+}
+
+/// @brief Replace every output at or above the threshold with a handle, keeping any that fail to spill in memory
+/// @param outputs A job's outputs
+/// @return Handles of the outputs spilled, each holding a reference for the caller to release
+std::vector<std::string> OutputStore::spillLarge(std::vector<std::string>& outputs)
+{
+    std::vector<std::string> handles;
+    for (auto& output : outputs)
+    {
+        if (output.size() < mSpillThreshold || isHandle(output))
+        {
+            continue;
+        }
+        try
+        {
+            output = spill(output);
+            handles.push_back(output);
+        }
+        catch (const std::exception&)
+        {
+            mStats.failures++;
+        }
+    }
+    return handles;
+}
+
+/// @brief Take a reference to the file behind every handle among some inputs (or outputs), keeping it on disk
+/// @param inputs Inputs, of which only handles count
+void OutputStore::retain(const std::vector<std::string>& inputs)
+{
+    std::lock_guard lock(mReferencesMutex);
+    for (const auto& input : inputs)
+    {
+        if (isHandle(input))
+        {
+            mReferences[input]++;
+        }
+    }
+}
+
+/// @brief Give up references taken by spill() or retain(), removing every file nothing refers to anymore
+/// @param inputs Inputs, of which only handles count
+void OutputStore::release(const std::vector<std::string>& inputs)
+{
+    std::lock_guard lock(mReferencesMutex);
+    for (const auto& input : inputs)
+    {
+        auto referencesIt = isHandle(input) ? mReferences.find(input) : mReferences.end();
+        if (referencesIt == mReferences.end() || --referencesIt->second > 0)
+        {
+            continue;
+        }
+        mReferences.erase(referencesIt);
+        // Outputs already mapped stay readable until unmapped
+        if (unlink(pathOf(input).c_str()) == 0)
+        {
+            mStats.removals++;
+        }
+    }
+}
+
+/// @brief Map a spilled output into memory
+/// @param handle Handle to the output
+/// @return Mapping of the output; throws std::invalid_argument if the handle is malformed and std::system_error if it
+/// names no stored output
+MappedOutput OutputStore::open(std::string_view handle) const
+{
+    const auto size = spilledSize(handle);
+    if (!size)
+    {
+        throw std::invalid_argument("Not a handle to a spilled output");
+    }
+    const auto path = pathOf(handle);
+    const int  fd   = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        throwErrno("Failed to open " + path);
+    }
+    struct stat status{};
+    if (fstat(fd, &status) < 0 || static_cast<size_t>(status.st_size) != *size)
+    {
+        close(fd);
+        throw std::system_error(EIO, std::generic_category(), "Spilled output " + path + " is truncated");
+    }
+    if (*size == 0)
+    {
+        close(fd);
+        return MappedOutput();
+    }
+    void* data = mmap(nullptr, *size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+    {
+        throwErrno("Failed to map " + path);
+    }
+    madvise(data, *size, MADV_SEQUENTIAL);
+    return MappedOutput(data, *size);
+}
+
+/// @brief Copy out one chunk of a spilled output, e.g. for a client reading it piece by piece
+/// @param handle Handle to the output
+/// @param offset Where in the output the chunk starts
+/// @param maxBytes Largest chunk to read
+/// @return The chunk, empty past the end of the output; throws like open()
+std::string OutputStore::read(std::string_view handle, size_t offset, size_t maxBytes) const
+{
+    const auto mapped = open(handle);
+    const auto view   = mapped.view();
+    return offset < view.size() ? std::string(view.substr(offset, maxBytes)) : std::string();
+}
+
+/// @brief Resolve a job input into its content, reading it back in if it was spilled
+/// @param input Job input, a handle or not
+/// @return The input's content; throws like open()
+std::string OutputStore::load(const std::string& input) const
+{
+    if (!isHandle(input))
+    {
+        return input;
+    }
+    return std::string(open(input).view());
+}
+
+/// @brief Add the store's instrumentation to a service's metrics
+void OutputStore::addStats(std::map<std::string, int64_t>& metrics) const
+{
+    metrics["output_store.spills"]        = static_cast<int64_t>(mStats.spills.load());
+    metrics["output_store.spilled_bytes"] = static_cast<int64_t>(mStats.spilledBytes.load());
+    metrics["output_store.duplicates"]    = static_cast<int64_t>(mStats.duplicates.load());
+    metrics["output_store.failures"]      = static_cast<int64_t>(mStats.failures.load());
+    metrics["output_store.removals"]      = static_cast<int64_t>(mStats.removals.load());
+}
+
+/// @brief Where the output a (well-formed) handle names lives, which nothing in the handle can steer outside the store
+std::string OutputStore::pathOf(std::string_view handle) const
+{
+    return mDirectory + "/" + std::string(handle.substr(kHandlePrefix.size()));
+}
+
+} // namespace outputs
+
+} // end namespace orchestrator
@@ -0,0 +1,174 @@
+#include "orchestrator/ResultCache.h"
+#include <iterator>
+
+namespace orchestrator
+{
+
+/// @brief Compute a content address for a job from its inputs
+/// @param inputs Job inputs to hash
+/// @return 64-bit FNV-1a hash of the length-prefixed inputs
+uint64_t ResultCache::hashInputs(const std::vector<std::string>& inputs)
+{
+    static constexpr uint64_t kFnvOffsetBasis = 14695981039346656037ULL;
+    static constexpr uint64_t kFnvPrime       = 1099511628211ULL;
+
+    uint64_t hash  = kFnvOffsetBasis;
+    auto     mixIn = [&](const char* data, size_t size) {
+        for (size_t k = 0; k < size; k++)
+        {
+            hash ^= static_cast<uint8_t>(data[k]);
+            hash *= kFnvPrime;
+        }
+    };
+    // Length prefixes keep e.g. {"ab", "c"} and {"a", "bc"} apart
+    for (const auto& input : inputs)
+    {
+        const uint64_t inputSize = input.size();
+        mixIn(reinterpret_cast<const char*>(&inputSize), sizeof(inputSize));
+        mixIn(input.data(), input.size());
+    }
+    return hash;
+}
+
+/// @brief Build the cache key of a job
+/// @param kind Job kind; the same inputs mean different things to different kinds
+/// @param inputs Job inputs
+/// @return Key carrying the kind, the inputs, and their hash
+ResultCacheKey ResultCache::keyOf(uint32_t kind, const std::vector<std::string>& inputs)
+{
+    static constexpr uint64_t kGoldenRatio = 0x9e3779b97f4a7c15ULL;
+
+    return ResultCacheKey{.hash = hashInputs(inputs) ^ (kind * kGoldenRatio), .kind = kind, .inputs = inputs};
+}
+
+/// @brief Only successful results made of plain outputs can be replayed for another job; spawned child jobs can't
+/// @param jobResult Result to check
+/// @return Whether the result may be cached
+bool ResultCache::isCacheable(const result::JobResult& jobResult)
+{
+    return jobResult.resultStatus != aapis::orchestrator::v1::JobStatus::JOB_STATUS_ERROR &&
+           std::holds_alternative<std::vector<std::string>>(jobResult.outputs);
+}
+
+/// @brief Create a cache
+/// @param capacityBytes Memory budget; zero (the default) leaves the cache disabled until setCapacity()
+ResultCache::ResultCache(size_t capacityBytes)
+{
+    mStats.capacityBytes = capacityBytes;
+}
+
+size_t ResultCache::numEntries() const
+{
+    return mEntries.size();
+}
+
+bool ResultCache::enabled() const
+{
+    return mStats.capacityBytes > 0;
+}
+
+/// @brief Change the memory budget of the cache, evicting entries as necessary
+/// @param capacityBytes New memory budget; zero disables the cache
+/// @return Evicted entries, least recently used first
+std::vector<ResultCache::Entry> ResultCache::setCapacity(size_t capacityBytes)
+{
+    mStats.capacityBytes = capacityBytes;
+    return evictToCapacity();
+}
+
+/// @brief Look up the result previously produced for a given key, marking it as most recently used
+/// @param key Key of the job about to run
+/// @return The cached result, if any
+std::optional<result::JobResult> ResultCache::lookup(const ResultCacheKey& key)
+{
+    auto indexIt = mIndex.find(key.hash);
+    if (indexIt == mIndex.end() || indexIt->second->first != key)
+    {
+        mStats.collisions += indexIt != mIndex.end();
+        mStats.misses++;
+        return std::nullopt;
+    }
+    mStats.hits++;
+    mEntries.splice(mEntries.begin(), mEntries, indexIt->second);
+    return indexIt->second->second;
+}
+
+/// @brief Cache the result produced for a given key
+/// @param key Key of the job that produced the result; replaces any entry whose key has the same hash
+/// @param jobResult Result to cache; ignored if not cacheable or larger than the whole cache
+/// @return The entry replaced, if any, then the entries evicted to make room, least recently used first
+std::vector<ResultCache::Entry> ResultCache::insert(const ResultCacheKey& key, const result::JobResult& jobResult)
+{
+    if (!enabled() || !isCacheable(jobResult))
+    {
+        return {};
+    }
+    Entry entry{key, jobResult};
+    if (entryBytes(entry) > mStats.capacityBytes)
+    {
+        return {};
+    }
+
+    std::vector<Entry> removed;
+    auto               indexIt = mIndex.find(key.hash);
+    if (indexIt != mIndex.end())
+    {
+        mStats.sizeBytes -= entryBytes(*indexIt->second);
+        removed.push_back(std::move(*indexIt->second));
+        mEntries.erase(indexIt->second);
+    }
+    mStats.sizeBytes += entryBytes(entry);
+    mEntries.push_front(std::move(entry));
+    mIndex[key.hash] = mEntries.begin();
+
+    auto evicted = evictToCapacity();
+    std::move(evicted.begin(), evicted.end(), std::back_inserter(removed));
+    return removed;
+}
+
+/// @brief Whether a result is cached for a given key, without counting as a lookup or marking it as used
+bool ResultCache::contains(const ResultCacheKey& key) const
+{
+    auto indexIt = mIndex.find(key.hash);
+    return indexIt != mIndex.end() && indexIt->second->first == key;
+}
+
+void ResultCache::recordDiskHit()
+{
+    mStats.diskHits++;
+}
+
+const ResultCacheStats& ResultCache::stats() const
+{
+    return mStats;
+}
+
+size_t ResultCache::entryBytes(const Entry& entry)
+{
+    size_t bytes = sizeof(Entry);
+    for (const auto& input : entry.first.inputs)
+    {
+        bytes += sizeof(std::string) + input.size();
+    }
+    for (const auto& output : std::get<std::vector<std::string>>(entry.second.outputs))
+    {
+        bytes += sizeof(std::string) + output.size();
+    }
+    return bytes;
+}
+
+std::vector<ResultCache::Entry> ResultCache::evictToCapacity()
+{
+    std::vector<Entry> evicted;
+    while (mStats.sizeBytes > mStats.capacityBytes && !mEntries.empty())
+    {
+        mStats.sizeBytes -= entryBytes(mEntries.back());
+        mStats.evictions++;
+        mIndex.erase(mEntries.back().first.hash);
+        evicted.push_back(std::move(mEntries.back()));
+        mEntries.pop_back();
+    }
+    return evicted;
+}
+
+} // end namespace orchestrator
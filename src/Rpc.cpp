@@ -0,0 +1,292 @@
+#include "orchestrator/Rpc.h"
+#include <stdexcept>
+
+namespace orchestrator
+{
+
+namespace rpc
+{
+
+namespace
+{
+
+void putLittleEndian(std::string& out, uint64_t value, size_t numBytes)
+{
+    for (size_t k = 0; k < numBytes; k++)
+    {
+        out.push_back(static_cast<char>((value >> (8 * k)) & 0xff));
+    }
+}
+
+uint64_t getLittleEndian(std::string_view in, size_t numBytes)
+{
+    uint64_t value = 0;
+    for (size_t k = 0; k < numBytes; k++)
+    {
+        value |= static_cast<uint64_t>(static_cast<uint8_t>(in[k])) << (8 * k);
+    }
+    return value;
+}
+
+} // namespace
+
+/// @brief Append a whole frame to an outgoing buffer
+/// @param buffer Outgoing buffer, possibly already holding other frames
+/// @param requestId ID the reply is matched on
+/// @param code Method for requests, Status for replies
+/// @param payload Frame body
+void appendFrame(std::string& buffer, uint32_t requestId, uint8_t code, std::string_view payload)
+{
+    if (payload.size() > kMaxPayloadSize)
+    {
+        throw std::runtime_error("RPC payload exceeds the maximum frame size");
+    }
+    putLittleEndian(buffer, payload.size(), 4);
+    putLittleEndian(buffer, requestId, 4);
+    buffer.push_back(static_cast<char>(code));
+    buffer.append(payload);
+}
+
+/// @brief Parse the frame at the front of an incoming buffer
+/// @param buffer Received bytes
+/// @param frame Filled in with the parsed frame
+/// @return Number of bytes the frame took up, or 0 if it has not been received in full yet
+size_t parseFrame(std::string_view buffer, Frame& frame)
+{
+    if (buffer.size() < kHeaderSize)
+    {
+        return 0;
+    }
+    const auto payloadSize = static_cast<uint32_t>(getLittleEndian(buffer, 4));
+    if (payloadSize > kMaxPayloadSize)
+    {
+        throw std::runtime_error("RPC payload exceeds the maximum frame size");
+    }
+    if (buffer.size() < kHeaderSize + payloadSize)
+    {
+        return 0;
+    }
+    frame.requestId = static_cast<uint32_t>(getLittleEndian(buffer.substr(4), 4));
+    frame.code      = static_cast<uint8_t>(buffer[8]);
+    frame.payload.assign(buffer.substr(kHeaderSize, payloadSize));
+    return kHeaderSize + payloadSize;
+}
+
+void Writer::u8(uint8_t value)
+{
+    mOut.push_back(static_cast<char>(value));
+}
+
+void Writer::u32(uint32_t value)
+{
+    putLittleEndian(mOut, value, 4);
+}
+
+void Writer::i64(int64_t value)
+{
+    putLittleEndian(mOut, static_cast<uint64_t>(value), 8);
+}
+
+void Writer::string(std::string_view value)
+{
+    u32(static_cast<uint32_t>(value.size()));
+    mOut.append(value);
+}
+
+void Writer::strings(const std::vector<std::string>& values)
+{
+    u32(static_cast<uint32_t>(values.size()));
+    for (const auto& value : values)
+    {
+        string(value);
+    }
+}
+
+void Writer::ids(const std::vector<int64_t>& values)
+{
+    u32(static_cast<uint32_t>(values.size()));
+    for (auto value : values)
+    {
+        i64(value);
+    }
+}
+
+void Writer::job(const Job& job)
+{
+    i64(job.id);
+    u8(static_cast<uint8_t>(job.status));
+    i64(job.priority);
+    i64(job.workflowId);
+    u32(job.kind);
+    i64(job.spawnTimeSeconds);
+    i64(job.executionTimeSeconds);
+    i64(job.completionTimestampSeconds);
+    i64(job.deadlineSeconds);
+    i64(job.timeoutSeconds);
+    i64(job.maxRetries);
+    i64(job.numRetries);
+    ids(job.independentBlockers);
+    ids(job.relevantBlockers);
+    strings(job.inputs);
+}
+
+void Writer::jobs(const std::vector<Job>& jobs)
+{
+    u32(static_cast<uint32_t>(jobs.size()));
+    for (const auto& j : jobs)
+    {
+        job(j);
+    }
+}
+
+void Writer::filter(const events::SubscriptionFilter& filter)
+{
+    ids({filter.jobIds.begin(), filter.jobIds.end()});
+    ids({filter.priorities.begin(), filter.priorities.end()});
+    u32(static_cast<uint32_t>(filter.statuses.size()));
+    for (auto status : filter.statuses)
+    {
+        u8(static_cast<uint8_t>(status));
+    }
+}
+
+void Writer::jobEvents(const std::vector<events::JobEvent>& events)
+{
+    u32(static_cast<uint32_t>(events.size()));
+    for (const auto& event : events)
+    {
+        i64(event.jobId);
+        u8(static_cast<uint8_t>(event.status));
+        i64(event.priority);
+        i64(event.timestampMicros);
+    }
+}
+
+std::string_view Reader::take(size_t numBytes)
+{
+    if (mIn.size() < numBytes)
+    {
+        throw std::runtime_error("Truncated RPC payload");
+    }
+    auto bytes = mIn.substr(0, numBytes);
+    mIn.remove_prefix(numBytes);
+    return bytes;
+}
+
+size_t Reader::count()
+{
+    // Every element takes at least a byte, so a bogus count can't trigger a huge allocation
+    const auto numElements = u32();
+    if (numElements > mIn.size())
+    {
+        throw std::runtime_error("Truncated RPC payload");
+    }
+    return numElements;
+}
+
+uint8_t Reader::u8()
+{
+    return static_cast<uint8_t>(take(1)[0]);
+}
+
+uint32_t Reader::u32()
+{
+    return static_cast<uint32_t>(getLittleEndian(take(4), 4));
+}
+
+int64_t Reader::i64()
+{
+    return static_cast<int64_t>(getLittleEndian(take(8), 8));
+}
+
+std::string Reader::string()
+{
+    const auto size = u32();
+    return std::string(take(size));
+}
+
+std::vector<std::string> Reader::strings()
+{
+    std::vector<std::string> values(count());
+    for (auto& value : values)
+    {
+        value = string();
+    }
+    return values;
+}
+
+std::vector<int64_t> Reader::ids()
+{
+    std::vector<int64_t> values(count());
+    for (auto& value : values)
+    {
+        value = i64();
+    }
+    return values;
+}
+
+Job Reader::job()
+{
+    Job j;
+    j.id                         = i64();
+    j.status                     = static_cast<aapis::orchestrator::v1::JobStatus>(u8());
+    j.priority                   = i64();
+    j.workflowId                 = i64();
+    j.kind                       = u32();
+    j.spawnTimeSeconds           = i64();
+    j.executionTimeSeconds       = i64();
+    j.completionTimestampSeconds = i64();
+    j.deadlineSeconds            = i64();
+    j.timeoutSeconds             = i64();
+    j.maxRetries                 = i64();
+    j.numRetries                 = i64();
+    j.independentBlockers        = ids();
+    j.relevantBlockers           = ids();
+    j.inputs                     = strings();
+    return j;
+}
+
+std::vector<Job> Reader::jobs()
+{
+    std::vector<Job> values(count());
+    for (auto& value : values)
+    {
+        value = job();
+    }
+    return values;
+}
+
+events::SubscriptionFilter Reader::filter()
+{
+    events::SubscriptionFilter filter;
+    for (auto jobId : ids())
+    {
+        filter.jobIds.insert(jobId);
+    }
+    for (auto priority : ids())
+    {
+        filter.priorities.insert(priority);
+    }
+    for (auto numStatuses = count(); numStatuses > 0; numStatuses--)
+    {
+        filter.statuses.insert(static_cast<aapis::orchestrator::v1::JobStatus>(u8()));
+    }
+    return filter;
+}
+
+std::vector<events::JobEvent> Reader::jobEvents()
+{
+    std::vector<events::JobEvent> values(count());
+    for (auto& value : values)
+    {
+        value.jobId           = i64();
+        value.status          = static_cast<aapis::orchestrator::v1::JobStatus>(u8());
+        value.priority        = i64();
+        value.timestampMicros = i64();
+    }
+    return values;
+}
+
+} // namespace rpc
+
+} // end namespace orchestrator
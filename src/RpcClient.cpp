@@ -0,0 +1,191 @@
+#include "orchestrator/RpcClient.h"
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <stdexcept>
+#include <system_error>
+
+namespace orchestrator
+{
+
+namespace rpc
+{
+
+/// @brief Connect to a server on the loopback interface
+/// @param port Port the server listens on
+RpcClient::RpcClient(uint16_t port) : RpcClient("127.0.0.1", port)
+{
+}
+
+/// @brief Connect to a server on another host
+/// @param host IPv4 address of the server, in dotted-decimal notation
+/// @param port Port the server listens on
+RpcClient::RpcClient(const std::string& host, uint16_t port)
+{
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port   = htons(port);
+    if (inet_pton(AF_INET, host.c_str(), &addr.sin_addr) != 1)
+    {
+        throw std::invalid_argument("Server address must be an IPv4 address");
+    }
+
+    mFd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (mFd < 0)
+    {
+        throw std::system_error(errno, std::generic_category(), "socket");
+    }
+    int enable = 1;
+    setsockopt(mFd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+    if (connect(mFd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0)
+    {
+        const auto connectError = errno;
+        close(mFd);
+        throw std::system_error(connectError, std::generic_category(), "connect");
+    }
+}
+
+/// @brief Connect to a server on a Unix-domain socket
+/// @param socketPath Filesystem path of the socket
+RpcClient::RpcClient(const std::string& socketPath)
+{
+    sockaddr_un addr{};
+    if (socketPath.size() >= sizeof(addr.sun_path))
+    {
+        throw std::invalid_argument("Unix-domain socket path is too long");
+    }
+    addr.sun_family = AF_UNIX;
+    std::copy(socketPath.begin(), socketPath.end(), addr.sun_path);
+
+    mFd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (mFd < 0)
+    {
+        throw std::system_error(errno, std::generic_category(), "socket");
+    }
+    if (connect(mFd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0)
+    {
+        const auto connectError = errno;
+        close(mFd);
+        throw std::system_error(connectError, std::generic_category(), "connect");
+    }
+}
+
+RpcClient::~RpcClient()
+{
+    close(mFd);
+}
+
+/// @brief Queue up a request, to go out on the next flush()
+/// @param method Requested method
+/// @param payload Method arguments
+/// @return ID of the request, which its reply carries
+uint32_t RpcClient::send(Method method, std::string_view payload)
+{
+    const auto requestId = mNextRequestId++;
+    appendFrame(mWriteBuffer, requestId, static_cast<uint8_t>(method), payload);
+    return requestId;
+}
+
+/// @brief Write out every queued request
+void RpcClient::flush()
+{
+    size_t offset = 0;
+    while (offset < mWriteBuffer.size())
+    {
+        const auto numWritten = ::send(mFd, mWriteBuffer.data() + offset, mWriteBuffer.size() - offset, MSG_NOSIGNAL);
+        if (numWritten < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            throw std::system_error(errno, std::generic_category(), "send");
+        }
+        offset += static_cast<size_t>(numWritten);
+    }
+    mWriteBuffer.clear();
+}
+
+/// @brief Block until the next reply arrives
+/// @return Reply frame, whose code is a Status
+Frame RpcClient::receive()
+{
+    static constexpr size_t kReadChunkSize = 64 * 1024;
+
+    Frame reply;
+    while (true)
+    {
+        const auto frameSize = parseFrame(mReadBuffer, reply);
+        if (frameSize > 0)
+        {
+            mReadBuffer.erase(0, frameSize);
+            return reply;
+        }
+        const auto oldSize = mReadBuffer.size();
+        mReadBuffer.resize(oldSize + kReadChunkSize);
+        const auto numRead   = read(mFd, mReadBuffer.data() + oldSize, kReadChunkSize);
+        const auto readError = errno;
+        mReadBuffer.resize(oldSize + static_cast<size_t>(std::max<ssize_t>(numRead, 0)));
+        if (numRead == 0)
+        {
+            throw std::runtime_error("Server closed the connection");
+        }
+        if (numRead < 0 && readError != EINTR)
+        {
+            throw std::system_error(readError, std::generic_category(), "read");
+        }
+    }
+}
+
+/// @brief Send a single request and wait for its reply
+Frame RpcClient::call(Method method, std::string_view payload)
+{
+    send(method, payload);
+    flush();
+    return receive();
+}
+
+/// @brief Send a single request along with file descriptors for the server to take over, and wait for its reply
+/// @details Only works over a Unix-domain socket. Anything already queued is flushed first, and the fds travel with
+/// the request's first byte, so the server sees them no later than the request itself.
+Frame RpcClient::callPassingFds(Method method, std::string_view payload, const std::vector<int>& fds)
+{
+    flush();
+    send(method, payload);
+
+    alignas(cmsghdr) char control[CMSG_SPACE(4 * sizeof(int))];
+    if (fds.size() > 4)
+    {
+        throw std::invalid_argument("At most 4 file descriptors may be passed with a request");
+    }
+    iovec  iov{mWriteBuffer.data(), 1};
+    msghdr msg{};
+    msg.msg_iov        = &iov;
+    msg.msg_iovlen     = 1;
+    msg.msg_control    = control;
+    msg.msg_controllen = CMSG_SPACE(fds.size() * sizeof(int));
+    auto* cmsg         = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level   = SOL_SOCKET;
+    cmsg->cmsg_type    = SCM_RIGHTS;
+    cmsg->cmsg_len     = CMSG_LEN(fds.size() * sizeof(int));
+    std::copy(fds.begin(), fds.end(), reinterpret_cast<int*>(CMSG_DATA(cmsg)));
+    while (sendmsg(mFd, &msg, MSG_NOSIGNAL) < 0)
+    {
+        if (errno != EINTR)
+        {
+            throw std::system_error(errno, std::generic_category(), "sendmsg");
+        }
+    }
+    mWriteBuffer.erase(0, 1);
+    flush();
+    return receive();
+}
+
+} // namespace rpc
+
+} // end namespace orchestrator
@@ -0,0 +1,688 @@
+#include "orchestrator/RpcServer.h"
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <chrono>
+#include <stdexcept>
+#include <system_error>
+
+namespace orchestrator
+{
+
+namespace rpc
+{
+
+namespace
+{
+
+// Most requests a connection may have outstanding before the server stops reading from it
+static constexpr size_t kMaxInFlight = 1024;
+// Replies can't signal that they are ready, so connections waiting on them are polled: at first right away, then at
+// doubling intervals up to the longest while none of them becomes ready
+static constexpr int    kMinReplyPollIntervalMs = 1;
+static constexpr int    kMaxReplyPollIntervalMs = 16;
+static constexpr size_t kReadChunkSize          = 64 * 1024;
+static constexpr size_t kMaxReadPerWakeup       = 16 * kReadChunkSize;
+// How long to stop accepting connections for once out of file descriptors (or memory), rather than spin on a listening
+// socket that stays readable
+static constexpr std::chrono::milliseconds kAcceptBackoff{100};
+// Most file descriptors taken from a single Unix-domain socket message
+static constexpr size_t kMaxPassedFds = 4;
+// Most passed file descriptors a connection may have waiting for a request to claim them; any beyond are closed
+static constexpr size_t kMaxQueuedFds = 2 * kMaxPassedFds;
+// Seals a channel's memfd must carry, so that the client can't shrink it out from under the server's mapping
+static constexpr int kRequiredSeals = F_SEAL_SHRINK | F_SEAL_GROW;
+
+[[noreturn]] void throwErrno(const char* what)
+{
+    throw std::system_error(errno, std::generic_category(), what);
+}
+
+} // namespace
+
+/// @brief Bind and listen on a TCP port
+/// @param port Port to listen on, or 0 to pick any free one
+/// @param handler Maps each request to its reply
+/// @param address IPv4 address of the interface to listen on, e.g. 0.0.0.0 for all of them
+RpcServer::RpcServer(uint16_t port, Handler handler, const std::string& address) : mHandler(std::move(handler))
+{
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port   = htons(port);
+    if (inet_pton(AF_INET, address.c_str(), &addr.sin_addr) != 1)
+    {
+        throw std::invalid_argument("Listening address must be an IPv4 address");
+    }
+
+    mListenFd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (mListenFd < 0)
+    {
+        throwErrno("socket");
+    }
+    int enable = 1;
+    setsockopt(mListenFd, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+    if (bind(mListenFd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0)
+    {
+        throwErrno("bind");
+    }
+    if (listen(mListenFd, SOMAXCONN) < 0)
+    {
+        throwErrno("listen");
+    }
+    socklen_t addrLen = sizeof(addr);
+    getsockname(mListenFd, reinterpret_cast<sockaddr*>(&addr), &addrLen);
+    mPort = ntohs(addr.sin_port);
+
+    mEpollFd = epoll_create1(EPOLL_CLOEXEC);
+    mWakeFd  = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (mEpollFd < 0 || mWakeFd < 0)
+    {
+        throwErrno("epoll");
+    }
+    for (int fd : {mListenFd, mWakeFd})
+    {
+        epoll_event event{};
+        event.events  = EPOLLIN;
+        event.data.fd = fd;
+        epoll_ctl(mEpollFd, EPOLL_CTL_ADD, fd, &event);
+    }
+}
+
+RpcServer::~RpcServer()
+{
+    while (!mConnections.empty())
+    {
+        closeConnection(*mConnections.begin()->second);
+    }
+    for (int fd : {mListenFd, mUnixListenFd, mEpollFd, mWakeFd})
+    {
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+    }
+    if (!mUnixSocketPath.empty())
+    {
+        unlink(mUnixSocketPath.c_str());
+    }
+}
+
+/// @brief Also accept connections on a Unix-domain socket, replacing any stale socket file at the path
+/// @param socketPath Filesystem path of the socket
+void RpcServer::listenUnix(const std::string& socketPath)
+{
+    sockaddr_un addr{};
+    if (socketPath.size() >= sizeof(addr.sun_path))
+    {
+        throw std::invalid_argument("Unix-domain socket path is too long");
+    }
+    addr.sun_family = AF_UNIX;
+    std::copy(socketPath.begin(), socketPath.end(), addr.sun_path);
+
+    mUnixListenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (mUnixListenFd < 0)
+    {
+        throwErrno("socket");
+    }
+    unlink(socketPath.c_str());
+    if (bind(mUnixListenFd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0)
+    {
+        throwErrno("bind");
+    }
+    if (listen(mUnixListenFd, SOMAXCONN) < 0)
+    {
+        throwErrno("listen");
+    }
+    mUnixSocketPath = socketPath;
+
+    epoll_event event{};
+    event.events  = EPOLLIN;
+    event.data.fd = mUnixListenFd;
+    epoll_ctl(mEpollFd, EPOLL_CTL_ADD, mUnixListenFd, &event);
+}
+
+/// @brief The port actually being listened on
+uint16_t RpcServer::port() const
+{
+    return mPort;
+}
+
+/// @brief Make run() return; safe to call from any thread or a signal handler
+void RpcServer::stop()
+{
+    mStopping = true;
+    wake();
+}
+
+/// @brief Have the event loop poll pending replies right away, for when one of them has become ready; safe to call
+/// from any thread or a signal handler
+void RpcServer::wake()
+{
+    const uint64_t        wakes   = 1;
+    [[maybe_unused]] auto written = write(mWakeFd, &wakes, sizeof(wakes));
+}
+
+/// @brief Serve requests until stop() is called
+void RpcServer::run()
+{
+    static constexpr int kMaxEvents = 256;
+
+    std::array<epoll_event, kMaxEvents> events;
+    int                                 replyPollIntervalMs = kMinReplyPollIntervalMs;
+    while (!mStopping)
+    {
+        int timeoutMs = mBusyFds.empty() ? -1 : replyPollIntervalMs;
+        if (mAcceptPaused)
+        {
+            const auto untilResume = std::chrono::ceil<std::chrono::milliseconds>(mAcceptResumeTime -
+                                                                                   std::chrono::steady_clock::now());
+            const int  resumeMs    = static_cast<int>(std::max<int64_t>(untilResume.count(), 0));
+            timeoutMs              = timeoutMs < 0 ? resumeMs : std::min(timeoutMs, resumeMs);
+        }
+        const int numEvents = epoll_wait(mEpollFd, events.data(), kMaxEvents, timeoutMs);
+        if (numEvents < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            throwErrno("epoll_wait");
+        }
+        if (mAcceptPaused && std::chrono::steady_clock::now() >= mAcceptResumeTime)
+        {
+            pauseAccepting(false);
+        }
+
+        const auto numRepliesBefore = mNumReplies;
+        for (int k = 0; k < numEvents; k++)
+        {
+            const int fd = events[k].data.fd;
+            if (fd == mListenFd || fd == mUnixListenFd)
+            {
+                acceptConnections(fd);
+                continue;
+            }
+            if (fd == mWakeFd)
+            {
+                uint64_t wakes;
+                [[maybe_unused]] auto numRead = read(mWakeFd, &wakes, sizeof(wakes));
+                continue;
+            }
+            auto connIt = mConnections.find(fd);
+            if (connIt == mConnections.end())
+            {
+                continue;
+            }
+            auto& conn = *connIt->second;
+            if (events[k].events & (EPOLLIN | EPOLLHUP | EPOLLERR))
+            {
+                readRequests(conn);
+            }
+            serviceConnection(conn);
+        }
+
+        // Connections serviced above may have been closed, so look each one up again
+        std::vector<int> busyFds(mBusyFds.begin(), mBusyFds.end());
+        for (int fd : busyFds)
+        {
+            auto connIt = mConnections.find(fd);
+            if (connIt != mConnections.end())
+            {
+                serviceConnection(*connIt->second);
+            }
+        }
+        const bool progressed = numEvents > 0 || mNumReplies != numRepliesBefore;
+        replyPollIntervalMs   = progressed ? kMinReplyPollIntervalMs
+                                           : std::min(2 * replyPollIntervalMs, kMaxReplyPollIntervalMs);
+    }
+}
+
+/// @brief Stop or resume waiting for new connections on every listening socket
+/// @param paused Whether to stop, until kAcceptBackoff from now, or to resume
+void RpcServer::pauseAccepting(bool paused)
+{
+    mAcceptPaused = paused;
+    if (paused)
+    {
+        mAcceptResumeTime = std::chrono::steady_clock::now() + kAcceptBackoff;
+    }
+    for (int fd : {mListenFd, mUnixListenFd})
+    {
+        if (fd < 0)
+        {
+            continue;
+        }
+        epoll_event event{};
+        event.events  = paused ? 0u : static_cast<uint32_t>(EPOLLIN);
+        event.data.fd = fd;
+        epoll_ctl(mEpollFd, EPOLL_CTL_MOD, fd, &event);
+    }
+}
+
+void RpcServer::acceptConnections(int listenFd)
+{
+    while (true)
+    {
+        const bool  isUnix   = listenFd == mUnixListenFd;
+        sockaddr_in peer{};
+        socklen_t   peerSize = sizeof(peer);
+        auto*       peerAddr = isUnix ? nullptr : reinterpret_cast<sockaddr*>(&peer);
+        const int   fd       = accept4(listenFd, peerAddr, isUnix ? nullptr : &peerSize, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0)
+        {
+            if (errno == EMFILE || errno == ENFILE || errno == ENOBUFS || errno == ENOMEM)
+            {
+                // The pending connection stays in the backlog and the socket readable, so back off until some of
+                // the server's own connections have had a chance to close
+                pauseAccepting(true);
+                return;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+            {
+                return;
+            }
+            // Anything else (the client gave up, say) is that connection's problem, not the server's
+            continue;
+        }
+        if (!isUnix)
+        {
+            int enable = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+        }
+
+        std::unique_ptr<Connection> conn;
+        if (mIdleConnections.empty())
+        {
+            conn = std::make_unique<Connection>();
+        }
+        else
+        {
+            conn = std::move(mIdleConnections.back());
+            mIdleConnections.pop_back();
+        }
+        conn->fd     = fd;
+        conn->events = EPOLLIN;
+        conn->isUnix  = isUnix;
+        conn->isLocal = isUnix || (ntohl(peer.sin_addr.s_addr) >> 24) == IN_LOOPBACKNET;
+
+        epoll_event event{};
+        event.events  = conn->events;
+        event.data.fd = fd;
+        epoll_ctl(mEpollFd, EPOLL_CTL_ADD, fd, &event);
+        mConnections.emplace(fd, std::move(conn));
+    }
+}
+
+void RpcServer::readRequests(Connection& conn)
+{
+    if (conn.channel)
+    {
+        // Requests are already waiting in the ring; just reset the doorbell
+        uint64_t rings;
+        [[maybe_unused]] auto numRead = read(conn.fd, &rings, sizeof(rings));
+        return;
+    }
+
+    // Level-triggered, so anything left unread is picked up on the next loop iteration
+    for (size_t totalRead = 0; totalRead < kMaxReadPerWakeup;)
+    {
+        const auto oldSize = conn.readBuffer.size();
+        conn.readBuffer.resize(oldSize + kReadChunkSize);
+
+        iovec   iov{conn.readBuffer.data() + oldSize, kReadChunkSize};
+        msghdr  msg{};
+        alignas(cmsghdr) char control[CMSG_SPACE(kMaxPassedFds * sizeof(int))];
+        msg.msg_iov    = &iov;
+        msg.msg_iovlen = 1;
+        if (conn.isUnix)
+        {
+            msg.msg_control    = control;
+            msg.msg_controllen = sizeof(control);
+        }
+        const auto numRead   = recvmsg(conn.fd, &msg, MSG_CMSG_CLOEXEC);
+        const auto readError = errno;
+        for (auto* cmsg = CMSG_FIRSTHDR(&msg); conn.isUnix && numRead > 0 && cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg))
+        {
+            if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS)
+            {
+                const auto numFds = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+                const auto* fds   = reinterpret_cast<const int*>(CMSG_DATA(cmsg));
+                for (size_t k = 0; k < numFds; k++)
+                {
+                    if (conn.receivedFds.size() < kMaxQueuedFds)
+                    {
+                        conn.receivedFds.push_back(fds[k]);
+                    }
+                    else
+                    {
+                        close(fds[k]);
+                    }
+                }
+            }
+        }
+        conn.readBuffer.resize(oldSize + static_cast<size_t>(std::max<ssize_t>(numRead, 0)));
+        if (numRead > 0)
+        {
+            totalRead += static_cast<size_t>(numRead);
+            continue;
+        }
+        if (numRead < 0 && readError == EINTR)
+        {
+            continue;
+        }
+        if (numRead == 0 || (readError != EAGAIN && readError != EWOULDBLOCK))
+        {
+            conn.peerClosed = true;
+        }
+        return;
+    }
+}
+
+void RpcServer::parseRequests(Connection& conn)
+{
+    size_t offset = 0;
+    Frame  request;
+    try
+    {
+        while (conn.inFlight.size() < kMaxInFlight)
+        {
+            if (conn.channel)
+            {
+                if (!conn.channel->requests.tryRead(request))
+                {
+                    break;
+                }
+            }
+            else
+            {
+                const auto frameSize = parseFrame(std::string_view(conn.readBuffer).substr(offset), request);
+                if (frameSize == 0)
+                {
+                    break;
+                }
+                offset += frameSize;
+            }
+
+            request.fromLocalPeer = conn.isLocal;
+            PendingReply reply;
+            try
+            {
+                reply = request.code == static_cast<uint8_t>(Method::ATTACH_SHM) ? attachChannel(conn, request)
+                                                                                 : mHandler(request);
+            }
+            catch (const std::exception& e)
+            {
+                reply = [message = std::string(e.what())]() { return std::optional<Reply>{{Status::ERROR, message}}; };
+            }
+            conn.inFlight.emplace_back(request.requestId, std::move(reply));
+        }
+    }
+    catch (const std::runtime_error&)
+    {
+        // An oversized frame or a corrupt ring means the stream can't be trusted anymore
+        conn.peerClosed = true;
+        conn.readBuffer.clear();
+        return;
+    }
+    conn.readBuffer.erase(0, offset);
+}
+
+/// @brief Map the shared-memory channel whose file descriptors came with the request
+/// @param conn Unix-domain socket connection the request arrived on
+/// @param request Carries the ring capacities; the memfd, doorbell, and notify eventfds were passed alongside it
+/// @return Immediate reply
+PendingReply RpcServer::attachChannel(Connection& conn, Frame& request)
+{
+    if (conn.channel || conn.receivedFds.size() < 3)
+    {
+        throw std::invalid_argument("Shared-memory channels attach over a Unix-domain socket with 3 passed fds");
+    }
+    std::vector<int> fds(conn.receivedFds.end() - 3, conn.receivedFds.end());
+    conn.receivedFds.resize(conn.receivedFds.size() - 3);
+    const int memFd = fds[0];
+
+    Reader           reader(request.payload);
+    ShmChannelLayout layout{.requestCapacity = static_cast<size_t>(reader.i64()),
+                            .replyCapacity   = static_cast<size_t>(reader.i64())};
+    // Bounded before anything is computed from them, so that the region size can't overflow
+    const bool       validCapacities =
+        layout.requestCapacity <= ShmRing::kMaxCapacity && layout.replyCapacity <= ShmRing::kMaxCapacity;
+    const bool       sealed = (fcntl(memFd, F_GET_SEALS) & kRequiredSeals) == kRequiredSeals;
+    struct stat      memStat;
+    void*            region = MAP_FAILED;
+    if (validCapacities && sealed && fstat(memFd, &memStat) == 0 &&
+        static_cast<size_t>(memStat.st_size) >= layout.regionSize())
+    {
+        region = mmap(nullptr, layout.regionSize(), PROT_READ | PROT_WRITE, MAP_SHARED, memFd, 0);
+    }
+    close(memFd);
+    if (region == MAP_FAILED)
+    {
+        close(fds[1]);
+        close(fds[2]);
+        throw std::invalid_argument(
+            "Could not map the shared-memory channel; its memfd must be sealed against shrinking and growing");
+    }
+
+    auto channel        = std::make_unique<ShmChannel>();
+    channel->region     = region;
+    channel->regionSize = layout.regionSize();
+    channel->notifyFd   = fds[2];
+    try
+    {
+        channel->requests = layout.requestRing(region, false);
+        channel->replies  = layout.replyRing(region, false);
+    }
+    catch (const std::exception&)
+    {
+        munmap(region, layout.regionSize());
+        close(fds[1]);
+        close(fds[2]);
+        throw;
+    }
+
+    auto channelConn     = std::make_unique<Connection>();
+    channelConn->fd      = fds[1];
+    channelConn->events  = EPOLLIN;
+    channelConn->channel = std::move(channel);
+    channelConn->ownerFd = conn.fd;
+    channelConn->isLocal = true;
+    conn.channelFds.push_back(channelConn->fd);
+
+    epoll_event event{};
+    event.events  = EPOLLIN;
+    event.data.fd = channelConn->fd;
+    epoll_ctl(mEpollFd, EPOLL_CTL_ADD, channelConn->fd, &event);
+    mConnections.emplace(channelConn->fd, std::move(channelConn));
+
+    return []() { return std::optional<Reply>{{Status::OK, ""}}; };
+}
+
+void RpcServer::collectReplies(Connection& conn)
+{
+    // Replies go out in request order, so a slow request holds back the ones pipelined behind it
+    while (!conn.inFlight.empty())
+    {
+        auto reply = conn.inFlight.front().second();
+        if (!reply)
+        {
+            break;
+        }
+        appendFrame(conn.writeBuffer, conn.inFlight.front().first, static_cast<uint8_t>(reply->status), reply->payload);
+        conn.inFlight.pop_front();
+        mNumReplies++;
+    }
+}
+
+bool RpcServer::writeReplies(Connection& conn)
+{
+    if (conn.channel)
+    {
+        // Move whole frames into the reply ring until it fills up, then wake the client if anything went in
+        Frame  reply;
+        size_t numMoved = 0;
+        while (const auto frameSize =
+                   parseFrame(std::string_view(conn.writeBuffer).substr(conn.writeOffset), reply))
+        {
+            try
+            {
+                if (!conn.channel->replies.tryWrite(reply.requestId, reply.code, reply.payload))
+                {
+                    break;
+                }
+            }
+            catch (const std::runtime_error&)
+            {
+                // The client corrupted its reply ring, so the channel can't be trusted anymore
+                return false;
+            }
+            conn.writeOffset += frameSize;
+            numMoved++;
+        }
+        if (numMoved > 0)
+        {
+            const uint64_t notify = 1;
+            [[maybe_unused]] auto written = write(conn.channel->notifyFd, &notify, sizeof(notify));
+        }
+        if (conn.writeOffset == conn.writeBuffer.size())
+        {
+            conn.writeBuffer.clear();
+            conn.writeOffset = 0;
+        }
+        return true;
+    }
+
+    while (conn.writeOffset < conn.writeBuffer.size())
+    {
+        const auto numWritten = send(conn.fd,
+                                     conn.writeBuffer.data() + conn.writeOffset,
+                                     conn.writeBuffer.size() - conn.writeOffset,
+                                     MSG_NOSIGNAL);
+        if (numWritten < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return errno == EAGAIN || errno == EWOULDBLOCK;
+        }
+        conn.writeOffset += static_cast<size_t>(numWritten);
+    }
+    conn.writeBuffer.clear();
+    conn.writeOffset = 0;
+    return true;
+}
+
+void RpcServer::serviceConnection(Connection& conn)
+{
+    parseRequests(conn);
+    collectReplies(conn);
+    // Replies freed up in-flight room, so requests held back in the read buffer can go now
+    parseRequests(conn);
+    collectReplies(conn);
+
+    if (!writeReplies(conn) || (conn.peerClosed && conn.inFlight.empty() && conn.writeBuffer.empty()))
+    {
+        closeConnection(conn);
+        return;
+    }
+
+    // A full reply ring gives nothing to wait on, so channels with replies left over get polled too
+    if (conn.inFlight.empty() && (!conn.channel || conn.writeBuffer.empty()))
+    {
+        mBusyFds.erase(conn.fd);
+    }
+    else
+    {
+        mBusyFds.insert(conn.fd);
+    }
+
+    uint32_t events = 0;
+    if (!conn.peerClosed && conn.inFlight.size() < kMaxInFlight)
+    {
+        events |= EPOLLIN;
+    }
+    if (!conn.writeBuffer.empty() && !conn.channel)
+    {
+        events |= EPOLLOUT;
+    }
+    if (events != conn.events)
+    {
+        conn.events = events;
+        epoll_event event{};
+        event.events  = events;
+        event.data.fd = conn.fd;
+        epoll_ctl(mEpollFd, EPOLL_CTL_MOD, conn.fd, &event);
+    }
+}
+
+void RpcServer::closeConnection(Connection& conn)
+{
+    const int fd = conn.fd;
+    epoll_ctl(mEpollFd, EPOLL_CTL_DEL, fd, nullptr);
+    close(fd);
+    mBusyFds.erase(fd);
+    for (int receivedFd : conn.receivedFds)
+    {
+        close(receivedFd);
+    }
+    if (conn.channel)
+    {
+        munmap(conn.channel->region, conn.channel->regionSize);
+        close(conn.channel->notifyFd);
+    }
+
+    auto connIt = mConnections.find(fd);
+    auto idle   = std::move(connIt->second);
+    mConnections.erase(connIt);
+
+    // Channels go away with the socket they were attached through
+    for (int channelFd : idle->channelFds)
+    {
+        auto channelIt = mConnections.find(channelFd);
+        if (channelIt != mConnections.end())
+        {
+            closeConnection(*channelIt->second);
+        }
+    }
+    if (idle->ownerFd >= 0)
+    {
+        auto ownerIt = mConnections.find(idle->ownerFd);
+        if (ownerIt != mConnections.end())
+        {
+            std::erase(ownerIt->second->channelFds, fd);
+        }
+    }
+    if (idle->channel)
+    {
+        // Channel connections are cheap and only ever created by attachChannel, so don't recycle them
+        return;
+    }
+
+    idle->fd = -1;
+    idle->readBuffer.clear();
+    idle->writeBuffer.clear();
+    idle->writeOffset = 0;
+    idle->inFlight.clear();
+    idle->peerClosed = false;
+    idle->isUnix     = false;
+    idle->isLocal    = false;
+    idle->receivedFds.clear();
+    idle->channelFds.clear();
+    mIdleConnections.push_back(std::move(idle));
+}
+
+} // namespace rpc
+
+} // end namespace orchestrator
@@ -0,0 +1,92 @@
+#include "orchestrator/ShardRouter.h"
+#include <stdexcept>
+#include <utility>
+
+namespace orchestrator
+{
+
+namespace job_queue
+{
+
+ShardRouter::ShardRouter(size_t numShards) : mNumShards(numShards)
+{
+    if (numShards == 0)
+    {
+        throw std::invalid_argument("There must be at least one job queue shard");
+    }
+    for (size_t k = 0; k < numShards; k++)
+    {
+        mMailboxes.push_back(std::make_unique<Mailbox>());
+    }
+}
+
+size_t ShardRouter::numShards() const
+{
+    return mNumShards;
+}
+
+/// @brief Find the shard that owns a job
+/// @param jobId ID of a job created by any shard
+/// @return Index of the shard that created the job
+size_t ShardRouter::shardOf(int64_t jobId) const
+{
+    return static_cast<size_t>(jobId) % mNumShards;
+}
+
+/// @brief Pick the shard a new job should be pushed to
+/// @param job Job about to be pushed
+/// @return The shard of the job's workflow if it has one, else that of its first blocker, else the next shard in turn
+size_t ShardRouter::shardFor(const Job& job)
+{
+    if (job.workflowId >= 0)
+    {
+        return static_cast<size_t>(job.workflowId) % mNumShards;
+    }
+    if (!job.independentBlockers.empty())
+    {
+        return shardOf(job.independentBlockers.front());
+    }
+    if (!job.relevantBlockers.empty())
+    {
+        return shardOf(job.relevantBlockers.front());
+    }
+    return mNextShard.fetch_add(1, std::memory_order_relaxed) % mNumShards;
+}
+
+/// @brief Round a prospective job ID up to the nearest one belonging to a shard
+/// @param jobId Prospective (non-negative) job ID
+/// @param shard Shard creating the job
+/// @return Smallest ID no less than jobId that shardOf() maps to the shard
+int64_t ShardRouter::alignId(int64_t jobId, size_t shard) const
+{
+    const auto offset = (shard + mNumShards - shardOf(jobId)) % mNumShards;
+    return jobId + static_cast<int64_t>(offset);
+}
+
+void ShardRouter::postWatch(size_t shard, const BlockerWatch& watch)
+{
+    auto&                       mailbox = *mMailboxes.at(shard);
+    std::lock_guard<std::mutex> lock(mailbox.mutex);
+    mailbox.mail.watches.push_back(watch);
+}
+
+void ShardRouter::postResolution(size_t shard, BlockerResolution resolution)
+{
+    auto&                       mailbox = *mMailboxes.at(shard);
+    std::lock_guard<std::mutex> lock(mailbox.mutex);
+    mailbox.mail.resolutions.push_back(std::move(resolution));
+}
+
+/// @brief Collect everything posted to a shard since the last call
+/// @param shard Shard checking its mail
+/// @return Watches and resolutions in the order they were posted
+ShardMail ShardRouter::takeMail(size_t shard)
+{
+    auto&                       mailbox = *mMailboxes.at(shard);
+    std::lock_guard<std::mutex> lock(mailbox.mutex);
+    return std::exchange(mailbox.mail, ShardMail{});
+}
+
+} // namespace job_queue
+
+} // end namespace orchestrator
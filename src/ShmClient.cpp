@@ -0,0 +1,165 @@
+#include "orchestrator/ShmClient.h"
+#include <fcntl.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <cerrno>
+#include <stdexcept>
+#include <system_error>
+#include <thread>
+
+namespace orchestrator
+{
+
+namespace rpc
+{
+
+namespace
+{
+
+// Polls of an empty reply ring before blocking on the notify eventfd; replies usually land within microseconds
+static constexpr int kSpinPolls = 4096;
+
+} // namespace
+
+/// @brief Create a channel and hand it to the server listening on a Unix-domain socket
+/// @param socketPath Filesystem path of the server's socket
+/// @param requestCapacity Bytes of request ring; a multiple of 8
+/// @param replyCapacity Bytes of reply ring; a multiple of 8
+ShmClient::ShmClient(const std::string& socketPath, size_t requestCapacity, size_t replyCapacity)
+    : mControl(socketPath), mLayout{.requestCapacity = requestCapacity, .replyCapacity = replyCapacity}
+{
+    const int memFd = memfd_create("orchestrator-shm-channel", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (memFd < 0)
+    {
+        throw std::system_error(errno, std::generic_category(), "memfd_create");
+    }
+    if (ftruncate(memFd, static_cast<off_t>(mLayout.regionSize())) < 0)
+    {
+        const auto truncateError = errno;
+        close(memFd);
+        throw std::system_error(truncateError, std::generic_category(), "ftruncate");
+    }
+    // The server only maps a region whose size is fixed for good
+    if (fcntl(memFd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL) < 0)
+    {
+        const auto sealError = errno;
+        close(memFd);
+        throw std::system_error(sealError, std::generic_category(), "F_ADD_SEALS");
+    }
+    mRegion = mmap(nullptr, mLayout.regionSize(), PROT_READ | PROT_WRITE, MAP_SHARED, memFd, 0);
+    if (mRegion == MAP_FAILED)
+    {
+        const auto mapError = errno;
+        close(memFd);
+        throw std::system_error(mapError, std::generic_category(), "mmap");
+    }
+    mRequests   = mLayout.requestRing(mRegion, true);
+    mReplies    = mLayout.replyRing(mRegion, true);
+    mDoorbellFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    mNotifyFd   = eventfd(0, EFD_CLOEXEC);
+
+    std::string payload;
+    Writer      writer(payload);
+    writer.i64(static_cast<int64_t>(requestCapacity));
+    writer.i64(static_cast<int64_t>(replyCapacity));
+    auto reply = mControl.callPassingFds(Method::ATTACH_SHM, payload, {memFd, mDoorbellFd, mNotifyFd});
+    close(memFd);
+    if (reply.code != static_cast<uint8_t>(Status::OK))
+    {
+        munmap(mRegion, mLayout.regionSize());
+        close(mDoorbellFd);
+        close(mNotifyFd);
+        throw std::runtime_error("Server refused the shared-memory channel: " + reply.payload);
+    }
+}
+
+ShmClient::~ShmClient()
+{
+    munmap(mRegion, mLayout.regionSize());
+    close(mDoorbellFd);
+    close(mNotifyFd);
+}
+
+/// @brief Write a request into the ring, to be picked up by the server on the next flush()
+/// @param method Requested method
+/// @param payload Method arguments
+/// @return ID of the request, which its reply carries
+uint32_t ShmClient::send(Method method, std::string_view payload)
+{
+    const auto requestId = mNextRequestId++;
+    while (!mRequests.tryWrite(requestId, static_cast<uint8_t>(method), payload))
+    {
+        if (2 * payload.size() + 64 > mRequests.capacity())
+        {
+            throw std::invalid_argument("Request is too large for the shared-memory channel");
+        }
+        // Let the server drain the ring, taking its replies as they come so it never stalls on a full reply ring
+        flush();
+        if (!takeReplies())
+        {
+            std::this_thread::yield();
+        }
+    }
+    mUnflushed = true;
+    return requestId;
+}
+
+/// @brief Wake the server up to take every request written since the last flush
+void ShmClient::flush()
+{
+    if (!mUnflushed)
+    {
+        return;
+    }
+    const uint64_t ring = 1;
+    [[maybe_unused]] auto written = write(mDoorbellFd, &ring, sizeof(ring));
+    mUnflushed = false;
+}
+
+bool ShmClient::takeReplies()
+{
+    Frame reply;
+    bool  tookAny = false;
+    while (mReplies.tryRead(reply))
+    {
+        mReceived.push_back(std::move(reply));
+        tookAny = true;
+    }
+    return tookAny;
+}
+
+/// @brief Wait for the next reply, spinning briefly before sleeping on the notify eventfd
+/// @return Reply frame, whose code is a Status
+Frame ShmClient::receive()
+{
+    flush();
+    for (int polls = 0; mReceived.empty(); polls++)
+    {
+        if (takeReplies())
+        {
+            break;
+        }
+        if (polls >= kSpinPolls)
+        {
+            // The server signals after every batch of replies, so a reply landing after the check above still
+            // leaves the eventfd readable
+            uint64_t notifications;
+            [[maybe_unused]] auto numRead = read(mNotifyFd, &notifications, sizeof(notifications));
+        }
+    }
+    auto reply = std::move(mReceived.front());
+    mReceived.pop_front();
+    return reply;
+}
+
+/// @brief Send a single request and wait for its reply
+Frame ShmClient::call(Method method, std::string_view payload)
+{
+    send(method, payload);
+    return receive();
+}
+
+} // namespace rpc
+
+} // end namespace orchestrator
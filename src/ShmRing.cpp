@@ -0,0 +1,157 @@
+#include "orchestrator/ShmRing.h"
+#include <cstring>
+#include <new>
+#include <stdexcept>
+
+namespace orchestrator
+{
+
+namespace rpc
+{
+
+namespace
+{
+
+constexpr size_t alignRecord(size_t numBytes)
+{
+    return (numBytes + 7) & ~size_t{7};
+}
+
+} // namespace
+
+/// @brief Bytes of shared memory a ring with the given data capacity takes up
+size_t ShmRing::regionSize(size_t capacity)
+{
+    return sizeof(Header) + alignRecord(capacity);
+}
+
+/// @brief View a ring in a mapped region
+/// @param region Start of the ring's region, at least regionSize(capacity) bytes long
+/// @param capacity Data capacity in bytes; a multiple of 8, at most kMaxCapacity
+/// @param initialize Whether this side creates the ring, rather than attaching to one the other side created
+ShmRing::ShmRing(void* region, size_t capacity, bool initialize)
+    : mHeader(static_cast<Header*>(region)), mData(static_cast<char*>(region) + sizeof(Header)), mCapacity(capacity)
+{
+    if (capacity % 8 != 0 || capacity < 2 * kRecordHeaderSize || capacity > kMaxCapacity)
+    {
+        throw std::invalid_argument("Shared-memory ring capacity must be a multiple of 8 bytes, at most 1 GiB");
+    }
+    if (initialize)
+    {
+        new (mHeader) Header{};
+        mHeader->capacity = capacity;
+    }
+    else if (mHeader->capacity != capacity)
+    {
+        throw std::runtime_error("Shared-memory ring was created with a different capacity");
+    }
+    mHead = mHeader->head.load(std::memory_order_acquire);
+    mTail = mHeader->tail.load(std::memory_order_acquire);
+    if (mHead - mTail > mCapacity || mHead % 8 != 0 || mTail % 8 != 0)
+    {
+        throw std::runtime_error("Corrupt shared-memory ring");
+    }
+}
+
+size_t ShmRing::capacity() const
+{
+    return mCapacity;
+}
+
+/// @brief Append a record if there is room for it
+/// @return Whether the record was written; records larger than half the ring never fit. Throws std::runtime_error if
+/// the consumer's cursor is inconsistent with ours.
+bool ShmRing::tryWrite(uint32_t requestId, uint8_t code, std::string_view payload)
+{
+    const auto recordSize = alignRecord(kRecordHeaderSize + payload.size());
+    if (recordSize > mCapacity / 2)
+    {
+        return false;
+    }
+
+    // The consumer lives in another process, so don't trust its cursor to be anywhere sensible
+    auto       head = mHead;
+    const auto tail = mHeader->tail.load(std::memory_order_acquire);
+    if (head - tail > mCapacity)
+    {
+        throw std::runtime_error("Corrupt shared-memory ring");
+    }
+    auto       offset = head % mCapacity;
+    const auto toEnd  = mCapacity - offset;
+    const auto needed = recordSize + (toEnd < recordSize ? toEnd : 0);
+    if (mCapacity - (head - tail) < needed)
+    {
+        return false;
+    }
+    if (toEnd < recordSize)
+    {
+        std::memcpy(mData + offset, &kWrapMarker, sizeof(kWrapMarker));
+        head += toEnd;
+        offset = 0;
+    }
+
+    const auto payloadSize = static_cast<uint32_t>(payload.size());
+    std::memcpy(mData + offset, &payloadSize, 4);
+    std::memcpy(mData + offset + 4, &requestId, 4);
+    std::memcpy(mData + offset + 8, &code, 1);
+    std::memcpy(mData + offset + kRecordHeaderSize, payload.data(), payload.size());
+    mHead = head + recordSize;
+    mHeader->head.store(mHead, std::memory_order_release);
+    return true;
+}
+
+/// @brief Take the oldest record if there is one
+/// @param frame Filled in with the record
+/// @return Whether a record was read; throws std::runtime_error if the producer left the ring inconsistent
+bool ShmRing::tryRead(Frame& frame)
+{
+    auto       tail = mTail;
+    const auto head = mHeader->head.load(std::memory_order_acquire);
+    if (tail == head)
+    {
+        return false;
+    }
+
+    // The producer lives in another process, so don't trust it to stay in bounds
+    auto available = head - tail;
+    if (available > mCapacity)
+    {
+        throw std::runtime_error("Corrupt shared-memory ring");
+    }
+    auto     offset = tail % mCapacity;
+    uint32_t payloadSize;
+    std::memcpy(&payloadSize, mData + offset, 4);
+    if (payloadSize == kWrapMarker)
+    {
+        const auto toEnd = mCapacity - offset;
+        if (toEnd >= available)
+        {
+            throw std::runtime_error("Corrupt shared-memory ring");
+        }
+        tail += toEnd;
+        available -= toEnd;
+        offset = 0;
+        std::memcpy(&payloadSize, mData, 4);
+    }
+    const auto recordSize = alignRecord(kRecordHeaderSize + payloadSize);
+    if (recordSize > mCapacity - offset || recordSize > available)
+    {
+        throw std::runtime_error("Corrupt shared-memory ring");
+    }
+
+    std::memcpy(&frame.requestId, mData + offset + 4, 4);
+    std::memcpy(&frame.code, mData + offset + 8, 1);
+    frame.payload.assign(mData + offset + kRecordHeaderSize, payloadSize);
+    mTail = tail + recordSize;
+    mHeader->tail.store(mTail, std::memory_order_release);
+    return true;
+}
+
+bool ShmRing::empty() const
+{
+    return mHeader->tail.load(std::memory_order_acquire) == mHeader->head.load(std::memory_order_acquire);
+}
+
+} // namespace rpc
+
+} // end namespace orchestrator
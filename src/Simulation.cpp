@@ -0,0 +1,422 @@
+#include "orchestrator/Simulation.h"
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <limits>
+#include <random>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+
+namespace orchestrator
+{
+
+namespace simulation
+{
+
+namespace
+{
+
+constexpr auto kJobSucceeded = aapis::orchestrator::v1::JobStatus::JOB_STATUS_COMPLETE;
+constexpr auto kJobFailed    = aapis::orchestrator::v1::JobStatus::JOB_STATUS_ERROR;
+constexpr auto kJobCanceled  = aapis::orchestrator::v1::JobStatus::JOB_STATUS_CANCELED;
+
+[[noreturn]] void throwTraceError(size_t lineNumber, const std::string& what)
+{
+    throw std::invalid_argument("Trace line " + std::to_string(lineNumber) + ": " + what);
+}
+
+int64_t parseInteger(std::string_view text, size_t lineNumber)
+{
+    int64_t    value  = 0;
+    const auto parsed = std::from_chars(text.data(), text.data() + text.size(), value);
+    if (parsed.ec != std::errc() || parsed.ptr != text.data() + text.size())
+    {
+        throwTraceError(lineNumber, "'" + std::string(text) + "' is not an integer");
+    }
+    return value;
+}
+
+// Comma-separated keys, or "-" for none
+std::vector<int64_t> parseKeys(std::string_view text, size_t lineNumber)
+{
+    std::vector<int64_t> keys;
+    if (text == "-")
+    {
+        return keys;
+    }
+    while (true)
+    {
+        const auto comma = text.find(',');
+        keys.push_back(parseInteger(text.substr(0, comma), lineNumber));
+        if (comma == std::string_view::npos)
+        {
+            return keys;
+        }
+        text.remove_prefix(comma + 1);
+    }
+}
+
+void writeKeys(std::ostream& out, const std::vector<int64_t>& keys)
+{
+    if (keys.empty())
+    {
+        out << "-";
+        return;
+    }
+    for (size_t k = 0; k < keys.size(); k++)
+    {
+        out << (k == 0 ? "" : ",") << keys[k];
+    }
+}
+
+} // namespace
+
+/// @brief Parse a trace: one job per line, as written by writeTrace(), with blank lines and '#' comments skipped
+/// @param in Trace text
+/// @return The trace; throws std::invalid_argument, naming the offending line, if the text is malformed
+Trace readTrace(std::istream& in)
+{
+    Trace             trace;
+    std::set<int64_t> keys;
+    std::string       line;
+    for (size_t lineNumber = 1; std::getline(in, line); lineNumber++)
+    {
+        std::istringstream fields(line);
+        std::string        pushMicros, key, priority, kind, runMicros, outcome, relevant, independent, extra;
+        if (!(fields >> pushMicros) || pushMicros.starts_with('#'))
+        {
+            continue;
+        }
+        fields >> key >> priority >> kind >> runMicros >> outcome >> relevant >> independent;
+        if (!fields || (fields >> extra))
+        {
+            throwTraceError(lineNumber, "expected 8 fields");
+        }
+        if (outcome != "ok" && outcome != "error")
+        {
+            throwTraceError(lineNumber, "outcome must be ok or error");
+        }
+
+        TraceJob job{.key                 = parseInteger(key, lineNumber),
+                     .pushMicros          = parseInteger(pushMicros, lineNumber),
+                     .runMicros           = parseInteger(runMicros, lineNumber),
+                     .fails               = outcome == "error",
+                     .priority            = parseInteger(priority, lineNumber),
+                     .kind                = static_cast<uint32_t>(parseInteger(kind, lineNumber)),
+                     .relevantBlockers    = parseKeys(relevant, lineNumber),
+                     .independentBlockers = parseKeys(independent, lineNumber)};
+        if (job.pushMicros < 0 || job.runMicros < 0)
+        {
+            throwTraceError(lineNumber, "times must not be negative");
+        }
+        if (!trace.empty() && job.pushMicros < trace.back().pushMicros)
+        {
+            throwTraceError(lineNumber, "jobs must be in push order");
+        }
+        if (!keys.insert(job.key).second)
+        {
+            throwTraceError(lineNumber, "duplicate key " + key);
+        }
+        trace.push_back(std::move(job));
+    }
+    return trace;
+}
+
+/// @brief Write a trace out in the form readTrace() takes
+void writeTrace(std::ostream& out, const Trace& trace)
+{
+    out << "# push_us key priority kind run_us ok|error relevant_blockers independent_blockers\n";
+    for (const auto& job : trace)
+    {
+        out << job.pushMicros << " " << job.key << " " << job.priority << " " << job.kind << " " << job.runMicros << " "
+            << (job.fails ? "error" : "ok") << " ";
+        writeKeys(out, job.relevantBlockers);
+        out << " ";
+        writeKeys(out, job.independentBlockers);
+        out << "\n";
+    }
+}
+
+/// @brief Make up a random workload; the same model (seed included) always makes the same trace
+/// @param model Shape of the workload
+/// @return Trace of model.numJobs jobs, keyed 0, 1, 2...
+Trace generateTrace(const WorkloadModel& model)
+{
+    std::mt19937_64                        rng(model.seed);
+    std::exponential_distribution<double>  interarrivalMicros(std::max(model.jobsPerSecond, 1e-9) / 1e6);
+    std::exponential_distribution<double>  runMicros(1.0 / std::max(model.meanRunMillis * 1e3, 1.0));
+    std::uniform_real_distribution<double> chance(0.0, 1.0);
+    std::uniform_int_distribution<int64_t> priority(0, std::max<int64_t>(model.numPriorities, 1) - 1);
+    std::uniform_int_distribution<size_t>  numBlockers(1, std::max<size_t>(model.maxBlockers, 1));
+
+    Trace  trace;
+    double pushMicros = 0;
+    for (size_t k = 0; k < model.numJobs; k++)
+    {
+        pushMicros += interarrivalMicros(rng);
+
+        TraceJob job{.key        = static_cast<int64_t>(k),
+                     .pushMicros = static_cast<int64_t>(pushMicros),
+                     .runMicros  = std::max<int64_t>(static_cast<int64_t>(runMicros(rng)), 1),
+                     .fails      = chance(rng) < model.failureProbability,
+                     .priority   = priority(rng)};
+        const auto window = std::min(model.blockerWindow, k);
+        if (window > 0 && chance(rng) < model.blockedFraction)
+        {
+            std::uniform_int_distribution<size_t> blocker(k - window, k - 1);
+            std::set<int64_t>                     blockers;
+            for (auto n = numBlockers(rng); n > 0; n--)
+            {
+                blockers.insert(static_cast<int64_t>(blocker(rng)));
+            }
+            for (auto blockerKey : blockers)
+            {
+                (chance(rng) < 0.5 ? job.relevantBlockers : job.independentBlockers).push_back(blockerKey);
+            }
+        }
+        trace.push_back(std::move(job));
+    }
+    return trace;
+}
+
+Simulation::Simulation(Trace trace, SimulationConfig config)
+    : mTrace(std::move(trace)), mConfig(std::move(config)), mNowMicros(mConfig.startMicros)
+{
+}
+
+/// @brief Replay the whole trace, until every job has finished or no job left can make any progress
+/// @return What happened; throws std::logic_error if the simulation was already run
+SimulationReport Simulation::run()
+{
+    if (mQueue.executorStandIn)
+    {
+        throw std::logic_error("A simulation can only be run once");
+    }
+    mQueue.configure(job_queue::ConfigureInput::SetSchedulingMode{mConfig.schedulingMode});
+    mQueue.virtualClock    = [this]() { return mNowMicros; };
+    mQueue.executorStandIn = job_queue::ExecutorStandIn{
+        .execute = [this](job_executor::ExecuteInput&& input) { return execute(std::move(input)); },
+        .abandon = [this](int64_t jobId) { mRunningJobs.erase(jobId); }};
+    events::SubscriptionFilter finishedFilter;
+    finishedFilter.statuses = {kJobSucceeded, kJobFailed, kJobCanceled};
+    mFinishedJobs           = mQueue.subscribe(finishedFilter, mTrace.size() + 1).stream;
+
+    const auto period    = std::max<int64_t>(mConfig.heartbeatPeriodMicros, 1);
+    const auto wallStart = std::chrono::steady_clock::now();
+    auto       finished  = [this]() { return mNumCompleted + mNumFailed + mNumCanceled; };
+    while (true)
+    {
+        const auto numDispatched = mDispatchOrder.size();
+        const auto numFinished   = finished();
+
+        pushDueJobs();
+        completeDueJobs();
+        heartbeat();
+        takeFinishedJobs();
+
+        // Done once every job has finished, or, with nothing left to push or running, once a heartbeat changes
+        // nothing, as no later one ever will either
+        const bool idle      = canSkipHeartbeats();
+        const bool allPushed = mNextPush == mTrace.size();
+        const bool unchanged = mDispatchOrder.size() == numDispatched && finished() == numFinished;
+        if (allPushed && (finished() == mNumPushed || (mCompletions.empty() && idle && unchanged)))
+        {
+            break;
+        }
+
+        // The queue only acts on pushes, results, and timers, so heartbeats until the next of those are skipped
+        mNowMicros += period;
+        if (idle)
+        {
+            auto nextEventMicros = std::numeric_limits<int64_t>::max();
+            if (mNextPush < mTrace.size())
+            {
+                nextEventMicros = mConfig.startMicros + mTrace[mNextPush].pushMicros;
+            }
+            if (!mCompletions.empty())
+            {
+                nextEventMicros = std::min(nextEventMicros, mCompletions.top().first);
+            }
+            if (nextEventMicros != std::numeric_limits<int64_t>::max() && nextEventMicros > mNowMicros)
+            {
+                mNowMicros += (nextEventMicros - mNowMicros + period - 1) / period * period;
+            }
+        }
+    }
+    const auto wallMicros =
+        std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - wallStart).count();
+    const auto virtualMicros = mNowMicros - mConfig.startMicros;
+    const auto numRun        = mNumCompleted + mNumFailed;
+
+    SimulationReport report{.metrics = mQueue.collectStats().metrics, .dispatchOrder = mDispatchOrder};
+    auto&            metrics = report.metrics;
+    metrics["sim.jobs.pushed"]           = mNumPushed;
+    metrics["sim.jobs.rejected"]         = mNumRejected;
+    metrics["sim.jobs.completed"]        = mNumCompleted;
+    metrics["sim.jobs.failed"]           = mNumFailed;
+    metrics["sim.jobs.canceled"]         = mNumCanceled;
+    metrics["sim.jobs.stuck"]            = mNumPushed - finished();
+    metrics["sim.blockers_dropped"]      = mNumBlockersDropped;
+    metrics["sim.heartbeats"]            = mNumHeartbeats;
+    metrics["sim.virtual_us"]            = virtualMicros;
+    metrics["sim.wall_us"]               = wallMicros;
+    metrics["sim.throughput_jobs_per_s"] = virtualMicros > 0 ? numRun * 1000000 / virtualMicros : 0;
+    metrics["sim.speedup_pct"]           = wallMicros > 0 ? virtualMicros * 100 / wallMicros : 0;
+    stats::addHistogram(metrics, "sim.push_to_finish_us", mPushToFinishMicros);
+    stats::addHistogram(metrics, "sim.heartbeat_budget_pct", mHeartbeatBudgetPercent);
+    return report;
+}
+
+/// @brief Stand in for the executor: take the job if a slot is free, to finish once its run time has passed
+/// @param input Execution request from the queue, answered before returning
+/// @return Always true, like a send to a service with room in its input queue
+bool Simulation::execute(job_executor::ExecuteInput&& input)
+{
+    if (mRunningJobs.size() >= mConfig.numSlots)
+    {
+        input.setResult(services::ErrorResult{"No free execution slots"});
+        return true;
+    }
+    const auto                      jobId    = input.job.id;
+    const auto&                     traceJob = mTrace[mTraceIndices.at(jobId)];
+    std::promise<result::JobResult> jobResult;
+    input.setResult(jobResult.get_future());
+    mRunningJobs.emplace(jobId, std::move(jobResult));
+    mCompletions.emplace(mNowMicros + std::max<int64_t>(traceJob.runMicros, 0), jobId);
+    mDispatchOrder.push_back(traceJob.key);
+    return true;
+}
+
+/// @brief Push every job whose time has come, each at its own time within the heartbeat period
+void Simulation::pushDueJobs()
+{
+    const auto heartbeatMicros = mNowMicros;
+
+    // Blockers the queue would wait on forever, never having seen them or having already archived them, are dropped
+    auto blockerIds = [this](const std::vector<int64_t>& keys) {
+        std::vector<int64_t> ids;
+        for (auto key : keys)
+        {
+            auto idIt = mIdsByKey.find(key);
+            if (idIt == mIdsByKey.end() || mQueue.archivedJobs.contains(idIt->second))
+            {
+                mNumBlockersDropped++;
+                continue;
+            }
+            ids.push_back(idIt->second);
+        }
+        return ids;
+    };
+
+    while (mNextPush < mTrace.size() && mConfig.startMicros + mTrace[mNextPush].pushMicros <= heartbeatMicros)
+    {
+        const auto  traceIndex = mNextPush++;
+        const auto& traceJob   = mTrace[traceIndex];
+        mNowMicros             = mConfig.startMicros + traceJob.pushMicros;
+
+        job_queue::PushInput pushInput;
+        pushInput.job.priority            = traceJob.priority;
+        pushInput.job.kind                = traceJob.kind;
+        pushInput.job.inputs              = {std::to_string(traceJob.key)};
+        pushInput.job.relevantBlockers    = blockerIds(traceJob.relevantBlockers);
+        pushInput.job.independentBlockers = blockerIds(traceJob.independentBlockers);
+        auto pushFuture                   = pushInput.getFuture();
+        job_queue::RunningState{}.step(mQueue, mContainer, pushInput);
+
+        auto pushResult = pushFuture.get();
+        if (std::holds_alternative<services::ErrorResult>(pushResult))
+        {
+            mNumRejected++;
+            continue;
+        }
+        const auto jobId        = std::get<result::JobIdResult>(pushResult).id;
+        mIdsByKey[traceJob.key] = jobId;
+        mTraceIndices[jobId]    = traceIndex;
+        mPushTimes[jobId]       = mNowMicros;
+        mNumPushed++;
+    }
+    mNowMicros = heartbeatMicros;
+}
+
+/// @brief Hand the queue the result of every job whose run time has passed
+void Simulation::completeDueJobs()
+{
+    while (!mCompletions.empty() && mCompletions.top().first <= mNowMicros)
+    {
+        const auto jobId = mCompletions.top().second;
+        mCompletions.pop();
+
+        // Jobs the queue abandoned (timed out) have nobody waiting on their result
+        auto runningIt = mRunningJobs.find(jobId);
+        if (runningIt == mRunningJobs.end())
+        {
+            continue;
+        }
+        const auto& traceJob = mTrace[mTraceIndices.at(jobId)];
+        runningIt->second.set_value(
+            traceJob.fails ? result::JobResult{kJobFailed, std::vector<std::string>{}}
+                           : result::JobResult{kJobSucceeded, std::vector<std::string>{std::to_string(traceJob.key)}});
+        mRunningJobs.erase(runningIt);
+    }
+}
+
+/// @brief Step the queue through one heartbeat, as the daemon would, timing how much of the period it takes for real
+void Simulation::heartbeat()
+{
+    job_queue::HeartbeatInput heartbeatInput;
+    const auto                start = std::chrono::steady_clock::now();
+    job_queue::RunningState{}.step(mQueue, mContainer, heartbeatInput);
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+
+    const auto elapsedMicros = std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
+    mHeartbeatBudgetPercent.record(elapsedMicros * 100 / std::max<int64_t>(mConfig.heartbeatPeriodMicros, 1));
+    mNumHeartbeats++;
+}
+
+/// @brief Tally the jobs the last heartbeat archived
+void Simulation::takeFinishedJobs()
+{
+    for (const auto& event : mFinishedJobs->take(std::numeric_limits<size_t>::max()).events)
+    {
+        if (event.status == kJobSucceeded)
+        {
+            mNumCompleted++;
+        }
+        else if (event.status == kJobFailed)
+        {
+            mNumFailed++;
+        }
+        else
+        {
+            mNumCanceled++;
+        }
+
+        auto pushTimeIt = mPushTimes.find(event.jobId);
+        if (pushTimeIt != mPushTimes.end())
+        {
+            mPushToFinishMicros.record(event.timestampMicros - pushTimeIt->second);
+            mPushTimes.erase(pushTimeIt);
+        }
+    }
+}
+
+/// @brief Whether the queue will sit still until the next push or job result
+bool Simulation::canSkipHeartbeats() const
+{
+    // Timers and disk lookups come due on their own schedule
+    if (!mQueue.runningDeadlines.empty() || !mQueue.retryingJobs.empty() || !mQueue.scheduledJobs.empty() ||
+        !mQueue.pendingCacheLookups.empty())
+    {
+        return false;
+    }
+    // Ready jobs left behind with slots to spare (e.g. by a heartbeat over its budget) go out at the next heartbeat
+    return mRunningJobs.size() >= mConfig.numSlots ||
+           std::none_of(mQueue.pendingJobs.begin(), mQueue.pendingJobs.end(), [](const Job& job) {
+               return job.numBlockers() == 0;
+           });
+}
+
+} // namespace simulation
+
+} // end namespace orchestrator
@@ -0,0 +1,136 @@
+#include <boost/program_options.hpp>
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include "orchestrator/Simulation.h"
+
+using namespace orchestrator;
+
+int main(int argc, char* argv[])
+{
+    simulation::WorkloadModel    model;
+    simulation::SimulationConfig config;
+    std::string                  trace_path;
+    std::string                  save_path;
+    std::string                  mode_name = "priority";
+
+    boost::program_options::options_description args_desc("Options");
+    // clang-format off
+    args_desc.add_options()
+        ("help,h", "print usage")
+        ("trace,t", boost::program_options::value<std::string>(), "Replay a recorded trace rather than a generated one")
+        ("save", boost::program_options::value<std::string>(), "Write the trace out before replaying it")
+        ("slots,n", boost::program_options::value<uint32_t>(), "Jobs the executor runs at once")
+        ("heartbeat-us", boost::program_options::value<uint32_t>(), "Heartbeat period, in microseconds")
+        ("mode,m", boost::program_options::value<std::string>(),
+            "Scheduling mode: priority, critical-path, or earliest-deadline")
+        ("jobs,j", boost::program_options::value<uint32_t>(), "Generated: number of jobs")
+        ("rate,r", boost::program_options::value<double>(), "Generated: jobs pushed per second")
+        ("run-ms", boost::program_options::value<double>(), "Generated: mean job run time, in milliseconds")
+        ("blocked", boost::program_options::value<double>(), "Generated: share of jobs blocked on earlier ones")
+        ("priorities", boost::program_options::value<uint32_t>(), "Generated: number of priority levels")
+        ("failures", boost::program_options::value<double>(), "Generated: chance of a job failing")
+        ("seed,s", boost::program_options::value<uint64_t>(), "Generated: random seed");
+    // clang-format on
+
+    boost::program_options::variables_map vm;
+    boost::program_options::store(boost::program_options::parse_command_line(argc, argv, args_desc), vm);
+    boost::program_options::notify(vm);
+
+    if (vm.count("help"))
+    {
+        std::cout << args_desc << std::endl;
+        return 0;
+    }
+
+    if (vm.count("trace"))
+    {
+        trace_path = vm["trace"].as<std::string>();
+    }
+    if (vm.count("save"))
+    {
+        save_path = vm["save"].as<std::string>();
+    }
+    if (vm.count("slots"))
+    {
+        config.numSlots = std::max(vm["slots"].as<uint32_t>(), 1u);
+    }
+    if (vm.count("heartbeat-us"))
+    {
+        config.heartbeatPeriodMicros = std::max(vm["heartbeat-us"].as<uint32_t>(), 1u);
+    }
+    if (vm.count("mode"))
+    {
+        mode_name = vm["mode"].as<std::string>();
+    }
+    if (vm.count("jobs"))
+    {
+        model.numJobs = vm["jobs"].as<uint32_t>();
+    }
+    if (vm.count("rate"))
+    {
+        model.jobsPerSecond = vm["rate"].as<double>();
+    }
+    if (vm.count("run-ms"))
+    {
+        model.meanRunMillis = vm["run-ms"].as<double>();
+    }
+    if (vm.count("blocked"))
+    {
+        model.blockedFraction = vm["blocked"].as<double>();
+    }
+    if (vm.count("priorities"))
+    {
+        model.numPriorities = vm["priorities"].as<uint32_t>();
+    }
+    if (vm.count("failures"))
+    {
+        model.failureProbability = vm["failures"].as<double>();
+    }
+    if (vm.count("seed"))
+    {
+        model.seed = vm["seed"].as<uint64_t>();
+    }
+
+    const auto mode = job_queue::schedulingModeFromName(mode_name);
+    if (!mode)
+    {
+        std::cerr << "Unknown scheduling mode " << mode_name << std::endl;
+        return 1;
+    }
+    config.schedulingMode = *mode;
+
+    simulation::Trace trace;
+    if (trace_path.empty())
+    {
+        trace = simulation::generateTrace(model);
+    }
+    else
+    {
+        std::ifstream traceFile(trace_path);
+        if (!traceFile)
+        {
+            std::cerr << "Failed to open " << trace_path << std::endl;
+            return 1;
+        }
+        try
+        {
+            trace = simulation::readTrace(traceFile);
+        }
+        catch (const std::invalid_argument& e)
+        {
+            std::cerr << trace_path << ": " << e.what() << std::endl;
+            return 1;
+        }
+    }
+    if (!save_path.empty())
+    {
+        std::ofstream saveFile(save_path);
+        simulation::writeTrace(saveFile, trace);
+    }
+
+    const auto report = simulation::Simulation(std::move(trace), config).run();
+    std::cout << stats::formatMetrics("simulation", report.metrics);
+
+    return report.metrics.at("sim.jobs.stuck") == 0 ? 0 : 2;
+}
@@ -0,0 +1,114 @@
+#include "orchestrator/Stats.h"
+#include <bit>
+#include <sstream>
+
+namespace orchestrator
+{
+
+namespace stats
+{
+
+void LatencyHistogram::record(uint64_t value)
+{
+    auto& bucket = mBuckets[bucketIndex(value)];
+    bucket.store(bucket.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    mCount.add();
+    if (value > mMax.load(std::memory_order_relaxed))
+    {
+        mMax.store(value, std::memory_order_relaxed);
+    }
+}
+
+uint64_t LatencyHistogram::count() const
+{
+    return mCount.value();
+}
+
+uint64_t LatencyHistogram::max() const
+{
+    return mMax.load(std::memory_order_relaxed);
+}
+
+/// @brief Estimate a percentile of the recorded samples
+/// @param p Percentile in [0, 100]
+/// @return Upper bound of the bucket holding the requested percentile, or 0 if nothing was recorded
+uint64_t LatencyHistogram::percentile(double p) const
+{
+    const auto total = count();
+    if (total == 0)
+    {
+        return 0;
+    }
+    const auto target = static_cast<uint64_t>(p / 100.0 * static_cast<double>(total - 1)) + 1;
+
+    uint64_t seen = 0;
+    for (size_t k = 0; k < kNumBuckets; k++)
+    {
+        seen += mBuckets[k].load(std::memory_order_relaxed);
+        if (seen >= target)
+        {
+            return std::min(bucketUpperBound(k), max());
+        }
+    }
+    return max();
+}
+
+size_t LatencyHistogram::bucketIndex(uint64_t value)
+{
+    // Values below kNumSubBuckets get exact buckets; above that, the top kSubBucketBits bits after the leading one
+    // pick the sub-bucket within the value's power of two
+    if (value < kNumSubBuckets)
+    {
+        return value;
+    }
+    const int exponent = std::bit_width(value) - 1;
+    const int shift    = exponent - kSubBucketBits;
+    return kNumSubBuckets * (shift + 1) + ((value >> shift) & (kNumSubBuckets - 1));
+}
+
+uint64_t LatencyHistogram::bucketUpperBound(size_t index)
+{
+    if (index < kNumSubBuckets)
+    {
+        return index;
+    }
+    const int      shift = static_cast<int>(index / kNumSubBuckets) - 1;
+    const uint64_t lower = (kNumSubBuckets + index % kNumSubBuckets) << shift;
+    return lower + ((uint64_t{1} << shift) - 1);
+}
+
+int64_t steadyClockMicros()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+void addCounter(std::map<std::string, int64_t>& metrics, const std::string& name, const Counter& counter)
+{
+    metrics[name] = static_cast<int64_t>(counter.value());
+}
+
+void addHistogram(std::map<std::string, int64_t>& metrics, const std::string& name, const LatencyHistogram& histogram)
+{
+    metrics[name + ".count"] = static_cast<int64_t>(histogram.count());
+    metrics[name + ".p50"]   = static_cast<int64_t>(histogram.percentile(50.0));
+    metrics[name + ".p90"]   = static_cast<int64_t>(histogram.percentile(90.0));
+    metrics[name + ".p99"]   = static_cast<int64_t>(histogram.percentile(99.0));
+    metrics[name + ".max"]   = static_cast<int64_t>(histogram.max());
+}
+
+/// @brief Render a service's metrics as one "service.metric value" line each
+std::string formatMetrics(const std::string& serviceName, const std::map<std::string, int64_t>& metrics)
+{
+    std::ostringstream text;
+    for (const auto& [name, value] : metrics)
+    {
+        text << serviceName << "." << name << " " << value << "\n";
+    }
+    return text.str();
+}
+
+} // namespace stats
+
+} // end namespace orchestrator
@@ -0,0 +1,165 @@
+#include "orchestrator/TimerWheel.h"
+#include <algorithm>
+#include <bit>
+#include <limits>
+#include <stdexcept>
+
+namespace orchestrator
+{
+
+/// @brief Arrange for an ID to be returned by advance() once the given time is reached
+/// @param id Caller-defined identifier of the timer
+/// @param expirySeconds Time at which the timer fires; times in the past fire on the next advance
+void TimerWheel::schedule(int64_t id, int64_t expirySeconds)
+{
+    if (!anchored())
+    {
+        throw std::logic_error("Timer wheel must be advanced to the current time before scheduling");
+    }
+    place(Timer{.id = id, .expirySeconds = expirySeconds});
+    mSize++;
+}
+
+/// @brief Move the wheel forward to the given time, collecting every timer that expires on the way
+/// @param nowSeconds Current time; the first call only anchors the wheel to it
+/// @return IDs of expired timers
+std::vector<int64_t> TimerWheel::advance(int64_t nowSeconds)
+{
+    std::vector<int64_t> expired;
+    if (!anchored())
+    {
+        mCurrentSeconds = nowSeconds;
+        return expired;
+    }
+
+    for (const auto& timer : mDue)
+    {
+        expired.push_back(timer.id);
+    }
+    mDue.clear();
+
+    while (mCurrentSeconds < nowSeconds)
+    {
+        mCurrentSeconds = std::min(nextTickSeconds(), nowSeconds);
+        tick(expired);
+    }
+
+    mSize -= expired.size();
+    return expired;
+}
+
+bool TimerWheel::anchored() const
+{
+    return mCurrentSeconds >= 0;
+}
+
+size_t TimerWheel::size() const
+{
+    return mSize;
+}
+
+/// @brief Fire and cascade whatever is due at the current second
+/// @param expired Collects the IDs of timers that fire
+void TimerWheel::tick(std::vector<int64_t>& expired)
+{
+    // Whenever a level's slot comes around, spread its timers over the finer levels below it (top first, so that
+    // timers can trickle all the way down within a single tick)
+    if ((mCurrentSeconds & ((int64_t{1} << (kSlotBits * kNumLevels)) - 1)) == 0)
+    {
+        std::vector<Timer> overflow;
+        overflow.swap(mOverflow);
+        for (const auto& timer : overflow)
+        {
+            place(timer);
+        }
+    }
+    for (size_t level = kNumLevels - 1; level > 0; level--)
+    {
+        if ((mCurrentSeconds & ((int64_t{1} << (kSlotBits * level)) - 1)) == 0)
+        {
+            cascade(level, (mCurrentSeconds >> (kSlotBits * level)) & kSlotMask);
+        }
+    }
+
+    const size_t slotIndex = mCurrentSeconds & kSlotMask;
+    auto&        slot      = mLevels[0][slotIndex];
+    for (const auto& timer : slot)
+    {
+        expired.push_back(timer.id);
+    }
+    slot.clear();
+    mOccupied[0] &= ~(uint64_t{1} << slotIndex);
+
+    // Timers cascaded onto exactly this second land in the due list
+    for (const auto& timer : mDue)
+    {
+        expired.push_back(timer.id);
+    }
+    mDue.clear();
+}
+
+/// @brief Find the next second at which an occupied slot fires or cascades, skipping every empty one in between
+/// @return That second, or the largest representable time if the wheel is empty
+int64_t TimerWheel::nextTickSeconds() const
+{
+    // A level only holds timers later in its current rotation than the current second, so the first occupied slot past
+    // the current one is the level's next event; the overflow only cascades when the top level starts a new rotation
+    int64_t next = std::numeric_limits<int64_t>::max();
+    for (size_t level = 0; level < kNumLevels; level++)
+    {
+        const int    shift      = kSlotBits * level;
+        const size_t laterIndex = ((mCurrentSeconds >> shift) & kSlotMask) + 1;
+        if (laterIndex == kNumSlots)
+        {
+            continue;
+        }
+        const uint64_t later = mOccupied[level] & (~uint64_t{0} << laterIndex);
+        if (later != 0)
+        {
+            const int64_t rotationStart = (mCurrentSeconds >> (shift + kSlotBits)) << (shift + kSlotBits);
+            next = std::min(next, rotationStart + (static_cast<int64_t>(std::countr_zero(later)) << shift));
+        }
+    }
+    if (!mOverflow.empty())
+    {
+        const int topShift = kSlotBits * kNumLevels;
+        next               = std::min(next, ((mCurrentSeconds >> topShift) + 1) << topShift);
+    }
+    return next;
+}
+
+/// @brief File a timer on the finest level whose current rotation contains its expiry time
+void TimerWheel::place(const Timer& timer)
+{
+    if (timer.expirySeconds <= mCurrentSeconds)
+    {
+        mDue.push_back(timer);
+        return;
+    }
+    for (size_t level = 0; level < kNumLevels; level++)
+    {
+        const int shift = kSlotBits * (level + 1);
+        if ((timer.expirySeconds >> shift) == (mCurrentSeconds >> shift))
+        {
+            const size_t slotIndex = (timer.expirySeconds >> (kSlotBits * level)) & kSlotMask;
+            mLevels[level][slotIndex].push_back(timer);
+            mOccupied[level] |= uint64_t{1} << slotIndex;
+            return;
+        }
+    }
+    mOverflow.push_back(timer);
+}
+
+/// @brief Spread the timers of a slot over the finer levels below it
+void TimerWheel::cascade(size_t level, size_t slotIndex)
+{
+    std::vector<Timer> cascading;
+    cascading.swap(mLevels[level][slotIndex]);
+    mOccupied[level] &= ~(uint64_t{1} << slotIndex);
+    for (const auto& timer : cascading)
+    {
+        place(timer);
+    }
+}
+
+} // end namespace orchestrator
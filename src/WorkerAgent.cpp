@@ -0,0 +1,187 @@
+#include "orchestrator/WorkerAgent.h"
+#include <algorithm>
+#include <exception>
+#include <stdexcept>
+
+namespace orchestrator
+{
+
+namespace agents
+{
+
+namespace
+{
+
+// How long to wait before trying again to reach a server that could not be reached
+static constexpr auto kReconnectDelay = std::chrono::seconds(1);
+
+} // namespace
+
+/// @brief Set up an agent; it does nothing until run()
+/// @param host IPv4 address of the orchestratord to take jobs from
+/// @param port Port orchestratord serves RPC requests on
+/// @param name Name the agent goes by in orchestratord's logs and stats
+/// @param numSlots How many jobs may run at once
+/// @param runner Runs each job on a worker thread
+/// @param token Agent token of the server; only needed when not connecting over the loopback interface
+WorkerAgent::WorkerAgent(std::string             host,
+                         uint16_t                port,
+                         std::string             name,
+                         size_t                  numSlots,
+                         job_executor::JobRunner runner,
+                         std::string             token)
+    : mHost(std::move(host))
+    , mPort(port)
+    , mName(std::move(name))
+    , mNumSlots(std::max<size_t>(numSlots, 1))
+    , mRunner(std::move(runner))
+    , mToken(std::move(token))
+{
+}
+
+WorkerAgent::~WorkerAgent()
+{
+    stop();
+}
+
+/// @brief Take and run jobs until stop(), reconnecting whenever the server goes away
+void WorkerAgent::run()
+{
+    while (!mStopping)
+    {
+        try
+        {
+            rpc::RpcClient client(mHost, mPort);
+            serve(client);
+        }
+        catch (const std::exception&)
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            mFinished.wait_for(lock, kReconnectDelay, [this]() { return mStopping.load(); });
+        }
+    }
+    for (auto& worker : mWorkers)
+    {
+        worker.wait();
+    }
+}
+
+/// @brief Make run() return once it is done with its current poll; jobs still running are waited for
+void WorkerAgent::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mStopping = true;
+    }
+    mFinished.notify_all();
+}
+
+/// @brief How many jobs have finished running, whether or not their results made it back
+size_t WorkerAgent::numJobsRun() const
+{
+    return mNumJobsRun;
+}
+
+/// @brief Register with the server and poll it for jobs until stopped or the server forgets about this agent
+/// @param client Connection to the server
+void WorkerAgent::serve(rpc::RpcClient& client)
+{
+    std::string registration;
+    rpc::Writer registrationWriter(registration);
+    registrationWriter.string(mToken);
+    registrationWriter.string(mName);
+    registrationWriter.u32(static_cast<uint32_t>(mNumSlots));
+    auto reply = client.call(rpc::Method::AGENT_REGISTER, registration);
+    if (reply.code != static_cast<uint8_t>(rpc::Status::OK))
+    {
+        throw std::runtime_error(reply.payload);
+    }
+    rpc::Reader registrationReader(reply.payload);
+    const auto  agentId      = registrationReader.i64();
+    const auto  pollInterval = std::chrono::milliseconds(registrationReader.i64()) / 3;
+    {
+        // Whatever finished under an earlier registration has been handed to other agents by now
+        std::lock_guard<std::mutex> lock(mMutex);
+        mResults.clear();
+    }
+
+    while (!mStopping)
+    {
+        reapWorkers();
+        std::vector<std::pair<int64_t, result::JobResult>> results;
+        size_t                                             numRunning = 0;
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            results.swap(mResults);
+            numRunning = mNumRunning;
+        }
+        // With nothing running there is nothing to report until new jobs arrive, so the server may hold on to the poll
+        const auto maxWait = numRunning == 0 && results.empty() ? pollInterval : std::chrono::milliseconds(0);
+
+        std::string poll;
+        rpc::Writer writer(poll);
+        writer.string(mToken);
+        writer.i64(agentId);
+        writer.u32(static_cast<uint32_t>(mNumSlots - std::min(numRunning, mNumSlots)));
+        writer.u32(static_cast<uint32_t>(maxWait.count()));
+        writer.u32(static_cast<uint32_t>(results.size()));
+        for (const auto& [jobId, jobResult] : results)
+        {
+            writer.i64(jobId);
+            writeJobResult(writer, jobResult);
+        }
+        reply = client.call(rpc::Method::AGENT_POLL, poll);
+        if (reply.code != static_cast<uint8_t>(rpc::Status::OK))
+        {
+            return;
+        }
+        for (auto& job : rpc::Reader(reply.payload).jobs())
+        {
+            launch(std::move(job));
+        }
+
+        std::unique_lock<std::mutex> lock(mMutex);
+        if (mNumRunning > 0)
+        {
+            mFinished.wait_for(lock, pollInterval, [this]() { return !mResults.empty() || mStopping; });
+        }
+    }
+}
+
+void WorkerAgent::launch(Job job)
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mNumRunning++;
+    }
+    mWorkers.push_back(std::async(std::launch::async, [this, job = std::move(job)]() {
+        result::JobResult jobResult;
+        try
+        {
+            jobResult = mRunner(job);
+        }
+        catch (const std::exception& e)
+        {
+            jobResult = result::JobResult{aapis::orchestrator::v1::JobStatus::JOB_STATUS_ERROR,
+                                          std::vector<std::string>{e.what()}};
+        }
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mResults.emplace_back(job.id, std::move(jobResult));
+            mNumRunning--;
+        }
+        mNumJobsRun++;
+        mFinished.notify_all();
+    }));
+}
+
+void WorkerAgent::reapWorkers()
+{
+    std::erase_if(mWorkers, [](const std::future<void>& worker) {
+        return worker.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+    });
+}
+
+} // namespace agents
+
+} // end namespace orchestrator
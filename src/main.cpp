@@ -1,19 +1,96 @@
 #include <boost/program_options.hpp>
+#include <csignal>
+#include <cstdlib>
 #include <iostream>
+#include <thread>
+#include <utility>
 #include <mscpp/ServiceFactory.h>
 #include "orchestrator/JobQueue.h"
+#include "orchestrator/OrchestratorApi.h"
+#include "orchestrator/RpcServer.h"
+
+using namespace orchestrator;
+
+namespace
+{
+
+// Every job queue shard is its own service type, so the factory has to know about all of them up front
+template<typename ShardIndices>
+struct ShardedServiceFactory;
+
+template<size_t... ShardIndices>
+struct ShardedServiceFactory<std::index_sequence<ShardIndices...>>
+{
+    using Type = services::ServiceFactory<job_queue::JobQueue,
+                                          job_queue::JobQueueShard<ShardIndices + 1>...,
+                                          job_executor::JobExecutor,
+                                          job_database::JobDatabase>;
+
+    static std::vector<std::shared_ptr<job_queue::JobQueue>> jobQueues(Type& factory, size_t numShards)
+    {
+        std::vector<std::shared_ptr<job_queue::JobQueue>> shards{
+            factory.template get<job_queue::JobQueue>(),
+            factory.template get<job_queue::JobQueueShard<ShardIndices + 1>>()...};
+        shards.resize(numShards);
+        return shards;
+    }
+};
+
+using ServiceFactory = ShardedServiceFactory<std::make_index_sequence<job_queue::kMaxShards - 1>>;
+
+// Print every service's metrics once they have all answered
+void dumpStats(OrchestratorApi& api)
+{
+    auto pendingDump = api.statsDump();
+    auto dump        = pendingDump();
+    while (!dump)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        dump = pendingDump();
+    }
+    std::cout << dump->payload << std::flush;
+}
+
+} // namespace
 
 int main(int argc, char* argv[])
 {
-    uint32_t port_number = 4444;
-    uint32_t num_threads = 4;
+    uint32_t    port_number  = 4444;
+    uint32_t    num_threads  = 4;
+    uint32_t    num_shards   = 1;
+    std::string socket_path  = "/tmp/orchestratord.sock";
+    std::string bind_address = "127.0.0.1";
+    bool        use_agents   = false;
+    std::string spill_dir;
+    uint64_t    spill_threshold = 1 << 20;
+    std::string mode_name       = "priority";
+    uint64_t    result_cache    = 0;
+    uint64_t    cache_tier      = job_database::Store::kDefaultResultCacheCapacity;
+    bool        coalesce        = false;
 
     boost::program_options::options_description args_desc("Options");
     // clang-format off
     args_desc.add_options()
         ("help,h", "print usage")
         ("port,p", boost::program_options::value<uint32_t>(), "Port to serve requests on")
-        ("num-allowed-threads,n", boost::program_options::value<uint32_t>(), "Number of concurrent threads to leverage");
+        ("num-allowed-threads,n", boost::program_options::value<uint32_t>(), "Number of concurrent threads to leverage")
+        ("socket,s", boost::program_options::value<std::string>(), "Unix-domain socket path; empty disables")
+        ("shards", boost::program_options::value<uint32_t>(), "Number of job queue shards (threads) partitioning jobs")
+        ("bind,b", boost::program_options::value<std::string>(),
+            "IPv4 address to serve requests on, e.g. 0.0.0.0; the job API has no authentication of its own")
+        ("agents", "Run jobs on worker agents (orchestrator-agent) instead of locally; agents on other hosts must "
+            "present the token in $ORCHESTRATOR_AGENT_TOKEN")
+        ("spill-dir", boost::program_options::value<std::string>(), "Directory to spill large job outputs to")
+        ("spill-threshold", boost::program_options::value<uint64_t>(), "Size (bytes) from which outputs are spilled")
+        ("mode,m", boost::program_options::value<std::string>(),
+            "Scheduling mode: priority, critical-path, or earliest-deadline")
+        ("result-cache", boost::program_options::value<uint64_t>(),
+            "Size (bytes) of each shard's cache of job results, reused for jobs with the same kind and inputs; "
+            "0 (the default) disables it")
+        ("result-cache-tier", boost::program_options::value<uint64_t>(),
+            "Size (bytes) of the database's second tier behind the result caches, which is not persisted; 0 disables "
+            "it")
+        ("coalesce", "Run identical (same kind and inputs) ready jobs once, sharing the result between them");
     // clang-format on
 
     boost::program_options::variables_map vm;
@@ -34,10 +111,173 @@ int main(int argc, char* argv[])
     {
         num_threads = vm["num-allowed-threads"].as<uint32_t>();
     }
+    if (vm.count("socket"))
+    {
+        socket_path = vm["socket"].as<std::string>();
+    }
+    if (vm.count("shards"))
+    {
+        num_shards = vm["shards"].as<uint32_t>();
+    }
+    if (vm.count("bind"))
+    {
+        bind_address = vm["bind"].as<std::string>();
+    }
+    if (vm.count("agents"))
+    {
+        use_agents = true;
+    }
+    if (vm.count("spill-dir"))
+    {
+        spill_dir = vm["spill-dir"].as<std::string>();
+    }
+    if (vm.count("spill-threshold"))
+    {
+        spill_threshold = vm["spill-threshold"].as<uint64_t>();
+    }
+    if (vm.count("mode"))
+    {
+        mode_name = vm["mode"].as<std::string>();
+    }
+    if (vm.count("result-cache"))
+    {
+        result_cache = vm["result-cache"].as<uint64_t>();
+    }
+    if (vm.count("result-cache-tier"))
+    {
+        cache_tier = vm["result-cache-tier"].as<uint64_t>();
+    }
+    if (vm.count("coalesce"))
+    {
+        coalesce = true;
+    }
+    const auto scheduling_mode = job_queue::schedulingModeFromName(mode_name);
+    if (!scheduling_mode)
+    {
+        std::cerr << "Unknown scheduling mode " << mode_name << std::endl;
+        return 1;
+    }
+    if (num_shards < 1 || num_shards > job_queue::kMaxShards)
+    {
+        std::cerr << "The number of shards must be between 1 and " << job_queue::kMaxShards << std::endl;
+        return 1;
+    }
+
+    // Signals are taken synchronously by the main thread, so block them before any other thread starts
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    sigaddset(&signals, SIGUSR1);
+    pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
+    ServiceFactory::Type factory;
+    auto                 jobQueues   = ServiceFactory::jobQueues(factory, num_shards);
+    auto                 jobExecutor = factory.get<job_executor::JobExecutor>();
+    auto                 jobDatabase = factory.get<job_database::JobDatabase>();
+
+    // Shards must know their place before their first heartbeat hands out job IDs
+    auto shardRouter = std::make_shared<job_queue::ShardRouter>(num_shards);
+    for (size_t k = 0; k < jobQueues.size(); k++)
+    {
+        job_queue::ConfigureInput shardConfig;
+        shardConfig.config = job_queue::ConfigureInput::SetSharding{shardRouter, k};
+        auto configured    = shardConfig.getFuture();
+        jobQueues[k]->sendInput(std::move(shardConfig));
+        configured.wait();
+    }
+
+    for (auto& jobQueue : jobQueues)
+    {
+        job_queue::ConfigureInput modeConfig;
+        modeConfig.config = job_queue::ConfigureInput::SetSchedulingMode{*scheduling_mode};
+        jobQueue->sendInput(std::move(modeConfig));
+
+        job_queue::ConfigureInput cacheConfig;
+        const bool diskTier = result_cache > 0 && cache_tier > 0;
+        cacheConfig.config  = job_queue::ConfigureInput::SetResultCache{result_cache, diskTier};
+        jobQueue->sendInput(std::move(cacheConfig));
+
+        job_queue::ConfigureInput coalescingConfig;
+        coalescingConfig.config = job_queue::ConfigureInput::SetJobCoalescing{coalesce};
+        jobQueue->sendInput(std::move(coalescingConfig));
+    }
+
+    job_database::ConfigureInput databaseConfig;
+    databaseConfig.config = job_database::ConfigureInput::SetResultCacheCapacity{cache_tier};
+    jobDatabase->sendInput(std::move(databaseConfig));
+
+    job_executor::ConfigureInput executorConfig;
+    executorConfig.config = job_executor::ConfigureInput::SetNumSlots{num_threads};
+    jobExecutor->sendInput(std::move(executorConfig));
+
+    std::shared_ptr<agents::AgentPool> agentPool;
+    if (use_agents)
+    {
+        // Without a token, only agents on this host may connect
+        const char* agent_token = std::getenv("ORCHESTRATOR_AGENT_TOKEN");
+        agentPool               = std::make_shared<agents::AgentPool>(
+            agents::AgentPool::kDefaultLease, agents::AgentPool::kDefaultLocalityWait, agent_token ? agent_token : "");
+        job_executor::ConfigureInput agentsConfig;
+        agentsConfig.config = job_executor::ConfigureInput::SetAgentPool{agentPool};
+        jobExecutor->sendInput(std::move(agentsConfig));
+    }
+
+    std::shared_ptr<outputs::OutputStore> outputStore;
+    if (!spill_dir.empty())
+    {
+        outputStore = std::make_shared<outputs::OutputStore>(spill_dir, spill_threshold);
+        for (auto& jobQueue : jobQueues)
+        {
+            job_queue::ConfigureInput spillConfig;
+            spillConfig.config = job_queue::ConfigureInput::SetOutputStore{outputStore};
+            jobQueue->sendInput(std::move(spillConfig));
+        }
+        job_executor::ConfigureInput loadConfig;
+        loadConfig.config = job_executor::ConfigureInput::SetOutputStore{outputStore};
+        jobExecutor->sendInput(std::move(loadConfig));
+    }
+
+    OrchestratorApi api(jobQueues, shardRouter, jobExecutor, jobDatabase, agentPool, outputStore);
+    rpc::RpcServer  server(
+        static_cast<uint16_t>(port_number), [&api](rpc::Frame& request) { return api.handle(request); }, bind_address);
+    api.setWakeCallback([&server]() { server.wake(); });
+    if (!socket_path.empty())
+    {
+        server.listenUnix(socket_path);
+    }
 
-    // services::ServiceFactory<orchestrator::job_queue::JobQueue> factory;
+    // Heartbeats drive every service's state machine forward
+    std::atomic_bool stopping{false};
+    std::thread      heartbeats([&]() {
+        static constexpr auto kHeartbeatPeriod = std::chrono::milliseconds(10);
+        while (!stopping)
+        {
+            for (auto& jobQueue : jobQueues)
+            {
+                jobQueue->sendInput(job_queue::HeartbeatInput{});
+            }
+            jobExecutor->sendInput(job_executor::HeartbeatInput{});
+            jobDatabase->sendInput(job_database::HeartbeatInput{});
+            std::this_thread::sleep_for(kHeartbeatPeriod);
+        }
+    });
+    std::thread serving([&server]() { server.run(); });
+
+    std::cout << "orchestratord listening on " << bind_address << ":" << server.port()
+              << (socket_path.empty() ? "" : " and " + socket_path) << " (SIGUSR1 dumps stats)" << std::endl;
+
+    int signal = 0;
+    while (sigwait(&signals, &signal) == 0 && signal == SIGUSR1)
+    {
+        dumpStats(api);
+    }
 
-    // TODO initialization
+    server.stop();
+    serving.join();
+    stopping = true;
+    heartbeats.join();
+    dumpStats(api);
 
     return 0;
 }
@@ -0,0 +1,223 @@
+#include <boost/test/unit_test.hpp>
+#include <thread>
+#include "orchestrator/AgentPool.h"
+#include "orchestrator/JobQueue.h"
+#include "orchestrator/RpcClient.h"
+#include "orchestrator/RpcServer.h"
+#include "orchestrator/WorkerAgent.h"
+
+using namespace orchestrator;
+
+namespace
+{
+
+constexpr auto kJobSucceeded = aapis::orchestrator::v1::JobStatus::JOB_STATUS_QUEUED;
+
+int64_t registerAgent(rpc::RpcClient& client, const std::string& name, uint32_t numSlots)
+{
+    std::string payload;
+    rpc::Writer writer(payload);
+    writer.string("");
+    writer.string(name);
+    writer.u32(numSlots);
+    auto reply = client.call(rpc::Method::AGENT_REGISTER, payload);
+    BOOST_REQUIRE_EQUAL(reply.code, static_cast<uint8_t>(rpc::Status::OK));
+    return rpc::Reader(reply.payload).i64();
+}
+
+rpc::Frame poll(rpc::RpcClient&                                           client,
+                int64_t                                                   agentId,
+                uint32_t                                                  freeSlots,
+                const std::vector<std::pair<int64_t, result::JobResult>>& results = {})
+{
+    std::string payload;
+    rpc::Writer writer(payload);
+    writer.string("");
+    writer.i64(agentId);
+    writer.u32(freeSlots);
+    writer.u32(0);
+    writer.u32(static_cast<uint32_t>(results.size()));
+    for (const auto& [jobId, jobResult] : results)
+    {
+        writer.i64(jobId);
+        agents::writeJobResult(writer, jobResult);
+    }
+    return client.call(rpc::Method::AGENT_POLL, payload);
+}
+
+std::vector<int64_t> jobIds(const rpc::Frame& reply)
+{
+    std::vector<int64_t> ids;
+    for (const auto& job : rpc::Reader(reply.payload).jobs())
+    {
+        ids.push_back(job.id);
+    }
+    return ids;
+}
+
+Job makeJob(int64_t id)
+{
+    Job job;
+    job.id     = id;
+    job.status = kJobSucceeded;
+    return job;
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_SUITE(TestAgentPool)
+
+BOOST_AUTO_TEST_CASE(TestAgentPoolLeasesAndReassignment)
+{
+    agents::AgentPool pool(std::chrono::milliseconds(200), std::chrono::milliseconds(0));
+    rpc::RpcServer    server(0, [&pool](rpc::Frame& request) { return pool.handle(request); });
+    std::thread       serving([&server]() { server.run(); });
+
+    BOOST_CHECK_EQUAL(pool.freeSlots(), 0);
+    rpc::RpcClient first(server.port());
+    const auto     firstId = registerAgent(first, "first", 2);
+    BOOST_CHECK_EQUAL(pool.freeSlots(), 2);
+
+    auto result1 = pool.submit(makeJob(1));
+    auto result2 = pool.submit(makeJob(2));
+    auto result3 = pool.submit(makeJob(3));
+    BOOST_CHECK(jobIds(poll(first, firstId, 2)) == std::vector<int64_t>({1, 2}));
+
+    // The first agent goes quiet, so once its lease lapses its jobs are handed out again ahead of the one still waiting
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+    BOOST_CHECK_EQUAL(pool.expireAgents(), 1);
+    rpc::RpcClient second(server.port());
+    const auto     secondId = registerAgent(second, "second", 4);
+    BOOST_CHECK(jobIds(poll(second, secondId, 4)) == std::vector<int64_t>({1, 2, 3}));
+
+    // The lost agent is turned away, and nothing it ran counts any longer
+    const result::JobResult lateResult{kJobSucceeded, std::vector<std::string>{"late"}};
+    BOOST_CHECK_EQUAL(poll(first, firstId, 2, {{1, lateResult}}).code, static_cast<uint8_t>(rpc::Status::ERROR));
+    BOOST_CHECK(result1.wait_for(std::chrono::seconds(0)) == std::future_status::timeout);
+
+    const result::JobResult onTimeResult{kJobSucceeded, std::vector<std::string>{"on time"}};
+    BOOST_CHECK(poll(second, secondId, 1, {{1, onTimeResult}}).payload.size() > 0);
+    BOOST_REQUIRE(result1.wait_for(std::chrono::seconds(0)) == std::future_status::ready);
+    BOOST_CHECK(std::get<std::vector<std::string>>(result1.get().outputs) == std::vector<std::string>{"on time"});
+
+    // An abandoned job frees its slot, and its eventual result is ignored
+    BOOST_CHECK(pool.abandon(2));
+    BOOST_CHECK(!pool.contains(2));
+    BOOST_CHECK_EQUAL(poll(second, secondId, 2, {{2, onTimeResult}}).code, static_cast<uint8_t>(rpc::Status::OK));
+    BOOST_CHECK(pool.contains(3));
+    BOOST_CHECK_EQUAL(pool.freeSlots(), 3);
+
+    std::map<std::string, int64_t> metrics;
+    pool.addStats(metrics);
+    BOOST_CHECK_EQUAL(metrics["agents.reassignments"], 2);
+    BOOST_CHECK_EQUAL(metrics["agents.lost"], 1);
+    BOOST_CHECK_EQUAL(metrics["agents.stale_results"], 1);
+
+    server.stop();
+    serving.join();
+}
+
+BOOST_AUTO_TEST_CASE(TestAgentPoolPrefersAgentHoldingOutputs)
+{
+    // Dependents hold out far longer than the test takes for the agent that ran their blocker
+    agents::AgentPool pool(agents::AgentPool::kDefaultLease, std::chrono::seconds(60));
+    rpc::RpcServer    server(0, [&pool](rpc::Frame& request) { return pool.handle(request); });
+    std::thread       serving([&server]() { server.run(); });
+
+    auto runAs = [](const std::string& name) {
+        return [name](const Job&) { return result::JobResult{kJobSucceeded, std::vector<std::string>{name}}; };
+    };
+    agents::WorkerAgent      first("127.0.0.1", server.port(), "first", 1, runAs("first"));
+    agents::WorkerAgent      second("127.0.0.1", server.port(), "second", 1, runAs("second"));
+    std::vector<std::thread> running;
+    running.emplace_back([&first]() { first.run(); });
+    running.emplace_back([&second]() { second.run(); });
+    for (int k = 0; k < 1000 && pool.freeSlots() < 2; k++)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    BOOST_REQUIRE_EQUAL(pool.freeSlots(), 2);
+
+    // Jobs reach the pool through a job queue, just as they do in the daemon
+    job_queue::Store queue;
+    auto             runReadyJobs = [&]() {
+        for (const auto& job : queue.pendingJobs)
+        {
+            if (job.numBlockers() == 0)
+            {
+                queue.pendingJobResults.emplace(job.id, pool.submit(job));
+            }
+        }
+        std::erase_if(queue.pendingJobs, [](const Job& j) { return j.numBlockers() == 0; });
+        for (int k = 0; k < 2000 && !queue.pendingJobResults.empty(); k++)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+            queue.processPendingJobResults(false);
+        }
+        BOOST_REQUIRE(queue.pendingJobResults.empty());
+    };
+
+    Job  blocker;
+    auto blockerId = queue.addAndRegisterNewJob(blocker, false);
+    for (int k = 0; k < 4; k++)
+    {
+        Job dependent;
+        dependent.relevantBlockers = {blockerId};
+        queue.addAndRegisterNewJob(dependent, false);
+    }
+    runReadyJobs();
+    BOOST_REQUIRE_EQUAL(queue.pendingJobs.size(), 4);
+    for (const auto& dependent : queue.pendingJobs)
+    {
+        BOOST_CHECK(dependent.relevantBlockers.empty());
+        BOOST_CHECK(dependent.consumedBlockers == std::vector<int64_t>{blockerId});
+    }
+    runReadyJobs();
+
+    first.stop();
+    second.stop();
+    for (auto& agent : running)
+    {
+        agent.join();
+    }
+    // Whichever agent ran the blocker ran every dependent too
+    BOOST_CHECK_EQUAL(std::max(first.numJobsRun(), second.numJobsRun()), 5);
+    BOOST_CHECK_EQUAL(std::min(first.numJobsRun(), second.numJobsRun()), 0);
+
+    std::map<std::string, int64_t> metrics;
+    pool.addStats(metrics);
+    BOOST_CHECK_EQUAL(metrics["agents.local_dispatches"], 4);
+
+    server.stop();
+    serving.join();
+}
+
+BOOST_AUTO_TEST_CASE(TestAgentPoolAuthenticatesRemoteAgents)
+{
+    auto registration = [](const std::string& token, bool fromLocalPeer) {
+        rpc::Frame  request{.requestId     = 1,
+                            .code          = static_cast<uint8_t>(rpc::Method::AGENT_REGISTER),
+                            .payload       = {},
+                            .fromLocalPeer = fromLocalPeer};
+        rpc::Writer writer(request.payload);
+        writer.string(token);
+        writer.string("agent");
+        writer.u32(1);
+        return request;
+    };
+    auto statusOf = [](agents::AgentPool& pool, rpc::Frame request) { return (*pool.handle(request)()).status; };
+
+    // Without a token of its own, a pool only takes agents on this host
+    agents::AgentPool localOnly;
+    BOOST_CHECK(statusOf(localOnly, registration("", true)) == rpc::Status::OK);
+    BOOST_CHECK(statusOf(localOnly, registration("", false)) == rpc::Status::ERROR);
+    BOOST_CHECK(statusOf(localOnly, registration("guess", false)) == rpc::Status::ERROR);
+
+    agents::AgentPool withToken(agents::AgentPool::kDefaultLease, agents::AgentPool::kDefaultLocalityWait, "secret");
+    BOOST_CHECK(statusOf(withToken, registration("secret", false)) == rpc::Status::OK);
+    BOOST_CHECK(statusOf(withToken, registration("secreT", false)) == rpc::Status::ERROR);
+    BOOST_CHECK(statusOf(withToken, registration("secret!", false)) == rpc::Status::ERROR);
+    BOOST_CHECK_EQUAL(withToken.freeSlots(), 1);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
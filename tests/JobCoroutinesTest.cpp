@@ -0,0 +1,178 @@
+#include <boost/test/unit_test.hpp>
+#include <unistd.h>
+#include <atomic>
+#include <thread>
+#include "orchestrator/JobCoroutines.h"
+#include "orchestrator/JobExecutor.h"
+
+using namespace orchestrator;
+
+namespace
+{
+
+constexpr auto kJobSucceeded = aapis::orchestrator::v1::JobStatus::JOB_STATUS_COMPLETE;
+constexpr auto kJobFailed    = aapis::orchestrator::v1::JobStatus::JOB_STATUS_ERROR;
+
+result::JobResult succeedWith(std::string output)
+{
+    return result::JobResult{kJobSucceeded, std::vector<std::string>{std::move(output)}};
+}
+
+std::vector<std::string> outputsOf(const result::JobResult& jobResult)
+{
+    return std::get<std::vector<std::string>>(jobResult.outputs);
+}
+
+job_coroutines::JobTask sleepThenSucceed(std::chrono::milliseconds delay, std::string output)
+{
+    co_await job_coroutines::sleepFor(delay);
+    co_return succeedWith(std::move(output));
+}
+
+job_coroutines::JobTask fail()
+{
+    throw std::runtime_error("no good");
+    co_return succeedWith("unreachable");
+}
+
+// Waits on children both one at a time and all at once, then reads what another thread writes to a pipe
+job_coroutines::JobTask parent(int readFd)
+{
+    auto first = co_await sleepThenSucceed(std::chrono::milliseconds(1), "a");
+
+    std::vector<job_coroutines::JobTask> children;
+    children.push_back(sleepThenSucceed(std::chrono::milliseconds(20), "b"));
+    children.push_back(sleepThenSucceed(std::chrono::milliseconds(10), "c"));
+    children.push_back(fail());
+    auto results = co_await job_coroutines::whenAll(std::move(children));
+
+    auto offloaded = co_await job_coroutines::offload([]() { return succeedWith("d"); });
+
+    co_await job_coroutines::readable(readFd);
+    char byte = 0;
+    if (read(readFd, &byte, 1) != 1)
+    {
+        co_return result::JobResult{kJobFailed, std::vector<std::string>{}};
+    }
+
+    co_return result::JobResult{kJobSucceeded,
+                                std::vector<std::string>{outputsOf(first)[0],
+                                                         outputsOf(results[0])[0],
+                                                         outputsOf(results[1])[0],
+                                                         outputsOf(results[2])[0],
+                                                         outputsOf(offloaded)[0],
+                                                         std::string(1, byte)}};
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_SUITE(TestJobCoroutines)
+
+BOOST_AUTO_TEST_CASE(TestCoroutineSchedulerRunsWaitingTasksOnFewThreads)
+{
+    constexpr size_t kNumTasks = 2000;
+
+    std::atomic_size_t numSucceeded{0};
+    const auto         start = std::chrono::steady_clock::now();
+    {
+        job_coroutines::CoroutineScheduler scheduler(2);
+        for (size_t k = 0; k < kNumTasks; k++)
+        {
+            scheduler.spawn(sleepThenSucceed(std::chrono::milliseconds(50), std::to_string(k)),
+                            [&numSucceeded](result::JobResult jobResult) {
+                                if (jobResult.resultStatus == kJobSucceeded)
+                                {
+                                    numSucceeded++;
+                                }
+                            });
+        }
+        while (scheduler.numTasks() > 0)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+
+        std::map<std::string, int64_t> metrics;
+        scheduler.addStats(metrics);
+        BOOST_CHECK_EQUAL(metrics["coroutines.threads"], 2);
+        BOOST_CHECK_EQUAL(metrics["coroutines.timer_waits_total"], kNumTasks);
+    }
+    // Waiting tasks hold no thread, so they all wait at once rather than two at a time
+    BOOST_CHECK_EQUAL(numSucceeded, kNumTasks);
+    BOOST_CHECK(std::chrono::steady_clock::now() - start < std::chrono::seconds(10));
+
+    // Tasks still waiting when the scheduler goes away are destroyed along with it
+    {
+        job_coroutines::CoroutineScheduler scheduler(1);
+        scheduler.spawn(sleepThenSucceed(std::chrono::hours(1), "never"), [](result::JobResult) {});
+        BOOST_CHECK_EQUAL(scheduler.numTasks(), 1);
+    }
+    BOOST_CHECK_THROW(job_coroutines::CoroutineScheduler::current(), std::logic_error);
+}
+
+BOOST_AUTO_TEST_CASE(TestJobTasksAwaitChildrenWorkAndFileDescriptors)
+{
+    int fds[2];
+    BOOST_REQUIRE_EQUAL(pipe(fds), 0);
+    std::thread writer([fd = fds[1]]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        BOOST_CHECK_EQUAL(write(fd, "e", 1), 1);
+    });
+
+    auto jobResult = job_coroutines::runToCompletion(parent(fds[0]));
+    writer.join();
+    close(fds[0]);
+    close(fds[1]);
+
+    // A child that throws fails rather than taking its parent down with it
+    BOOST_CHECK(jobResult.resultStatus == kJobSucceeded);
+    BOOST_CHECK(outputsOf(jobResult) == std::vector<std::string>({"a", "b", "c", "no good", "d", "e"}));
+}
+
+BOOST_AUTO_TEST_CASE(TestJobExecutorRunsCoroutineJobsBeyondItsSlots)
+{
+    job_executor::Store s;
+    s.numSlots = 1;
+    s.configure(job_executor::ConfigureInput::SetCoroutineCapacity{1, 100});
+
+    auto execute = [&s](int64_t id, std::vector<std::string> inputs) {
+        job_executor::ExecuteInput executeInput;
+        executeInput.job.id     = id;
+        executeInput.job.kind   = job_kinds::DelayJob::kId;
+        executeInput.job.inputs = std::move(inputs);
+        auto future             = executeInput.getFuture();
+        s.execute(executeInput);
+        return future.get();
+    };
+
+    std::vector<result::FutureJobResult> delayed;
+    for (int64_t id = 1; id <= 100; id++)
+    {
+        auto executeResult = execute(id, {"30", std::to_string(id)});
+        BOOST_REQUIRE(std::holds_alternative<result::FutureJobResult>(executeResult));
+        delayed.push_back(std::move(std::get<result::FutureJobResult>(executeResult)));
+    }
+    BOOST_CHECK_EQUAL(s.coroutineJobs.size(), 100);
+    BOOST_CHECK(s.runningJobs.empty());
+    BOOST_CHECK(std::holds_alternative<services::ErrorResult>(execute(101, {"30"})));
+    BOOST_CHECK(std::holds_alternative<services::ErrorResult>(execute(1, {"30"})));
+
+    for (int64_t id = 1; id <= 100; id++)
+    {
+        auto jobResult = delayed[id - 1].get();
+        BOOST_CHECK(jobResult.resultStatus == kJobSucceeded);
+        BOOST_CHECK(outputsOf(jobResult) == std::vector<std::string>{std::to_string(id)});
+    }
+
+    s.reapFinishedJobs();
+    while (!s.coroutineJobs.empty())
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        s.reapFinishedJobs();
+    }
+    BOOST_CHECK(s.runningJobKinds.empty());
+    auto metrics = s.collectStats().metrics;
+    BOOST_CHECK_EQUAL(metrics["coroutines.threads"], 1);
+    BOOST_CHECK_EQUAL(metrics["launches"], 100);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,118 @@
+#include <boost/test/unit_test.hpp>
+#include <algorithm>
+#include <iterator>
+#include "orchestrator/JobDatabase.h"
+
+using namespace orchestrator;
+
+namespace
+{
+
+constexpr auto kJobSucceeded = aapis::orchestrator::v1::JobStatus::JOB_STATUS_COMPLETE;
+
+// Steps the database through one input, returning its answer
+template<typename Input>
+typename Input::ResultType step(job_database::Store& s, Input input)
+{
+    job_database::Container c;
+    auto                    future = input.getFuture();
+    job_database::ForeverState().step(s, c, input);
+    return future.get();
+}
+
+std::optional<result::JobResult> loadCachedResult(job_database::Store& s, const ResultCacheKey& key)
+{
+    job_database::LoadCachedResult loadInput;
+    loadInput.key = key;
+    return std::get<result::OptionalJobResult>(step(s, std::move(loadInput))).result;
+}
+
+void storeCachedResult(job_database::Store& s, const ResultCacheKey& key, std::vector<std::string> outputs)
+{
+    job_database::StoreCachedResult storeInput;
+    storeInput.key    = key;
+    storeInput.result = result::JobResult{kJobSucceeded, std::move(outputs)};
+    step(s, std::move(storeInput));
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_SUITE(TestJobDatabase)
+
+BOOST_AUTO_TEST_CASE(TestJobDatabaseKeepsEachShardsLatestDump)
+{
+    job_database::Store s;
+    auto dumpShard = [&s](size_t shardIndex, std::vector<int64_t> jobIds) {
+        job_database::DumpQueueData dumpInput;
+        dumpInput.shardIndex = shardIndex;
+        for (auto jobId : jobIds)
+        {
+            Job job;
+            job.id = jobId;
+            dumpInput.pendingJobs.push_back(job);
+        }
+        step(s, std::move(dumpInput));
+    };
+    auto loadedIds = [&s]() {
+        auto                 queueData = std::get<result::JobQueueDataResult>(step(s, job_database::LoadQueueData{}));
+        std::vector<int64_t> pendingIds, runningIds;
+        std::ranges::transform(queueData.pendingJobs.jobs, std::back_inserter(pendingIds), &Job::id);
+        std::ranges::transform(queueData.runningJobs.jobs, std::back_inserter(runningIds), &Job::id);
+        return std::make_pair(pendingIds, runningIds);
+    };
+
+    BOOST_CHECK(loadedIds().first.empty());
+
+    // A shard's dump replaces only that shard's, and the load hands back every shard's in shard order
+    dumpShard(1, {21, 22});
+    dumpShard(0, {11});
+    dumpShard(1, {23});
+    job_database::DumpRunningJobs runningInput;
+    runningInput.runningJobs.resize(1);
+    runningInput.runningJobs[0].id = 31;
+    step(s, std::move(runningInput));
+
+    auto [pendingIds, runningIds] = loadedIds();
+    BOOST_CHECK(pendingIds == std::vector<int64_t>({11, 23}));
+    BOOST_CHECK(runningIds == std::vector<int64_t>({31}));
+
+    // Loading leaves the dumps in place, so every shard reloading sees the same jobs
+    BOOST_CHECK(loadedIds().first == pendingIds);
+    step(s, job_database::DumpRunningJobs{});
+    BOOST_CHECK(loadedIds().second.empty());
+
+    auto metrics = s.collectStats().metrics;
+    BOOST_CHECK_EQUAL(metrics["dumps"], 5);
+    BOOST_CHECK_EQUAL(metrics["loads"], 4);
+}
+
+BOOST_AUTO_TEST_CASE(TestJobDatabaseResultCacheIsBounded)
+{
+    job_database::Store s;
+    const auto          one = ResultCache::keyOf(0, {"1"});
+    const auto          two = ResultCache::keyOf(0, {"2"});
+
+    storeCachedResult(s, one, {std::string(1000, 'a')});
+    auto cached = loadCachedResult(s, one);
+    BOOST_REQUIRE(cached.has_value());
+    BOOST_CHECK(std::get<std::vector<std::string>>(cached->outputs) ==
+                std::vector<std::string>{std::string(1000, 'a')});
+    BOOST_CHECK(!loadCachedResult(s, ResultCache::keyOf(1, {"1"})).has_value());
+
+    // With room for only one of them, the least recently used result goes
+    job_database::ConfigureInput configureInput;
+    configureInput.config = job_database::ConfigureInput::SetResultCacheCapacity{1500};
+    step(s, std::move(configureInput));
+    storeCachedResult(s, two, {std::string(1000, 'b')});
+    BOOST_CHECK(!loadCachedResult(s, one).has_value());
+    BOOST_CHECK(loadCachedResult(s, two).has_value());
+
+    auto metrics = s.collectStats().metrics;
+    BOOST_CHECK_EQUAL(metrics["cached_results"], 1);
+    BOOST_CHECK_EQUAL(metrics["cached_results.evictions"], 1);
+    BOOST_CHECK_LE(metrics["cached_results.bytes"], 1500);
+    BOOST_CHECK_EQUAL(metrics["cache_hits"], 2);
+    BOOST_CHECK_EQUAL(metrics["cache_misses"], 2);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
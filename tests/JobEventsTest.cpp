@@ -0,0 +1,90 @@
+#include <boost/test/unit_test.hpp>
+#include <thread>
+#include "orchestrator/JobEvents.h"
+
+using orchestrator::events::EventStream;
+using orchestrator::events::JobEvent;
+using orchestrator::events::SubscriptionFilter;
+
+namespace
+{
+
+JobEvent event(int64_t jobId, aapis::orchestrator::v1::JobStatus status, int64_t priority = 0)
+{
+    return JobEvent{.jobId = jobId, .status = status, .priority = priority, .timestampMicros = 0};
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_SUITE(TestJobEvents)
+
+BOOST_AUTO_TEST_CASE(TestJobEventsFilterAndCoalesce)
+{
+    SubscriptionFilter filter;
+    filter.priorities = {1};
+    EventStream stream(filter, 2);
+
+    stream.publish({event(10, aapis::orchestrator::v1::JobStatus::JOB_STATUS_QUEUED, 1),
+                    event(11, aapis::orchestrator::v1::JobStatus::JOB_STATUS_QUEUED, 2),
+                    event(12, aapis::orchestrator::v1::JobStatus::JOB_STATUS_QUEUED, 1),
+                    event(10, aapis::orchestrator::v1::JobStatus::JOB_STATUS_ACTIVE, 1)});
+    // Job 10's second event replaces its first in place rather than taking up more room
+    stream.publish({event(13, aapis::orchestrator::v1::JobStatus::JOB_STATUS_QUEUED, 1),
+                    event(12, aapis::orchestrator::v1::JobStatus::JOB_STATUS_COMPLETE, 1)});
+
+    BOOST_CHECK(stream.ready());
+    auto batch = stream.take(1);
+    BOOST_CHECK_EQUAL(batch.numDropped, 1);
+    BOOST_REQUIRE_EQUAL(batch.events.size(), 1);
+    BOOST_CHECK_EQUAL(batch.events[0].jobId, 10);
+    BOOST_CHECK_EQUAL(batch.events[0].status, aapis::orchestrator::v1::JobStatus::JOB_STATUS_ACTIVE);
+
+    // Job 12 keeps coalescing in the position it was left in after the partial take
+    stream.publish({event(12, aapis::orchestrator::v1::JobStatus::JOB_STATUS_ERROR, 1)});
+    batch = stream.take(10);
+    BOOST_CHECK_EQUAL(batch.numDropped, 0);
+    BOOST_REQUIRE_EQUAL(batch.events.size(), 1);
+    BOOST_CHECK_EQUAL(batch.events[0].jobId, 12);
+    BOOST_CHECK_EQUAL(batch.events[0].status, aapis::orchestrator::v1::JobStatus::JOB_STATUS_ERROR);
+    BOOST_CHECK(!stream.ready());
+}
+
+BOOST_AUTO_TEST_CASE(TestJobEventsWaitAndClose)
+{
+    EventStream stream({}, EventStream::kDefaultCapacity);
+    BOOST_CHECK(stream.waitAndTake(10, std::chrono::milliseconds(1)).events.empty());
+
+    std::thread publisher([&]() {
+        stream.publish({event(1, aapis::orchestrator::v1::JobStatus::JOB_STATUS_QUEUED)});
+        stream.close();
+    });
+    auto batch = stream.waitAndTake(10, std::chrono::seconds(10));
+    publisher.join();
+    BOOST_REQUIRE_EQUAL(batch.events.size(), 1);
+    BOOST_CHECK_EQUAL(batch.events[0].jobId, 1);
+
+    // Nothing gets in once closed, and the subscriber is told so as soon as it has everything
+    stream.publish({event(2, aapis::orchestrator::v1::JobStatus::JOB_STATUS_QUEUED)});
+    batch = stream.take(10);
+    BOOST_CHECK(batch.events.empty());
+    BOOST_CHECK(batch.closed);
+}
+
+BOOST_AUTO_TEST_CASE(TestJobEventsListener)
+{
+    SubscriptionFilter filter;
+    filter.jobIds = {1};
+    EventStream stream(filter, EventStream::kDefaultCapacity);
+    int         numCalls = 0;
+    stream.setListener([&]() { numCalls++; });
+
+    // Only publishes that leave something to take, and closing, call the listener
+    stream.publish({event(2, aapis::orchestrator::v1::JobStatus::JOB_STATUS_QUEUED)});
+    BOOST_CHECK_EQUAL(numCalls, 0);
+    stream.publish({event(1, aapis::orchestrator::v1::JobStatus::JOB_STATUS_QUEUED)});
+    BOOST_CHECK_EQUAL(numCalls, 1);
+    stream.close();
+    BOOST_CHECK_EQUAL(numCalls, 2);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,145 @@
+#include <boost/test/unit_test.hpp>
+#include <future>
+#include <thread>
+#include "orchestrator/JobDatabase.h"
+#include "orchestrator/JobExecutor.h"
+
+using namespace orchestrator;
+
+namespace
+{
+
+constexpr auto kJobFailed    = aapis::orchestrator::v1::JobStatus::JOB_STATUS_ERROR;
+constexpr auto kJobSucceeded = aapis::orchestrator::v1::JobStatus::JOB_STATUS_COMPLETE;
+
+Job makeJob(int64_t id, std::vector<std::string> inputs)
+{
+    Job job;
+    job.id     = id;
+    job.inputs = std::move(inputs);
+    return job;
+}
+
+// Hands a job to the executor, returning its answer: the future result or an error
+job_executor::ExecuteInput::ResultType execute(job_executor::Store& s, const Job& job)
+{
+    job_executor::ExecuteInput executeInput;
+    executeInput.job = job;
+    auto future      = executeInput.getFuture();
+    s.execute(executeInput);
+    return future.get();
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_SUITE(TestJobExecutor)
+
+BOOST_AUTO_TEST_CASE(TestJobExecutorRejectsJobsBeyondItsSlots)
+{
+    job_executor::Store s;
+    std::promise<void>  finish;
+    auto                finished = finish.get_future().share();
+    s.numSlots                   = 2;
+    s.runner                     = [finished](const Job& job) {
+        finished.wait();
+        return job_executor::Store::echoJob(job);
+    };
+
+    auto first = execute(s, makeJob(1, {"1"}));
+    BOOST_REQUIRE(std::holds_alternative<result::FutureJobResult>(first));
+    BOOST_REQUIRE(std::holds_alternative<result::FutureJobResult>(execute(s, makeJob(2, {"2"}))));
+
+    // A job already running, or one with every slot taken, is turned away for the queue to offer again later
+    BOOST_CHECK(std::holds_alternative<services::ErrorResult>(execute(s, makeJob(1, {"1"}))));
+    BOOST_CHECK(std::holds_alternative<services::ErrorResult>(execute(s, makeJob(3, {"3"}))));
+
+    // Abandoning a job lets go of its result, but its worker can't be stopped and keeps the slot until it finishes
+    BOOST_CHECK(s.abandon(2));
+    BOOST_CHECK(!s.abandon(2));
+    BOOST_CHECK_EQUAL(s.abandonedJobs.size(), 1);
+    BOOST_CHECK(std::holds_alternative<services::ErrorResult>(execute(s, makeJob(3, {"3"}))));
+    BOOST_CHECK_EQUAL(s.collectStats().metrics["slots.abandoned"], 1);
+
+    finish.set_value();
+    auto firstResult = std::get<result::FutureJobResult>(first).get();
+    BOOST_CHECK(firstResult.resultStatus == kJobSucceeded);
+    BOOST_CHECK(std::get<std::vector<std::string>>(firstResult.outputs) == std::vector<std::string>{"1"});
+    auto reapAll = [&s]() {
+        while (!s.runningJobs.empty() || !s.abandonedJobs.empty())
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            s.reapFinishedJobs();
+        }
+    };
+    reapAll();
+    auto third = execute(s, makeJob(3, {"3"}));
+    BOOST_REQUIRE(std::holds_alternative<result::FutureJobResult>(third));
+    BOOST_CHECK(std::get<result::FutureJobResult>(third).get().resultStatus == kJobSucceeded);
+    reapAll();
+
+    auto metrics = s.collectStats().metrics;
+    BOOST_CHECK_EQUAL(metrics["launches"], 3);
+    BOOST_CHECK_EQUAL(metrics["rejections"], 3);
+    BOOST_CHECK_EQUAL(metrics["abandons"], 1);
+    BOOST_CHECK_EQUAL(metrics["slots.running"], 0);
+    BOOST_CHECK_EQUAL(metrics["run_us.count"], 2);
+}
+
+BOOST_AUTO_TEST_CASE(TestJobExecutorFailsJobsWhoseRunnerThrows)
+{
+    job_executor::Store s;
+    s.runner = [](const Job&) -> result::JobResult { throw std::runtime_error("no such input"); };
+
+    auto answer = execute(s, makeJob(1, {}));
+    BOOST_REQUIRE(std::holds_alternative<result::FutureJobResult>(answer));
+    auto jobResult = std::get<result::FutureJobResult>(answer).get();
+    BOOST_CHECK(jobResult.resultStatus == kJobFailed);
+    BOOST_CHECK(std::get<std::vector<std::string>>(jobResult.outputs) == std::vector<std::string>{"no such input"});
+}
+
+BOOST_AUTO_TEST_CASE(TestJobExecutorDumpsRunningJobsForReexecution)
+{
+    job_executor::Store s;
+    std::promise<void>  finish;
+    auto                finished = finish.get_future().share();
+    s.runner                     = [finished](const Job& job) {
+        finished.wait();
+        return job_executor::Store::echoJob(job);
+    };
+
+    for (int64_t id : {1, 2})
+    {
+        BOOST_REQUIRE(std::holds_alternative<result::FutureJobResult>(execute(s, makeJob(id, {"input"}))));
+    }
+    auto inFlight = s.jobsInFlight();
+    BOOST_REQUIRE_EQUAL(inFlight.size(), 2);
+    BOOST_CHECK_EQUAL(inFlight[0].id, 1);
+    BOOST_CHECK(inFlight[1].inputs == std::vector<std::string>{"input"});
+
+    // The database hands dumped jobs back to the queue as the ones to re-execute
+    job_database::Store           database;
+    job_database::Container       c;
+    job_database::DumpRunningJobs dumpInput;
+    dumpInput.runningJobs = inFlight;
+    job_database::ForeverState().step(database, c, dumpInput);
+    job_database::LoadQueueData loadInput;
+    auto                        loaded = loadInput.getFuture();
+    job_database::ForeverState().step(database, c, loadInput);
+    auto queueData = std::get<result::JobQueueDataResult>(loaded.get());
+    BOOST_CHECK(queueData.pendingJobs.jobs.empty());
+    BOOST_REQUIRE_EQUAL(queueData.runningJobs.jobs.size(), 2);
+    BOOST_CHECK_EQUAL(queueData.runningJobs.jobs[1].id, 2);
+
+    // Finished and abandoned jobs no longer count as running
+    BOOST_CHECK(s.abandon(1));
+    finish.set_value();
+    while (!s.runningJobs.empty() || !s.abandonedJobs.empty())
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        s.reapFinishedJobs();
+    }
+    BOOST_CHECK(s.jobsInFlight().empty());
+    BOOST_CHECK(job_executor::Store::echoJob(makeJob(3, {"x"})).resultStatus == kJobSucceeded);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
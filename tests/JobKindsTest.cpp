@@ -0,0 +1,121 @@
+#include <boost/test/unit_test.hpp>
+#include <thread>
+#include "orchestrator/JobExecutor.h"
+#include "orchestrator/JobKinds.h"
+
+using namespace orchestrator;
+
+namespace
+{
+
+constexpr auto kJobSucceeded = aapis::orchestrator::v1::JobStatus::JOB_STATUS_COMPLETE;
+constexpr auto kJobFailed    = aapis::orchestrator::v1::JobStatus::JOB_STATUS_ERROR;
+
+// Adds up its inputs, which it insists are numbers
+struct SumJob
+{
+    static constexpr uint32_t kId             = 7;
+    static constexpr size_t   kMaxConcurrency = 2;
+
+    using Args = std::vector<int>;
+
+    static Args parse(const Job& job)
+    {
+        Args args;
+        for (const auto& input : job.inputs)
+        {
+            args.push_back(std::stoi(input));
+        }
+        return args;
+    }
+    static result::JobResult run(Args& args)
+    {
+        int sum = 0;
+        for (auto arg : args)
+        {
+            sum += arg;
+        }
+        return result::JobResult{kJobSucceeded, std::vector<std::string>{std::to_string(sum)}};
+    }
+};
+
+using TestKinds = job_kinds::JobKindSet<job_kinds::EchoJob, SumJob>;
+
+Job makeJob(int64_t id, uint32_t kind, std::vector<std::string> inputs)
+{
+    Job job;
+    job.id     = id;
+    job.kind   = kind;
+    job.inputs = std::move(inputs);
+    return job;
+}
+
+std::vector<std::string> outputsOf(const result::JobResult& jobResult)
+{
+    return std::get<std::vector<std::string>>(jobResult.outputs);
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_SUITE(TestJobKinds)
+
+BOOST_AUTO_TEST_CASE(TestJobKindSetDispatch)
+{
+    static_assert(TestKinds::size() == 2);
+    static_assert(TestKinds::indexOf(SumJob::kId) == 1);
+    static_assert(TestKinds::indexOf(3) == TestKinds::size());
+    static_assert(TestKinds::maxConcurrency(TestKinds::indexOf(SumJob::kId)) == 2);
+
+    // Arguments are parsed once up front, and the prepared job runs as its own kind
+    auto preparedJob = TestKinds::prepare(1, makeJob(1, SumJob::kId, {"1", "2", "39"}));
+    BOOST_CHECK(std::holds_alternative<job_kinds::Prepared<SumJob>>(preparedJob));
+    BOOST_CHECK(outputsOf(TestKinds::run(preparedJob)) == std::vector<std::string>{"42"});
+
+    BOOST_CHECK(outputsOf(TestKinds::runJob(makeJob(2, job_kinds::EchoJob::kId, {"a", "b"}))) ==
+                std::vector<std::string>({"a", "b"}));
+    BOOST_CHECK_THROW(TestKinds::runJob(makeJob(3, 3, {})), std::invalid_argument);
+    BOOST_CHECK_THROW(TestKinds::runJob(makeJob(4, SumJob::kId, {"x"})), std::invalid_argument);
+}
+
+BOOST_AUTO_TEST_CASE(TestJobExecutorRunsJobKinds)
+{
+    job_executor::Store s;
+
+    auto execute = [&s](const Job& job) {
+        job_executor::ExecuteInput executeInput;
+        executeInput.job = job;
+        auto future      = executeInput.getFuture();
+        s.execute(executeInput);
+        return future.get();
+    };
+
+    auto sleeping = execute(makeJob(1, job_kinds::SleepJob::kId, {"20"}));
+    BOOST_REQUIRE(std::holds_alternative<result::FutureJobResult>(sleeping));
+    BOOST_CHECK_EQUAL(s.runningJobKinds.size(), 1);
+    BOOST_CHECK_EQUAL(s.numRunningPerKind[job_kinds::JobKinds::indexOf(job_kinds::SleepJob::kId)], 1);
+    auto sleepResult = std::get<result::FutureJobResult>(sleeping).get();
+    BOOST_CHECK(sleepResult.resultStatus == kJobSucceeded);
+
+    // Malformed jobs and jobs of unknown kinds fail outright, without taking up a slot
+    for (const auto& invalidJob : {makeJob(2, job_kinds::SleepJob::kId, {"soon"}), makeJob(3, 99, {})})
+    {
+        auto failing = execute(invalidJob);
+        BOOST_REQUIRE(std::holds_alternative<result::FutureJobResult>(failing));
+        BOOST_CHECK(std::get<result::FutureJobResult>(failing).get().resultStatus == kJobFailed);
+    }
+
+    auto echoing = execute(makeJob(4, job_kinds::EchoJob::kId, {"hi"}));
+    BOOST_REQUIRE(std::holds_alternative<result::FutureJobResult>(echoing));
+    BOOST_CHECK(outputsOf(std::get<result::FutureJobResult>(echoing).get()) == std::vector<std::string>{"hi"});
+
+    s.reapFinishedJobs();
+    while (!s.runningJobs.empty())
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        s.reapFinishedJobs();
+    }
+    BOOST_CHECK(s.runningJobKinds.empty());
+    BOOST_CHECK_EQUAL(s.collectStats().metrics["invalid_jobs"], 2);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
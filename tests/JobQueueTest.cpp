@@ -2,6 +2,26 @@
 #include <mscpp/ServiceFactory.h>
 #include "orchestrator/JobQueue.h"
 
+using orchestrator::Job;
+using orchestrator::job_queue::Store;
+
+namespace
+{
+
+// Hand a registered job off as if the executor had accepted it, returning the promise standing in for the executor
+std::promise<orchestrator::result::JobResult> dispatch(Store& s, int64_t jobId)
+{
+    std::promise<orchestrator::result::JobResult> promise;
+    std::erase_if(s.pendingJobs, [&](const Job& j) { return j.id == jobId; });
+    s.pendingJobResults.emplace(jobId, promise.get_future());
+    return promise;
+}
+
+// The queue treats any non-error result status as success
+constexpr auto kJobSucceeded = aapis::orchestrator::v1::JobStatus::JOB_STATUS_QUEUED;
+
+} // namespace
+
 BOOST_AUTO_TEST_SUITE(TestJobQueue)
 
 BOOST_AUTO_TEST_CASE(TestJobQueueInsertionIds)
@@ -19,4 +39,527 @@ BOOST_AUTO_TEST_CASE(TestJobQueueInsertionIds)
     // }
 }
 
+BOOST_AUTO_TEST_CASE(TestJobQueueChildJobCycleCancelsDependent)
+{
+    Store s;
+    Job   parent;
+    auto  parentId = s.addAndRegisterNewJob(parent, false);
+    Job   dependent;
+    dependent.independentBlockers = {parentId};
+    auto dependentId              = s.addAndRegisterNewJob(dependent, false);
+
+    // The parent spawns a child that waits on the parent's own dependent
+    auto promise = dispatch(s, parentId);
+    Job  child;
+    child.independentBlockers = {dependentId};
+    promise.set_value({kJobSucceeded, std::vector<Job>{child}});
+    s.processPendingJobResults(false);
+
+    // Both the dependent and the child waiting on it can never run
+    BOOST_CHECK(s.pendingJobResults.empty());
+    BOOST_CHECK(s.pendingJobs.empty());
+    BOOST_CHECK_EQUAL(s.archivedJobs.at(dependentId).status, aapis::orchestrator::v1::JobStatus::JOB_STATUS_CANCELED);
+}
+
+BOOST_AUTO_TEST_CASE(TestJobQueueErrorCancelsTransitively)
+{
+    Store s;
+    Job   root;
+    auto  rootId = s.addAndRegisterNewJob(root, false);
+    Job   child;
+    child.relevantBlockers = {rootId};
+    auto childId           = s.addAndRegisterNewJob(child, false);
+    Job  grandchild;
+    grandchild.independentBlockers = {childId};
+    auto grandchildId              = s.addAndRegisterNewJob(grandchild, false);
+    Job  unrelated;
+    auto unrelatedId = s.addAndRegisterNewJob(unrelated, false);
+
+    auto promise = dispatch(s, rootId);
+    promise.set_value({aapis::orchestrator::v1::JobStatus::JOB_STATUS_ERROR, std::vector<std::string>{}});
+    s.processPendingJobResults(false);
+
+    BOOST_REQUIRE_EQUAL(s.pendingJobs.size(), 1);
+    BOOST_CHECK_EQUAL(s.pendingJobs.front().id, unrelatedId);
+    BOOST_CHECK_EQUAL(s.archivedJobs.at(rootId).status, aapis::orchestrator::v1::JobStatus::JOB_STATUS_ERROR);
+    BOOST_CHECK_EQUAL(s.archivedJobs.at(childId).status, aapis::orchestrator::v1::JobStatus::JOB_STATUS_CANCELED);
+    BOOST_CHECK_EQUAL(s.archivedJobs.at(grandchildId).status,
+                      aapis::orchestrator::v1::JobStatus::JOB_STATUS_CANCELED);
+    BOOST_CHECK(s.jobDependents.empty());
+}
+
+BOOST_AUTO_TEST_CASE(TestJobQueueCriticalPathOrdering)
+{
+    Store s;
+    Job   shortChain;
+    auto  shortChainId = s.addAndRegisterNewJob(shortChain, false);
+    Job   longChain;
+    auto  longChainId = s.addAndRegisterNewJob(longChain, false);
+    Job   middle;
+    middle.relevantBlockers = {longChainId};
+    auto middleId           = s.addAndRegisterNewJob(middle, false);
+    Job  tail;
+    tail.independentBlockers = {middleId};
+    s.addAndRegisterNewJob(tail, false);
+
+    BOOST_CHECK_EQUAL(s.pendingJobs.front().id, shortChainId);
+
+    s.configure(orchestrator::job_queue::ConfigureInput::SetSchedulingMode{
+        orchestrator::job_queue::SchedulingMode::CRITICAL_PATH});
+    BOOST_CHECK_EQUAL(s.pendingJobs.front().id, longChainId);
+    BOOST_CHECK_EQUAL(s.criticalPathLengths.at(longChainId), 3);
+}
+
+BOOST_AUTO_TEST_CASE(TestJobQueueCoalescesIdenticalJobs)
+{
+    Store s;
+    s.configure(orchestrator::job_queue::ConfigureInput::SetJobCoalescing{true});
+    Job primary;
+    primary.inputs = {"x"};
+    auto primaryId = s.addAndRegisterNewJob(primary, false);
+    auto promise   = dispatch(s, primaryId);
+
+    // An identical push while the first copy runs costs no queue slot of its own
+    Job duplicate;
+    duplicate.inputs = {"x"};
+    auto duplicateId = s.addAndRegisterNewJob(duplicate, false);
+    BOOST_CHECK(s.pendingJobs.empty());
+    BOOST_CHECK(s.hasActiveJob(duplicateId));
+    Job dependent;
+    dependent.relevantBlockers = {duplicateId};
+    s.addAndRegisterNewJob(dependent, false);
+
+    promise.set_value({kJobSucceeded, std::vector<std::string>{"y"}});
+    s.processPendingJobResults(false);
+
+    BOOST_CHECK(s.archivedJobs.contains(primaryId));
+    BOOST_CHECK(s.archivedJobs.contains(duplicateId));
+    BOOST_REQUIRE_EQUAL(s.pendingJobs.size(), 1);
+    BOOST_CHECK_EQUAL(s.pendingJobs.front().numBlockers(), 0);
+    BOOST_CHECK(s.pendingJobs.front().inputs == std::vector<std::string>{"y"});
+}
+
+BOOST_AUTO_TEST_CASE(TestJobQueueDoesNotCoalesceOnHashAlone)
+{
+    Store s;
+    s.configure(orchestrator::job_queue::ConfigureInput::SetJobCoalescing{true});
+    Job primary;
+    primary.inputs = {"x"};
+    auto primaryId = s.addAndRegisterNewJob(primary, false);
+
+    // Make the queued job's inputs differ from those of a job whose hash matches it
+    s.coalescingPrimaryKeys.at(primaryId).inputs = {"z"};
+    Job other;
+    other.inputs = {"x"};
+    s.addAndRegisterNewJob(other, false);
+
+    BOOST_CHECK_EQUAL(s.pendingJobs.size(), 2);
+    BOOST_CHECK(s.coalescedWaiters.empty());
+}
+
+BOOST_AUTO_TEST_CASE(TestJobQueueKindsDoNotShareResults)
+{
+    Store                              s;
+    orchestrator::job_queue::Container c;
+    s.configure(orchestrator::job_queue::ConfigureInput::SetJobCoalescing{true});
+    s.configure(orchestrator::job_queue::ConfigureInput::SetResultCache{.capacityBytes = 1 << 20, .diskTier = false});
+    Job first;
+    first.inputs = {"x"};
+    auto firstId = s.addAndRegisterNewJob(first, false);
+    BOOST_CHECK(!s.resolveFromResultCache(s.pendingJobs.front(), c));
+    auto promise = dispatch(s, firstId);
+
+    // Identical inputs pushed for another kind neither wait on the running job nor reuse its result
+    Job other;
+    other.kind   = 1;
+    other.inputs = {"x"};
+    s.addAndRegisterNewJob(other, false);
+    BOOST_CHECK(s.coalescedWaiters.empty());
+    BOOST_REQUIRE_EQUAL(s.pendingJobs.size(), 1);
+
+    promise.set_value({kJobSucceeded, std::vector<std::string>{"y"}});
+    s.processPendingJobResults(false);
+    BOOST_CHECK(!s.resolveFromResultCache(s.pendingJobs.front(), c));
+
+    // While a job of the same kind does
+    Job same;
+    same.inputs = {"x"};
+    s.addAndRegisterNewJob(same, false);
+    BOOST_CHECK(s.resolveFromResultCache(s.pendingJobs.back(), c));
+}
+
+BOOST_AUTO_TEST_CASE(TestJobQueueRecurringJobs)
+{
+    Store s;
+    Job   recurring;
+    recurring.inputs = {"tick"};
+    Job blocked;
+    blocked.independentBlockers = {0};
+    BOOST_CHECK_THROW(s.scheduleJob(blocked, 0, 60, false), std::runtime_error);
+
+    // A start time in the past is released on the next heartbeat, and the next run is lined up after now
+    auto scheduleId = s.scheduleJob(recurring, 0, 3600, false);
+    BOOST_CHECK(s.pendingJobs.empty());
+    s.releaseScheduledJobs(false);
+    BOOST_REQUIRE_EQUAL(s.pendingJobs.size(), 1);
+    BOOST_CHECK(s.pendingJobs.front().inputs == recurring.inputs);
+    BOOST_CHECK_NE(s.pendingJobs.front().id, scheduleId);
+    BOOST_CHECK_EQUAL(s.jobTimers.size(), 1);
+    BOOST_CHECK_GT(s.scheduledJobs.at(scheduleId).nextRunSeconds, s.pendingJobs.front().spawnTimeSeconds);
+
+    BOOST_CHECK(s.hasActiveJob(scheduleId));
+    BOOST_CHECK(s.cancelJobs(scheduleId) == std::vector<int64_t>{scheduleId});
+    BOOST_CHECK(!s.hasActiveJob(scheduleId));
+}
+
+BOOST_AUTO_TEST_CASE(TestJobQueueSchedulesSurviveDumpAndLoad)
+{
+    namespace job_database = orchestrator::job_database;
+
+    static constexpr int64_t kStartSeconds = 1700000000;
+    int64_t                  nowSeconds    = kStartSeconds;
+    auto                     virtualClock  = [&nowSeconds]() { return nowSeconds * 1000000; };
+
+    Store before;
+    before.virtualClock = virtualClock;
+    Job recurring;
+    recurring.inputs = {"hourly"};
+    Job once;
+    once.inputs = {"once"};
+    Job queued;
+    queued.inputs          = {"queued"};
+    const auto recurringId = before.scheduleJob(recurring, kStartSeconds + 60, 3600, false);
+    const auto onceId      = before.scheduleJob(once, kStartSeconds + 120, 0, false);
+    before.addAndRegisterNewJob(queued, false);
+
+    // The database keeps the dump for the queue to load after a restart
+    job_database::Store     database;
+    job_database::Container c;
+    auto                    dumpInput = before.dumpQueueData();
+    job_database::ForeverState().step(database, c, dumpInput);
+    job_database::LoadQueueData loadInput;
+    auto                        loaded = loadInput.getFuture();
+    job_database::ForeverState().step(database, c, loadInput);
+    BOOST_CHECK_EQUAL(database.collectStats().metrics["dumped.scheduled_jobs"], 2);
+
+    nowSeconds += 30;
+    Store after;
+    after.virtualClock = virtualClock;
+    after.loadQueueData(std::get<orchestrator::result::JobQueueDataResult>(loaded.get()));
+    BOOST_REQUIRE_EQUAL(after.pendingJobs.size(), 1);
+    BOOST_CHECK(after.pendingInitExecs.empty());
+    BOOST_CHECK_EQUAL(after.scheduledJobs.size(), 2);
+    BOOST_CHECK_EQUAL(after.jobTimers.size(), 2);
+    BOOST_CHECK(after.hasActiveJob(recurringId));
+    BOOST_CHECK(after.hasActiveJob(onceId));
+
+    // Each schedule still comes due at its original time, and the recurring one is lined up again after running
+    nowSeconds = kStartSeconds + 60;
+    after.releaseScheduledJobs(false);
+    BOOST_REQUIRE_EQUAL(after.pendingJobs.size(), 2);
+    BOOST_CHECK(after.pendingJobs.back().inputs == recurring.inputs);
+    BOOST_CHECK_EQUAL(after.scheduledJobs.at(recurringId).nextRunSeconds, kStartSeconds + 60 + 3600);
+
+    nowSeconds = kStartSeconds + 120;
+    after.releaseScheduledJobs(false);
+    BOOST_REQUIRE_EQUAL(after.pendingJobs.size(), 3);
+    BOOST_CHECK(after.pendingJobs.back().inputs == once.inputs);
+    BOOST_CHECK(!after.hasActiveJob(onceId));
+
+    // New IDs keep clear of the loaded schedules', and the schedules can still be canceled
+    Job later;
+    BOOST_CHECK_GT(after.addAndRegisterNewJob(later, false), std::max(recurringId, onceId));
+    BOOST_CHECK(after.cancelJobs(recurringId) == std::vector<int64_t>{recurringId});
+    BOOST_CHECK(after.scheduledJobs.empty());
+}
+
+BOOST_AUTO_TEST_CASE(TestJobQueueRetriesTimedOutJobsWithBackoff)
+{
+    static constexpr int64_t kStartSeconds = 1700000000;
+    int64_t                  nowSeconds    = kStartSeconds;
+    std::vector<int64_t>     abandoned;
+
+    Store                              s;
+    orchestrator::job_queue::Container c;
+    s.virtualClock    = [&nowSeconds]() { return nowSeconds * 1000000; };
+    s.executorStandIn = orchestrator::job_queue::ExecutorStandIn{
+        .execute = [](orchestrator::job_executor::ExecuteInput&&) { return false; },
+        .abandon = [&abandoned](int64_t jobId) { abandoned.push_back(jobId); }};
+    // The first heartbeat anchors the timer wheel that backoffs are waited out on
+    s.releaseScheduledJobs(false);
+
+    Job flaky;
+    flaky.timeoutSeconds = 10;
+    flaky.maxRetries     = 2;
+    auto flakyId         = s.addAndRegisterNewJob(flaky, false);
+    Job  dependent;
+    dependent.independentBlockers = {flakyId};
+    auto dependentId              = s.addAndRegisterNewJob(dependent, false);
+
+    // Hands the job over as if the executor had taken it, which starts the clock on its timeout
+    auto run = [&s](int64_t jobId) {
+        auto jobIt = std::ranges::find(s.pendingJobs, jobId, &Job::id);
+        BOOST_REQUIRE(jobIt != s.pendingJobs.end());
+        const Job job     = *jobIt;
+        auto      promise = dispatch(s, jobId);
+        s.trackDeadline(job);
+        return promise;
+    };
+
+    // Each timeout takes the job off the executor, freeing its slot, and puts it back in line under the same ID once
+    // a backoff that doubles with every retry has passed
+    int64_t backoffSeconds = 1;
+    for (size_t attempt = 0; attempt < 2; attempt++)
+    {
+        auto promise = run(flakyId);
+        nowSeconds += flaky.timeoutSeconds - 1;
+        s.reapExpiredJobs(c, false);
+        BOOST_CHECK_EQUAL(abandoned.size(), attempt);
+        nowSeconds++;
+        s.reapExpiredJobs(c, false);
+        BOOST_REQUIRE_EQUAL(abandoned.size(), attempt + 1);
+        BOOST_CHECK_EQUAL(abandoned.back(), flakyId);
+        BOOST_CHECK(s.pendingJobResults.empty());
+        BOOST_CHECK(s.retryingJobs.contains(flakyId));
+        BOOST_CHECK(s.hasActiveJob(flakyId));
+
+        nowSeconds += backoffSeconds - 1;
+        s.releaseScheduledJobs(false);
+        BOOST_CHECK(s.retryingJobs.contains(flakyId));
+        nowSeconds++;
+        s.releaseScheduledJobs(false);
+        BOOST_CHECK(s.retryingJobs.empty());
+        BOOST_CHECK_EQUAL(std::ranges::find(s.pendingJobs, flakyId, &Job::id)->numRetries, attempt + 1);
+        backoffSeconds *= 2;
+    }
+
+    // Out of retries, the job fails like any other, taking its dependent down with it
+    auto promise = run(flakyId);
+    nowSeconds += flaky.timeoutSeconds;
+    s.reapExpiredJobs(c, false);
+    BOOST_CHECK_EQUAL(abandoned.size(), 3);
+    BOOST_CHECK(s.retryingJobs.empty());
+    BOOST_CHECK_EQUAL(s.archivedJobs.at(flakyId).status, aapis::orchestrator::v1::JobStatus::JOB_STATUS_ERROR);
+    BOOST_CHECK_EQUAL(s.archivedJobs.at(dependentId).status, aapis::orchestrator::v1::JobStatus::JOB_STATUS_CANCELED);
+    BOOST_CHECK_EQUAL(s.collectStats().metrics["timeouts"], 3);
+
+    // However many retries a job allows, its backoff stays capped at an hour
+    Job persistent;
+    persistent.timeoutSeconds = 1;
+    persistent.numRetries     = 100;
+    persistent.maxRetries     = 1000;
+    auto persistentId         = s.addAndRegisterNewJob(persistent, false);
+    auto persistentPromise    = run(persistentId);
+    nowSeconds += persistent.timeoutSeconds;
+    s.reapExpiredJobs(c, false);
+    nowSeconds += 3599;
+    s.releaseScheduledJobs(false);
+    BOOST_CHECK(s.retryingJobs.contains(persistentId));
+    nowSeconds++;
+    s.releaseScheduledJobs(false);
+    BOOST_CHECK(!s.retryingJobs.contains(persistentId));
+}
+
+BOOST_AUTO_TEST_CASE(TestJobQueueEarliestDeadlineOrdering)
+{
+    Store s;
+    s.configure(orchestrator::job_queue::ConfigureInput::SetSchedulingMode{
+        orchestrator::job_queue::SchedulingMode::EARLIEST_DEADLINE});
+    Job  noDeadline;
+    auto noDeadlineId = s.addAndRegisterNewJob(noDeadline, false);
+    Job  late;
+    late.deadlineSeconds = 2000;
+    auto lateId          = s.addAndRegisterNewJob(late, false);
+    Job  early;
+    early.deadlineSeconds = 1000;
+    auto earlyId          = s.addAndRegisterNewJob(early, false);
+
+    BOOST_REQUIRE_EQUAL(s.pendingJobs.size(), 3);
+    BOOST_CHECK_EQUAL(s.pendingJobs[0].id, earlyId);
+    BOOST_CHECK_EQUAL(s.pendingJobs[1].id, lateId);
+    BOOST_CHECK_EQUAL(s.pendingJobs[2].id, noDeadlineId);
+}
+
+BOOST_AUTO_TEST_CASE(TestJobQueueSubscriptions)
+{
+    Store s;
+    Job   unwatched;
+    s.addAndRegisterNewJob(unwatched, false);
+    BOOST_CHECK(s.pendingEvents.empty());
+
+    orchestrator::events::SubscriptionFilter filter;
+    filter.priorities = {5};
+    auto subscription = s.subscribe(filter, orchestrator::events::EventStream::kDefaultCapacity);
+    // A subscriber that lets go of its stream is forgotten at the next publish
+    auto dropped   = s.subscribe({}, orchestrator::events::EventStream::kDefaultCapacity);
+    dropped.stream = nullptr;
+    Job  watched;
+    watched.priority = 5;
+    auto watchedId   = s.addAndRegisterNewJob(watched, false);
+    Job  other;
+    s.addAndRegisterNewJob(other, false);
+
+    // Events go out once per publish, and only those matching the filter reach the subscriber
+    s.publishEvents();
+    BOOST_CHECK(s.pendingEvents.empty());
+    BOOST_CHECK_EQUAL(s.subscriptions.size(), 1);
+    auto batch = subscription.stream->take(10);
+    BOOST_REQUIRE_EQUAL(batch.events.size(), 1);
+    BOOST_CHECK_EQUAL(batch.events[0].jobId, watchedId);
+    BOOST_CHECK_EQUAL(batch.events[0].status, aapis::orchestrator::v1::JobStatus::JOB_STATUS_QUEUED);
+
+    // Going active and finishing within one batch leaves only the final status
+    auto promise = dispatch(s, watchedId);
+    s.recordDispatch(watchedId);
+    promise.set_value({aapis::orchestrator::v1::JobStatus::JOB_STATUS_COMPLETE, std::vector<std::string>{}});
+    s.processPendingJobResults(false);
+    s.publishEvents();
+    batch = subscription.stream->take(10);
+    BOOST_REQUIRE_EQUAL(batch.events.size(), 1);
+    BOOST_CHECK_EQUAL(batch.events[0].status, aapis::orchestrator::v1::JobStatus::JOB_STATUS_COMPLETE);
+    BOOST_CHECK_EQUAL(batch.events[0].priority, 5);
+    BOOST_CHECK(!s.jobPriorities.contains(watchedId));
+
+    BOOST_CHECK(s.unsubscribe(subscription.id));
+    BOOST_CHECK(!s.unsubscribe(subscription.id));
+    BOOST_CHECK(subscription.stream->take(10).closed);
+}
+
+BOOST_AUTO_TEST_CASE(TestJobQueueAnswersSubscriptionRequests)
+{
+    Store s;
+
+    orchestrator::job_queue::SubscribeInput unbuffered;
+    unbuffered.capacity = 0;
+    auto refused        = unbuffered.getFuture();
+    s.answerSubscribe(unbuffered);
+    BOOST_CHECK(std::holds_alternative<services::ErrorResult>(refused.get()));
+    BOOST_CHECK(s.subscriptions.empty());
+
+    orchestrator::job_queue::SubscribeInput subscribe;
+    auto                                    subscribed = subscribe.getFuture();
+    s.answerSubscribe(subscribe);
+    auto subscription = std::get<orchestrator::result::SubscriptionResult>(subscribed.get());
+    BOOST_CHECK_EQUAL(s.subscriptions.size(), 1);
+
+    for (bool known : {true, false})
+    {
+        orchestrator::job_queue::UnsubscribeInput unsubscribe;
+        unsubscribe.id = subscription.id;
+        auto answer    = unsubscribe.getFuture();
+        s.answerUnsubscribe(unsubscribe);
+        BOOST_CHECK_EQUAL(std::holds_alternative<orchestrator::result::BooleanResult>(answer.get()), known);
+    }
+    BOOST_CHECK(s.subscriptions.empty());
+}
+
+BOOST_AUTO_TEST_CASE(TestJobQueueCrossShardBlockers)
+{
+    auto  router = std::make_shared<orchestrator::job_queue::ShardRouter>(2);
+    Store shards[2];
+    for (size_t k = 0; k < 2; k++)
+    {
+        shards[k].configure(orchestrator::job_queue::ConfigureInput::SetSharding{router, k});
+    }
+    auto& s0 = shards[0];
+    auto& s1 = shards[1];
+
+    // IDs encode the shard that owns the job
+    Job  blocker;
+    auto blockerId = s0.addAndRegisterNewJob(blocker, false);
+    Job  failing;
+    auto failingId = s0.addAndRegisterNewJob(failing, false);
+    BOOST_CHECK_EQUAL(router->shardOf(blockerId), 0);
+    BOOST_CHECK_EQUAL(router->shardOf(failingId), 0);
+    Job dependent;
+    dependent.relevantBlockers = {blockerId};
+    auto dependentId           = s1.addAndRegisterNewJob(dependent, false);
+    Job  doomed;
+    doomed.independentBlockers = {failingId};
+    auto doomedId              = s1.addAndRegisterNewJob(doomed, false);
+    BOOST_CHECK_EQUAL(router->shardOf(dependentId), 1);
+    // Left to the router, a dependent would join its first blocker instead
+    Job follower;
+    follower.relevantBlockers = {dependentId, blockerId};
+    BOOST_CHECK_EQUAL(router->shardFor(follower), 1);
+
+    // Shard 1's watches reach shard 0 on its next heartbeat, and the outcomes come back on shard 1's
+    s0.processShardMail();
+    BOOST_CHECK_EQUAL(s0.remoteWatchers.size(), 2);
+    auto blockerPromise = dispatch(s0, blockerId);
+    blockerPromise.set_value({kJobSucceeded, std::vector<std::string>{"out"}});
+    auto failingPromise = dispatch(s0, failingId);
+    failingPromise.set_value({aapis::orchestrator::v1::JobStatus::JOB_STATUS_ERROR, std::vector<std::string>{}});
+    s0.processPendingJobResults(false);
+    BOOST_CHECK(s0.remoteWatchers.empty());
+    s1.processShardMail();
+
+    BOOST_REQUIRE_EQUAL(s1.pendingJobs.size(), 1);
+    BOOST_CHECK_EQUAL(s1.pendingJobs[0].id, dependentId);
+    BOOST_CHECK_EQUAL(s1.pendingJobs[0].numBlockers(), 0);
+    BOOST_CHECK(s1.pendingJobs[0].inputs == std::vector<std::string>{"out"});
+    BOOST_CHECK_EQUAL(s1.archivedJobs.at(doomedId).status, aapis::orchestrator::v1::JobStatus::JOB_STATUS_CANCELED);
+
+    // A watch that arrives after its blocker finished still gets the blocker's outputs
+    Job late;
+    late.relevantBlockers = {blockerId};
+    auto lateId           = s1.addAndRegisterNewJob(late, false);
+    s0.processShardMail();
+    s1.processShardMail();
+    auto lateIt = std::ranges::find(s1.pendingJobs, lateId, &Job::id);
+    BOOST_REQUIRE(lateIt != s1.pendingJobs.end());
+    BOOST_CHECK_EQUAL(lateIt->numBlockers(), 0);
+    BOOST_CHECK(lateIt->inputs == std::vector<std::string>{"out"});
+
+    // And a watch on a job nobody knows of cancels its dependents rather than leaving them blocked
+    Job orphan;
+    orphan.independentBlockers = {router->alignId(failingId + 1, 0)};
+    auto orphanId              = s1.addAndRegisterNewJob(orphan, false);
+    s0.processShardMail();
+    s1.processShardMail();
+    BOOST_CHECK_EQUAL(s1.archivedJobs.at(orphanId).status, aapis::orchestrator::v1::JobStatus::JOB_STATUS_CANCELED);
+}
+
+BOOST_AUTO_TEST_CASE(TestJobQueueLateCrossShardWatchOnSpawningBlocker)
+{
+    auto  router = std::make_shared<orchestrator::job_queue::ShardRouter>(2);
+    Store shards[2];
+    for (size_t k = 0; k < 2; k++)
+    {
+        shards[k].configure(orchestrator::job_queue::ConfigureInput::SetSharding{router, k});
+    }
+    auto& s0 = shards[0];
+    auto& s1 = shards[1];
+
+    // The blocker spawns a child and finishes before shard 1's watch reaches shard 0
+    Job  parent;
+    auto parentId = s0.addAndRegisterNewJob(parent, false);
+    Job  dependent;
+    dependent.relevantBlockers = {parentId};
+    auto dependentId           = s1.addAndRegisterNewJob(dependent, false);
+    auto parentPromise         = dispatch(s0, parentId);
+    Job  child;
+    child.inputs = {"child"};
+    parentPromise.set_value({kJobSucceeded, std::vector<Job>{child}});
+    s0.processPendingJobResults(false);
+    BOOST_REQUIRE_EQUAL(s0.pendingJobs.size(), 1);
+    auto childId = s0.pendingJobs.front().id;
+
+    // The late watch is answered with the children, which the watcher now waits on in the parent's place
+    s0.processShardMail();
+    BOOST_CHECK(s0.remoteWatchers.at(childId).contains(1));
+    s1.processShardMail();
+    BOOST_REQUIRE_EQUAL(s1.pendingJobs.size(), 1);
+    BOOST_CHECK(s1.pendingJobs.front().relevantBlockers == std::vector<int64_t>{childId});
+
+    auto childPromise = dispatch(s0, childId);
+    childPromise.set_value({kJobSucceeded, std::vector<std::string>{"from child"}});
+    s0.processPendingJobResults(false);
+    s1.processShardMail();
+    BOOST_REQUIRE_EQUAL(s1.pendingJobs.size(), 1);
+    BOOST_CHECK_EQUAL(s1.pendingJobs.front().id, dependentId);
+    BOOST_CHECK_EQUAL(s1.pendingJobs.front().numBlockers(), 0);
+    BOOST_CHECK(s1.pendingJobs.front().inputs == std::vector<std::string>{"from child"});
+}
+
 BOOST_AUTO_TEST_SUITE_END()
\ No newline at end of file
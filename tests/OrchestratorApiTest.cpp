@@ -0,0 +1,112 @@
+#include <boost/test/unit_test.hpp>
+#include <unistd.h>
+#include <filesystem>
+#include "orchestrator/OrchestratorApi.h"
+#include "orchestrator/Rpc.h"
+
+using namespace orchestrator;
+
+namespace
+{
+
+// An API over a single shard whose services are never reached: only requests the API answers by itself are made
+struct ApiWithoutServices
+{
+    explicit ApiWithoutServices(std::shared_ptr<outputs::OutputStore> outputStore = nullptr)
+        : api({nullptr}, std::make_shared<job_queue::ShardRouter>(1), nullptr, nullptr, nullptr, std::move(outputStore))
+    {
+    }
+
+    rpc::Reply call(rpc::Method method, const std::function<void(rpc::Writer&)>& writeArgs)
+    {
+        rpc::Frame request{.requestId = 1, .code = static_cast<uint8_t>(method), .payload = {}};
+        rpc::Writer writer(request.payload);
+        writeArgs(writer);
+        auto reply = api.handle(request)();
+        BOOST_REQUIRE(reply.has_value());
+        return *reply;
+    }
+
+    OrchestratorApi api;
+};
+
+} // namespace
+
+BOOST_AUTO_TEST_SUITE(TestOrchestratorApi)
+
+BOOST_AUTO_TEST_CASE(TestOrchestratorApiNeedsOneQueuePerShard)
+{
+    BOOST_CHECK_THROW(OrchestratorApi({nullptr}, std::make_shared<job_queue::ShardRouter>(2), nullptr, nullptr),
+                      std::invalid_argument);
+}
+
+BOOST_AUTO_TEST_CASE(TestOrchestratorApiRejectsRequestsItCannotServe)
+{
+    ApiWithoutServices api;
+
+    // Subscriptions are only known once SUBSCRIBE has made them
+    for (auto method : {rpc::Method::NEXT_EVENTS, rpc::Method::UNSUBSCRIBE})
+    {
+        auto reply = api.call(method, [](rpc::Writer& w) {
+            w.i64(42);
+            w.u32(0);
+        });
+        BOOST_CHECK(reply.status == rpc::Status::ERROR);
+        BOOST_CHECK_EQUAL(reply.payload, "No subscription has the requested ID");
+    }
+
+    // Neither agents nor spilled outputs are there unless the daemon was started with them
+    auto agentReply = api.call(rpc::Method::AGENT_POLL, [](rpc::Writer& w) { w.string(""); });
+    BOOST_CHECK(agentReply.status == rpc::Status::ERROR);
+    auto outputReply = api.call(rpc::Method::READ_OUTPUT, [](rpc::Writer& w) {
+        w.string(outputs::OutputStore::kHandlePrefix);
+        w.i64(0);
+        w.u32(1);
+    });
+    BOOST_CHECK(outputReply.status == rpc::Status::ERROR);
+
+    rpc::Frame unknown{.requestId = 1, .code = 0xff, .payload = {}};
+    BOOST_CHECK_THROW(api.api.handle(unknown), std::runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(TestOrchestratorApiReadsSpilledOutputsInChunks)
+{
+    const auto directory =
+        std::filesystem::temp_directory_path() / ("orchestrator-api-outputs-" + std::to_string(getpid()));
+    auto               store = std::make_shared<outputs::OutputStore>(directory.string(), 16);
+    ApiWithoutServices api(store);
+
+    const std::string output = "0123456789abcdefghijklmnopqrstuvwxyz";
+    const auto        handle = store->spill(output);
+    auto              read   = [&](const std::string& handleToRead, int64_t offset, uint32_t maxBytes) {
+        return api.call(rpc::Method::READ_OUTPUT, [&](rpc::Writer& w) {
+            w.string(handleToRead);
+            w.i64(offset);
+            w.u32(maxBytes);
+        });
+    };
+
+    std::string readBack;
+    for (int64_t offset = 0;; offset += 10)
+    {
+        auto reply = read(handle, offset, 10);
+        BOOST_REQUIRE(reply.status == rpc::Status::OK);
+        auto chunk = rpc::Reader(reply.payload).string();
+        if (chunk.empty())
+        {
+            break;
+        }
+        BOOST_CHECK_LE(chunk.size(), 10);
+        readBack += chunk;
+    }
+    BOOST_CHECK_EQUAL(readBack, output);
+
+    BOOST_CHECK(read(handle, -1, 10).status == rpc::Status::ERROR);
+    BOOST_CHECK(read(std::string(outputs::OutputStore::kHandlePrefix) + "missing", 0, 10).status ==
+                rpc::Status::ERROR);
+
+    store->release({handle});
+    std::filesystem::remove_all(directory);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
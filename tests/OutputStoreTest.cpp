@@ -0,0 +1,219 @@
+#include <boost/test/unit_test.hpp>
+#include <unistd.h>
+#include <filesystem>
+#include <thread>
+#include "orchestrator/JobExecutor.h"
+#include "orchestrator/JobQueue.h"
+#include "orchestrator/OutputStore.h"
+
+using namespace orchestrator;
+
+namespace
+{
+
+// The queue treats any non-error result status as success
+constexpr auto kJobSucceeded = aapis::orchestrator::v1::JobStatus::JOB_STATUS_QUEUED;
+
+// A store in a scratch directory of its own, removed again afterwards
+struct ScratchStore
+{
+    explicit ScratchStore(size_t spillThresholdBytes)
+        : directory(std::filesystem::temp_directory_path() /
+                    ("orchestrator-outputs-" + std::to_string(getpid()) + "-" + std::to_string(spillThresholdBytes)))
+        , store(std::make_shared<outputs::OutputStore>(directory.string(), spillThresholdBytes))
+    {
+    }
+    ~ScratchStore()
+    {
+        std::filesystem::remove_all(directory);
+    }
+
+    std::filesystem::path                 directory;
+    std::shared_ptr<outputs::OutputStore> store;
+};
+
+} // namespace
+
+BOOST_AUTO_TEST_SUITE(TestOutputStore)
+
+BOOST_AUTO_TEST_CASE(TestOutputStoreSpillsAndReadsBack)
+{
+    ScratchStore scratch(1024);
+    auto&        store = *scratch.store;
+
+    const std::string large(100000, 'x');
+    auto              handle = store.spill(large);
+    BOOST_CHECK(outputs::OutputStore::isHandle(handle));
+    BOOST_CHECK_EQUAL(outputs::OutputStore::spilledSize(handle).value(), large.size());
+    BOOST_CHECK(store.open(handle).view() == large);
+    BOOST_CHECK_EQUAL(store.read(handle, 99990, 100), std::string(10, 'x'));
+    BOOST_CHECK(store.read(handle, 200000, 100).empty());
+    BOOST_CHECK_EQUAL(store.load(handle), large);
+
+    // Identical content is stored once, under the same handle
+    BOOST_CHECK_EQUAL(store.spill(large), handle);
+    BOOST_CHECK_EQUAL(std::distance(std::filesystem::directory_iterator(scratch.directory),
+                                    std::filesystem::directory_iterator()),
+                      1);
+
+    // Only outputs at or above the threshold are spilled, and only once
+    std::vector<std::string> jobOutputs{"small", std::string(1024, 'y'), handle};
+    BOOST_CHECK_EQUAL(store.spillLarge(jobOutputs).size(), 1);
+    BOOST_CHECK_EQUAL(jobOutputs[0], "small");
+    BOOST_CHECK(outputs::OutputStore::isHandle(jobOutputs[1]));
+    BOOST_CHECK_EQUAL(jobOutputs[2], handle);
+    BOOST_CHECK_EQUAL(store.load("small"), "small");
+
+    std::map<std::string, int64_t> metrics;
+    store.addStats(metrics);
+    BOOST_CHECK_EQUAL(metrics["output_store.spills"], 2);
+    BOOST_CHECK_EQUAL(metrics["output_store.spilled_bytes"], 101024);
+    BOOST_CHECK_EQUAL(metrics["output_store.duplicates"], 1);
+
+    // Files go once the last reference to them (each spill holds one) is given up, and only then
+    store.retain({"small", handle});
+    store.release({handle, handle});
+    BOOST_CHECK(store.open(handle).view() == large);
+    store.release({handle});
+    BOOST_CHECK_THROW(store.open(handle), std::system_error);
+    BOOST_CHECK(store.open(jobOutputs[1]).view() == std::string(1024, 'y'));
+    store.addStats(metrics);
+    BOOST_CHECK_EQUAL(metrics["output_store.removals"], 1);
+
+    // Spilled outputs are named by the SHA-256 of their content
+    BOOST_CHECK_EQUAL(store.spill("abc"),
+                      "orchestrator-output:ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad-3");
+    BOOST_CHECK_EQUAL(store.spill(std::string(1000000, 'a')),
+                      "orchestrator-output:cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0-1000000");
+
+    // Handles can't be made to point anywhere but into the store
+    BOOST_CHECK(!outputs::OutputStore::isHandle("orchestrator-output:../../etc/passwd"));
+    BOOST_CHECK_THROW(store.open("orchestrator-output:../../etc/passwd"), std::invalid_argument);
+    BOOST_CHECK_THROW(store.open("orchestrator-output:" + std::string(64, '0') + "-5"), std::system_error);
+}
+
+BOOST_AUTO_TEST_CASE(TestJobQueueHandsDependentsSpilledOutputs)
+{
+    ScratchStore     scratch(1024);
+    job_queue::Store s;
+    s.configure(job_queue::ConfigureInput::SetOutputStore{scratch.store});
+
+    Job  blocker;
+    auto blockerId = s.addAndRegisterNewJob(blocker, false);
+    Job  dependent;
+    dependent.relevantBlockers = {blockerId};
+    s.addAndRegisterNewJob(dependent, false);
+
+    std::promise<result::JobResult> promise;
+    std::erase_if(s.pendingJobs, [&](const Job& j) { return j.id == blockerId; });
+    s.pendingJobResults.emplace(blockerId, promise.get_future());
+    const std::string large(4096, 'z');
+    promise.set_value({kJobSucceeded, std::vector<std::string>{"small", large}});
+
+    // The output is spilled off the queue's thread, and the result only taken in once it has been
+    s.processPendingJobResults(false);
+    BOOST_CHECK(s.hasActiveJob(blockerId));
+    while (!s.pendingSpills.empty())
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        s.processPendingJobResults(false);
+    }
+    BOOST_CHECK(!s.hasActiveJob(blockerId));
+
+    BOOST_REQUIRE_EQUAL(s.pendingJobs.size(), 1);
+    const auto& inputs = s.pendingJobs.front().inputs;
+    BOOST_REQUIRE_EQUAL(inputs.size(), 2);
+    BOOST_CHECK_EQUAL(inputs[0], "small");
+    BOOST_CHECK(outputs::OutputStore::isHandle(inputs[1]));
+    BOOST_CHECK_EQUAL(scratch.store->load(inputs[1]), large);
+
+    auto metrics = s.collectStats().metrics;
+    BOOST_CHECK_EQUAL(metrics["inputs.held_bytes"], 5);
+    BOOST_CHECK_EQUAL(metrics["inputs.spilled_bytes"], 4096);
+    BOOST_CHECK_EQUAL(metrics["output_store.spills"], 1);
+
+    // Whatever runs the dependent gets the blocker's outputs themselves, not the handle standing in for one
+    job_executor::Store executor;
+    executor.configure(job_executor::ConfigureInput::SetOutputStore{scratch.store});
+    std::vector<std::string> seenInputs;
+    executor.runner = [&](const Job& job) {
+        seenInputs = job.inputs;
+        return result::JobResult{kJobSucceeded, job.inputs};
+    };
+    job_executor::ExecuteInput executeInput;
+    executeInput.job = s.pendingJobs.front();
+    auto future      = executeInput.getFuture();
+    executor.execute(executeInput);
+    auto executing = future.get();
+    BOOST_REQUIRE(std::holds_alternative<result::FutureJobResult>(executing));
+    BOOST_CHECK(std::get<result::FutureJobResult>(executing).get().resultStatus == kJobSucceeded);
+    BOOST_CHECK(seenInputs == std::vector<std::string>({"small", large}));
+
+    // A handle to an output that is no longer stored fails the job rather than running it on the handle
+    executeInput     = job_executor::ExecuteInput{};
+    executeInput.job = s.pendingJobs.front();
+    executeInput.job.id++;
+    std::filesystem::remove_all(scratch.directory);
+    std::filesystem::create_directories(scratch.directory);
+    future = executeInput.getFuture();
+    executor.execute(executeInput);
+    executing = future.get();
+    BOOST_REQUIRE(std::holds_alternative<result::FutureJobResult>(executing));
+    BOOST_CHECK(std::get<result::FutureJobResult>(executing).get().resultStatus ==
+                aapis::orchestrator::v1::JobStatus::JOB_STATUS_ERROR);
+}
+
+BOOST_AUTO_TEST_CASE(TestJobQueueRemovesSpilledOutputsOnceUnused)
+{
+    ScratchStore     scratch(1024);
+    job_queue::Store s;
+    s.configure(job_queue::ConfigureInput::SetOutputStore{scratch.store});
+    s.configure(job_queue::ConfigureInput::SetResultCache{.capacityBytes = 1 << 20, .diskTier = false});
+
+    auto finish = [&s](int64_t jobId, std::vector<std::string> outputs) {
+        std::promise<result::JobResult> promise;
+        std::erase_if(s.pendingJobs, [&](const Job& j) { return j.id == jobId; });
+        s.pendingJobResults.emplace(jobId, promise.get_future());
+        promise.set_value({kJobSucceeded, std::move(outputs)});
+        do
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            s.processPendingJobResults(false);
+        } while (!s.pendingSpills.empty());
+    };
+    auto numFiles = [&scratch]() {
+        return std::distance(std::filesystem::directory_iterator(scratch.directory),
+                             std::filesystem::directory_iterator());
+    };
+
+    // An output nothing takes in is removed as soon as it has been passed on
+    Job  loner;
+    auto lonerId = s.addAndRegisterNewJob(loner, false);
+    finish(lonerId, {std::string(2048, 'a')});
+    BOOST_CHECK_EQUAL(numFiles(), 0);
+
+    // One dependents take in lasts as long as the last of them, and as long as the result cache holds it
+    Job  blocker;
+    blocker.inputs = {"cached"};
+    auto blockerId = s.addAndRegisterNewJob(blocker, false);
+    s.inFlightCacheKeys[blockerId] = ResultCache::keyOf(0, {"cached"});
+    std::vector<int64_t> dependentIds;
+    for (int k = 0; k < 2; k++)
+    {
+        Job dependent;
+        dependent.relevantBlockers = {blockerId};
+        dependentIds.push_back(s.addAndRegisterNewJob(dependent, false));
+    }
+    finish(blockerId, {std::string(2048, 'b')});
+    BOOST_CHECK_EQUAL(numFiles(), 1);
+    finish(dependentIds[0], {});
+    s.cancelJobs(dependentIds[1]);
+    BOOST_CHECK_EQUAL(numFiles(), 1);
+    s.configure(job_queue::ConfigureInput::SetResultCache{.capacityBytes = 0, .diskTier = false});
+    BOOST_CHECK_EQUAL(numFiles(), 0);
+    BOOST_CHECK(s.heldInputHandles.empty());
+    BOOST_CHECK(s.heldResultHandles.empty());
+    BOOST_CHECK_EQUAL(s.collectStats().metrics["output_store.removals"], 2);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
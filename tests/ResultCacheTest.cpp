@@ -0,0 +1,85 @@
+#include <boost/test/unit_test.hpp>
+#include "orchestrator/ResultCache.h"
+
+using orchestrator::ResultCache;
+
+namespace
+{
+
+orchestrator::result::JobResult outputsResult(const std::vector<std::string>& outputs)
+{
+    return {aapis::orchestrator::v1::JobStatus::JOB_STATUS_QUEUED, outputs};
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_SUITE(TestResultCache)
+
+BOOST_AUTO_TEST_CASE(TestResultCacheInputHashing)
+{
+    BOOST_CHECK_EQUAL(ResultCache::hashInputs({"a", "bc"}), ResultCache::hashInputs({"a", "bc"}));
+    BOOST_CHECK_NE(ResultCache::hashInputs({"a", "bc"}), ResultCache::hashInputs({"ab", "c"}));
+    BOOST_CHECK_NE(ResultCache::hashInputs({}), ResultCache::hashInputs({""}));
+}
+
+BOOST_AUTO_TEST_CASE(TestResultCacheLeastRecentlyUsedEviction)
+{
+    const auto one   = ResultCache::keyOf(0, {"1"});
+    const auto two   = ResultCache::keyOf(0, {"2"});
+    const auto three = ResultCache::keyOf(0, {"3"});
+
+    ResultCache cache;
+    BOOST_CHECK(!cache.enabled());
+    BOOST_CHECK(cache.insert(one, outputsResult({"one"})).empty());
+    BOOST_CHECK(!cache.lookup(one).has_value());
+
+    // Room for two single-input, single-output entries but not three
+    auto oneEntryBytes = sizeof(ResultCache::Entry) + 2 * sizeof(std::string) + 1 + 3;
+    cache.setCapacity(2 * oneEntryBytes + 1);
+    cache.insert(one, outputsResult({"one"}));
+    cache.insert(two, outputsResult({"two"}));
+    BOOST_REQUIRE(cache.lookup(one).has_value());
+
+    auto evicted = cache.insert(three, outputsResult({"bee"}));
+    BOOST_REQUIRE_EQUAL(evicted.size(), 1);
+    BOOST_CHECK(evicted.front().first == two);
+    BOOST_CHECK(cache.lookup(one).has_value());
+    BOOST_CHECK(!cache.lookup(two).has_value());
+    BOOST_CHECK_EQUAL(cache.stats().hits, 2);
+    BOOST_CHECK_EQUAL(cache.stats().misses, 2);
+    BOOST_CHECK_EQUAL(cache.stats().evictions, 1);
+
+    // Failed jobs and spawned child jobs are never replayed
+    BOOST_CHECK(!ResultCache::isCacheable({aapis::orchestrator::v1::JobStatus::JOB_STATUS_ERROR, {}}));
+    BOOST_CHECK(!ResultCache::isCacheable(
+        {aapis::orchestrator::v1::JobStatus::JOB_STATUS_QUEUED, std::vector<orchestrator::Job>{}}));
+}
+
+BOOST_AUTO_TEST_CASE(TestResultCacheHashCollisionsMiss)
+{
+    ResultCache cache;
+    cache.setCapacity(1 << 20);
+
+    // Forge a key whose hash matches a cached entry's but whose inputs don't
+    const auto cached = ResultCache::keyOf(0, {"cached"});
+    auto       forged = ResultCache::keyOf(0, {"different"});
+    forged.hash       = cached.hash;
+    cache.insert(cached, outputsResult({"cached output"}));
+
+    BOOST_CHECK(!cache.lookup(forged).has_value());
+    BOOST_CHECK_EQUAL(cache.stats().collisions, 1);
+    BOOST_REQUIRE(cache.lookup(cached).has_value());
+    BOOST_CHECK(std::get<std::vector<std::string>>(cache.lookup(cached)->outputs) ==
+                std::vector<std::string>{"cached output"});
+
+    // The later of two colliding keys takes the slot, handing back the entry it replaced
+    auto replaced = cache.insert(forged, outputsResult({"forged output"}));
+    BOOST_REQUIRE_EQUAL(replaced.size(), 1);
+    BOOST_CHECK(replaced.front().first == cached);
+    BOOST_CHECK(!cache.contains(cached));
+    BOOST_CHECK(cache.contains(forged));
+    BOOST_CHECK(!cache.lookup(cached).has_value());
+    BOOST_CHECK(cache.lookup(forged).has_value());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,195 @@
+#include <boost/test/unit_test.hpp>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <cstring>
+#include <thread>
+#include "orchestrator/RpcClient.h"
+#include "orchestrator/RpcServer.h"
+#include "orchestrator/ShmClient.h"
+#include "orchestrator/ShmRing.h"
+
+using namespace orchestrator;
+
+BOOST_AUTO_TEST_SUITE(TestRpc)
+
+BOOST_AUTO_TEST_CASE(TestRpcJobRoundTrip)
+{
+    Job job;
+    job.id                  = 42;
+    job.status              = aapis::orchestrator::v1::JobStatus::JOB_STATUS_BLOCKED;
+    job.priority            = -3;
+    job.workflowId          = 11;
+    job.kind                = 2;
+    job.deadlineSeconds     = 1700000000;
+    job.independentBlockers = {7, 8};
+    job.relevantBlockers    = {9};
+    job.inputs              = {"a", "", std::string(300, 'x')};
+
+    std::string payload;
+    rpc::Writer(payload).jobs({job, Job{}});
+
+    std::string buffer;
+    rpc::appendFrame(buffer, 5, static_cast<uint8_t>(rpc::Method::PUSH), payload);
+    rpc::Frame frame;
+    BOOST_CHECK_EQUAL(rpc::parseFrame(std::string_view(buffer).substr(0, buffer.size() - 1), frame), 0);
+    BOOST_CHECK_EQUAL(rpc::parseFrame(buffer, frame), buffer.size());
+    BOOST_CHECK_EQUAL(frame.requestId, 5);
+
+    rpc::Reader reader(frame.payload);
+    auto        jobs = reader.jobs();
+    BOOST_REQUIRE_EQUAL(jobs.size(), 2);
+    BOOST_CHECK_EQUAL(jobs[0].id, job.id);
+    BOOST_CHECK(jobs[0].status == job.status);
+    BOOST_CHECK_EQUAL(jobs[0].priority, job.priority);
+    BOOST_CHECK_EQUAL(jobs[0].workflowId, job.workflowId);
+    BOOST_CHECK_EQUAL(jobs[0].kind, job.kind);
+    BOOST_CHECK_EQUAL(jobs[0].deadlineSeconds, job.deadlineSeconds);
+    BOOST_CHECK(jobs[0].independentBlockers == job.independentBlockers);
+    BOOST_CHECK(jobs[0].relevantBlockers == job.relevantBlockers);
+    BOOST_CHECK(jobs[0].inputs == job.inputs);
+    BOOST_CHECK_EQUAL(jobs[1].id, -1);
+
+    // A truncated payload must not be mistaken for a shorter list
+    rpc::Reader truncated(std::string_view(frame.payload).substr(0, frame.payload.size() - 1));
+    BOOST_CHECK_THROW(truncated.jobs(), std::runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(TestRpcPipelinedRepliesInOrder)
+{
+    static constexpr uint32_t kNumRequests = 500;
+
+    // Every third request takes a few polls to become ready, so replies behind it have to wait their turn
+    rpc::RpcServer server(0, [](rpc::Frame& request) -> rpc::PendingReply {
+        if (request.payload == "throw")
+        {
+            throw std::runtime_error("bad request");
+        }
+        auto pollsLeft = std::make_shared<int>(request.requestId % 3 == 0 ? 3 : 0);
+        return [pollsLeft, payload = request.payload]() -> std::optional<rpc::Reply> {
+            if ((*pollsLeft)-- > 0)
+            {
+                return std::nullopt;
+            }
+            return rpc::Reply{rpc::Status::OK, payload};
+        };
+    });
+    std::thread serving([&server]() { server.run(); });
+
+    {
+        rpc::RpcClient client(server.port());
+        for (uint32_t k = 0; k < kNumRequests; k++)
+        {
+            client.send(rpc::Method::STATS, std::to_string(k));
+        }
+        client.flush();
+        for (uint32_t k = 0; k < kNumRequests; k++)
+        {
+            auto reply = client.receive();
+            BOOST_CHECK_EQUAL(reply.requestId, k + 1);
+            BOOST_CHECK_EQUAL(reply.code, static_cast<uint8_t>(rpc::Status::OK));
+            BOOST_CHECK_EQUAL(reply.payload, std::to_string(k));
+        }
+
+        auto reply = client.call(rpc::Method::STATS, "throw");
+        BOOST_CHECK_EQUAL(reply.code, static_cast<uint8_t>(rpc::Status::ERROR));
+        BOOST_CHECK_EQUAL(reply.payload, "bad request");
+    }
+
+    // Connections are recycled once closed
+    rpc::RpcClient client(server.port());
+    BOOST_CHECK_EQUAL(client.call(rpc::Method::STATS, "again").payload, "again");
+
+    server.stop();
+    serving.join();
+}
+
+BOOST_AUTO_TEST_CASE(TestRpcSharedMemoryChannel)
+{
+    static constexpr uint32_t kNumRequests  = 3000;
+    static constexpr size_t   kRingCapacity = 4096;
+
+    const std::string socketPath = "/tmp/orchestrator-rpc-test-" + std::to_string(getpid()) + ".sock";
+    rpc::RpcServer    server(0, [](rpc::Frame& request) -> rpc::PendingReply {
+        return [payload = request.payload]() { return std::optional<rpc::Reply>{{rpc::Status::OK, payload}}; };
+    });
+    server.listenUnix(socketPath);
+    std::thread serving([&server]() { server.run(); });
+
+    // Plain requests work over the Unix-domain socket too
+    rpc::RpcClient socketClient(socketPath);
+    BOOST_CHECK_EQUAL(socketClient.call(rpc::Method::STATS, "over the socket").payload, "over the socket");
+
+    // Pipeline far more than the small rings hold, so both of them wrap and fill up many times over
+    {
+        rpc::ShmClient client(socketPath, kRingCapacity, kRingCapacity);
+        for (uint32_t k = 0; k < kNumRequests; k++)
+        {
+            client.send(rpc::Method::STATS, std::string(k % 200, 'a') + std::to_string(k));
+        }
+        for (uint32_t k = 0; k < kNumRequests; k++)
+        {
+            auto reply = client.receive();
+            BOOST_REQUIRE_EQUAL(reply.requestId, k + 1);
+            BOOST_CHECK_EQUAL(reply.payload, std::string(k % 200, 'a') + std::to_string(k));
+        }
+        BOOST_CHECK_THROW(client.send(rpc::Method::STATS, std::string(kRingCapacity, 'a')), std::invalid_argument);
+    }
+
+    // Attaching without passing the channel's file descriptors is refused
+    BOOST_CHECK_EQUAL(socketClient.call(rpc::Method::ATTACH_SHM, "").code, static_cast<uint8_t>(rpc::Status::ERROR));
+
+    // As is attaching a memfd the client could still resize under the server's mapping
+    {
+        const int    memFd      = memfd_create("unsealed", MFD_CLOEXEC);
+        const int    bellFd     = eventfd(0, EFD_CLOEXEC);
+        const size_t regionSize = rpc::ShmChannelLayout{kRingCapacity, kRingCapacity}.regionSize();
+        std::string  payload;
+        rpc::Writer  writer(payload);
+        BOOST_REQUIRE_EQUAL(ftruncate(memFd, static_cast<off_t>(regionSize)), 0);
+        writer.i64(kRingCapacity);
+        writer.i64(kRingCapacity);
+        const auto reply = socketClient.callPassingFds(rpc::Method::ATTACH_SHM, payload, {memFd, bellFd, bellFd});
+        BOOST_CHECK_EQUAL(reply.code, static_cast<uint8_t>(rpc::Status::ERROR));
+        close(memFd);
+        close(bellFd);
+    }
+
+    server.stop();
+    serving.join();
+}
+
+BOOST_AUTO_TEST_CASE(TestShmRingIgnoresScribbledHeader)
+{
+    static constexpr size_t kRingCapacity = 256;
+
+    alignas(64) char region[1024];
+    BOOST_REQUIRE_LE(rpc::ShmRing::regionSize(kRingCapacity), sizeof(region));
+    rpc::ShmRing producer(region, kRingCapacity, true);
+    rpc::ShmRing consumer(region, kRingCapacity, false);
+    auto*        header = reinterpret_cast<rpc::ShmRing::Header*>(region);
+    rpc::Frame   frame;
+
+    // The capacity in shared memory is only checked when attaching, not relied on afterwards
+    BOOST_REQUIRE(producer.tryWrite(1, 0, "first"));
+    header->capacity = 0;
+    BOOST_REQUIRE(consumer.tryRead(frame));
+    BOOST_CHECK_EQUAL(frame.payload, "first");
+    BOOST_CHECK_EQUAL(consumer.capacity(), kRingCapacity);
+    BOOST_CHECK_THROW(rpc::ShmRing(region, kRingCapacity, false), std::runtime_error);
+
+    // Cursors pushed out of range by the other side are refused rather than followed out of bounds
+    header->head.store(1000 * kRingCapacity);
+    BOOST_CHECK_THROW(consumer.tryRead(frame), std::runtime_error);
+    header->tail.store(1000 * kRingCapacity);
+    BOOST_CHECK_THROW(producer.tryWrite(2, 0, "second"), std::runtime_error);
+
+    // As is a record claiming to be bigger than what was written
+    rpc::ShmRing fresh(region, kRingCapacity, true);
+    BOOST_REQUIRE(fresh.tryWrite(3, 0, "third"));
+    const uint32_t hugePayload = 1 << 20;
+    std::memcpy(region + sizeof(rpc::ShmRing::Header), &hugePayload, sizeof(hugePayload));
+    BOOST_CHECK_THROW(rpc::ShmRing(region, kRingCapacity, false).tryRead(frame), std::runtime_error);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
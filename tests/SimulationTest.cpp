@@ -0,0 +1,105 @@
+#include <boost/test/unit_test.hpp>
+#include <sstream>
+#include "orchestrator/Simulation.h"
+
+using namespace orchestrator;
+
+BOOST_AUTO_TEST_SUITE(TestSimulation)
+
+BOOST_AUTO_TEST_CASE(TestSimulationRunsAreDeterministic)
+{
+    simulation::WorkloadModel model{.numJobs            = 2000,
+                                    .jobsPerSecond      = 2000,
+                                    .meanRunMillis      = 5,
+                                    .blockedFraction    = 0.4,
+                                    .numPriorities      = 3,
+                                    .failureProbability = 0.02,
+                                    .seed               = 7};
+    simulation::SimulationConfig config{.numSlots = 8};
+
+    const auto trace  = simulation::generateTrace(model);
+    const auto first  = simulation::Simulation(trace, config).run();
+    const auto second = simulation::Simulation(trace, config).run();
+
+    auto metrics = first.metrics;
+    BOOST_CHECK_EQUAL(metrics["sim.jobs.pushed"], 2000);
+    BOOST_CHECK_EQUAL(metrics["sim.jobs.stuck"], 0);
+    BOOST_CHECK_EQUAL(metrics["sim.jobs.completed"] + metrics["sim.jobs.failed"] + metrics["sim.jobs.canceled"], 2000);
+    BOOST_CHECK_GT(metrics["sim.jobs.failed"], 0);
+    BOOST_CHECK_GT(metrics["sim.throughput_jobs_per_s"], 0);
+    BOOST_CHECK_EQUAL(metrics["sim.push_to_finish_us.count"], 2000);
+
+    // Everything measured on the virtual clock comes out the same every time
+    BOOST_CHECK(first.dispatchOrder == second.dispatchOrder);
+    for (const auto& name : {"sim.virtual_us",
+                             "sim.heartbeats",
+                             "sim.jobs.canceled",
+                             "sim.push_to_finish_us.p50",
+                             "sim.push_to_finish_us.p99",
+                             "push_to_dispatch_us.p99",
+                             "dispatch_to_completion_us.max",
+                             "executor_rejections"})
+    {
+        BOOST_CHECK_MESSAGE(first.metrics.at(name) == second.metrics.at(name), name);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(TestSimulationFollowsDependenciesSlotsAndFailures)
+{
+    // Jobs 1 and 2 take turns on the only slot, job 3 waits for job 1, job 4 fails and takes job 5 down with it, and
+    // job 6's blockers are respectively unknown and already done by the time it is pushed
+    std::istringstream traceText("# push_us key priority kind run_us ok|error relevant independent\n"
+                                 "0 1 0 0 100000 ok - -\n"
+                                 "0 2 0 0 100000 ok - -\n"
+                                 "0 3 0 0 10000 ok 1 -\n"
+                                 "\n"
+                                 "300000 4 0 0 10000 error - -\n"
+                                 "300000 5 0 0 10000 ok - 4\n"
+                                 "300000 6 0 0 10000 ok 99 3\n");
+    auto               report  = simulation::Simulation(simulation::readTrace(traceText), {.numSlots = 1}).run();
+    auto&              metrics = report.metrics;
+
+    BOOST_CHECK(report.dispatchOrder == std::vector<int64_t>({1, 2, 3, 4, 6}));
+    BOOST_CHECK_EQUAL(metrics["sim.jobs.completed"], 4);
+    BOOST_CHECK_EQUAL(metrics["sim.jobs.failed"], 1);
+    BOOST_CHECK_EQUAL(metrics["sim.jobs.canceled"], 1);
+    BOOST_CHECK_EQUAL(metrics["sim.jobs.stuck"], 0);
+    BOOST_CHECK_EQUAL(metrics["sim.blockers_dropped"], 2);
+    BOOST_CHECK_EQUAL(metrics["sim.virtual_us"], 320000);
+    BOOST_CHECK_GT(metrics["executor_rejections"], 0);
+
+    // The idle stretches between pushes and results are skipped rather than stepped through
+    BOOST_CHECK_LT(metrics["sim.heartbeats"], 32);
+}
+
+BOOST_AUTO_TEST_CASE(TestTracesRoundTripThroughText)
+{
+    const auto        trace = simulation::generateTrace({.numJobs = 100, .failureProbability = 0.1, .seed = 3});
+    std::stringstream traceText;
+    simulation::writeTrace(traceText, trace);
+    const auto readBack = simulation::readTrace(traceText);
+
+    BOOST_REQUIRE_EQUAL(readBack.size(), trace.size());
+    for (size_t k = 0; k < trace.size(); k++)
+    {
+        BOOST_CHECK_EQUAL(readBack[k].key, trace[k].key);
+        BOOST_CHECK_EQUAL(readBack[k].pushMicros, trace[k].pushMicros);
+        BOOST_CHECK_EQUAL(readBack[k].runMicros, trace[k].runMicros);
+        BOOST_CHECK_EQUAL(readBack[k].fails, trace[k].fails);
+        BOOST_CHECK(readBack[k].relevantBlockers == trace[k].relevantBlockers);
+        BOOST_CHECK(readBack[k].independentBlockers == trace[k].independentBlockers);
+    }
+
+    for (const auto* malformed : {"0 1 0 0 10 ok -\n",
+                                  "0 1 0 0 10 maybe - -\n",
+                                  "0 1 0 0 ten ok - -\n",
+                                  "0 1 0 0 10 ok 2,x -\n",
+                                  "5 1 0 0 10 ok - -\n0 2 0 0 10 ok - -\n",
+                                  "0 1 0 0 10 ok - -\n0 1 0 0 10 ok - -\n"})
+    {
+        std::istringstream malformedText(malformed);
+        BOOST_CHECK_THROW(simulation::readTrace(malformedText), std::invalid_argument);
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,31 @@
+#include <boost/test/unit_test.hpp>
+#include "orchestrator/Stats.h"
+
+using orchestrator::stats::LatencyHistogram;
+
+BOOST_AUTO_TEST_SUITE(TestStats)
+
+BOOST_AUTO_TEST_CASE(TestLatencyHistogramPercentiles)
+{
+    LatencyHistogram histogram;
+    BOOST_CHECK_EQUAL(histogram.percentile(50.0), 0);
+
+    for (uint64_t v = 1; v <= 10000; v++)
+    {
+        histogram.record(v);
+    }
+    BOOST_CHECK_EQUAL(histogram.count(), 10000);
+    BOOST_CHECK_EQUAL(histogram.max(), 10000);
+
+    // Bucket bounds are within 1/16th of the true value
+    for (double p : {50.0, 90.0, 99.0})
+    {
+        const double exact = p / 100.0 * 10000.0;
+        const double found = static_cast<double>(histogram.percentile(p));
+        BOOST_CHECK_GE(found, exact);
+        BOOST_CHECK_LE(found, exact * (1.0 + 1.0 / 16.0) + 1.0);
+    }
+    BOOST_CHECK_EQUAL(histogram.percentile(100.0), 10000);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
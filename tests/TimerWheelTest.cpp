@@ -0,0 +1,73 @@
+#include <boost/test/unit_test.hpp>
+#include <random>
+#include "orchestrator/TimerWheel.h"
+
+using orchestrator::TimerWheel;
+
+BOOST_AUTO_TEST_SUITE(TestTimerWheel)
+
+BOOST_AUTO_TEST_CASE(TestTimerWheelFiresOnTime)
+{
+    static constexpr int64_t kStartSeconds = 1700000000;
+    static constexpr size_t  kNumTimers    = 2000;
+
+    TimerWheel wheel;
+    BOOST_CHECK_THROW(wheel.schedule(0, kStartSeconds), std::logic_error);
+    BOOST_CHECK(wheel.advance(kStartSeconds).empty());
+
+    // Spread expiry times across every level of the wheel and beyond it
+    std::mt19937                           rng(7);
+    std::uniform_int_distribution<int64_t> delayDist(1, int64_t{1} << 26);
+    std::vector<int64_t>                   expiries;
+    for (size_t k = 0; k < kNumTimers; k++)
+    {
+        expiries.push_back(kStartSeconds + (k % 2 == 0 ? 1 + delayDist(rng) % 5000 : delayDist(rng)));
+        wheel.schedule(k, expiries.back());
+    }
+    BOOST_CHECK_EQUAL(wheel.size(), kNumTimers);
+
+    // Advance in irregular strides, checking that each timer fires in the first stride that reaches its expiry
+    std::uniform_int_distribution<int64_t> strideDist(1, 40000);
+    std::vector<bool>                      fired(kNumTimers, false);
+    int64_t                                prevSeconds = kStartSeconds;
+    while (wheel.size() > 0)
+    {
+        int64_t nowSeconds = prevSeconds + (prevSeconds - kStartSeconds < 10000 ? 1 : strideDist(rng));
+        for (auto id : wheel.advance(nowSeconds))
+        {
+            BOOST_REQUIRE(!fired[id]);
+            fired[id] = true;
+            BOOST_CHECK_GT(expiries[id], prevSeconds);
+            BOOST_CHECK_LE(expiries[id], nowSeconds);
+        }
+        prevSeconds = nowSeconds;
+    }
+    BOOST_CHECK(std::all_of(fired.begin(), fired.end(), [](bool f) { return f; }));
+
+    // Times already in the past fire on the very next advance
+    wheel.schedule(kNumTimers, kStartSeconds);
+    BOOST_CHECK_EQUAL(wheel.advance(prevSeconds).size(), 1);
+}
+
+BOOST_AUTO_TEST_CASE(TestTimerWheelSkipsOverEmptySlots)
+{
+    static constexpr int64_t kStartSeconds = 1700000000;
+
+    // Stepping through these one second at a time would take far longer than the test is given
+    TimerWheel wheel;
+    wheel.advance(kStartSeconds);
+    BOOST_CHECK(wheel.advance(kStartSeconds + (int64_t{1} << 40)).empty());
+
+    const int64_t nowSeconds = kStartSeconds + (int64_t{1} << 40);
+    wheel.schedule(1, nowSeconds + 100);
+    wheel.schedule(2, nowSeconds + (int64_t{1} << 30));
+    wheel.schedule(3, nowSeconds + (int64_t{1} << 30) + 1);
+    BOOST_CHECK(wheel.advance(nowSeconds + 99).empty());
+    BOOST_CHECK(wheel.advance(nowSeconds + 100) == std::vector<int64_t>{1});
+    BOOST_CHECK(wheel.advance(nowSeconds + (int64_t{1} << 30) - 1).empty());
+    BOOST_CHECK(wheel.advance(nowSeconds + (int64_t{1} << 30)) == std::vector<int64_t>{2});
+    BOOST_CHECK(wheel.advance(nowSeconds + (int64_t{1} << 40)) == std::vector<int64_t>{3});
+    BOOST_CHECK_EQUAL(wheel.size(), 0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()